@@ -0,0 +1,166 @@
+/*
+ * This benchmark executes SPS (integer swap) with the array split across several independent pools,
+ * each one with its own file, allocator and clock, and each thread doing its transactions on one of them.
+ * Only the PTMs with pools (PTM_POOL in ptm.h) can run it.
+ */
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <memory>
+#include <cstdlib>      // Needed by aligned_alloc()
+#include "PBenchmarkSPS.hpp"
+#include "ptms/ptm.h"
+
+#ifndef PTM_POOL
+#error "This benchmark needs a PTM with pools, like TrinityTL2"
+#endif
+
+#define DATA_FILE "data/psps-integer-pools-" PTM_FILEXT ".txt"
+
+
+// PTM_POOL has over-aligned members, which operator new only honors from c++17 onwards,
+// so the pools are constructed in memory from aligned_alloc() and released with this deleter
+using Pool = PTM_POOL;
+
+struct PoolDeleter {
+    void operator()(Pool* pool) const {
+        pool->~Pool();
+        free(pool);
+    }
+};
+
+using PoolPtr = std::unique_ptr<Pool,PoolDeleter>;
+
+PoolPtr makePool(const char* filename, uint64_t regionSize, uint64_t initialSize) {
+    void* mem = aligned_alloc(alignof(Pool), sizeof(Pool));
+    if (mem == nullptr) {
+        std::cout << "ERROR: could not allocate the pool object\n";
+        std::abort();
+    }
+    return PoolPtr(new (mem) Pool(filename, regionSize, initialSize));
+}
+
+/*
+ * Runs the swaps for 'testLength' with 'numThreads', on an array of arraySize integers split over 'numPools' pools.
+ * Thread i works on the pool i%numPools. Returns the number of swaps per second.
+ */
+uint64_t benchmarkSPSPools(int numPools, int numThreads, seconds testLength, long numSwapsPerTx) {
+    // Every run starts with new files, so that the pools don't grow from one run to the next
+    std::vector<PoolPtr> pools;
+    for (int ip = 0; ip < numPools; ip++) {
+        std::string filename = "/dev/shm/" PTM_FILEXT "_pool" + std::to_string(ip) + "_shared";
+        std::remove(filename.c_str());
+        pools.push_back(makePool(filename.c_str(), PM_REGION_SIZE, PM_REGION_SIZE/8));
+    }
+    const uint64_t poolArraySize = arraySize/numPools;
+    for (int ip = 0; ip < numPools; ip++) {
+        PTM_POOL::updateTx(*pools[ip], [&] () {
+            PTM_PUT_ROOT(0, PTM_MALLOC(poolArraySize*sizeof(PTM_TYPE<uint64_t>)));
+        });
+        // Break up the initialization into transactions of 1k stores
+        for (uint64_t j = 0; j < poolArraySize; j += 1000) {
+            PTM_POOL::updateTx(*pools[ip], [&] () {
+                PTM_TYPE<uint64_t>* parray = (PTM_TYPE<uint64_t>*)PTM_GET_ROOT(0);
+                for (uint64_t i = j; i < j+1000 && i < poolArraySize; i++) parray[i] = i;
+            });
+        }
+    }
+
+    std::atomic<bool> startFlag = { false };
+    std::atomic<bool> quit = { false };
+    std::vector<long long> ops(numThreads);
+    auto func = [&] (const int tid) {
+        PTM_POOL& pool = *pools[tid % numPools];
+        uint64_t seed = (tid+1)+1234567890123456781ULL;
+        while (!startFlag.load()) {}
+        long long tcount = 0;
+        while (!quit.load()) {
+            PTM_POOL::updateTx(pool, [&] () {
+                PTM_TYPE<uint64_t>* parray = (PTM_TYPE<uint64_t>*)PTM_GET_ROOT(0);
+                uint64_t lseed = seed;
+                for (int i = 0; i < numSwapsPerTx; i++) {
+                    lseed = PBenchmarkSPS::randomLong(lseed);
+                    auto ia = lseed%poolArraySize;
+                    uint64_t tmp = parray[ia];
+                    lseed = PBenchmarkSPS::randomLong(lseed);
+                    auto ib = lseed%poolArraySize;
+                    parray[ia] = parray[ib];
+                    parray[ib] = tmp;
+                }
+            });
+            for (int i = 0; i < numSwapsPerTx*2; i++) seed = PBenchmarkSPS::randomLong(seed);
+            ++tcount;
+        }
+        ops[tid] = tcount;
+    };
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < numThreads; tid++) threads.emplace_back(func, tid);
+    auto startBeats = steady_clock::now();
+    startFlag.store(true);
+    this_thread::sleep_for(testLength);
+    quit.store(true);
+    auto stopBeats = steady_clock::now();
+    for (auto& th : threads) th.join();
+    const long long lengthNs = (stopBeats-startBeats).count();
+
+    // Check that the array of each pool is still a permutation, and free it
+    for (int ip = 0; ip < numPools; ip++) {
+        uint64_t sum = 0;
+        for (uint64_t j = 0; j < poolArraySize; j += 1000) {
+            PTM_POOL::readTx(*pools[ip], [&] () {
+                PTM_TYPE<uint64_t>* parray = (PTM_TYPE<uint64_t>*)PTM_GET_ROOT(0);
+                for (uint64_t i = j; i < j+1000 && i < poolArraySize; i++) sum += parray[i];
+            });
+        }
+        if (sum != poolArraySize*(poolArraySize-1)/2) {
+            printf("ERROR in SPS validation of pool %d: sum = %ld  but should be  %ld\n", ip, sum, poolArraySize*(poolArraySize-1)/2);
+            assert(false);
+        }
+        PTM_POOL::updateTx(*pools[ip], [&] () {
+            PTM_FREE(PTM_GET_ROOT(0));
+            PTM_PUT_ROOT(0, nullptr);
+        });
+    }
+
+    long long total = 0;
+    for (int tid = 0; tid < numThreads; tid++) total += ops[tid]*1000000000LL/lengthNs;
+    std::cout << "Swaps/sec = " << total*numSwapsPerTx << "\n";
+    return total*numSwapsPerTx;
+}
+
+
+int main(int argc, char* argv[]) {
+    const std::string dataFilename { DATA_FILE };
+    vector<int> threadList = { 1, 2, 4, 8, 10, 16, 20, 24, 32, 40 }; // For castor
+    vector<int> poolsList = { 1, 2, 4, 8 };
+    const long numSwapsPerTx = 8;
+    // Read the number of seconds from the command line or use 20 seconds as default
+    long secs = (argc >= 2) ? atoi(argv[1]) : 20;
+    seconds testLength {secs};
+    uint64_t results[threadList.size()][poolsList.size()];
+    std::memset(results, 0, sizeof(uint64_t)*threadList.size()*poolsList.size());
+
+    std::cout << "\n----- Persistent SPS Benchmark with pools (multi-threaded integer array swap) -----\n";
+    std::cout << "##### " << PTM_NAME() << " #####  \n";
+    for (unsigned ip = 0; ip < poolsList.size(); ip++) {
+        for (unsigned it = 0; it < threadList.size(); it++) {
+            std::cout << "\n----- threads=" << threadList[it] << "   pools=" << poolsList[ip] << "   length=" << testLength.count() << "s   arraySize=" << arraySize << "   swaps/tx=" << numSwapsPerTx << " -----\n";
+            results[it][ip] = benchmarkSPSPools(poolsList[ip], threadList[it], testLength, numSwapsPerTx);
+        }
+    }
+
+    // Export tab-separated values to a file to be imported in gnuplot or excel
+    ofstream dataFile;
+    dataFile.open(dataFilename);
+    dataFile << "Threads\t";
+    for (unsigned ip = 0; ip < poolsList.size(); ip++) dataFile << PTM_NAME() << "-" << poolsList[ip] << "pools\t";
+    dataFile << "\n";
+    for (unsigned it = 0; it < threadList.size(); it++) {
+        dataFile << threadList[it] << "\t";
+        for (unsigned ip = 0; ip < poolsList.size(); ip++) dataFile << results[it][ip] << "\t";
+        dataFile << "\n";
+    }
+    dataFile.close();
+    std::cout << "\nSuccessfuly saved results in " << dataFilename << "\n";
+    return 0;
+}
@@ -1,611 +1,880 @@
-/*
- * B-tree Map (C++)
- *
- * Copyright (c) 2018 Project Nayuki. (MIT License)
- * https://www.nayuki.io/page/btree-set
- *
- * Modified by Andreia Correia
- *
- * Permission is hereby granted, free of charge, to any person obtaining a copy of
- * this software and associated documentation files (the "Software"), to deal in
- * the Software without restriction, including without limitation the rights to
- * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
- * the Software, and to permit persons to whom the Software is furnished to do so,
- * subject to the following conditions:
- * - The above copyright notice and this permission notice shall be included in
- *   all copies or substantial portions of the Software.
- * - The Software is provided "as is", without warranty of any kind, express or
- *   implied, including but not limited to the warranties of merchantability,
- *   fitness for a particular purpose and noninfringement. In no event shall the
- *   authors or copyright holders be liable for any claim, damages or other
- *   liability, whether in an action of contract, tort or otherwise, arising from,
- *   out of or in connection with the Software or the use or other dealings in the
- *   Software.
- */
-
-#ifndef _TM_BTREE_MAP_PSLICE_H_
-#define _TM_BTREE_MAP_PSLICE_H_
-
-#pragma once
-
-#include <algorithm>
-#include <cassert>
-#include <climits>
-#include <cstddef>
-#include <cstdint>
-#include <memory>
-#include <stdexcept>
-#include <utility>
-#include "ptmdb.h"
-#include "slice.h"
-
-
-namespace ptmdb {
-
-
-/* If V is larger than size_t then better make it a pointer to the object, otherwise it's going to be slow */
-class TMBTreeMap {
-
-private: static const int MAXKEYS { 16 };    // Must be (at least) degree*2 - 1
-
-public: class Node;  // Forward declaration
-
-/*---- Fields ----*/
-
-public: PTM_TYPE<Node*>   root {nullptr};
-public: PTM_TYPE<int32_t> minKeys;  // At least 1, equal to degree-1
-public: PTM_TYPE<int32_t> maxKeys;  // At least 3, odd number, equal to minKeys*2+1
-
-
-
-/*---- Constructors ----*/
-
-// The degree is the minimum number of children each non-root internal node must have.
-public: explicit TMBTreeMap(std::int32_t degree=8) :
-									minKeys(degree - 1),
-									maxKeys(degree <= UINT32_MAX / 2 ? degree * 2 - 1 : 0) {  // Avoid overflow
-	if (degree < 2)
-		throw std::domain_error("Degree must be at least 2");
-	if (degree > UINT32_MAX / 2)  // In other words, need maxChildren <= UINT32_MAX
-		throw std::domain_error("Degree too large");
-	clear();
-}
-
-~TMBTreeMap() {
-	if (root == nullptr) return;
-	Node* first = seekFirst(root);
-	deleteAll(first);
-}
-
-
-/*---- Methods ----*/
-
-public: void deleteAll(Node* node) {
-	int it=-1;
-	TMBTreeMap::Node* p =nullptr;
-	while(true){
-		p = node->parent.pload();
-		int32_t index = node->childIndex.pload();
-		PTM_DELETE(node);
-		if(p==nullptr) return;
-
-		it = index+1;
-		int32_t len = p->length;
-		while(it <= len){
-			node = p->children[it];
-			if(!node->isLeaf()) {
-				node = node->children[0];
-				while(!node->isLeaf()){
-					node = node->children[0];
-				}
-				it = 0;
-				break;
-			}
-			PTM_DELETE(node);
-			it++;
-		}
-		if(it <= len) {
-			continue;
-		}
-		node = p;
-	}
-}
-
-public: Node* seekFirst(Node* r) {
-	if(r->isLeaf()){
-		return r;
-	}
-
-	while(!r->isLeaf()){
-		r = r->children[0].pload();
-	}
-	return r;
-}
-
-// Starting from root, add all keys in a set and all values in another set and make sure they are unique
-// This is used for debugging only.
-/*
-public: void assertIfNotASet(Node* node, std::set<PBTSlice*>& keyset, std::set<PBTSlice*>& valset) {
-    if (!node->isLeaf()) {
-        for(int i = 0; i < node->length.pload()+1; i++) {
-            assertIfNotASet(node->children[i], keyset, valset);
-        }
-    }
-    for (int i = 0; i < node->length.pload(); i++) {
-        auto resultKey = keyset.insert(node->keys[i].pload());
-        assert (resultKey.second);
-        auto resultVal = valset.insert(node->vals[i].pload());
-        assert (resultVal.second);
-    }
-}
-*/
-
-public: void clear() {
-	if (root != nullptr) {
-		deleteAll(root);
-	}
-	root = PTM_NEW<Node>(maxKeys, true, nullptr);
-}
-
-
-using SearchResult = std::pair<bool,std::int32_t>;
-using KeyVal = std::pair<PBTSlice*,PBTSlice*>;
-
-
-/*---- Helper class: B-tree node ----*/
-
-public: class Node final {
-
-	/*-- Fields --*/
-
-public: PTM_TYPE<int32_t>   childIndex;
-public: PTM_TYPE<int32_t>   length {0};
-// Size is in the range [0, maxKeys] for root node, [minKeys, maxKeys] for all other nodes.
-public: PBTSlice  keys[MAXKEYS];
-public: PBTSlice  vals[MAXKEYS];
-// If leaf then size is 0, otherwise if internal node then size always equals keys.size()+1.
-public: PTM_TYPE<Node*>     children[MAXKEYS+1];
-public: PTM_TYPE<Node*>     parent;
-/*-- Constructor --*/
-
-// Note: Once created, a node's structure never changes between a leaf and internal node.
-public: Node(std::uint32_t maxKeys, bool leaf, Node* parent) {
-	assert(maxKeys >= 3 && maxKeys % 2 == 1);
-	assert(maxKeys <= MAXKEYS);
-	//printf("Creating Node = %p\n", this);
-	for (int i = 0; i < maxKeys+1; i++) children[i] = nullptr;
-	this->parent.pstore(parent);
-}
-
-public: ~Node() {
-    //printf("Destroying Node = %p with length=%d\n", this, length.pload());
-}
-
-/*-- Methods for getting info --*/
-
-public: void print() {
-    printf("keys=[");
-    for (int i = 0; i < length; i++) {
-        printf("%p, ", &keys[i]);
-    }
-    printf("]\n");
-    printf("vals=[");
-    for (int i = 0; i < length; i++) {
-        printf("%p, ", &vals[i]);
-    }
-    printf("]\n");
-}
-
-public: int getSize(){
-	int size = 0;
-	for(int i=0; i<length.pload();i++){
-		size += children[i].pload()->getSize();
-	}
-	return size;
-}
-
-public: bool getLength() const {
-	return length;
-}
-
-public: bool isLeaf() const {
-	return (children[0]==nullptr);
-}
-
-// Searches this node's keys vector and returns (true, i) if obj equals keys[i],
-// otherwise returns (false, i) if children[i] should be explored. For simplicity,
-// the implementation uses linear search. It's possible to replace it with binary search for speed.
-public: SearchResult search(const Slice &val) const {
-	if (length == 0) return SearchResult(false, 0);
-	std::int32_t max = length;
-	std::int32_t min = 0;
-	while (true) {
-		std::int32_t i = min + (max-min)/2;
-		PBTSlice* elem = (PBTSlice*)&keys[i];
-		int cmp = elem->compare(val);
-		if (cmp == 0) {
-			assert(i < length);
-			return SearchResult(true, i);  // Key found
-		} else if (cmp < 0){
-			if (i == length-1 || max-min<=1) return SearchResult(false, i+1);
-			min = i;
-		}else{  // val < elem
-			if (i == 0 || max-min<=1) return SearchResult(false, i);
-			max = i;
-		}
-	}
-}
-
-/*-- Methods for insertion --*/
-
-// For the child node at the given index, this moves the right half of keys and children to a new node,
-// and adds the middle key and new child to this node. The left half of child's data is not moved.
-public: void splitChild(std::size_t minKeys, std::int32_t maxKeys, std::size_t index) {
-	assert(!this->isLeaf() && index <= this->length && this->length < maxKeys);
-	Node* left = this->children[index];
-	Node* right = PTM_NEW<Node>(maxKeys,left->isLeaf(),this);
-
-	// Handle keys
-	int j=0;
-	for(int i=minKeys + 1;i<left->length;i++){
-		right->keys[j] = left->keys[i];
-		right->vals[j] = left->vals[i];
-		j++;
-	}
-
-	//add right node to this
-	for(int i=length+1; i>=index+2;i--){
-		this->children[i] = this->children[i-1];
-		this->children[i].pload()->childIndex.pstore(i);
-	}
-	this->children[index+1] = right;
-	right->parent = this;
-	right->childIndex.pstore(index+1);
-	for(int i=length; i>=index+1;i--){
-		this->keys[i] = this->keys[i-1];
-		this->vals[i] = this->vals[i-1];
-	}
-	this->keys[index] = left->keys[minKeys];
-	this->vals[index] = left->vals[minKeys];
-	this->length = this->length+1;
-
-	if(!left->isLeaf()){
-		j=0;
-		for(int i= minKeys + 1;i<left->length+1;i++){
-			right->children[j] = left->children[i];
-			right->children[j].pload()->parent = right;
-			right->children[j].pload()->childIndex = j;
-			j++;
-		}
-	}
-
-	right->length = left->length-minKeys-1;
-	left->length = minKeys;
-}
-
-
-/*-- Methods for removal --*/
-
-// Performs modifications to ensure that this node's child at the given index has at least
-// minKeys+1 keys in preparation for a single removal. The child may gain a key and subchild
-// from its sibling, or it may be merged with a sibling, or nothing needs to be done.
-// A reference to the appropriate child is returned, which is helpful if the old child no longer exists.
-public: Node* ensureChildRemove(std::int32_t minKeys, std::uint32_t index) {
-	// Preliminaries
-	assert(!this->isLeaf() && index < this->length+1);
-	Node* child = this->children[index];
-	if (child->length > minKeys)  // Already satisfies the condition
-		return child;
-	assert(child->length == minKeys);
-
-	// Get siblings
-	Node* left = index >= 1 ? this->children[index - 1].pload() : nullptr;
-	Node* right = index < this->length ? this->children[index + 1].pload() : nullptr;
-	bool internal = !child->isLeaf();
-	assert(left != nullptr || right != nullptr);  // At least one sibling exists because degree >= 2
-	assert(left  == nullptr || left ->isLeaf() != internal);  // Sibling must be same type (internal/leaf) as child
-	assert(right == nullptr || right->isLeaf() != internal);  // Sibling must be same type (internal/leaf) as child
-
-	if (left != nullptr && left->length > minKeys) {  // Steal rightmost item from left sibling
-		if (internal) {
-			for(int i=child->length+1;i>=1;i--){
-				child->children[i] = child->children[i-1];
-				child->children[i].pload()->childIndex.pstore(i);
-			}
-			child->children[0] = left->children[left->length];
-			child->children[0].pload()->parent = child;
-			child->children[0].pload()->childIndex = 0;
-		}
-		for(int i=child->length;i>=1;i--){
-			child->keys[i] = child->keys[i-1];
-			child->vals[i] = child->vals[i-1];
-		}
-		child->keys[0] = this->keys[index - 1];
-		child->vals[0] = this->vals[index - 1];
-		this->keys[index-1] = left->keys[left->length-1];
-		this->vals[index-1] = left->vals[left->length-1];
-		left->length = left->length-1;
-		child->length = child->length+1;
-		return child;
-	} else if (right != nullptr && right->length > minKeys) {  // Steal leftmost item from right sibling
-		if (internal) {
-			child->children[child->length+1] = right->children[0];
-			child->children[child->length+1].pload()->parent = child;
-			child->children[child->length+1].pload()->childIndex.pstore(child->length+1);
-			for(int i=0;i<right->length;i++){
-				right->children[i] = right->children[i+1];
-				right->children[i].pload()->childIndex.pstore(i);
-			}
-		}
-		child->keys[child->length] = this->keys[index];
-		child->vals[child->length] = this->vals[index];
-		KeyVal ret = right->removeKey(0);
-		//PTM_DELETE(this->keys[index].pload());
-		//PTM_DELETE(this->vals[index].pload());
-		this->keys[index] = *ret.first;
-		this->vals[index] = *ret.second;
-		child->length = child->length+1;
-		return child;
-	} else if (left != nullptr) {  // Merge child into left sibling
-		this->mergeChildren(minKeys, index - 1);
-		return left;  // This is the only case where the return value is different
-	} else if (right != nullptr) {  // Merge right sibling into child
-		this->mergeChildren(minKeys, index);
-		return child;
-	} else
-		throw std::logic_error("Impossible condition");
-}
-
-
-// Merges the child node at index+1 into the child node at index,
-// assuming the current node is not empty and both children have minKeys.
-public: void mergeChildren(std::int32_t minKeys, std::uint32_t index) {
-	assert(!this->isLeaf() && index < this->length);
-	Node* left  = this->children[index];
-	Node* right = this->children[index+1];
-	assert(left->length == minKeys && right->length == minKeys);
-	//std::cout<<"Passou\n";
-	if (!left->isLeaf()){
-		for(int i=0;i<right->length+1;i++){
-			left->children[left->length+1+i] = right->children[i];
-			left->children[left->length+1+i].pload()->parent = left;
-			left->children[left->length+1+i].pload()->childIndex.pstore(left->length+1+i);
-		}
-	}
-	left->keys[left->length] = this->keys[index];
-	left->vals[left->length] = this->vals[index];
-	for(int i=0;i<right->length;i++){
-		left->keys[left->length+1+i] = right->keys[i];
-		left->vals[left->length+1+i] = right->vals[i];
-	}
-	left->length = left->length + right->length+1;
-	// remove key(index)
-	for(int i=index;i<length-1;i++){
-		this->keys[i] = this->keys[i+1];
-		this->vals[i] = this->vals[i+1];
-	}
-	// remove children (index+1)
-	children[index+1].pload()->length = 0; // TODO: do we really need this or will cause leaks?
-	PTM_DELETE(children[index+1].pload());
-	for(int i=index+1;i<length;i++){
-		this->children[i] = this->children[i+1];
-		this->children[i].pload()->childIndex.pstore(i);
-	}
-	this->children[length] = nullptr;
-	length = length-1;
-}
-
-
-// Removes and returns the minimum key among the whole subtree rooted at this node.
-// Requires this node to be preprocessed to have at least minKeys+1 keys.
-public: KeyVal removeMin(std::int32_t minKeys) {
-	for (Node* node = this; ; ) {
-		assert(node->length > minKeys);
-		if (node->isLeaf()){
-			KeyVal ret = KeyVal(&node->keys[0],&node->vals[0]);
-			//PTM_DELETE(node->keys[0]->pload());
-			//PTM_DELETE(node->vals[0]->pload());
-			for(int i=0;i<node->length-1;i++){
-				node->keys[i] = node->keys[i+1];
-				node->vals[i] = node->vals[i+1];
-			}
-			node->length = node->length-1;
-			return ret;
-		}else{
-			node = node->ensureChildRemove(minKeys, 0);
-		}
-
-	}
-}
-
-
-// Removes and returns the maximum key among the whole subtree rooted at this node.
-// Requires this node to be preprocessed to have at least minKeys+1 keys.
-public: KeyVal removeMax(std::int32_t minKeys) {
-	for (Node *node = this; ; ) {
-		assert(node->length > minKeys);
-		if (node->isLeaf()){
-			node->length = node->length-1;
-            //PTM_DELETE(node->keys[node->length]->pload());
-            //PTM_DELETE(node->vals[node->length]->pload());
-			return KeyVal(&node->keys[node->length], &node->vals[node->length]);
-		}else{
-			node = node->ensureChildRemove(minKeys, node->length);
-		}
-	}
-}
-
-
-// Removes and returns this node's key at the given index.
-public: KeyVal removeKey(std::uint32_t index) {
-	KeyVal ret = KeyVal(&keys[index], &vals[index]);
-	for(int i=index;i < this->length-1;i++){
-		this->keys[i] = this->keys[i+1];
-		this->vals[i] = this->vals[i+1];
-	}
-	length = length-1;
-	return ret;
-}
-};
-
-static std::string className() { return PTM_NAME()+ "-BTreeMap" ; }
-
-
-/*
- * Adds a node with a key if the key is not present, otherwise replaces the value.
- * Returns true if there was no mapping for the key, false if there was already a value and it was replaced.
- */
-bool innerPut(const Slice& key, const Slice& val) {
-	// Special preprocessing to split root node
-	if (root.pload()->length.pload() == maxKeys) {
-		Node* child = root;
-		root = PTM_NEW<Node>(maxKeys, false,nullptr);  // Increment tree height
-		child->parent = root;
-		root.pload()->children[0] = child;
-		child->childIndex.pstore(0);
-		root.pload()->splitChild(minKeys, maxKeys, 0);
-	}
-
-	// Walk down the tree
-	Node* node = root;
-	//node->print();
-	while (true) {
-		// Search for index in current node
-		assert(node->length < maxKeys);
-		assert(node == root || node->length >= minKeys);
-
-		SearchResult sr = node->search(key);
-		if (sr.first) {
-		    // Replace val
-			node->vals[sr.second] = val;
-			//node->print();
-			return false;  // Key already exists in tree
-		}
-		std::int32_t index = sr.second;
-		if (node->isLeaf()) {  // Simple insertion into leaf
-			for(int i=node->length;i>=index+1;i--){
-				node->keys[i] = node->keys[i-1];
-				node->vals[i] = node->vals[i-1];
-			}
-			node->keys[index] = key;
-			node->vals[index] = val;
-			node->length = node->length+1;
-			//node->print();
-			return true;  // Successfully inserted
-
-		} else {  // Handle internal node
-			Node* child = node->children[index];
-			if (child->length == maxKeys) {  // Split child node
-				node->splitChild(minKeys, maxKeys, index);
-				PBTSlice* middleKey = &node->keys[index];
-				int cmp = middleKey->compare(key);
-				if (cmp == 0) {
-					node->vals[index] = val;
-					//node->print();
-					return false;  // Key already exists in tree
-				} else if (cmp < 0) {
-					child = node->children[index + 1];
-				}
-			}
-			node = child;
-		}
-	}
-}
-
-
-/*
- * Removes a key and its mapping.
- * Returns returns true if a matching key was found
- */
-bool innerRemove(const Slice& key) {
-	// Walk down the tree
-	bool found;
-	std::int32_t index;
-	{
-		SearchResult sr = root.pload()->search(key);
-		found = sr.first;
-		index = sr.second;
-	}
-	Node* node = root;
-	while (true) {
-		assert(node->length <= maxKeys);
-		assert(node == root || node->length > minKeys);
-		if (node->isLeaf()) {
-			if (found) {  // Simple removal from leaf
-			    // TODO: implement a "reset()" ?
-		        //PTM_DELETE(node->keys[index].pload());
-		        //PTM_DELETE(node->vals[index].pload());
-				node->removeKey(index);
-				return 1;
-			} else
-				return 0;
-
-		} else {  // Internal node
-			if (found) {  // Key is stored at current node
-				Node* left  = node->children[index + 0];
-				Node* right = node->children[index + 1];
-				assert(left != nullptr && right != nullptr);
-				if (left->length > minKeys) {  // Replace key with predecessor
-					KeyVal ret = left->removeMax(minKeys);
-					node->keys[index] = *ret.first;
-					node->vals[index] = *ret.second;
-					return true;
-				} else if (right->length > minKeys) {  // Replace key with successor
-					KeyVal ret = right->removeMin(minKeys);
-					node->keys[index] = *ret.first;
-					node->vals[index] = *ret.second;
-					return true;
-				} else {  // Merge key and right node into left node, then recurse
-					node->mergeChildren(minKeys, index);
-					if (node == root && root.pload()->length==0) {
-						assert(root.pload()->length+1 == 1);
-						Node* next = root.pload()->children[0];
-						PTM_DELETE(root.pload());
-						root = next; //TODO:delete root
-						//root->children[0] = nullptr;
-					}
-					node = left;
-					index = minKeys;  // Index known due to merging; no need to search
-				}
-			} else {  // Key might be found in some child
-				Node* child = node->ensureChildRemove(minKeys, index);
-				if (node == root && root.pload()->length==0) {
-					assert(root.pload()->length +1 == 1);
-					Node* next = root.pload()->children[0];
-					PTM_DELETE(root.pload());
-					root = next; //TODO:delete root
-					//root->children[0] = nullptr;
-				}
-				node = child;
-				SearchResult sr = node->search(key);
-				found = sr.first;
-				index = sr.second;
-			}
-		}
-	}
-}
-
-
-/*
- * Returns true if key is present. Saves a copy of 'value' in 'oldValue' if 'saveOldValue' is set.
- */
-bool innerGet(const Slice& key, std::string* oldValue) {
-	// Walk down the tree
-	Node* node = root.pload();
-	while (true) {
-		SearchResult sr = node->search(key);
-		if (sr.first) {
-			// Found a matching key: make a copy of the corresponding value
-			oldValue->assign(node->vals[sr.second].data(), node->vals[sr.second].size());
-			return true;
-		} else if (node->isLeaf()) {
-			return false;
-		} else { // Internal node
-			node = node->children[sr.second];
-		}
-	}
-}
-
-};
-}
-#endif   // _TM_BTREE_MAP_PSLICE_H_
+/*
+ * B-tree Map (C++)
+ *
+ * Copyright (c) 2018 Project Nayuki. (MIT License)
+ * https://www.nayuki.io/page/btree-set
+ *
+ * Modified by Andreia Correia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * - The above copyright notice and this permission notice shall be included in
+ *   all copies or substantial portions of the Software.
+ * - The Software is provided "as is", without warranty of any kind, express or
+ *   implied, including but not limited to the warranties of merchantability,
+ *   fitness for a particular purpose and noninfringement. In no event shall the
+ *   authors or copyright holders be liable for any claim, damages or other
+ *   liability, whether in an action of contract, tort or otherwise, arising from,
+ *   out of or in connection with the Software or the use or other dealings in the
+ *   Software.
+ */
+
+#ifndef _TM_BTREE_MAP_PSLICE_H_
+#define _TM_BTREE_MAP_PSLICE_H_
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+#include "ptmdb.h"
+#include "slice.h"
+
+
+namespace ptmdb {
+
+
+/*
+ * This is a B+tree: the keys and values are all in the leaves, and the internal nodes have only
+ * separator keys (copies of keys, which may no longer be in the tree) to route the searches.
+ * The leaves are linked in key order, in both directions, which is what the iterator uses to go from
+ * one key to the next without walking up the tree.
+ * Insertions and removals walk down the tree once, splitting full nodes (or filling up nodes with
+ * minKeys) on the way down, the same as the classic B-tree this was derived from.
+ */
+class TMBTreeMap {
+
+// Capacity of the nodes, fixed at compile time because the arrays are inline in the nodes.
+// The degree of the tree, which gives the fan-out, is chosen at runtime and can be up to MAX_DEGREE.
+// Must be a multiple of 4, for the SIMD search, and at most 64.
+#ifndef PTMDB_BTREE_MAXKEYS
+#define PTMDB_BTREE_MAXKEYS  16
+#endif
+
+private: static const int MAXKEYS { PTMDB_BTREE_MAXKEYS };    // Must be (at least) degree*2 - 1
+static_assert(MAXKEYS % 4 == 0 && MAXKEYS <= 64, "PTMDB_BTREE_MAXKEYS must be a multiple of 4, up to 64");
+
+public: static const int MAX_DEGREE { (MAXKEYS+1)/2 };
+
+// Number of lookups of a MultiGet whose descents are interleaved (see innerMultiGet())
+public: static const int MULTIGET_GROUP { 8 };
+
+public: class Node;  // Forward declaration
+
+// The nodes and the stripes of the counters start at a group of PM cache lines and take whole groups, so
+// that they share no cache line with other objects. In Trinity a group is 4 PMCacheLines (96 bytes of the volatile replica), which is also what
+// a lock covers in TrinityVR-TL2. Elsewhere a group is a single cache line.
+#ifdef PTM_PCL_GROUP_SIZE
+public: static const std::size_t GROUP_SIZE { PTM_PCL_GROUP_SIZE };
+static inline std::size_t groupOffset(const void* addr) { return PTM_PCL_GROUP_OFFSET(addr); }
+#else
+public: static const std::size_t GROUP_SIZE { 64 };
+static inline std::size_t groupOffset(const void* addr) { return (std::size_t)addr % GROUP_SIZE; }
+#endif
+
+/*---- Fields ----*/
+
+public: PTM_TYPE<Node*>   root {nullptr};
+public: PTM_TYPE<int32_t> minKeys;  // At least 1, equal to degree-1
+public: PTM_TYPE<int32_t> maxKeys;  // At least 3, odd number, equal to minKeys*2+1
+
+// Number of keys and their sizes, updated in the same transaction as the tree. The counters are striped
+// by thread, to avoid conflicts between concurrent update transactions, and summed when they are read.
+// The stripes are in an allocation of their own (see groupMalloc()), one every STRIPE_SIZE bytes, so each
+// stripe has whole groups of PM cache lines to itself: no two stripes, nor a stripe and 'root', share
+// a cache line, or a lock in TrinityVR-TL2.
+public: static const int NUM_STRIPES { 16 };
+public: struct Counters {
+	PTM_TYPE<int64_t> keys {0};
+	PTM_TYPE<int64_t> keyBytes {0};
+	PTM_TYPE<int64_t> valueBytes {0};
+};
+public: static const std::size_t STRIPE_SIZE { (sizeof(Counters) + GROUP_SIZE - 1)/GROUP_SIZE*GROUP_SIZE };
+public: PTM_TYPE<uint8_t*> stripes {nullptr};
+public: PTM_TYPE<int32_t>  stripesShift {0};    // Distance from the start of the allocation to 'stripes'
+
+
+
+/*---- Constructors ----*/
+
+// The degree is the minimum number of children each non-root internal node must have.
+public: explicit TMBTreeMap(std::int32_t degree=MAX_DEGREE) :
+									minKeys(degree - 1),
+									maxKeys(degree <= UINT32_MAX / 2 ? degree * 2 - 1 : 0) {  // Avoid overflow
+	if (degree < 2)
+		throw std::domain_error("Degree must be at least 2");
+	if (degree > MAX_DEGREE)  // The keys must fit in the nodes
+		throw std::domain_error("Degree too large");
+	std::int32_t shift;
+	uint8_t* s = (uint8_t*)groupMalloc(NUM_STRIPES*STRIPE_SIZE, shift);
+	for (int i = 0; i < NUM_STRIPES; i++) new (s + i*STRIPE_SIZE) Counters();
+	stripes = s;
+	stripesShift = shift;
+	clear();
+}
+
+~TMBTreeMap() {
+	PTM_FREE(stripes.pload() - stripesShift.pload());
+	if (root == nullptr) return;
+	deleteAll(root);
+}
+
+
+/*---- Methods ----*/
+
+// Deletes the node and all the nodes below it, along with their keys and values
+public: void deleteAll(Node* node) {
+	if (!node->isLeaf()) {
+		for (int i = 0; i <= node->length; i++) deleteAll(node->children[i]);
+	}
+	Node::destroy(node);
+}
+
+// Returns the leftmost leaf
+public: Node* seekFirst(Node* r) {
+	while (!r->isLeaf()) {
+		r = r->children[0].pload();
+	}
+	return r;
+}
+
+// Returns the rightmost leaf
+public: Node* seekLast(Node* r) {
+	while (!r->isLeaf()) {
+		r = r->children[r->length.pload()].pload();
+	}
+	return r;
+}
+
+// Returns the leaf where 'key' is, or where it would be inserted
+public: Node* seekLeaf(const Slice& key) {
+	Node* node = root.pload();
+	while (!node->isLeaf()) {
+		node = node->children[node->childIndex(key)].pload();
+	}
+	return node;
+}
+
+// Prefetches the part of the node that a search reads first, 'length' and 'prefixes'
+public: static inline void prefetchNode(const Node* node) {
+	const char* end = (const char*)&node->keys[0];
+	for (const char* p = (const char*)node; p < end; p += 64) __builtin_prefetch(p, 0, 3);
+}
+
+public: void clear() {
+	if (root != nullptr) {
+		deleteAll(root);
+	}
+	root = Node::create(maxKeys, true);
+	for (int i = 0; i < NUM_STRIPES; i++) {
+		Counters& c = counters(i);
+		c.keys = 0;
+		c.keyBytes = 0;
+		c.valueBytes = 0;
+	}
+}
+
+public: inline Counters& counters(int i) {
+	return *(Counters*)(stripes.pload() + i*STRIPE_SIZE);
+}
+
+// Each thread always updates the same stripe of the counters
+public: static inline int myStripe() {
+	static std::atomic<int> nextStripe {0};
+	static thread_local int stripe = nextStripe.fetch_add(1) % NUM_STRIPES;
+	return stripe;
+}
+
+public: inline void addCounters(int64_t keys, int64_t keyBytes, int64_t valueBytes) {
+	Counters& c = counters(myStripe());
+	if (keys != 0) c.keys = c.keys.pload() + keys;
+	if (keyBytes != 0) c.keyBytes = c.keyBytes.pload() + keyBytes;
+	if (valueBytes != 0) c.valueBytes = c.valueBytes.pload() + valueBytes;
+}
+
+// Sum of all the stripes
+public: void getCounters(int64_t& keys, int64_t& keyBytes, int64_t& valueBytes) {
+	keys = keyBytes = valueBytes = 0;
+	for (int i = 0; i < NUM_STRIPES; i++) {
+		Counters& c = counters(i);
+		keys += c.keys.pload();
+		keyBytes += c.keyBytes.pload();
+		valueBytes += c.valueBytes.pload();
+	}
+}
+
+
+using SearchResult = std::pair<bool,std::int32_t>;
+
+// Allocates 'size' bytes, rounded up to whole groups, at the start of a group, and returns their address.
+// 'shift' is set to their distance from the start of the allocation, which is the address to give to PTM_FREE().
+// The allocators return blocks aligned to at least 8 bytes, which is the most that can be skipped in a group.
+public: static void* groupMalloc(std::size_t size, std::int32_t& shift) {
+	const std::size_t gsize = (size + GROUP_SIZE - 1)/GROUP_SIZE*GROUP_SIZE;
+	std::uint8_t* block = (std::uint8_t*)PTM_MALLOC(gsize + GROUP_SIZE - 8);
+	shift = (GROUP_SIZE - groupOffset(block)) % GROUP_SIZE;
+	return block + shift;
+}
+
+
+/*---- Helper class: B+tree node ----*/
+
+public: class Node final {
+
+	/*-- Fields --*/
+
+// The fields are in the order they are accessed in a search: 'length' and 'prefixes' first, so that
+// a search in a node touches the minimum number of cache lines (PM cache lines, or the chunks
+// of the volatile replica in Trinity) before it reads a key, then the keys, then a child or a value.
+public: PTM_TYPE<int32_t>   length {0};
+// Distance from the start of the allocation to the node (see create())
+public: PTM_TYPE<int32_t>   shift {0};
+// The first 8 bytes of each key, big-endian and padded with zeros, which have the same order as the keys
+// when compared as integers. Most of the keys in a search are skipped by looking only at their prefix.
+public: PTM_TYPE<uint64_t>  prefixes[MAXKEYS];
+// Size is in the range [0, maxKeys] for root node, [minKeys, maxKeys] for all other nodes.
+// In internal nodes, all the keys in children[i] are smaller than keys[i], and keys[i] is smaller
+// or equal to all the keys in children[i+1].
+public: PBTSlice  keys[MAXKEYS];
+// If leaf then size is 0, otherwise if internal node then size always equals keys.size()+1.
+public: PTM_TYPE<Node*>     children[MAXKEYS+1];
+// Only used in leaves
+public: PBTValueSlice vals[MAXKEYS];
+// Leaves are in a doubly linked list, in key order. Not used in internal nodes.
+public: PTM_TYPE<Node*>     prev {nullptr};
+public: PTM_TYPE<Node*>     next {nullptr};
+
+/*-- Constructor --*/
+
+// Note: Once created, a node's structure never changes between a leaf and internal node.
+public: Node(std::uint32_t maxKeys, bool leaf) {
+	assert(maxKeys >= 3 && maxKeys % 2 == 1);
+	assert(maxKeys <= MAXKEYS);
+	for (int i = 0; i < maxKeys+1; i++) children[i] = nullptr;
+}
+
+public: ~Node() {
+}
+
+// Nodes are always created and destroyed with these, instead of PTM_NEW and PTM_DELETE, to place them in groups
+public: static Node* create(std::uint32_t maxKeys, bool leaf) {
+	std::int32_t shift;
+	Node* node = new (groupMalloc(sizeof(Node), shift)) Node(maxKeys, leaf);
+	node->shift = shift;
+	return node;
+}
+
+public: static void destroy(Node* node) {
+	void* block = (std::uint8_t*)node - node->shift.pload();
+	node->~Node();
+	PTM_FREE(block);
+}
+
+// Start of the allocation of this node
+public: const void* block() const {
+	return (const std::uint8_t*)this - shift.pload();
+}
+
+/*-- Methods for getting info --*/
+
+public: void print() {
+    printf("keys=[");
+    for (int i = 0; i < length; i++) {
+        printf("%p, ", &keys[i]);
+    }
+    printf("]\n");
+    printf("vals=[");
+    for (int i = 0; i < length; i++) {
+        printf("%p, ", &vals[i]);
+    }
+    printf("]\n");
+}
+
+public: bool getLength() const {
+	return length;
+}
+
+public: bool isLeaf() const {
+	return (children[0]==nullptr);
+}
+
+// Returns the prefix of a key, to compare with the ones in 'prefixes'
+public: static inline std::uint64_t keyPrefix(const char* data, std::size_t size) {
+	std::uint64_t p = 0;
+	std::memcpy(&p, data, size < 8 ? size : 8);
+	return __builtin_bswap64(p);
+}
+
+// Sets 'lt' to the number of keys with a prefix smaller than 'p', and 'le' to the number of keys with
+// a prefix smaller or equal to 'p'. The prefixes are loaded in place and compared all at once.
+public: inline void prefixRange(std::uint64_t p, std::int32_t len, std::int32_t& lt, std::int32_t& le) const {
+	const std::uint64_t* pre = (const std::uint64_t*)prefixes;
+#if defined(__AVX2__)
+	// There are no unsigned 64 bit comparisons, flipping the sign bit gives the same order with signed ones
+	const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+	const __m256i vp = _mm256_xor_si256(_mm256_set1_epi64x((long long)p), bias);
+	std::uint64_t ltMask = 0, gtMask = 0;
+	for (int i = 0; i < MAXKEYS; i += 4) {
+		const __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)&pre[i]), bias);
+		ltMask |= (std::uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(vp, v))) << i;
+		gtMask |= (std::uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(v, vp))) << i;
+	}
+	const std::uint64_t valid = (len == 64) ? ~0ULL : (1ULL << len) - 1;
+	lt = __builtin_popcountll(ltMask & valid);
+	le = len - __builtin_popcountll(gtMask & valid);
+#elif defined(__SSE4_2__)
+	const __m128i bias = _mm_set1_epi64x(INT64_MIN);
+	const __m128i vp = _mm_xor_si128(_mm_set1_epi64x((long long)p), bias);
+	std::uint64_t ltMask = 0, gtMask = 0;
+	for (int i = 0; i < MAXKEYS; i += 2) {
+		const __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)&pre[i]), bias);
+		ltMask |= (std::uint64_t)_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(vp, v))) << i;
+		gtMask |= (std::uint64_t)_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(v, vp))) << i;
+	}
+	const std::uint64_t valid = (len == 64) ? ~0ULL : (1ULL << len) - 1;
+	lt = __builtin_popcountll(ltMask & valid);
+	le = len - __builtin_popcountll(gtMask & valid);
+#else
+	lt = 0;
+	le = 0;
+	for (int i = 0; i < len; i++) {
+		lt += (pre[i] < p);
+		le += (pre[i] <= p);
+	}
+#endif
+	PTM_CHECK_LOADS(pre, len*sizeof(std::uint64_t));
+}
+
+// Searches this node's keys vector and returns (true, i) if obj equals keys[i],
+// otherwise returns (false, i) where i is the number of keys smaller than obj.
+// Only the keys with the same prefix as obj are compared.
+public: SearchResult search(const Slice &val) const {
+	const std::int32_t len = length;
+	if (len == 0) return SearchResult(false, 0);
+	std::int32_t min, max;
+	prefixRange(keyPrefix(val.data(), val.size()), len, min, max);
+	while (min < max) {
+		std::int32_t i = min + (max-min)/2;
+		int cmp = keys[i].compare(val);
+		if (cmp == 0) return SearchResult(true, i);  // Key found
+		if (cmp < 0) min = i+1;
+		else max = i;
+	}
+	return SearchResult(false, min);
+}
+
+// Stores a copy of 'key' at the given index
+public: void setKey(std::int32_t index, const Slice& key) {
+	keys[index] = key;
+	prefixes[index] = keyPrefix(key.data(), key.size());
+}
+
+// Stores at the given index a copy of the key in 'src' at 'srcIndex'
+public: void copyKey(std::int32_t index, Node* src, std::int32_t srcIndex) {
+	keys[index] = Slice(src->keys[srcIndex].data(), src->keys[srcIndex].size());
+	prefixes[index] = src->prefixes[srcIndex].pload();
+}
+
+// Moves the key in 'src' at 'srcIndex' to the given index, which must be empty, without copying the data
+public: void moveKey(std::int32_t index, Node* src, std::int32_t srcIndex) {
+	keys[index] = src->keys[srcIndex];
+	prefixes[index] = src->prefixes[srcIndex].pload();
+}
+
+// In an internal node, returns the index of the child where 'key' is
+public: std::int32_t childIndex(const Slice& key) const {
+	SearchResult sr = search(key);
+	return sr.first ? sr.second+1 : sr.second;
+}
+
+/*-- Methods for insertion --*/
+
+// For the child node at the given index, this moves the right half of keys (and values or children)
+// to a new node, and adds a separator key and the new child to this node.
+// The left half of child's data is not moved.
+public: void splitChild(std::size_t minKeys, std::int32_t maxKeys, std::size_t index) {
+	assert(!this->isLeaf() && index <= this->length && this->length < maxKeys);
+	Node* left = this->children[index];
+	Node* right = create(maxKeys, left->isLeaf());
+
+	//add right node to this
+	for(int i=length+1; i>=index+2;i--){
+		this->children[i] = this->children[i-1];
+	}
+	this->children[index+1] = right;
+	for(int i=length; i>=index+1;i--){
+		this->moveKey(i, this, i-1);
+	}
+
+	if (left->isLeaf()) {
+		// The left leaf keeps minKeys+1 keys and the separator is a copy of the first key on the right
+		int j=0;
+		for(int i=minKeys+1;i<left->length;i++){
+			right->moveKey(j, left, i);
+			right->vals[j] = left->vals[i];
+			j++;
+		}
+		right->length = left->length-minKeys-1;
+		left->length = minKeys+1;
+		this->copyKey(index, right, 0);
+		// Link the new leaf
+		Node* lnext = left->next;
+		right->prev = left;
+		right->next = lnext;
+		if (lnext != nullptr) lnext->prev = right;
+		left->next = right;
+	} else {
+		// The middle key moves up to this node
+		int j=0;
+		for(int i=minKeys + 1;i<left->length;i++){
+			right->moveKey(j, left, i);
+			j++;
+		}
+		j=0;
+		for(int i= minKeys + 1;i<left->length+1;i++){
+			right->children[j] = left->children[i];
+			j++;
+		}
+		this->moveKey(index, left, minKeys);
+		right->length = left->length-minKeys-1;
+		left->length = minKeys;
+	}
+	this->length = this->length+1;
+}
+
+
+/*-- Methods for removal --*/
+
+// Performs modifications to ensure that this node's child at the given index has at least
+// minKeys+1 keys in preparation for a single removal. The child may gain a key and subchild
+// from its sibling, or it may be merged with a sibling, or nothing needs to be done.
+// A reference to the appropriate child is returned, which is helpful if the old child no longer exists.
+public: Node* ensureChildRemove(std::int32_t minKeys, std::uint32_t index) {
+	// Preliminaries
+	assert(!this->isLeaf() && index < this->length+1);
+	Node* child = this->children[index];
+	if (child->length > minKeys)  // Already satisfies the condition
+		return child;
+	assert(child->length == minKeys);
+
+	// Get siblings
+	Node* left = index >= 1 ? this->children[index - 1].pload() : nullptr;
+	Node* right = index < this->length ? this->children[index + 1].pload() : nullptr;
+	bool internal = !child->isLeaf();
+	assert(left != nullptr || right != nullptr);  // At least one sibling exists because degree >= 2
+	assert(left  == nullptr || left ->isLeaf() != internal);  // Sibling must be same type (internal/leaf) as child
+	assert(right == nullptr || right->isLeaf() != internal);  // Sibling must be same type (internal/leaf) as child
+
+	if (left != nullptr && left->length > minKeys) {  // Steal rightmost item from left sibling
+		if (internal) {
+			for(int i=child->length+1;i>=1;i--){
+				child->children[i] = child->children[i-1];
+			}
+			child->children[0] = left->children[left->length];
+		}
+		for(int i=child->length;i>=1;i--){
+			child->moveKey(i, child, i-1);
+			if (!internal) child->vals[i] = child->vals[i-1];
+		}
+		if (internal) {
+			// Rotate through the separator
+			child->moveKey(0, this, index - 1);
+			this->moveKey(index-1, left, left->length-1);
+		} else {
+			child->moveKey(0, left, left->length-1);
+			child->vals[0] = left->vals[left->length-1];
+			this->copyKey(index-1, child, 0);
+		}
+		left->length = left->length-1;
+		child->length = child->length+1;
+		return child;
+	} else if (right != nullptr && right->length > minKeys) {  // Steal leftmost item from right sibling
+		if (internal) {
+			child->children[child->length+1] = right->children[0];
+			for(int i=0;i<right->length;i++){
+				right->children[i] = right->children[i+1];
+			}
+			right->children[right->length] = nullptr;
+			// Rotate through the separator
+			child->moveKey(child->length, this, index);
+			this->moveKey(index, right, 0);
+		} else {
+			child->moveKey(child->length, right, 0);
+			child->vals[child->length] = right->vals[0];
+		}
+		for(int i=0;i<right->length-1;i++){
+			right->moveKey(i, right, i+1);
+			if (!internal) right->vals[i] = right->vals[i+1];
+		}
+		right->length = right->length-1;
+		child->length = child->length+1;
+		if (!internal) this->copyKey(index, right, 0);
+		return child;
+	} else if (left != nullptr) {  // Merge child into left sibling
+		this->mergeChildren(minKeys, index - 1);
+		return left;  // This is the only case where the return value is different
+	} else if (right != nullptr) {  // Merge right sibling into child
+		this->mergeChildren(minKeys, index);
+		return child;
+	} else
+		throw std::logic_error("Impossible condition");
+}
+
+
+// Merges the child node at index+1 into the child node at index,
+// assuming the current node is not empty and both children have minKeys.
+public: void mergeChildren(std::int32_t minKeys, std::uint32_t index) {
+	assert(!this->isLeaf() && index < this->length);
+	Node* left  = this->children[index];
+	Node* right = this->children[index+1];
+	assert(left->length == minKeys && right->length == minKeys);
+	if (left->isLeaf()){
+		// The separator is not needed anymore
+		this->keys[index].reset();
+		for(int i=0;i<right->length;i++){
+			left->moveKey(left->length+i, right, i);
+			left->vals[left->length+i] = right->vals[i];
+		}
+		left->length = left->length + right->length;
+		// Unlink the right leaf
+		Node* rnext = right->next;
+		left->next = rnext;
+		if (rnext != nullptr) rnext->prev = left;
+	} else {
+		// The separator moves down, between the keys of the two nodes
+		for(int i=0;i<right->length+1;i++){
+			left->children[left->length+1+i] = right->children[i];
+		}
+		left->moveKey(left->length, this, index);
+		for(int i=0;i<right->length;i++){
+			left->moveKey(left->length+1+i, right, i);
+		}
+		left->length = left->length + right->length+1;
+	}
+	// remove key(index)
+	for(int i=index;i<length-1;i++){
+		this->moveKey(i, this, i+1);
+	}
+	// remove children (index+1). All its keys and values have moved to the left node.
+	right->length = 0;
+	destroy(right);
+	for(int i=index+1;i<length;i++){
+		this->children[i] = this->children[i+1];
+	}
+	this->children[length] = nullptr;
+	length = length-1;
+}
+
+
+// Removes this leaf's key and value at the given index.
+public: void removeKey(std::uint32_t index) {
+	keys[index].reset();
+	vals[index].reset();
+	for(int i=index;i < this->length-1;i++){
+		this->moveKey(i, this, i+1);
+		this->vals[i] = this->vals[i+1];
+	}
+	length = length-1;
+}
+};
+
+static std::string className() { return PTM_NAME()+ "-BTreeMap" ; }
+
+
+// Number of keys in the tree
+long getSize() {
+	long size = 0;
+	for (int i = 0; i < NUM_STRIPES; i++) size += counters(i).keys.pload();
+	return size;
+}
+
+
+/*
+ * Adds a node with a key if the key is not present, otherwise replaces the value.
+ * Returns true if there was no mapping for the key, false if there was already a value and it was replaced.
+ */
+bool innerPut(const Slice& key, const Slice& val) {
+	// Special preprocessing to split root node
+	if (root.pload()->length.pload() == maxKeys) {
+		Node* child = root;
+		root = Node::create(maxKeys, false);  // Increment tree height
+		root.pload()->children[0] = child;
+		root.pload()->splitChild(minKeys, maxKeys, 0);
+	}
+
+	// Walk down the tree
+	Node* node = root;
+	while (true) {
+		assert(node->length < maxKeys);
+		assert(node == root || node->length >= minKeys);
+		if (node->isLeaf()) {
+			SearchResult sr = node->search(key);
+			std::int32_t index = sr.second;
+			if (sr.first) {
+				// Replace val
+				addCounters(0, 0, (int64_t)val.size() - (int64_t)node->vals[index].size());
+				node->vals[index] = val;
+				return false;  // Key already exists in tree
+			}
+			// Simple insertion into leaf
+			for(int i=node->length;i>=index+1;i--){
+				node->moveKey(i, node, i-1);
+				node->vals[i] = node->vals[i-1];
+			}
+			node->setKey(index, key);
+			node->vals[index] = val;
+			node->length = node->length+1;
+			addCounters(1, key.size(), val.size());
+			return true;  // Successfully inserted
+		}
+		// Internal node
+		std::int32_t index = node->childIndex(key);
+		Node* child = node->children[index];
+		if (child->length == maxKeys) {  // Split child node
+			node->splitChild(minKeys, maxKeys, index);
+			if (node->keys[index].compare(key) <= 0) child = node->children[index + 1];
+		}
+		node = child;
+	}
+}
+
+
+/*
+ * Read-modify-write of the value of 'key': calls fn(existing, &newValue), where 'existing' points to the current
+ * value, or is nullptr if the key is not present, and stores newValue if fn returns true, in the same node.
+ * Only an insertion of a new key walks down the tree a second time, with innerPut().
+ * Returns true if newValue was stored.
+ */
+template<typename F> bool innerUpdate(const Slice& key, F&& fn) {
+	Node* node = seekLeaf(key);
+	SearchResult sr = node->search(key);
+	std::string newValue;
+	if (!sr.first) {
+		if (!fn(nullptr, &newValue)) return false;
+		innerPut(key, newValue);
+		return true;
+	}
+	const Slice old(node->vals[sr.second].data(), node->vals[sr.second].size());
+	const bool store = fn(&old, &newValue);
+	PTM_CHECK_LOADS(old.data(), old.size());
+	if (!store) return false;
+	addCounters(0, 0, (int64_t)newValue.size() - (int64_t)old.size());
+	node->vals[sr.second] = Slice(newValue);
+	return true;
+}
+
+
+/*
+ * Removes a key and its mapping.
+ * Returns returns true if a matching key was found
+ */
+bool innerRemove(const Slice& key) {
+	// Walk down the tree
+	Node* node = root;
+	while (true) {
+		assert(node->length <= maxKeys);
+		assert(node == root || node->length > minKeys);
+		if (node->isLeaf()) {
+			SearchResult sr = node->search(key);
+			if (!sr.first) return false;
+			addCounters(-1, -(int64_t)node->keys[sr.second].size(), -(int64_t)node->vals[sr.second].size());
+			node->removeKey(sr.second);
+			return true;
+		}
+		// Internal node: the key might be found in some child
+		Node* child = node->ensureChildRemove(minKeys, node->childIndex(key));
+		if (node == root && root.pload()->length==0) {
+			// The root lost its last key in a merge, decrement tree height
+			Node* next = root.pload()->children[0];
+			Node::destroy(root.pload());
+			root = next;
+		}
+		node = child;
+	}
+}
+
+
+#ifdef PTM_MUST_RELOCATE
+/*
+ * Used by the compaction of the persistent memory pool.
+ * Walks down the tree to the leaf holding the successor of 'cursor', relocating the nodes on the path
+ * and their keys and values, if the PTM says they must be relocated.
+ * Returns false if there are no keys after 'cursor', otherwise sets 'next' to the last key in that leaf.
+ * Calling it with 'cursor' starting from an empty string, and then from 'next', until it returns false
+ * visits the whole tree, each call in its own (small) transaction.
+ */
+bool innerRelocate(const std::string& cursor, std::string& next) {
+	std::string target = cursor;
+	bool inclusive = false;    // True when looking for the first key at or after 'target'
+	while (true) {
+		Slice key(target);
+		Node* parent = nullptr;
+		std::int32_t pindex = 0;
+		Node* node = root;
+		Node* succ = nullptr;  // Deepest node on the path with a separator after the path
+		std::int32_t succIndex = 0;
+		while (true) {
+			node = relocateNode(node, parent, pindex);
+			for (int i = 0; i < node->length; i++) {
+				if (!node->keys[i].isInline() && PTM_MUST_RELOCATE(node->keys[i].data())) node->keys[i].relocate();
+				if (node->isLeaf() && !node->vals[i].isInline() && PTM_MUST_RELOCATE(node->vals[i].data())) node->vals[i].relocate();
+			}
+			if (node->isLeaf()) break;
+			parent = node;
+			pindex = node->childIndex(key);
+			if (pindex < node->length) {
+				succ = node;
+				succIndex = pindex;
+			}
+			node = node->children[pindex];
+		}
+		// First key larger than cursor. We compare the whole keys to be sure the cursor moves forward
+		std::int32_t index = 0;
+		while (index < node->length && node->keys[index].compare(key) < (inclusive ? 0 : 1)) index++;
+		if (index < node->length) {
+			next.assign(node->keys[node->length-1].data(), node->keys[node->length-1].size());
+			return true;
+		}
+		// The successor is in the next leaf, where the separator after the path leads to
+		if (succ == nullptr || inclusive) return false;
+		target.assign(succ->keys[succIndex].data(), succ->keys[succIndex].size());
+		inclusive = true;
+	}
+}
+
+// Moves a node to a new allocation if the PTM says it must be relocated, and returns the node to use.
+// 'parent' is the node that has it at children[pindex], or nullptr if it's the root.
+Node* relocateNode(Node* node, Node* parent, std::int32_t pindex) {
+	if (!PTM_MUST_RELOCATE(node->block())) return node;
+	Node* newnode = Node::create(maxKeys, node->isLeaf());
+	newnode->length = node->length.pload();
+	for (int i = 0; i < node->length; i++) {
+		newnode->moveKey(i, node, i);   // Does not copy the data
+		if (node->isLeaf()) newnode->vals[i] = node->vals[i];
+	}
+	if (node->isLeaf()) {
+		Node* lprev = node->prev;
+		Node* lnext = node->next;
+		newnode->prev = lprev;
+		newnode->next = lnext;
+		if (lprev != nullptr) lprev->next = newnode;
+		if (lnext != nullptr) lnext->prev = newnode;
+	} else {
+		for (int i = 0; i < node->length+1; i++) {
+			newnode->children[i] = node->children[i].pload();
+		}
+	}
+	if (parent == nullptr) {
+		root = newnode;
+	} else {
+		parent->children[pindex] = newnode;
+	}
+	// The keys and values now belong to the new node, so there is no destructor to call
+	PTM_FREE((void*)node->block());
+	return newnode;
+}
+#endif
+
+
+/*
+ * Calls visitor(key, value) for up to 'count' keys, starting at the first key at or after 'start' and following
+ * the links between the leaves, until the visitor returns false. Returns the number of keys visited.
+ * The Slices point to the keys and values in the nodes, and their contents are validated after the visitor
+ * returns, because the visitor reads them in place.
+ */
+template<typename F> int innerScan(const Slice& start, int count, F&& visitor) {
+	Node* node = seekLeaf(start);
+	std::int32_t i = node->search(start).second;
+	int visited = 0;
+	while (node != nullptr && visited < count) {
+		const std::int32_t len = node->length;
+		for (; i < len && visited < count; i++) {
+			const Slice k(node->keys[i].data(), node->keys[i].size());
+			const Slice v(node->vals[i].data(), node->vals[i].size());
+			const bool more = visitor(k, v);
+			PTM_CHECK_LOADS(k.data(), k.size());
+			PTM_CHECK_LOADS(v.data(), v.size());
+			visited++;
+			if (!more) return visited;
+		}
+		node = node->next;
+		i = 0;
+	}
+	return visited;
+}
+
+
+/*
+ * Looks up the keys keys[order[0]], keys[order[1]], ... keys[order[n-1]], which should be sorted, and calls
+ * found(order[i], value) for each one that is present. The Slice points to the value in the node and its
+ * contents are validated after found() returns.
+ * The lookups are done in groups of MULTIGET_GROUP, with their descents interleaved: all the leaves are at
+ * the same depth, so the group goes down one level at a time, and the next nodes of all the lookups are
+ * prefetched before any of them is searched, which overlaps their cache misses instead of paying them one
+ * after the other. The same is done with the values of the non-inline slices, before they are read.
+ * With sorted keys, neighbouring lookups often go through the same nodes, which are prefetched only once.
+ */
+template<typename F> void innerMultiGet(const Slice* keys, const std::int32_t* order, std::int32_t n, F&& found) {
+	Node* nodes[MULTIGET_GROUP];
+	std::int32_t idx[MULTIGET_GROUP];
+	for (std::int32_t g = 0; g < n; g += MULTIGET_GROUP) {
+		const std::int32_t gn = (n - g < MULTIGET_GROUP) ? n - g : MULTIGET_GROUP;
+		Node* node = root.pload();
+		for (std::int32_t j = 0; j < gn; j++) nodes[j] = node;
+		while (!node->isLeaf()) {
+			Node* last = nullptr;
+			for (std::int32_t j = 0; j < gn; j++) {
+				Node* child = nodes[j]->children[nodes[j]->childIndex(keys[order[g+j]])].pload();
+				if (child != last) prefetchNode(child);
+				last = child;
+				nodes[j] = child;
+			}
+			node = nodes[0];
+		}
+		for (std::int32_t j = 0; j < gn; j++) {
+			SearchResult sr = nodes[j]->search(keys[order[g+j]]);
+			idx[j] = sr.first ? sr.second : -1;
+			if (sr.first) __builtin_prefetch(nodes[j]->vals[sr.second].data(), 0, 3);
+		}
+		for (std::int32_t j = 0; j < gn; j++) {
+			if (idx[j] < 0) continue;
+			const Slice v(nodes[j]->vals[idx[j]].data(), nodes[j]->vals[idx[j]].size());
+			found(order[g+j], v);
+			PTM_CHECK_LOADS(v.data(), v.size());
+		}
+	}
+}
+
+
+/*
+ * Returns true if key is present. Saves a copy of 'value' in 'oldValue' if 'saveOldValue' is set.
+ */
+bool innerGet(const Slice& key, std::string* oldValue) {
+	Node* node = seekLeaf(key);
+	SearchResult sr = node->search(key);
+	if (!sr.first) return false;
+	// Found a matching key: make a copy of the corresponding value, which is read in place
+	const Slice val(node->vals[sr.second].data(), node->vals[sr.second].size());
+	oldValue->assign(val.data(), val.size());
+	PTM_CHECK_LOADS(val.data(), val.size());
+	return true;
+}
+
+};
+}
+#endif   // _TM_BTREE_MAP_PSLICE_H_
@@ -15,6 +15,8 @@
 #ifndef _TM_BTREE_MAP_ITERATOR_H_
 #define _TM_BTREE_MAP_ITERATOR_H_
 
+#include <string>
+#include <vector>
 #include "slice.h"
 #include "status.h"
 #include "iterator.h"
@@ -27,7 +29,7 @@ class TMBTreeMapIterator : public Iterator {
 public:
     uint8_t           pad_a[64];
 	TMBTreeMap*       db_btree = nullptr;
-	// The state of the iterator is kept in the 'bucket' and 'node'
+	// The state of the iterator is the leaf 'node' and the index 'it' of the key in that leaf
 	TMBTreeMap::Node* node = nullptr;
 	long              it = -1;
 	uint8_t           pad_b[64];
@@ -48,112 +50,40 @@ public:
 	// Position at the first key in the source.  The iterator is Valid()
 	// after this call iff the source is not empty.
 	void SeekToFirst(){
-		TMBTreeMap::Node* n = db_btree->root.pload();
-		if(n->isLeaf()){
-			it = -1;
-			return;
-		}
-
-		while(!n->isLeaf()){
-			n = n->children[0].pload();
-		}
-		node = n;
-		it = 0;
-
+		node = db_btree->seekFirst(db_btree->root.pload());
+		it = (node->length.pload() == 0) ? -1 : 0;
 	}
 
 	// Position at the last key in the source.  The iterator is
 	// Valid() after this call iff the source is not empty.
 	void SeekToLast(){
-		TMBTreeMap::Node* n = db_btree->root.pload();
-		if(n->isLeaf()){
-			it = -1;
-			return;
-		}
-
-		while(!n->isLeaf()){
-			n = n->children[n->length.pload()].pload();
-		}
-		node = n;
-		it = n->length.pload()-1;
-
+		node = db_btree->seekLast(db_btree->root.pload());
+		it = node->length.pload()-1;
 	}
 
 	// Position at the first key in the source that is at or past target.
 	// The iterator is Valid() after this call iff the source contains
 	// an entry that comes at or past target.
 	void Seek(const Slice& target){
-		node = db_btree->root.pload();
-
-		TMBTreeMap::Node* snode = node;
-		while(!snode->isLeaf()){
-			TMBTreeMap::SearchResult sr = snode->search(target);
-			if (sr.first){
-				node = snode;
-				it = sr.second;
-				return;
-			}
-			else{// Internal node
-				snode = snode->children[sr.second];
-			}
-
-		}
-
-		TMBTreeMap::SearchResult sr = snode->search(target);
-		if(sr.first || sr.second<snode->length){
-			node = snode;
-			it = sr.second;
-			return;
+		node = db_btree->seekLeaf(target);
+		TMBTreeMap::SearchResult sr = node->search(target);
+		it = sr.second;
+		// All the keys in this leaf are smaller than target, the next one is in the next leaf
+		if (it == node->length.pload()) {
+			node = node->next.pload();
+			it = (node == nullptr) ? -1 : 0;
 		}
-		node = snode;
-		while(true){
-			TMBTreeMap::Node* p = node->parent.pload();
-			if(p==nullptr) {
-				it=-1;
-				return;
-			}
-			int32_t index = node->childIndex.pload();
-			node = p;
-			if(index != p->length){
-				it = index;
-				return;
-			}
-		}
-
 	}
 
 	// Moves to the next entry in the source.  After this call, Valid() is
 	// true iff the iterator was not positioned at the last entry in the source.
 	// REQUIRES: Valid()
 	void Next(){
-
 		if(it == -1) return;
-
-		if(node->isLeaf()){
-			it++;
-			if(it<node->length) {
-				return;
-			}
-			while(true){
-				TMBTreeMap::Node* p = node->parent.pload();
-				if(p==nullptr) {
-					it=-1;
-					return;
-				}
-				int32_t index = node->childIndex.pload();
-				node = p;
-				if(index < p->length){
-					it = index;
-					return;
-				}
-			}
-		}
-
-		node = node->children[it+1];
-		while(!node->isLeaf()){
-			node = node->children[0];
-		}
-		it = 0;
+		it++;
+		if(it < node->length.pload()) return;
+		node = node->next.pload();
+		it = (node == nullptr) ? -1 : 0;
 	}
 
 	// Moves to the previous entry in the source.  After this call, Valid() is
@@ -161,33 +91,10 @@ public:
 	// REQUIRES: Valid()
 	void Prev(){
 		if(it == -1) return;
-
-		if(node->isLeaf()){
-			it--;
-			if(it>=0) {
-				return;
-			}
-			while(true){
-				TMBTreeMap::Node* p = node->parent.pload();
-				if(p==nullptr) {
-					it=-1;
-					return;
-				}
-				int32_t index = node->childIndex.pload();
-				node = p;
-				if(index-1 >= 0){
-					it = index-1;
-					return;
-				}
-
-			}
-		}
-
-		node = node->children[it];
-		while(!node->isLeaf()){
-			node = node->children[node->length];
-		}
-		it = node->length-1;
+		it--;
+		if(it >= 0) return;
+		node = node->prev.pload();
+		it = (node == nullptr) ? -1 : node->length.pload()-1;
 	}
 
 	// Return the key for the current entry.  The underlying storage for
@@ -196,9 +103,7 @@ public:
 	// REQUIRES: Valid()
 	Slice key() const{
 		if(it==-1) return Slice();
-		return node->keys[it].data();
-
-
+		return Slice(node->keys[it].data(), node->keys[it].size());
 	}
 
 	// Return the value for the current entry.  The underlying storage for
@@ -207,7 +112,7 @@ public:
 	// REQUIRES: Valid()
 	Slice value() const{
 		if(it==-1) return Slice();
-		return node->vals[it].data();
+		return Slice(node->vals[it].data(), node->vals[it].size());
 	}
 
 	// If an error has occurred, return it.  Else return an ok status.
@@ -230,6 +135,133 @@ public:
 	void operator=(const TMBTreeMapIterator&);
 };
 
+
+/*
+ * Iterator that can be used outside of a transaction.
+ * Each read transaction copies the next 'batchSize' key/value pairs (in the direction of the scan) to a
+ * volatile buffer, and the iterator moves on the buffer until it runs out. The next batch starts with a
+ * Seek() to the last key in the buffer, which means each batch is consistent, though keys inserted or removed
+ * by other threads between two batches may or may not be seen.
+ * The TMBTreeMapIterator above is faster but can only be used inside of a readTx().
+ */
+class TMBTreeMapBatchIterator : public Iterator {
+public:
+	TMBTreeMap*              db_btree = nullptr;
+	const int32_t            batchSize;
+	// The pairs copied in the last transaction, in the order they are visited
+	std::vector<std::string> keys;
+	std::vector<std::string> vals;
+	int32_t                  length = 0;
+	int32_t                  it = -1;         // Index of the current pair, -1 if not Valid()
+	bool                     forward = true;  // Direction of the scan when the buffer was filled
+	bool                     last = true;     // There are no more pairs after the ones in the buffer
+	std::string              resumeKey;
+
+	TMBTreeMapBatchIterator(TMBTreeMap* db_btree, int32_t batchSize) : db_btree{db_btree}, batchSize{batchSize},
+	                                                                   keys(batchSize), vals(batchSize) {
+	}
+
+	~TMBTreeMapBatchIterator() {
+	}
+
+	bool Valid() const {
+		return it != -1;
+	}
+
+	void SeekToFirst() {
+		fill(nullptr, true, false);
+	}
+
+	void SeekToLast() {
+		fill(nullptr, false, false);
+	}
+
+	void Seek(const Slice& target) {
+		// 'target' may be the key() of this iterator, which the fill() overwrites
+		resumeKey.assign(target.data(), target.size());
+		fill(&resumeKey, true, false);
+	}
+
+	void Next() {
+		if (it == -1) return;
+		if (forward) {
+			if (it+1 < length) { it++; return; }
+			if (last) { it = -1; return; }
+		}
+		resumeKey = keys[it];
+		fill(&resumeKey, true, true);
+	}
+
+	void Prev() {
+		if (it == -1) return;
+		if (!forward) {
+			if (it+1 < length) { it++; return; }
+			if (last) { it = -1; return; }
+		}
+		resumeKey = keys[it];
+		fill(&resumeKey, false, true);
+	}
+
+	Slice key() const {
+		if (it == -1) return Slice();
+		return Slice(keys[it]);
+	}
+
+	Slice value() const {
+		if (it == -1) return Slice();
+		return Slice(vals[it]);
+	}
+
+	Status status() const {
+		return Status{};
+	}
+
+	void RegisterCleanup(CleanupFunction function, void* arg1, void* arg2) {
+	}
+
+	// Copies up to batchSize pairs, in a single read transaction, starting from the first (or last, if
+	// going backwards) key, or from 'start'. If 'exclusive' is set, 'start' itself is skipped.
+	void fill(const std::string* start, bool fwd, bool exclusive) {
+		forward = fwd;
+		PTM_READ_TX([&] () {
+			length = 0;
+			TMBTreeMapIterator raw(db_btree);
+			if (start == nullptr) {
+				if (fwd) raw.SeekToFirst();
+				else raw.SeekToLast();
+			} else {
+				Slice skey(*start);
+				raw.Seek(skey);
+				if (fwd) {
+					if (exclusive && raw.Valid() && raw.node->keys[raw.it].compare(skey) == 0) raw.Next();
+				} else {
+					// Seek() gives the first key at or after 'start', we want the last one before it (or at it)
+					if (!raw.Valid()) raw.SeekToLast();
+					else if (exclusive || raw.node->keys[raw.it].compare(skey) != 0) raw.Prev();
+				}
+			}
+			while (raw.Valid() && length < batchSize) {
+				// The bytes are read in place, so they are validated after they are copied
+				const Slice k(raw.node->keys[raw.it].data(), raw.node->keys[raw.it].size());
+				const Slice v(raw.node->vals[raw.it].data(), raw.node->vals[raw.it].size());
+				keys[length].assign(k.data(), k.size());
+				vals[length].assign(v.data(), v.size());
+				PTM_CHECK_LOADS(k.data(), k.size());
+				PTM_CHECK_LOADS(v.data(), v.size());
+				length++;
+				if (fwd) raw.Next();
+				else raw.Prev();
+			}
+			last = !raw.Valid();
+		});
+		it = (length == 0) ? -1 : 0;
+	}
+
+	// No copying allowed
+	TMBTreeMapBatchIterator(const TMBTreeMapBatchIterator&);
+	void operator=(const TMBTreeMapBatchIterator&);
+};
+
 }  // namespace ptmdb
 
 #endif  // _TM_BTREE_MAP_ITERATOR_H_
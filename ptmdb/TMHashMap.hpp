@@ -11,67 +11,41 @@ namespace ptmdb {
 /**
  * <h1> A NON-Resizable Hash Map for usage in PTMDB </h1>
  *
+ * Used as the index of the column families created with kHashIndex. The keys and values are stored like
+ * in the TMBTreeMap (inline when they are small). Like the TMBTreeMap, it must be created, deleted and
+ * accessed inside transactions.
  */
 class TMHashMap : public PTM_BASE {
 public:
     struct Node : public PTM_BASE {
-        PSlice               key;  // Immutable after node creation, so no need for persist<PSlice>
-        PSlice               val;  // Mutates only when put() replaces the key
+        PBTSlice             key;  // Immutable after node creation
+        PBTValueSlice        val;  // Mutates only when put() replaces the key
         PTM_TYPE<Node*>      next {nullptr};
-        Node(const Slice& k, const Slice& v):key{k},val{v}{}
+        Node(const Slice& k, const Slice& v) { key = k; val = v; }
     };
 
 
     PTM_TYPE<long>                         capacity;
-    PTM_TYPE<long>                         sizeHM = 0;
-    PTM_TYPE<double>                       loadFactor = 2;
     alignas(128) PTM_TYPE<PTM_TYPE<Node*>*> buckets;      // An array of pointers to Nodes
 
 
 public:
     TMHashMap(int capacity=1*1024*1024) : capacity{capacity} {
-#ifdef PTMDB_CAPTURE_BY_COPY
-        PTM_UPDATE_TX<bool>([=] () {
-            buckets = (PTM_TYPE<Node*>*)PTM_MALLOC(capacity*sizeof(PTM_TYPE<Node*>));
-            for (int i = 0; i < capacity; i++) buckets[i]=nullptr;
-            return true;
-        });
-#else
-        PTM_UPDATE_TX([&] () {
-            buckets = (PTM_TYPE<Node*>*)PTM_MALLOC(capacity*sizeof(PTM_TYPE<Node*>));
-            for (int i = 0; i < capacity; i++) buckets[i]=nullptr;
-        });
-#endif
+        buckets = (PTM_TYPE<Node*>*)PTM_MALLOC(capacity*sizeof(PTM_TYPE<Node*>));
+        for (int i = 0; i < capacity; i++) buckets[i]=nullptr;
     }
 
 
-    ~TMHashMap() noexcept(false) {
-#ifdef PTMDB_CAPTURE_BY_COPY
-        PTM_UPDATE_TX<bool>([=] () {
-            for(int i = 0; i < capacity; i++){
-                Node* node = buckets[i];
-                while (node!=nullptr) {
-                    Node* next = node->next;
-                    PTM_DELETE(node);
-                    node = next;
-                }
-            }
-            TM_PFREE(buckets);
-            return true;
-        });
-#else
-        PTM_UPDATE_TX([&] () {
-            for(int i = 0; i < capacity; i++){
-                Node* node = buckets[i];
-                while (node!=nullptr) {
-                    Node* next = node->next;
-                    PTM_DELETE(node);
-                    node = next;
-                }
+    ~TMHashMap() {
+        for(int i = 0; i < capacity; i++){
+            Node* node = buckets[i];
+            while (node!=nullptr) {
+                Node* next = node->next;
+                PTM_DELETE(node);
+                node = next;
             }
-            PTM_FREE(buckets);
-        });
-#endif
+        }
+        PTM_FREE(buckets.pload());
     }
 
 
@@ -124,8 +98,7 @@ public:
                 //sizeHM++;
                 return true;  // New insertion
             }
-            if (node->key == key) {
-                node->val.destructor(); // TODO: is this realy needed? we take care of it in the assignment operator
+            if (node->key.compare(key) == 0) {
                 node->val = value;
                 return false; // Replace value for existing key
             }
@@ -145,15 +118,13 @@ public:
         Node* prev = node;
         while (true) {
             if (node == nullptr) return false;
-            if (node->key == key) {
+            if (node->key.compare(key) == 0) {
                 if (node == prev) {
                     buckets[h] = node->next;
                 } else {
                     prev->next = node->next;
                 }
                 //sizeHM--;
-                node->key.destructor();
-                node->val.destructor();
                 PTM_DELETE(node);
                 return true;
             }
@@ -171,13 +142,37 @@ public:
         Node* node = buckets[h];
         while (true) {
             if (node == nullptr) return false;
-            if (node->key == key) {
-                oldValue->assign(node->val.data(), node->val.size());  // Makes a copy of V
+            if (node->key.compare(key) == 0) {
+                const Slice val(node->val.data(), node->val.size());
+                oldValue->assign(val.data(), val.size());  // Makes a copy of V
+                PTM_CHECK_LOADS(val.data(), val.size());
                 return true;
             }
             node = node->next;
         }
     }
+
+
+    /*
+     * Read-modify-write of the value of 'key', with the same semantics as TMBTreeMap::innerUpdate().
+     */
+    template<typename F> bool innerUpdate(const Slice& key, F&& fn) {
+        auto h = std::hash<Slice>{}(key) % capacity;
+        Node* node = buckets[h];
+        while (node != nullptr && node->key.compare(key) != 0) node = node->next;
+        std::string newValue;
+        if (node == nullptr) {
+            if (!fn(nullptr, &newValue)) return false;
+            innerPut(key, newValue);
+            return true;
+        }
+        const Slice old(node->val.data(), node->val.size());
+        const bool store = fn(&old, &newValue);
+        PTM_CHECK_LOADS(old.data(), old.size());
+        if (!store) return false;
+        node->val = Slice(newValue);
+        return true;
+    }
     
     int getBucket(const Slice& key) {
         return std::hash<Slice>{}(key) % capacity;
@@ -45,10 +45,7 @@ class TMHashMapIterator : public Iterator {
   // Position at the first key in the source.  The iterator is Valid()
   // after this call iff the source is not empty.
   void SeekToFirst(){
-      if(db_hashmap->sizeHM.pload()==0){
-          bucket = -1;
-          return;
-      }
+      bucket = -1;
       for(int i=0;i< db_hashmap->capacity;i++){
           if(db_hashmap->buckets[i]!=nullptr){
               bucket = i;
@@ -61,10 +58,7 @@ class TMHashMapIterator : public Iterator {
   // Position at the last key in the source.  The iterator is
   // Valid() after this call iff the source is not empty.
   void SeekToLast(){
-      if(db_hashmap->sizeHM.pload()==0){
-          bucket = -1;
-          return;
-      }
+      bucket = -1;
       for(int i=db_hashmap->capacity-1; i >= 0; i--){
         if(db_hashmap->buckets[i]!=nullptr){
             bucket = i;
@@ -84,15 +78,11 @@ class TMHashMapIterator : public Iterator {
   // The iterator is Valid() after this call iff the source contains
   // an entry that comes at or past target.
   void Seek(const Slice& target){
-      if(db_hashmap->sizeHM.pload()==0){
-          bucket = -1;
-          return;
-      }
       auto h = db_hashmap->getBucket(target);
       TMHashMap::Node* nodeSeek = db_hashmap->buckets[h];
       TMHashMap::Node* prev = nodeSeek;
       while(nodeSeek!=nullptr){
-          if(nodeSeek->key == target){
+          if(nodeSeek->key.compare(target) == 0){
               bucket = h;
               node = nodeSeek;
               return;
@@ -166,7 +156,7 @@ class TMHashMapIterator : public Iterator {
   // REQUIRES: Valid()
   Slice key() const{
 	  if(bucket == -1) return Slice();
-      return node->key.data();
+      return Slice(node->key.data(), node->key.size());
   }
 
   // Return the value for the current entry.  The underlying storage for
@@ -175,7 +165,7 @@ class TMHashMapIterator : public Iterator {
   // REQUIRES: Valid()
   Slice value() const{
 	  if(bucket == -1) return Slice();
-      return node->val.data();
+      return Slice(node->val.data(), node->val.size());
   }
 
   // If an error has occurred, return it.  Else return an ok status.
@@ -189,7 +179,7 @@ class TMHashMapIterator : public Iterator {
   // Note that unlike all of the preceding methods, this method is
   // not abstract and therefore clients should not override it.
   //typedef void (*CleanupFunction)(void* arg1, void* arg2);
-  void RegisterCleanup(CleanupFunction function, void* arg1, void* arg2){
+  void RegisterCleanup(CleanupFunction, void*, void*){
 
   }
 
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2017-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.txt
+ */
+#ifndef _PTMDB_DB_COLUMN_FAMILY_H_
+#define _PTMDB_DB_COLUMN_FAMILY_H_
+
+#include <atomic>
+#include <string>
+#include "db.h"
+#include "options.h"
+#include "ptmdb.h"
+#include "TMBTreeMap.hpp"
+#include "TMHashMap.hpp"
+
+namespace ptmdb {
+
+/*
+ * Persistent catalog of the column families, in the root pointer 1.
+ * The default family is not in the catalog: its tree is in the root pointer 0, like in the DBs created
+ * before there were column families, which open with an empty catalog.
+ * The family in entries[i] has the id i+1. A free entry has a null index.
+ * The generation of an entry is incremented each time a family is created in it, and is kept when the family is
+ * dropped, so that the operations of a WriteBatch made for a dropped family are not applied to a new one.
+ */
+class ColumnFamilyCatalog {
+public:
+    static const int MAX_FAMILIES = 63;
+
+    struct Entry {
+        PBTSlice                name;
+        PTM_TYPE<int32_t>       type {kBTreeIndex};
+        PTM_TYPE<TMBTreeMap*>   tree {nullptr};
+        PTM_TYPE<TMHashMap*>    hash {nullptr};
+        PTM_TYPE<uint32_t>      generation {0};
+
+        bool isFree() const { return tree.pload() == nullptr && hash.pload() == nullptr; }
+    };
+
+    Entry entries[MAX_FAMILIES];
+};
+
+
+/*
+ * Volatile handle of a column family, with the index of the family. The inner*() methods dispatch to the
+ * index and must be called inside transactions.
+ */
+class ColumnFamilyHandleImpl : public ColumnFamilyHandle {
+public:
+    const uint32_t          id;
+    const uint32_t          generation; // Of the catalog entry, zero for the default family
+    const std::string       name;
+    TMBTreeMap* const       tree;       // Null if the family has a hash index
+    TMHashMap* const        hash;       // Null if the family has a B-tree index
+    std::atomic<bool>       dropped {false};
+
+    ColumnFamilyHandleImpl(uint32_t id, uint32_t generation, const std::string& name, TMBTreeMap* tree, TMHashMap* hash) :
+        id{id}, generation{generation}, name{name}, tree{tree}, hash{hash} { }
+
+    const std::string& GetName() const { return name; }
+
+    uint32_t GetID() const { return id; }
+
+    uint32_t GetGeneration() const { return generation; }
+
+    bool innerPut(const Slice& key, const Slice& value) {
+        return (tree != nullptr) ? tree->innerPut(key, value) : hash->innerPut(key, value);
+    }
+
+    bool innerRemove(const Slice& key) {
+        return (tree != nullptr) ? tree->innerRemove(key) : hash->innerRemove(key);
+    }
+
+    bool innerGet(const Slice& key, std::string* value) {
+        return (tree != nullptr) ? tree->innerGet(key, value) : hash->innerGet(key, value);
+    }
+
+    template<typename F> bool innerUpdate(const Slice& key, F&& fn) {
+        return (tree != nullptr) ? tree->innerUpdate(key, fn) : hash->innerUpdate(key, fn);
+    }
+
+    // The hash index has no ordering to take advantage of, so it does one lookup after the other
+    template<typename F> void innerMultiGet(const Slice* keys, const std::int32_t* order, std::int32_t n, F&& found) {
+        if (tree != nullptr) {
+            tree->innerMultiGet(keys, order, n, found);
+            return;
+        }
+        std::string value;
+        for (std::int32_t i = 0; i < n; i++) {
+            if (hash->innerGet(keys[order[i]], &value)) found(order[i], Slice(value));
+        }
+    }
+};
+
+}  // namespace ptmdb
+
+#endif  // _PTMDB_DB_COLUMN_FAMILY_H_
@@ -9,6 +9,8 @@
 #ifndef _PTMDB_INCLUDE_DB_H_
 #define _PTMDB_INCLUDE_DB_H_
 
+#include <functional>
+#include <vector>
 #include "iterator.h"
 #include "options.h"
 #include "ptmdb.h"
@@ -42,6 +44,20 @@ struct Range {
     Range(const Slice& s, const Slice& l) : start(s), limit(l) { }
 };
 
+// Handle to a column family of a DB (see DB::CreateColumnFamily()).
+// The handles are owned by the DB, and remain valid until the DB is deleted,
+// even after the family is dropped.
+class ColumnFamilyHandle {
+public:
+    virtual ~ColumnFamilyHandle() { }
+    virtual const std::string& GetName() const = 0;
+    // The default family has id zero
+    virtual uint32_t GetID() const = 0;
+    // The id of a dropped family is given to the next family created, with
+    // a new generation, so a WriteBatch can tell the two apart
+    virtual uint32_t GetGeneration() const = 0;
+};
+
 // A DB is a persistent ordered map from keys to values.
 // A DB is safe for concurrent access from multiple threads without
 // any external synchronization.
@@ -72,6 +88,25 @@ public:
     // Note: consider setting options.sync = true.
     virtual Status Delete(const WriteOptions& options, const Slice& key) = 0;
 
+    // Replace the value of "key" with the result of applying "operand" to
+    // it with options.merge_operator, which also sees when the key is
+    // missing. The read and the write are done in a single transaction.
+    // Returns NotSupported if the DB has no merge operator, and
+    // InvalidArgument if the operator failed, leaving the key unchanged.
+    virtual Status Merge(const WriteOptions& options, const Slice& key,
+            const Slice& operand) = 0;
+
+    // Read-modify-write of "key" in a single update transaction: calls
+    // fn(existing_value, &new_value), where existing_value is NULL if the
+    // key is missing, and stores new_value as the value of "key" if fn
+    // returns true. If fn returns false, the key is left unchanged and a
+    // status for which Status::IsAborted() returns true is returned.
+    // existing_value points into the DB and is only valid during the call.
+    // fn may be called several times, if the transaction restarts, and by
+    // other threads (with flat-combining), so it must not have side effects.
+    virtual Status Update(const WriteOptions& options, const Slice& key,
+            const std::function<bool(const Slice* existing_value, std::string* new_value)>& fn) = 0;
+
     // Apply the specified updates to the database.
     // Returns OK on success, non-OK on failure.
     // Note: consider setting options.sync = true.
@@ -88,14 +123,127 @@ public:
     virtual Status Get(const ReadOptions& options,
             const Slice& key, std::string* value) = 0;
 
+    // Get() of several keys at once, in a single read transaction. Returns
+    // one Status per key, and (*values)[i] has the value of keys[i] when its
+    // Status is OK. The values vector is resized to the number of keys.
+    //
+    // The keys are looked up in sorted order, with the tree descents of
+    // several keys interleaved so that their memory accesses overlap, which
+    // is faster than one Get() per key for batches of a few tens of keys.
+    virtual std::vector<Status> MultiGet(const ReadOptions& options,
+            const std::vector<Slice>& keys, std::vector<std::string>* values) = 0;
+
     // Return a heap-allocated iterator over the contents of the database.
     // The result of NewIterator() is initially invalid (caller must
     // call one of the Seek methods on the iterator before using it).
     //
     // Caller should delete the iterator when it is no longer needed.
     // The returned iterator should be deleted before this db is deleted.
+    // Unless options.iterator_batch_size is zero, the iterator reads
+    // batches of keys in their own read transactions (see ReadOptions).
     virtual Iterator* NewIterator(const ReadOptions& options) = 0;
 
+    // Calls visitor(key, value) for the first 'count' entries at or after
+    // 'start', in key order, or until the visitor returns false.
+    // All the entries are visited in a single read transaction, walking the
+    // DB directly. The key and value Slices point into the DB and are only
+    // valid during the call to the visitor. If the transaction restarts, the
+    // visitor is called again from the first entry, so it should not keep
+    // state that can't be reset (like a count, unless it's reset on 'start').
+    virtual Status Scan(const ReadOptions& options, const Slice& start, int count,
+            const std::function<bool(const Slice& key, const Slice& value)>& visitor) = 0;
+
+    // DB implementations can export properties about their state
+    // via this method.  If "property" is a valid property understood by this
+    // DB implementation, fills "*value" with its current value and returns
+    // true.  Otherwise returns false.
+    //
+    // Valid property names include:
+    //
+    //  "ptmdb.stats" - returns a multi-line string with the statistics of
+    //     the persistent memory allocator.
+    //  "ptmdb.pm-used-bytes" - bytes of the persistent memory pool in use,
+    //     from its start up to the top of the allocator.
+    //  "ptmdb.pm-live-bytes" - bytes in blocks currently allocated.
+    //  "ptmdb.pm-free-bytes" - bytes in blocks sitting in the free-lists.
+    //  "ptmdb.pm-fragmentation" - percentage of the used pool which is not
+    //     holding live data.
+    //  "ptmdb.num-keys" - number of keys in the DB.
+    //  "ptmdb.key-bytes" - sum of the sizes of the keys.
+    //  "ptmdb.value-bytes" - sum of the sizes of the values.
+    //  "ptmdb.data-stats" - the three above, in a single line.
+    //
+    // The last four are kept up to date by each write, and are cheap to read.
+    // The others return false if the underlying PTM does not provide
+    // allocator statistics.
+    virtual bool GetProperty(const Slice& property, std::string* value) = 0;
+
+    // Compact the underlying storage for the key range [*begin,*end].
+    // In PTM-DB this means relocating the keys and values in that range (and the
+    // tree nodes on the way to them) out of the sparsely used regions of the
+    // persistent memory pool, and handing back the regions left empty, so that a
+    // fragmented pool can be reclaimed without a dump and reload.
+    //
+    // begin==NULL is treated as a key before all keys in the database.
+    // end==NULL is treated as a key after all keys in the database.
+    // Therefore the following call will compact the entire database:
+    //    db->CompactRange(NULL, NULL);
+    //
+    // Does nothing if the underlying PTM does not support compaction.
+    virtual void CompactRange(const Slice* begin, const Slice* end) = 0;
+
+    // Column families are named keyspaces of the DB, each one with its own
+    // index (see ColumnFamilyOptions), so that the keys of different tables
+    // don't interleave, and each table has a tree as small as its data.
+    // The methods above use the default family, which always exists and is
+    // the whole DB for applications that don't use column families.
+    // The list of families is in a persistent catalog, and survives restarts.
+
+    // Creates a new family and stores its handle in *handle. Returns
+    // InvalidArgument if there is already a family with that name, and
+    // NotSupported if the maximum number of families was reached.
+    virtual Status CreateColumnFamily(const ColumnFamilyOptions& options,
+            const std::string& name, ColumnFamilyHandle** handle) = 0;
+
+    // Deletes a family and all of its keys. The handle remains valid, and
+    // the operations on it return InvalidArgument. The caller must make sure
+    // that no other threads are using the family. The default family can not
+    // be dropped.
+    virtual Status DropColumnFamily(ColumnFamilyHandle* handle) = 0;
+
+    // Stores in *handle the handle of an existing family. Used to get the
+    // handles of the families after the DB is opened again.
+    virtual Status GetColumnFamily(const std::string& name,
+            ColumnFamilyHandle** handle) = 0;
+
+    // Stores the names of all the families in *names, starting with the
+    // default one ("default").
+    virtual Status ListColumnFamilies(std::vector<std::string>* names) = 0;
+
+    virtual ColumnFamilyHandle* DefaultColumnFamily() = 0;
+
+    // The same as the methods above, in the given column family. The ones
+    // that need an ordered index (Scan(), and the properties of the keys)
+    // return NotSupported on a family with a kHashIndex.
+    virtual Status Put(const WriteOptions& options, ColumnFamilyHandle* column_family,
+            const Slice& key, const Slice& value) = 0;
+    virtual Status Delete(const WriteOptions& options, ColumnFamilyHandle* column_family,
+            const Slice& key) = 0;
+    virtual Status Merge(const WriteOptions& options, ColumnFamilyHandle* column_family,
+            const Slice& key, const Slice& operand) = 0;
+    virtual Status Update(const WriteOptions& options, ColumnFamilyHandle* column_family, const Slice& key,
+            const std::function<bool(const Slice* existing_value, std::string* new_value)>& fn) = 0;
+    virtual Status Get(const ReadOptions& options, ColumnFamilyHandle* column_family,
+            const Slice& key, std::string* value) = 0;
+    virtual std::vector<Status> MultiGet(const ReadOptions& options, ColumnFamilyHandle* column_family,
+            const std::vector<Slice>& keys, std::vector<std::string>* values) = 0;
+    virtual Iterator* NewIterator(const ReadOptions& options, ColumnFamilyHandle* column_family) = 0;
+    virtual Status Scan(const ReadOptions& options, ColumnFamilyHandle* column_family,
+            const Slice& start, int count,
+            const std::function<bool(const Slice& key, const Slice& value)>& visitor) = 0;
+    virtual bool GetProperty(ColumnFamilyHandle* column_family, const Slice& property,
+            std::string* value) = 0;
+
 
 private:
     // No copying allowed
@@ -117,13 +265,12 @@ Status DestroyDB(const std::string& name, const Options& options);
 Status RepairDB(const std::string& dbname, const Options& options);
 
 // A read-only transaction can be executed by passing a lambda, function pointer or std::function
-#ifdef PTMDB_CAPTURE_BY_COPY
-// Used by CX-Redo (capture by value and uint64_t return value)
-template<typename R, typename F> R readTx(F&& func) { return PTM_READ_TX<R>(func); }
-#else
+#ifndef PTMDB_CAPTURE_BY_COPY
 // Used by Romulus and all the other durabletx PTMs (capture by ref and no return value needed)
 template<typename F> void readTx(F&& func) { PTM_READ_TX(func); }
 #endif
+// Returns the value returned by func(), which is moved out after the commit. Needed by CX-Redo (capture by value).
+template<typename R, typename F> R readTx(F&& func) { return PTM_READ_TX<R>(func); }
 
 }  // namespace ptmdb
 
@@ -46,7 +46,10 @@ using namespace chrono;
 //      deleterandom  -- delete N keys in random order
 //      readseq       -- read N times sequentially
 //      readreverse   -- read N times in reverse order
+//      readseqbatch  -- read N times sequentially, with an iterator that reads a batch of keys per transaction
+//      readreversebatch -- read N times in reverse order, with an iterator that reads a batch of keys per transaction
 //      readrandom    -- read N times in random order
+//      multireadrandom -- read N times in random order, with a MultiGet() of --multiget_batch_size keys
 //      readmissing   -- read N missing keys in random order
 //      readhot       -- read N times in random order from 1% section of DB
 //      seekrandom    -- N random seeks
@@ -54,7 +57,7 @@ using namespace chrono;
 //      crc32c        -- repeated crc32c of 4K of data
 //      acquireload   -- load N*1000 times
 //   Meta operations:
-//      compact     -- Compact the entire DB  (Pedro: disabled)
+//      compact     -- Compact the entire DB (relocates live data out of fragmented regions of the PM pool)
 //      stats       -- Print DB stats
 //      sstables    -- Print sstable info
 //      heapprofile -- Dump a heap profile (if supported by this port)
@@ -120,6 +123,15 @@ static int FLAGS_open_files = 0;
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
 
+// Number of keys read in each transaction by the iterators of readseqbatch and readreversebatch
+static int FLAGS_iterator_batch_size = 64;
+
+// Number of keys read by each MultiGet() of multireadrandom
+static int FLAGS_multiget_batch_size = 16;
+
+// Degree of the B-tree (see Options::btree_degree). Zero means the largest one.
+static int FLAGS_btree_degree = 0;
+
 // If true, do not destroy the existing database.  If you set this
 // flag and also specify a benchmark that wants a fresh database, that
 // benchmark will fail.
@@ -349,6 +361,9 @@ private:
         fprintf(stdout, "Keys:       %d bytes each\n", kKeySize);
         fprintf(stdout, "Values:     %d bytes each\n", FLAGS_value_size);
         fprintf(stdout, "Entries:    %d\n", num_);
+        fprintf(stdout, "BTree:      degree %d (nodes with up to %d keys)\n",
+                (FLAGS_btree_degree <= 0 || FLAGS_btree_degree > TMBTreeMap::MAX_DEGREE) ? TMBTreeMap::MAX_DEGREE : std::max(FLAGS_btree_degree, 2),
+                PTMDB_BTREE_MAXKEYS);
         fprintf(stdout, "RawSize:    %.1f MB (estimated)\n",
                 ((static_cast<int64_t>(kKeySize + FLAGS_value_size) * num_)
                         / 1048576.0));
@@ -504,8 +519,14 @@ public:
                 method = &Benchmark::ReadSequential;
             } else if (name == Slice("readreverse")) {
                 method = &Benchmark::ReadReverse;
+            } else if (name == Slice("readseqbatch")) {
+                method = &Benchmark::ReadSequentialBatch;
+            } else if (name == Slice("readreversebatch")) {
+                method = &Benchmark::ReadReverseBatch;
             } else if (name == Slice("readrandom")) {
                 method = &Benchmark::ReadRandom;
+            } else if (name == Slice("multireadrandom")) {
+                method = &Benchmark::MultiReadRandom;
             } else if (name == Slice("readmissing")) {
                 method = &Benchmark::ReadMissing;
             } else if (name == Slice("seekrandom")) {
@@ -530,10 +551,12 @@ public:
                 method = &Benchmark::SnappyCompress;
             } else if (name == Slice("snappyuncomp")) {
                 method = &Benchmark::SnappyUncompress;
+            } else if (name == Slice("compact")) {
+                method = &Benchmark::Compact;
             } else if (name == Slice("heapprofile")) {
                 HeapProfile();
             } else if (name == Slice("stats")) {
-                PrintStats("leveldb.stats");
+                PrintStats("ptmdb.stats");
             } else if (name == Slice("sstables")) {
                 PrintStats("leveldb.sstables");
             } else {
@@ -714,6 +737,7 @@ private:
         options.max_open_files = FLAGS_open_files;
         //options.filter_policy = filter_policy_;
         options.reuse_logs = FLAGS_reuse_logs;
+        options.btree_degree = FLAGS_btree_degree;
         Status s = DB::Open(options, FLAGS_db, &db_);
         if (!s.ok()) {
             fprintf(stderr, "open error: %s\n", s.ToString().c_str());
@@ -808,13 +832,20 @@ private:
         thread->stats.AddBytes(bytes);
     }
 
+    // The iterators used inside of a readTx() read the tree directly
+    static ReadOptions InTxReadOptions() {
+        ReadOptions options;
+        options.iterator_batch_size = 0;
+        return options;
+    }
+
     void ReadSequential(ThreadState* thread) {
-        Iterator* iter = db_->NewIterator(ReadOptions());
+        Iterator* iter = db_->NewIterator(InTxReadOptions());
         int countOp = 0;
 #ifdef PTMDB_CAPTURE_BY_COPY
         int64_t bytes = readTx<int64_t>([=] {       // This is CX-PTM and wait-free stuff (gives return value)
             int64_t bytes = 0;
-            Iterator* itercp = db_->NewIterator(ReadOptions()); //begin_read_transaction
+            Iterator* itercp = db_->NewIterator(InTxReadOptions()); //begin_read_transaction
             int i = 0;
             for (itercp->SeekToFirst(); i < reads_ && itercp->Valid(); itercp->Next()) {
                 bytes += itercp->key().size() + itercp->value().size();
@@ -843,12 +874,12 @@ private:
     }
 
     void ReadReverse(ThreadState* thread) {
-        Iterator* iter = db_->NewIterator(ReadOptions());
+        Iterator* iter = db_->NewIterator(InTxReadOptions());
         int countOp = 0;
 #ifdef PTMDB_CAPTURE_BY_COPY
         int64_t bytes = readTx<int64_t>([=] {       // This is CX-PTM and wait-free stuff (gives return value)
             int64_t bytes = 0;
-            Iterator* itercp = db_->NewIterator(ReadOptions());
+            Iterator* itercp = db_->NewIterator(InTxReadOptions());
             int i = 0;
             for (itercp->SeekToLast(); i < reads_ && itercp->Valid(); itercp->Prev()) {
                 bytes += itercp->key().size() + itercp->value().size();
@@ -876,6 +907,37 @@ private:
         thread->stats.AddBytes(bytes);
     }
 
+    // No readTx() here, the iterator does a transaction for each batch of keys
+    void ReadSequentialBatch(ThreadState* thread) {
+        ReadOptions options;
+        options.iterator_batch_size = FLAGS_iterator_batch_size;
+        Iterator* iter = db_->NewIterator(options);
+        int64_t bytes = 0;
+        int i = 0;
+        for (iter->SeekToFirst(); i < reads_ && iter->Valid(); iter->Next()) {
+            bytes += iter->key().size() + iter->value().size();
+            ++i;
+        }
+        delete iter;
+        thread->stats.FinishedSingleOp(i);
+        thread->stats.AddBytes(bytes);
+    }
+
+    void ReadReverseBatch(ThreadState* thread) {
+        ReadOptions options;
+        options.iterator_batch_size = FLAGS_iterator_batch_size;
+        Iterator* iter = db_->NewIterator(options);
+        int64_t bytes = 0;
+        int i = 0;
+        for (iter->SeekToLast(); i < reads_ && iter->Valid(); iter->Prev()) {
+            bytes += iter->key().size() + iter->value().size();
+            ++i;
+        }
+        delete iter;
+        thread->stats.FinishedSingleOp(i);
+        thread->stats.AddBytes(bytes);
+    }
+
     void ReadRandom(ThreadState* thread) {
         ReadOptions options;
         std::string value;
@@ -894,6 +956,34 @@ private:
         thread->stats.AddMessage(msg);
     }
 
+    void MultiReadRandom(ThreadState* thread) {
+        ReadOptions options;
+        std::vector<std::string> keys(FLAGS_multiget_batch_size);
+        std::vector<Slice> keySlices(FLAGS_multiget_batch_size);
+        std::vector<std::string> values;
+        int found = 0;
+        for (int i = 0; i < reads_; i += FLAGS_multiget_batch_size) {
+            const int n = std::min(FLAGS_multiget_batch_size, reads_ - i);
+            keys.resize(n);
+            keySlices.resize(n);
+            for (int j = 0; j < n; j++) {
+                char key[100];
+                const int k = thread->rand.Next() % FLAGS_num;
+                snprintf(key, sizeof(key), "%016d", k);
+                keys[j] = key;
+                keySlices[j] = keys[j];
+            }
+            std::vector<Status> statuses = db_->MultiGet(options, keySlices, &values);
+            for (int j = 0; j < n; j++) {
+                if (statuses[j].ok()) found++;
+                thread->stats.FinishedSingleOp();
+            }
+        }
+        char msg[100];
+        snprintf(msg, sizeof(msg), "(%d of %d found)", found, reads_);
+        thread->stats.AddMessage(msg);
+    }
+
     void ReadMissing(ThreadState* thread) {
         ReadOptions options;
         std::string value;
@@ -920,7 +1010,7 @@ private:
     }
 
     void SeekRandom(ThreadState* thread) {
-        ReadOptions options;
+        ReadOptions options = InTxReadOptions();
         int found = 0;
         Iterator* iter = db_->NewIterator(options);
         for (int i = 0; i < reads_; i++) {
@@ -986,7 +1076,7 @@ private:
         // exclude writes from the ops/sec calculation
         thread->stats.Start();
 
-        Iterator* iter = db_->NewIterator(ReadOptions());
+        Iterator* iter = db_->NewIterator(InTxReadOptions());
         int64_t bytes = 0;
         for (int64_t i = 0; i < FLAGS_num; ++i) {
             int countOp = 0;
@@ -996,7 +1086,7 @@ private:
 #ifdef PTMDB_CAPTURE_BY_COPY
             countOp = readTx<int32_t>([=] {
                 int32_t lcountOp = 0;
-                Iterator* itercp = db_->NewIterator(ReadOptions());
+                Iterator* itercp = db_->NewIterator(InTxReadOptions());
                 itercp->Seek(key);
                 assert(itercp->Valid() && itercp->key() == key);
                 ++lcountOp;
@@ -1076,8 +1166,16 @@ private:
         }
     }
 
+    void Compact(ThreadState*) {
+        db_->CompactRange(NULL, NULL);
+    }
+
     void PrintStats(const char* key) {
-        fprintf(stdout, "\nStats not implemented in PTM-DB\n");
+        std::string stats;
+        if (!db_->GetProperty(key, &stats)) {
+            stats = "(failed)";
+        }
+        fprintf(stdout, "\n%s\n", stats.c_str());
     }
 
     static void WriteToFile(void* arg, const char* buf, int n) {
@@ -1148,6 +1246,12 @@ int main(int argc, char** argv) {
             FLAGS_bloom_bits = n;
         } else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1) {
             FLAGS_open_files = n;
+        } else if (sscanf(argv[i], "--iterator_batch_size=%d%c", &n, &junk) == 1 && n > 0) {
+            FLAGS_iterator_batch_size = n;
+        } else if (sscanf(argv[i], "--multiget_batch_size=%d%c", &n, &junk) == 1 && n > 0) {
+            FLAGS_multiget_batch_size = n;
+        } else if (sscanf(argv[i], "--btree_degree=%d%c", &n, &junk) == 1) {
+            FLAGS_btree_degree = n;
         } else if (strncmp(argv[i], "--db=", 5) == 0) {
             FLAGS_db = argv[i] + 5;
         } else {
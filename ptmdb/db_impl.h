@@ -10,28 +10,41 @@
 #define _PTMDB_DB_DB_IMPL_H_
 
 #include <set>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <functional>
 #include "db.h"
 #include "write_batch.h"
+#include "merge_operator.h"
 #include "ptmdb.h"
-//#include "TMHashMap.hpp"
-//#include "TMHashMapIterator.h"
+#include "TMHashMap.hpp"
+#include "TMHashMapIterator.h"
 #include "TMBTreeMap.hpp"
 #include "TMBTreeMapIterator.h"
+#include "column_family.h"
 
 namespace ptmdb {
 
 
 class DBImpl : public DB {
 public:
-    DBImpl(const Options& raw_options, const std::string& dbname) {
+    DBImpl(const Options& raw_options, const std::string& dbname) : options_(raw_options) {
         dbname_ = dbname;
+        int32_t degree = options_.btree_degree;
+        if (degree <= 0 || degree > TMBTreeMap::MAX_DEGREE) degree = TMBTreeMap::MAX_DEGREE;
+        if (degree < 2) degree = 2;
         // Create the ds
 #ifdef PTMDB_CAPTURE_BY_COPY
         PTM_UPDATE_TX<bool>([=] () {
             // We expect the root pointer zero to be the ds
             ds = (TMBTreeMap*)PTM_GET_ROOT(0);
             if (ds == nullptr) {
-                ds = PTM_NEW<TMBTreeMap>();
+                ds = PTM_NEW<TMBTreeMap>(degree);
                 PTM_PUT_ROOT(0, ds);
             }
             return true;
@@ -41,26 +54,68 @@ public:
             // We expect the root pointer zero to be the ds
             ds = (TMBTreeMap*)PTM_GET_ROOT(0);
             if (ds == nullptr) {
-                ds = PTM_NEW<TMBTreeMap>();
+                ds = PTM_NEW<TMBTreeMap>(degree);
                 PTM_PUT_ROOT(0, ds);
             }
         });
+#endif
+        // Open the catalog of the column families (root pointer 1), and make a handle for each family in it
+        catalog_ = PTM_UPDATE_TX<ColumnFamilyCatalog*>([] () {
+            ColumnFamilyCatalog* catalog = (ColumnFamilyCatalog*)PTM_GET_ROOT(1);
+            if (catalog == nullptr) {
+                catalog = PTM_NEW<ColumnFamilyCatalog>();
+                PTM_PUT_ROOT(1, catalog);
+            }
+            return catalog;
+        });
+        for (int i = 0; i <= ColumnFamilyCatalog::MAX_FAMILIES; i++) families_[i].store(nullptr);
+        default_cf_ = new ColumnFamilyHandleImpl(0, 0, "default", ds, nullptr);
+        families_[0].store(default_cf_);
+        handles_.push_back(default_cf_);
+        using Infos = std::vector<std::tuple<int,uint32_t,std::string,TMBTreeMap*,TMHashMap*>>;
+        Infos infos = PTM_READ_TX<Infos>([catalog = catalog_] () {
+            Infos linfos;
+            for (int i = 0; i < ColumnFamilyCatalog::MAX_FAMILIES; i++) {
+                ColumnFamilyCatalog::Entry& e = catalog->entries[i];
+                if (e.isFree()) continue;
+                linfos.emplace_back(i, e.generation.pload(), std::string(e.name.data(), e.name.size()), e.tree.pload(), e.hash.pload());
+            }
+            return linfos;
+        });
+        for (auto& info : infos) {
+            const int i = std::get<0>(info);
+            ColumnFamilyHandleImpl* cfd = new ColumnFamilyHandleImpl(i+1, std::get<1>(info), std::get<2>(info), std::get<3>(info), std::get<4>(info));
+            families_[i+1].store(cfd);
+            handles_.push_back(cfd);
+        }
+#ifdef PTM_COMPACT
+        if (options_.pm_compaction_threshold > 0) {
+            compactor_ = std::thread(&DBImpl::BackgroundCompaction, this);
+        }
 #endif
     }
 
+    ~DBImpl() {
+        StopBackgroundCompaction();
+        for (ColumnFamilyHandleImpl* cfd : handles_) delete cfd;
+    }
+
     // This is the PTM-safe destructor
     void destructor() {
-        // delete the ds
+        StopBackgroundCompaction();
+        // delete the ds, and the other column families with their catalog
 #ifdef PTMDB_CAPTURE_BY_COPY
         PTM_UPDATE_TX<bool>([=] () {
             PTM_DELETE(ds);
             PTM_PUT_ROOT(0, nullptr);
+            deleteCatalog();
             return true;
         });
 #else
         PTM_UPDATE_TX([&] () {
             PTM_DELETE(ds);
             PTM_PUT_ROOT(0, nullptr);
+            deleteCatalog();
         });
 #endif
     }
@@ -68,15 +123,21 @@ public:
     // Set the database entry for "key" to "value".  Returns OK on success,
     // and a non-OK status on error.
     // Note: consider setting options.sync = true.
-    Status Put(const WriteOptions&, const Slice& k, const Slice& v) {
+    Status Put(const WriteOptions& options, const Slice& k, const Slice& v) {
+        return Put(options, default_cf_, k, v);
+    }
+
+    Status Put(const WriteOptions&, ColumnFamilyHandle* column_family, const Slice& k, const Slice& v) {
+        ColumnFamilyHandleImpl* cfd = toImpl(column_family);
+        if (cfd == nullptr) return Status::InvalidArgument("column family was dropped");
 #ifdef PTMDB_CAPTURE_BY_COPY
-        PTM_UPDATE_TX<bool>([this,key = k, val = v] () {
-            ds->innerPut(key,val);
+        PTM_UPDATE_TX<bool>([cfd,key = k, val = v] () {
+            cfd->innerPut(key,val);
             return true;
         });
 #else
         PTM_UPDATE_TX([&] () {
-            ds->innerPut(k,v);
+            cfd->innerPut(k,v);
         });
 #endif
         return Status::OK();
@@ -87,53 +148,132 @@ public:
     // did not exist in the database.
     // Note: consider setting options.sync = true.
     Status Delete(const WriteOptions& options, const Slice& k) {
+        return Delete(options, default_cf_, k);
+    }
+
+    Status Delete(const WriteOptions& options, ColumnFamilyHandle* column_family, const Slice& k) {
+        ColumnFamilyHandleImpl* cfd = toImpl(column_family);
+        if (cfd == nullptr) return Status::InvalidArgument("column family was dropped");
 #ifdef PTMDB_CAPTURE_BY_COPY
-        bool found = PTM_UPDATE_TX<bool>([this,key = k] () {
-            return ds->innerRemove(key);
+        bool found = PTM_UPDATE_TX<bool>([cfd,key = k] () {
+            return cfd->innerRemove(key);
         });
 #else
-        bool found;
-        PTM_UPDATE_TX([&] () {
-            found = ds->innerRemove(k);
+        bool found = PTM_UPDATE_TX<bool>([&] () {
+            return cfd->innerRemove(k);
         });
 #endif
         if (!found) return Status::NotFound("key Not Found");
         return Status::OK();
     }
 
+    // See DB::Merge()
+    Status Merge(const WriteOptions& options, const Slice& k, const Slice& operand) {
+        return Merge(options, default_cf_, k, operand);
+    }
+
+    Status Merge(const WriteOptions& options, ColumnFamilyHandle* column_family, const Slice& k, const Slice& operand) {
+        const MergeOperator* mop = options_.merge_operator;
+        if (mop == nullptr) return Status::NotSupported("no merge operator");
+        ColumnFamilyHandleImpl* cfd = toImpl(column_family);
+        if (cfd == nullptr) return Status::InvalidArgument("column family was dropped");
+#ifdef PTMDB_CAPTURE_BY_COPY
+        bool merged = PTM_UPDATE_TX<bool>([cfd,mop,key = k,oper = operand] () {
+            return cfd->innerUpdate(key, [&] (const Slice* existing, std::string* newValue) {
+                return mop->Merge(key, existing, oper, newValue);
+            });
+        });
+#else
+        bool merged = PTM_UPDATE_TX<bool>([&] () {
+            return cfd->innerUpdate(k, [&] (const Slice* existing, std::string* newValue) {
+                return mop->Merge(k, existing, operand, newValue);
+            });
+        });
+#endif
+        if (!merged) return Status::InvalidArgument("merge operator failed on key", k);
+        return Status::OK();
+    }
+
+    // See DB::Update()
+    Status Update(const WriteOptions& options, const Slice& k,
+            const std::function<bool(const Slice* existing_value, std::string* new_value)>& fn) {
+        return Update(options, default_cf_, k, fn);
+    }
+
+    Status Update(const WriteOptions& options, ColumnFamilyHandle* column_family, const Slice& k,
+            const std::function<bool(const Slice* existing_value, std::string* new_value)>& fn) {
+        ColumnFamilyHandleImpl* cfd = toImpl(column_family);
+        if (cfd == nullptr) return Status::InvalidArgument("column family was dropped");
+#ifdef PTMDB_CAPTURE_BY_COPY
+        bool stored = PTM_UPDATE_TX<bool>([cfd,key = k,fn] () {
+            return cfd->innerUpdate(key, fn);
+        });
+#else
+        bool stored = PTM_UPDATE_TX<bool>([&] () {
+            return cfd->innerUpdate(k, fn);
+        });
+#endif
+        if (!stored) return Status::Aborted("update function left the key unchanged", k);
+        return Status::OK();
+    }
+
     // Apply the specified updates to the database.
     // Returns OK on success, non-OK on failure.
     Status Write(const WriteOptions& options, WriteBatch* my_batch) {
         std::vector<WriteBatch::Op>& vec = my_batch->getTransaction();
-#ifdef PTMDB_CAPTURE_BY_COPY
-        while (!vec.empty()) {
-            PTM_UPDATE_TX<bool>([this,oper = vec[vec.size()-1]] () {
-                if(oper.operation){
-                    ds->innerPut(oper.key, oper.value);
-                }else{
-                    ds->innerRemove(oper.key);
-                }
-                return true;
-            });
-            vec.pop_back();
+        for (const WriteBatch::Op& oper : vec) {
+            if (oper.operation == WriteBatch::kTypeMerge && options_.merge_operator == nullptr) {
+                return Status::NotSupported("no merge operator");
+            }
+            if (oper.cf > ColumnFamilyCatalog::MAX_FAMILIES || liveFamily(oper) == nullptr) {
+                return Status::InvalidArgument("column family was dropped");
+            }
         }
+#ifdef PTMDB_CAPTURE_BY_COPY
+        // The operations are moved into the lambda, and applied in order in a single transaction, as below
+        PTM_UPDATE_TX<bool>([this,ops = std::move(vec)] () {
+            for (const WriteBatch::Op& oper : ops) applyOp(oper);
+            return true;
+        });
+        vec.clear();
 #else
         PTM_UPDATE_TX([&] () {
             for(int i=0;i<vec.size();i++){
-                WriteBatch::Op& operat = vec[i];
-                if(operat.operation){
-                    ds->innerPut(operat.key, operat.value);
-                }else{
-                    ds->innerRemove(operat.key);
-                }
+                applyOp(vec[i]);
             }
         });
 #endif
         return Status::OK();
     }
 
+    // Applies one operation of a WriteBatch, inside an update transaction. The sizes are
+    // given explicitly, because the keys and values may have zeros in them.
+    // A merge whose operator fails leaves the key unchanged, and so does any operation on a family
+    // dropped after Write() checked it.
+    void applyOp(const WriteBatch::Op& oper) {
+        const Slice key(oper.key, oper.key_size);
+        ColumnFamilyHandleImpl* cfd = liveFamily(oper);
+        if (cfd == nullptr) return;
+        switch (oper.operation) {
+        case WriteBatch::kTypeValue:
+            cfd->innerPut(key, Slice(oper.value, oper.value_size));
+            break;
+        case WriteBatch::kTypeDeletion:
+            cfd->innerRemove(key);
+            break;
+        case WriteBatch::kTypeMerge: {
+            const Slice operand(oper.value, oper.value_size);
+            const MergeOperator* mop = options_.merge_operator;
+            cfd->innerUpdate(key, [&] (const Slice* existing, std::string* newValue) {
+                return mop->Merge(key, existing, operand, newValue);
+            });
+            break;
+        }
+        }
+    }
+
     long size() {
-        return ds->root.pload()->getSize();
+        return PTM_READ_TX<long>([this] () { return ds->getSize(); });
     }
 
     // If the database contains an entry for "key" store the
@@ -144,21 +284,83 @@ public:
     //
     // May return some other Status on an error.
     Status Get(const ReadOptions& options, const Slice& k, std::string* svalue) {
+        return Get(options, default_cf_, k, svalue);
+    }
+
+    Status Get(const ReadOptions& options, ColumnFamilyHandle* column_family, const Slice& k, std::string* svalue) {
+        ColumnFamilyHandleImpl* cfd = toImpl(column_family);
+        if (cfd == nullptr) return Status::InvalidArgument("column family was dropped");
 #ifdef PTMDB_CAPTURE_BY_COPY
-        // ERROR   ERROR   ERROR: We can not have multiple threads changing the string svalue, it creates races and possibly memory reclamation issues
-        bool found = PTM_READ_TX<bool>([this,key = k,svalue] () {
-            return ds->innerGet(key,svalue);
+        // The lambda may be executed by other threads, therefore it can not write to svalue. Instead, the value
+        // is returned by the transaction and moved to svalue after the commit.
+        std::pair<bool,std::string> res = PTM_READ_TX<std::pair<bool,std::string>>([cfd,key = k] () {
+            std::pair<bool,std::string> kv;
+            kv.first = cfd->innerGet(key,&kv.second);
+            return kv;
         });
+        if (!res.first) return Status::NotFound("key Not Found");
+        *svalue = std::move(res.second);
 #else
-        bool found;
-        PTM_READ_TX([&] () {
-            found = ds->innerGet(k,svalue);
+        bool found = PTM_READ_TX<bool>([&] () {
+            return cfd->innerGet(k,svalue);
         });
-#endif
         if (!found) return Status::NotFound("key Not Found");
+#endif
         return Status::OK();
     }
 
+    // See DB::MultiGet()
+    std::vector<Status> MultiGet(const ReadOptions& options, const std::vector<Slice>& keys, std::vector<std::string>* values) {
+        return MultiGet(options, default_cf_, keys, values);
+    }
+
+    std::vector<Status> MultiGet(const ReadOptions& options, ColumnFamilyHandle* column_family,
+            const std::vector<Slice>& keys, std::vector<std::string>* values) {
+        const std::int32_t n = keys.size();
+        ColumnFamilyHandleImpl* cfd = toImpl(column_family);
+        if (cfd == nullptr) return std::vector<Status>(n, Status::InvalidArgument("column family was dropped"));
+        std::vector<std::int32_t> order(n);
+        for (std::int32_t i = 0; i < n; i++) order[i] = i;
+        std::sort(order.begin(), order.end(), [&keys] (std::int32_t a, std::int32_t b) {
+            return keys[a].compare(keys[b]) < 0;
+        });
+        values->resize(n);
+        std::vector<char> found(n, 0);
+#ifdef PTMDB_CAPTURE_BY_COPY
+        // The lambda may be executed by other threads, therefore it can not write to values. Instead, the values
+        // are returned by the transaction and moved to values after the commit.
+        using Values = std::vector<std::pair<bool,std::string>>;
+        std::vector<std::string> skeys(n);
+        for (std::int32_t i = 0; i < n; i++) skeys[i] = keys[i].ToString();
+        Values res = PTM_READ_TX<Values>([cfd,skeys = std::move(skeys),order] () {
+            Values lres(skeys.size());
+            std::vector<Slice> lkeys(skeys.begin(), skeys.end());
+            cfd->innerMultiGet(lkeys.data(), order.data(), lkeys.size(), [&] (std::int32_t i, const Slice& v) {
+                lres[i].first = true;
+                lres[i].second.assign(v.data(), v.size());
+            });
+            return lres;
+        });
+        for (std::int32_t i = 0; i < n; i++) {
+            found[i] = res[i].first;
+            if (found[i]) (*values)[i] = std::move(res[i].second);
+        }
+#else
+        PTM_READ_TX([&] () {
+            std::fill(found.begin(), found.end(), 0);
+            cfd->innerMultiGet(keys.data(), order.data(), n, [&] (std::int32_t i, const Slice& v) {
+                found[i] = 1;
+                (*values)[i].assign(v.data(), v.size());
+            });
+        });
+#endif
+        std::vector<Status> statuses(n);
+        for (std::int32_t i = 0; i < n; i++) {
+            if (!found[i]) statuses[i] = Status::NotFound("key Not Found");
+        }
+        return statuses;
+    }
+
     // Return a heap-allocated iterator over the contents of the database.
     // The result of NewIterator() is initially invalid (caller must
     // call one of the Seek methods on the iterator before using it).
@@ -166,13 +368,224 @@ public:
     // Caller should delete the iterator when it is no longer needed.
     // The returned iterator should be deleted before this db is deleted.
     Iterator* NewIterator(const ReadOptions& options) {
-        return new TMBTreeMapIterator(ds);
+        return NewIterator(options, default_cf_);
+    }
+
+    // The iterators of the families with a hash index read the buckets directly, regardless of
+    // options.iterator_batch_size, and visit the keys in the order of their hashes.
+    // Returns NULL if the family was dropped.
+    Iterator* NewIterator(const ReadOptions& options, ColumnFamilyHandle* column_family) {
+        ColumnFamilyHandleImpl* cfd = toImpl(column_family);
+        if (cfd == nullptr) return nullptr;
+        if (cfd->tree == nullptr) return new TMHashMapIterator(cfd->hash);
+        if (options.iterator_batch_size > 0) return new TMBTreeMapBatchIterator(cfd->tree, options.iterator_batch_size);
+        return new TMBTreeMapIterator(cfd->tree);
     }
 
+    // See DB::Scan()
+    Status Scan(const ReadOptions& options, const Slice& start, int count,
+            const std::function<bool(const Slice& key, const Slice& value)>& visitor) {
+        return Scan(options, default_cf_, start, count, visitor);
+    }
 
-    //virtual bool GetProperty(const Slice& property, std::string* value);
+    Status Scan(const ReadOptions& options, ColumnFamilyHandle* column_family, const Slice& start, int count,
+            const std::function<bool(const Slice& key, const Slice& value)>& visitor) {
+        ColumnFamilyHandleImpl* cfd = toImpl(column_family);
+        if (cfd == nullptr) return Status::InvalidArgument("column family was dropped");
+        TMBTreeMap* tree = cfd->tree;
+        if (tree == nullptr) return Status::NotSupported("scan on a hash index");
+#ifdef PTMDB_CAPTURE_BY_COPY
+        // The lambda may be executed by other threads, therefore it can not call the visitor. Instead, the entries
+        // are copied and returned by the transaction, and visited after the commit.
+        using KVs = std::vector<std::pair<std::string,std::string>>;
+        KVs kvs = PTM_READ_TX<KVs>([tree,skey = start.ToString(),count] () {
+            KVs lkvs;
+            tree->innerScan(Slice(skey), count, [&] (const Slice& k, const Slice& v) {
+                lkvs.emplace_back(k.ToString(), v.ToString());
+                return true;
+            });
+            return lkvs;
+        });
+        for (auto& kv : kvs) {
+            if (!visitor(Slice(kv.first), Slice(kv.second))) break;
+        }
+#else
+        PTM_READ_TX([&] () {
+            tree->innerScan(start, count, visitor);
+        });
+#endif
+        return Status::OK();
+    }
+
+
+    // See DB::GetProperty() for the list of valid properties
+    bool GetProperty(const Slice& property, std::string* value) {
+        return GetProperty(default_cf_, property, value);
+    }
+
+    // The properties of the persistent memory pool are the same in all the families
+    bool GetProperty(ColumnFamilyHandle* column_family, const Slice& property, std::string* value) {
+        if (!property.starts_with("ptmdb.")) return false;
+        if (property == "ptmdb.num-keys" || property == "ptmdb.key-bytes" || property == "ptmdb.value-bytes" ||
+            property == "ptmdb.data-stats") {
+            ColumnFamilyHandleImpl* cfd = toImpl(column_family);
+            if (cfd == nullptr || cfd->tree == nullptr) return false;
+            int64_t counters[3];
+            PTM_READ_TX([&] () {
+                cfd->tree->getCounters(counters[0], counters[1], counters[2]);
+            });
+            char buf[200];
+            if (property == "ptmdb.data-stats") {
+                std::snprintf(buf, sizeof(buf), "keys=%lld  key-bytes=%lld  value-bytes=%lld\n",
+                              (long long)counters[0], (long long)counters[1], (long long)counters[2]);
+            } else {
+                const int i = (property == "ptmdb.num-keys") ? 0 : (property == "ptmdb.key-bytes") ? 1 : 2;
+                std::snprintf(buf, sizeof(buf), "%lld", (long long)counters[i]);
+            }
+            *value = buf;
+            return true;
+        }
+#ifdef PTM_GET_ALLOC_STATS
+        // Only the report needs the arrays of the size classes, and only the used size is cheap on every allocator
+        PTM_ALLOC_STATS::Detail detail = PTM_ALLOC_STATS::kTotals;
+        if (property == "ptmdb.stats") detail = PTM_ALLOC_STATS::kAll;
+        else if (property == "ptmdb.pm-used-bytes") detail = PTM_ALLOC_STATS::kUsage;
+        PTM_ALLOC_STATS stats;
+        PTM_READ_TX([&] () {
+            PTM_GET_ALLOC_STATS(stats, detail);
+        });
+        char buf[64];
+        if (property == "ptmdb.stats") {
+            *value = stats.toString();
+        } else if (property == "ptmdb.pm-used-bytes") {
+            std::snprintf(buf, sizeof(buf), "%llu", (unsigned long long)stats.usedSize);
+            *value = buf;
+        } else if (property == "ptmdb.pm-live-bytes") {
+            std::snprintf(buf, sizeof(buf), "%llu", (unsigned long long)stats.liveBytes);
+            *value = buf;
+        } else if (property == "ptmdb.pm-free-bytes") {
+            std::snprintf(buf, sizeof(buf), "%llu", (unsigned long long)stats.freeBytes);
+            *value = buf;
+        } else if (property == "ptmdb.pm-fragmentation") {
+            std::snprintf(buf, sizeof(buf), "%.2f", 100.*stats.fragmentation());
+            *value = buf;
+        } else {
+            return false;
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
     //virtual void GetApproximateSizes(const Range* range, int n, uint64_t* sizes);
 
+    // See DB::CompactRange()
+    // The range is compacted in all the families with a B-tree index.
+    void CompactRange(const Slice* begin, const Slice* end) {
+#ifdef PTM_COMPACT
+        PTM_COMPACT([&] () {
+            for (int i = 0; i <= ColumnFamilyCatalog::MAX_FAMILIES; i++) {
+                ColumnFamilyHandleImpl* cfd = families_[i].load();
+                if (cfd == nullptr || cfd->tree == nullptr) continue;
+                // Relocate in many small transactions, one leaf at a time
+                std::string cursor = (begin == nullptr) ? "" : begin->ToString();
+                std::string next;
+                bool more = true;
+                while (true) {
+                    PTM_UPDATE_TX([&] () {
+                        more = cfd->tree->innerRelocate(cursor, next);
+                    });
+                    if (!more || (end != nullptr && Slice(next).compare(*end) >= 0)) break;
+                    cursor.swap(next);
+                }
+            }
+        });
+#else
+        // This PTM can't relocate blocks, there is nothing to compact
+        (void)begin;
+        (void)end;
+#endif
+    }
+
+    // See DB::CreateColumnFamily()
+    Status CreateColumnFamily(const ColumnFamilyOptions& cf_options, const std::string& name, ColumnFamilyHandle** handle) {
+        std::lock_guard<std::mutex> lock(cf_mutex_);
+        if (name == default_cf_->name || findFamily(name) != nullptr) {
+            return Status::InvalidArgument("column family already exists", name);
+        }
+        int32_t degree = cf_options.btree_degree;
+        if (degree <= 0 || degree > TMBTreeMap::MAX_DEGREE) degree = TMBTreeMap::MAX_DEGREE;
+        if (degree < 2) degree = 2;
+        const bool isHash = (cf_options.index_type == kHashIndex);
+        const int buckets = (cf_options.hash_buckets > 0) ? cf_options.hash_buckets : 1;
+        // Fills the first free entry of the catalog, and returns its index, or -1 if the catalog is full
+        using Created = std::tuple<int,uint32_t,TMBTreeMap*,TMHashMap*>;
+        Created created = PTM_UPDATE_TX<Created>([catalog = catalog_,name,degree,isHash,buckets] () {
+            for (int i = 0; i < ColumnFamilyCatalog::MAX_FAMILIES; i++) {
+                ColumnFamilyCatalog::Entry& e = catalog->entries[i];
+                if (!e.isFree()) continue;
+                e.name = Slice(name);
+                e.type = isHash ? kHashIndex : kBTreeIndex;
+                e.generation = e.generation.pload() + 1;
+                if (isHash) e.hash = PTM_NEW<TMHashMap>(buckets);
+                else e.tree = PTM_NEW<TMBTreeMap>(degree);
+                return Created(i, e.generation.pload(), e.tree.pload(), e.hash.pload());
+            }
+            return Created(-1, 0, nullptr, nullptr);
+        });
+        const int i = std::get<0>(created);
+        if (i < 0) return Status::NotSupported("too many column families");
+        ColumnFamilyHandleImpl* cfd = new ColumnFamilyHandleImpl(i+1, std::get<1>(created), name, std::get<2>(created), std::get<3>(created));
+        handles_.push_back(cfd);
+        families_[i+1].store(cfd);
+        *handle = cfd;
+        return Status::OK();
+    }
+
+    // See DB::DropColumnFamily()
+    Status DropColumnFamily(ColumnFamilyHandle* column_family) {
+        std::lock_guard<std::mutex> lock(cf_mutex_);
+        ColumnFamilyHandleImpl* cfd = toImpl(column_family);
+        if (cfd == nullptr) return Status::InvalidArgument("column family was dropped");
+        if (cfd == default_cf_) return Status::InvalidArgument("the default column family can not be dropped");
+        families_[cfd->id].store(nullptr);
+        cfd->dropped.store(true);
+        PTM_UPDATE_TX<bool>([catalog = catalog_,i = cfd->id-1] () {
+            ColumnFamilyCatalog::Entry& e = catalog->entries[i];
+            if (e.tree.pload() != nullptr) PTM_DELETE(e.tree.pload());
+            if (e.hash.pload() != nullptr) PTM_DELETE(e.hash.pload());
+            e.tree = nullptr;
+            e.hash = nullptr;
+            e.name.reset();
+            return true;
+        });
+        return Status::OK();
+    }
+
+    // See DB::GetColumnFamily()
+    Status GetColumnFamily(const std::string& name, ColumnFamilyHandle** handle) {
+        std::lock_guard<std::mutex> lock(cf_mutex_);
+        ColumnFamilyHandleImpl* cfd = (name == default_cf_->name) ? default_cf_ : findFamily(name);
+        if (cfd == nullptr) return Status::NotFound("column family not found", name);
+        *handle = cfd;
+        return Status::OK();
+    }
+
+    // See DB::ListColumnFamilies()
+    Status ListColumnFamilies(std::vector<std::string>* names) {
+        std::lock_guard<std::mutex> lock(cf_mutex_);
+        names->clear();
+        for (int i = 0; i <= ColumnFamilyCatalog::MAX_FAMILIES; i++) {
+            ColumnFamilyHandleImpl* cfd = families_[i].load();
+            if (cfd != nullptr) names->push_back(cfd->name);
+        }
+        return Status::OK();
+    }
+
+    ColumnFamilyHandle* DefaultColumnFamily() {
+        return default_cf_;
+    }
+
     // Record a sample of bytes read at the specified internal key.
     // Samples are taken approximately once every config::kReadBytesPeriod
     // bytes.
@@ -191,6 +604,87 @@ private:
     bool owns_cache_;
     std::string dbname_;
     TMBTreeMap* ds {nullptr};
+    // The column families: the catalog has all but the default one, whose tree is ds.
+    // families_[id] has the handle of each live family, for the lookups by id of the WriteBatch,
+    // and handles_ has all the handles, including the dropped ones, which are deleted with the DBImpl.
+    ColumnFamilyCatalog* catalog_ {nullptr};
+    ColumnFamilyHandleImpl* default_cf_ {nullptr};
+    std::atomic<ColumnFamilyHandleImpl*> families_[ColumnFamilyCatalog::MAX_FAMILIES+1];
+    std::vector<ColumnFamilyHandleImpl*> handles_;
+    std::mutex cf_mutex_;   // Serializes the creation and deletion of families
+
+    // Returns the handle of a live family (NULL is the default one), or NULL if it was dropped
+    ColumnFamilyHandleImpl* toImpl(ColumnFamilyHandle* column_family) {
+        if (column_family == nullptr) return default_cf_;
+        ColumnFamilyHandleImpl* cfd = static_cast<ColumnFamilyHandleImpl*>(column_family);
+        return cfd->dropped.load() ? nullptr : cfd;
+    }
+
+    // Returns the handle of the family of a WriteBatch operation, or NULL if it was dropped, even if
+    // another family was created since with the same id
+    ColumnFamilyHandleImpl* liveFamily(const WriteBatch::Op& oper) {
+        ColumnFamilyHandleImpl* cfd = families_[oper.cf].load();
+        return (cfd == nullptr || cfd->generation != oper.generation) ? nullptr : cfd;
+    }
+
+    // Returns the handle of the live family with this name, if any. Must be called with cf_mutex_.
+    ColumnFamilyHandleImpl* findFamily(const std::string& name) {
+        for (int i = 1; i <= ColumnFamilyCatalog::MAX_FAMILIES; i++) {
+            ColumnFamilyHandleImpl* cfd = families_[i].load();
+            if (cfd != nullptr && cfd->name == name) return cfd;
+        }
+        return nullptr;
+    }
+
+    // Deletes the indexes of all the families in the catalog, and the catalog. Called inside a transaction.
+    void deleteCatalog() {
+        if (catalog_ == nullptr) return;
+        for (int i = 0; i < ColumnFamilyCatalog::MAX_FAMILIES; i++) {
+            ColumnFamilyCatalog::Entry& e = catalog_->entries[i];
+            if (e.tree.pload() != nullptr) PTM_DELETE(e.tree.pload());
+            if (e.hash.pload() != nullptr) PTM_DELETE(e.hash.pload());
+        }
+        PTM_DELETE(catalog_);
+        PTM_PUT_ROOT(1, nullptr);
+    }
+#ifdef PTM_COMPACT
+    std::thread compactor_;
+    std::atomic<bool> stop_compactor_ {false};
+
+    // Checks the free space of the persistent memory pool every second and compacts it when needed.
+    // Only the bytes in the free-lists count, because the unused tails of the slabs can't be reclaimed.
+    // Neither can the free blocks in windows of the pool that are too full to be evacuated, so the free
+    // bytes left by a compaction don't count either, until they are re-used, otherwise each compaction
+    // would trigger the next one.
+    void BackgroundCompaction() {
+        uint64_t leftFree = 0;
+        while (true) {
+            for (int i = 0; i < 10; i++) {
+                if (stop_compactor_.load()) return;
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            PTM_ALLOC_STATS stats;
+            PTM_READ_TX([&] () {
+                PTM_GET_ALLOC_STATS(stats, PTM_ALLOC_STATS::kTotals);
+            });
+            if (stats.freeBytes < leftFree) leftFree = stats.freeBytes;
+            const uint64_t heap = stats.usedSize - stats.metadataSize - stats.chunkBytes;
+            if (stats.freeBytes - leftFree <= options_.pm_compaction_threshold*heap) continue;
+            CompactRange(nullptr, nullptr);
+            PTM_READ_TX([&] () {
+                PTM_GET_ALLOC_STATS(stats, PTM_ALLOC_STATS::kTotals);
+            });
+            leftFree = stats.freeBytes;
+        }
+    }
+#endif
+
+    void StopBackgroundCompaction() {
+#ifdef PTM_COMPACT
+        stop_compactor_.store(true);
+        if (compactor_.joinable()) compactor_.join();
+#endif
+    }
 
     // No copying allowed
     DBImpl(const DBImpl&);
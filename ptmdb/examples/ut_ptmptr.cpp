@@ -0,0 +1,119 @@
+/*
+ * Checks the position-independent pointers (PTM_PTR and PTM_TYPE_PI in ptm.h): builds a list in a pool, closes it,
+ * and re-opens it at a different address, and then at whichever address the kernel picks, where the list must
+ * still be intact and usable by new transactions.
+ */
+#include <cassert>
+#include <cstdio>
+#include <cstdint>
+
+#include "../../ptms/ptm.h"
+
+#ifndef PTM_PTR
+#error "This test needs a PTM with position-independent pointers, like TrinityTL2"
+#endif
+
+static const char*    POOL_FILE = "/dev/shm/ut_ptmptr_pool";
+static const uint64_t POOL_SIZE = 64*1024*1024ULL;
+static const uint64_t NUM_NODES = 10000;
+
+struct Node {
+    PTM_TYPE_PI<uint64_t> key;
+    PTM_TYPE_PI<Node*>    next;     // Same as PTM_PTR<Node>
+    Node(uint64_t key, Node* next) : key{key}, next{next} { }
+};
+
+struct Header {
+    PTM_PTR<Node>         head {nullptr};
+    PTM_TYPE_PI<uint64_t> size {0};
+};
+
+static bool inPool(const void* ptr, const uint8_t* base) {
+    return base == nullptr || ((const uint8_t*)ptr >= base && (const uint8_t*)ptr < base + POOL_SIZE);
+}
+
+// Walks the list and checks that the keys are the ones in [0,NUM_NODES) with a step of 'step', in decreasing
+// order, and that all the nodes are in the pool mapped at 'base' (any address if 'base' is nullptr)
+static bool checkList(PTM_POOL& pool, const uint8_t* base, uint64_t step) {
+    bool ok = true;
+    PTM_POOL::readTx(pool, [&] () {
+        ok = true;
+        Header* header = (Header*)PTM_GET_ROOT(0);
+        if (header == nullptr || !inPool(header, base)) { ok = false; return; }
+        uint64_t count = 0;
+        uint64_t expected = (NUM_NODES-1)/step*step;
+        for (Node* node = header->head; node != nullptr; node = node->next) {
+            if (!inPool(node, base) || node->key != expected) { ok = false; return; }
+            expected -= step;
+            count++;
+        }
+        if (count != header->size || count != (NUM_NODES-1)/step+1) ok = false;
+    });
+    return ok;
+}
+
+int main(void) {
+    uint8_t* const addr1 = (uint8_t*)0x7fd000000000;
+    uint8_t* const addr2 = (uint8_t*)0x7fc000000000;
+    std::remove(POOL_FILE);
+
+    printf("Creating the list at %p\n", addr1);
+    {
+        PTM_POOL pool(POOL_FILE, addr1, POOL_SIZE, POOL_SIZE/4);
+        PTM_POOL::updateTx(pool, [&] () {
+            Header* header = PTM_NEW<Header>();
+            PTM_PUT_ROOT(0, header);
+        });
+        // Push the nodes in transactions of 100 nodes
+        for (uint64_t i = 0; i < NUM_NODES; i += 100) {
+            PTM_POOL::updateTx(pool, [&] () {
+                Header* header = (Header*)PTM_GET_ROOT(0);
+                for (uint64_t key = i; key < i+100 && key < NUM_NODES; key++) {
+                    header->head = PTM_NEW<Node>(key, header->head);
+                    header->size = header->size + 1;
+                }
+            });
+        }
+        assert(checkList(pool, addr1, 1));
+    }
+
+    printf("Re-opening at %p and removing the odd keys\n", addr2);
+    {
+        PTM_POOL pool(POOL_FILE, addr2, POOL_SIZE, POOL_SIZE/4);
+        assert(checkList(pool, addr2, 1));
+        PTM_POOL::updateTx(pool, [&] () {
+            Header* header = (Header*)PTM_GET_ROOT(0);
+            PTM_PTR<Node>* prev = &header->head;
+            while (Node* node = *prev) {
+                if (node->key % 2 == 1) {
+                    *prev = node->next;
+                    PTM_DELETE(node);
+                    header->size = header->size - 1;
+                } else {
+                    prev = &node->next;
+                }
+            }
+        });
+        assert(checkList(pool, addr2, 2));
+    }
+
+    printf("Re-opening at any address and deleting the list\n");
+    {
+        PTM_POOL pool(POOL_FILE, POOL_SIZE, POOL_SIZE/4);
+        assert(checkList(pool, nullptr, 2));
+        PTM_POOL::updateTx(pool, [&] () {
+            Header* header = (Header*)PTM_GET_ROOT(0);
+            Node* node = header->head;
+            while (node != nullptr) {
+                Node* next = node->next;
+                PTM_DELETE(node);
+                node = next;
+            }
+            PTM_DELETE(header);
+            PTM_PUT_ROOT(0, nullptr);
+        });
+    }
+    std::remove(POOL_FILE);
+    printf("Done\n");
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * Checks the write-set of RedoOpt (and its WriteSetIndex): transactions with more stores than a group of
+ * the index holds, to the same addresses several times, and with more entries than a node of the log.
+ */
+#include <cassert>
+#include <cstdio>
+#include <random>
+
+#include "otherdb/redodb/ptms/redoopt/RedoOpt.hpp"
+
+using namespace redoopt;
+
+static const int NUM_WORDS = 1024;
+
+int main(void) {
+    persist<uint64_t>* words = RedoOpt::updateTx<persist<uint64_t>*>([] () {
+        persist<uint64_t>* w = (persist<uint64_t>*)RedoOpt::pmalloc(NUM_WORDS*sizeof(persist<uint64_t>));
+        for (int i = 0; i < NUM_WORDS; i++) w[i] = 0;
+        return w;
+    });
+    uint64_t ref[NUM_WORDS] = {};
+
+    printf("Large transaction\n");
+    // Three stores to each of 200 words, which is more than a group of the index (8 slots),
+    // its initial slots (2*MAXLOGSIZE) and a node of the log (MAXLOGSIZE entries)
+    bool ok = RedoOpt::updateTx<bool>([words] () {
+        for (uint64_t round = 1; round <= 3; round++) {
+            for (int i = 0; i < 200; i++) words[i] = round*1000 + i;
+        }
+        for (int i = 0; i < 200; i++) {
+            if (words[i].pload() != 3000 + (uint64_t)i) return false;
+        }
+        return true;
+    });
+    assert(ok);
+    for (int i = 0; i < 200; i++) ref[i] = 3000 + i;
+
+    printf("Many transactions\n");
+    // Each transaction starts with an empty write-set, which reuses the slots of the index
+    std::mt19937_64 rng(42);
+    for (int tx = 0; tx < 10000; tx++) {
+        const int numStores = 1 + rng() % 100;
+        uint64_t idxs[100], vals[100];
+        for (int j = 0; j < numStores; j++) {
+            idxs[j] = rng() % (j > 0 && rng() % 4 == 0 ? 8 : NUM_WORDS);   // Some stores go to the same few words
+            vals[j] = rng();
+            ref[idxs[j]] = vals[j];
+        }
+        RedoOpt::updateTx<bool>([&] () {
+            for (int j = 0; j < numStores; j++) words[idxs[j]] = vals[j];
+            return true;
+        });
+    }
+    ok = RedoOpt::readTx<bool>([&] () {
+        for (int i = 0; i < NUM_WORDS; i++) {
+            if (words[i].pload() != ref[i]) return false;
+        }
+        return true;
+    });
+    assert(ok);
+
+    RedoOpt::updateTx<bool>([words] () {
+        RedoOpt::pfree(words);
+        return true;
+    });
+    printf("Done\n");
+    return 0;
+}
@@ -1,8 +1,8 @@
 #!/usr/bin/env python
 import os
 
-# We only support workload A and workload B
-workload_list = [ " a", " b" ]
+# We support workloads A, B, E (short ranges) and F (read-modify-write)
+workload_list = [ " a", " b", " e", " f" ]
 
 # List of threads to run with
 thread_list = [
@@ -26,4 +26,6 @@ for workload in workload_list:
 # Move all the workloads to workloads/1m/
 os.system("mv workloads/a-* workloads/1m/")
 os.system("mv workloads/b-* workloads/1m/")
+os.system("mv workloads/e-* workloads/1m/")
+os.system("mv workloads/f-* workloads/1m/")
     
@@ -0,0 +1,85 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <cstdint>
+#include <cstring>
+#include "merge_operator.h"
+
+namespace ptmdb {
+
+MergeOperator::~MergeOperator() { }
+
+namespace {
+
+class UInt64AddOperator : public MergeOperator {
+ public:
+  virtual const char* Name() const { return "ptmdb.UInt64AddOperator"; }
+
+  virtual bool Merge(const Slice&, const Slice* existing_value,
+                     const Slice& operand, std::string* new_value) const {
+    uint64_t value = 0, delta = 0;
+    if (operand.size() != sizeof(delta)) return false;
+    if (existing_value != NULL) {
+      if (existing_value->size() != sizeof(value)) return false;
+      std::memcpy(&value, existing_value->data(), sizeof(value));
+    }
+    std::memcpy(&delta, operand.data(), sizeof(delta));
+    value += delta;
+    new_value->assign((const char*)&value, sizeof(value));
+    return true;
+  }
+};
+
+class StringAppendOperator : public MergeOperator {
+ public:
+  explicit StringAppendOperator(char delim) : delim_(delim) { }
+
+  virtual const char* Name() const { return "ptmdb.StringAppendOperator"; }
+
+  virtual bool Merge(const Slice&, const Slice* existing_value,
+                     const Slice& operand, std::string* new_value) const {
+    new_value->clear();
+    if (existing_value != NULL) {
+      new_value->reserve(existing_value->size() + 1 + operand.size());
+      new_value->assign(existing_value->data(), existing_value->size());
+      new_value->push_back(delim_);
+    }
+    new_value->append(operand.data(), operand.size());
+    return true;
+  }
+
+ private:
+  char delim_;
+};
+
+class MaxOperator : public MergeOperator {
+ public:
+  virtual const char* Name() const { return "ptmdb.MaxOperator"; }
+
+  virtual bool Merge(const Slice&, const Slice* existing_value,
+                     const Slice& operand, std::string* new_value) const {
+    if (existing_value != NULL && existing_value->compare(operand) >= 0) {
+      new_value->assign(existing_value->data(), existing_value->size());
+    } else {
+      new_value->assign(operand.data(), operand.size());
+    }
+    return true;
+  }
+};
+
+}  // namespace
+
+MergeOperator* NewUInt64AddOperator() {
+  return new UInt64AddOperator;
+}
+
+MergeOperator* NewStringAppendOperator(char delim) {
+  return new StringAppendOperator(delim);
+}
+
+MergeOperator* NewMaxOperator() {
+  return new MaxOperator;
+}
+
+}  // namespace ptmdb
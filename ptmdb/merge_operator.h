@@ -0,0 +1,54 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A MergeOperator gives the semantics of DB::Merge() and WriteBatch::Merge():
+// it computes the new value of a key from its current value and an operand,
+// inside the same update transaction that stores the result.
+//
+// The operator may be called several times for the same Merge(), if the
+// transaction restarts, and by other threads (with flat-combining PTMs),
+// therefore it must be thread-safe and must not have side effects.
+
+#ifndef _RDB_INCLUDE_MERGE_OPERATOR_H_
+#define _RDB_INCLUDE_MERGE_OPERATOR_H_
+
+#include <string>
+
+#include "slice.h"
+
+namespace ptmdb {
+
+class MergeOperator {
+ public:
+  virtual ~MergeOperator();
+
+  // The name of the operator, for the logs.
+  virtual const char* Name() const = 0;
+
+  // Stores in *new_value the result of applying "operand" to
+  // "*existing_value", or to nothing if existing_value is NULL, which
+  // happens when the key is not in the DB.
+  // Returns false if the operand can not be applied to the existing value,
+  // in which case the key is left unchanged.
+  virtual bool Merge(const Slice& key, const Slice* existing_value,
+                     const Slice& operand, std::string* new_value) const = 0;
+};
+
+// Built-in operators. The caller owns the result and must delete it after
+// the DB is closed.
+
+// The values and the operands are unsigned 64 bit integers, stored as 8
+// bytes in the byte order of the machine, and the operand is added to the
+// value (a missing key counts as zero). Used for counters.
+extern MergeOperator* NewUInt64AddOperator();
+
+// Appends the operand to the value, with "delim" between them.
+extern MergeOperator* NewStringAppendOperator(char delim);
+
+// Keeps the largest of the value and the operand, in byte-wise order.
+extern MergeOperator* NewMaxOperator();
+
+}  // namespace ptmdb
+
+#endif  // _RDB_INCLUDE_MERGE_OPERATOR_H_
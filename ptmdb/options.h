@@ -5,6 +5,8 @@
 
 namespace ptmdb {
 
+class MergeOperator;
+
 // Options to control the behavior of a database (passed to DB::Open)
 struct Options {
   // -------------------
@@ -126,6 +128,32 @@ struct Options {
 
   int max_background_jobs;
 
+  // If non-zero, a background thread checks the persistent memory pool every
+  // second, and when the fraction of it in free blocks (see the
+  // "ptmdb.pm-free-bytes" property) goes above this value, it compacts the
+  // whole DB, as in CompactRange(NULL, NULL). The free blocks that are left
+  // after a compaction are not counted for the next one.
+  // Only some PTMs support compaction.
+  //
+  // Default: 0 (no background compaction)
+  double pm_compaction_threshold;
+
+  // Degree of the B-tree, when the DB is created: the internal nodes have
+  // between btree_degree and 2*btree_degree children. Larger values give a
+  // shorter tree with larger nodes. The capacity of the nodes is fixed at
+  // compile time (PTMDB_BTREE_MAXKEYS), and values outside of [2, (capacity+1)/2]
+  // are clipped. An existing DB keeps the degree it was created with.
+  //
+  // Default: 0 (the largest degree that fits in the nodes)
+  int btree_degree;
+
+  // Operator used by DB::Merge() and WriteBatch::Merge() to combine the
+  // value of a key with an operand (see merge_operator.h). It is not
+  // persisted, and must be passed again on each DB::Open().
+  //
+  // Default: NULL (Merge() returns NotSupported)
+  const MergeOperator* merge_operator;
+
   // If non-NULL, use the specified filter policy to reduce disk reads.
   // Many applications will benefit from passing the result of
   // NewBloomFilterPolicy() here.
@@ -144,9 +172,40 @@ struct Options {
       max_file_size = 2<<20;
       reuse_logs = false;
       max_background_jobs = 128;
+      pm_compaction_threshold = 0;
+      btree_degree = 0;
+      merge_operator = NULL;
   }
 };
 
+// Type of the index of a column family
+enum IndexType {
+  // Ordered: supports all the operations, including iterators and scans.
+  kBTreeIndex = 0,
+  // Unordered: faster point operations, no scans, and the iterators visit
+  // the keys in the order of their hashes. The number of buckets is fixed.
+  kHashIndex = 1
+};
+
+// Options of a column family (passed to DB::CreateColumnFamily)
+struct ColumnFamilyOptions {
+  // Index used by the family. Default: kBTreeIndex
+  IndexType index_type;
+
+  // Degree of the B-tree, as in Options::btree_degree. Default: 0
+  int btree_degree;
+
+  // Number of buckets of a kHashIndex, which should be about the number of
+  // keys expected in the family. Default: 64K
+  int hash_buckets;
+
+  ColumnFamilyOptions()
+      : index_type(kBTreeIndex),
+        btree_degree(0),
+        hash_buckets(64*1024)
+  { }
+};
+
 // Options that control read operations
 struct ReadOptions {
   // If true, all data read from underlying storage will be
@@ -166,9 +225,17 @@ struct ReadOptions {
   // Default: NULL
   //const Snapshot* snapshot;
 
+  // Number of key/value pairs that an iterator reads in each transaction.
+  // The iterator can then be used outside of a transaction. Use zero to
+  // get an iterator that reads the tree directly, which is faster but can
+  // only be used inside of a readTx().
+  // Default: 64
+  int iterator_batch_size;
+
   ReadOptions()
       : verify_checksums(false),
-        fill_cache(true)
+        fill_cache(true),
+        iterator_batch_size(64)
         //snapshot(NULL)
   { }
 };
@@ -35,6 +35,7 @@
 #include "../../common/ThreadRegistry.hpp"
 #include "../../common/StrongTryRIRWLock.hpp"
 #include "../redoopt/HazardPointers.hpp"
+#include "../../../../../ptms/WriteSetIndex.hpp"
 
 using namespace std;
 using namespace chrono;
@@ -303,19 +304,13 @@ class RedoOpt {
         uint8_t*       addr {nullptr};      // Address of value+sequence to change
         uint64_t       oldval {0};          // Previous value
         uint64_t       val {0};             // Desired value to change to
-        WriteSetEntry*        next {nullptr};
     };
 
     // A single entry in the write-set
     struct WriteSetNode {
-        WriteSetEntry*     buckets[MAXLOGSIZE];
         WriteSetEntry      log[MAXLOGSIZE];     // Redo log of stores
         WriteSetNode*      next {nullptr};
         WriteSetNode*      prev {nullptr};
-
-        WriteSetNode() {
-        	for (int i = 0; i < MAXLOGSIZE; i++) buckets[i] = &log[MAXLOGSIZE-1];
-        }
     };
 
     struct WriteSetCL {
@@ -344,6 +339,7 @@ class RedoOpt {
         WriteSetNode           logHead {};
         WriteSetNode*          logTail {nullptr};
         uint64_t               lSize = 0;
+        ptmtx::WriteSetIndex<WriteSetEntry*> index {2*MAXLOGSIZE}; // Address -> entry in the log, to have a single entry per address
         std::atomic<uint64_t>  logSize {0};
 
         WriteSetNodeCL         logHeadCL {};
@@ -979,53 +975,19 @@ public:
 		}
     }
 
-    // Each cl on a different bucket
-	inline uint64_t hashAddress(const void* addr) const {
-		return ((uint64_t)addr>>3) % MAXLOGSIZE;
-	}
-
-	inline void addAddress(WriteSetNode* tail, uint64_t lSize, uint8_t* addr,
-			uint64_t oldval, uint64_t val, const uint64_t hashAddr, WriteSetEntry* next){
-
-		WriteSetEntry* e = &tail->log[lSize%MAXLOGSIZE];
-		e->addr = (uint8_t*)addr;
-		e->oldval = oldval;
-		e->val = val;
-		// Clear if entry is from previous tx
-		e->next = next;
-		tail->buckets[hashAddr] = e;
-	}
-
     /*
      * @return false if address is already present otherwise true
      */
     inline bool addAddrIfAbsent(void* addr, uint64_t oldval, uint64_t val) noexcept {
     	State* state = (State*)tlocal.st;
-    	const uint64_t hashAddr = hashAddress(addr);
+    	WriteSetEntry** be = state->index.find(addr);
+    	if (be != nullptr) {
+    		(*be)->val = val;
+    		return false;
+    	}
     	WriteSetNode* tail = state->logTail;
     	uint64_t lSize = state->lSize;
-    	if(lSize==0){
-    		addAddress(tail, lSize, (uint8_t*)addr, oldval, val, hashAddr,nullptr);
-    		state->lSize=lSize+1;
-			return true;
-    	}
-    	WriteSetNode* node = tail;
-    	if(lSize%MAXLOGSIZE==0){
-    		for(int i=0;i<lSize/MAXLOGSIZE;i++){
-    			if(i==16) break;
-    			WriteSetEntry* be = node->buckets[hashAddr];
-				if(hashAddress(be->addr) == hashAddr){
-					while (be != nullptr) {
-						if (be->addr == addr) {
-							be->val = val;
-							return false;
-						}
-						be = be->next;
-					}
-				}
-    			node = node->prev;
-    		}
-
+    	if (lSize != 0 && lSize%MAXLOGSIZE == 0) {
 			WriteSetNode* next = tail->next;
 			if(next ==nullptr){
 				next = new WriteSetNode();
@@ -1034,36 +996,12 @@ public:
 			}
 			tail = next;
 			state->logTail = next;
-
-    	}else{
-    		int numNodes = lSize/MAXLOGSIZE +1;
-    		for(int i=0;i<numNodes;i++){
-    			if(i==16) break;
-				WriteSetEntry* be = node->buckets[hashAddr];
-				if(hashAddress(be->addr) != hashAddr){
-					node = node->prev;
-					continue;
-				}
-				if(i != 0 ||
-				  (i == 0 &&
-					be < &node->log[lSize%MAXLOGSIZE])){
-
-					while (be != nullptr) {
-						if (be->addr == addr) {
-							be->val = val;
-							return false;
-						}
-						be = be->next;
-					}
-				}
-				node = node->prev;
-			}
     	}
     	WriteSetEntry* e = &tail->log[lSize%MAXLOGSIZE];
-    	WriteSetEntry* be = tail->buckets[hashAddr];
-		// Clear if entry is from previous tx
-    	WriteSetEntry* next = (be < e && hashAddress(be->addr) == hashAddr) ? be : nullptr;
-    	addAddress(tail, lSize, (uint8_t*)addr, oldval, val, hashAddr,next);
+		e->addr = (uint8_t*)addr;
+		e->oldval = oldval;
+		e->val = val;
+		state->index.insert(addr, e);
 		state->lSize=lSize+1;
 		return true;
     }
@@ -1547,6 +1485,7 @@ public:
             newState->ticket.store(newTicket);
             newState->logTail = &newState->logHead;
             newState->lSize = 0;
+            newState->index.clear();
             newState->numCL = 0;
             newState->logTailCL = &newState->logHeadCL;
             // Copy the contents of the current State into the new State
@@ -1 +1 @@
-#include "../ptms/trinity/TrinityVRFC.hpp"
+#include "../ptms/trinity/TrinityVRFC.hpp"
@@ -1 +1 @@
-#include "../ptms/trinity/TrinityVRTL2.hpp"
+#include "../ptms/trinity/TrinityVRTL2.hpp"
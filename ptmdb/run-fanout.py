@@ -0,0 +1,48 @@
+#!/usr/bin/env python
+import os
+
+#
+# Sweep over the fan-out of the B-tree of PTM-DB.
+# The capacity of the nodes is fixed at compile time, so we rebuild for each
+# capacity and then run db_bench and ycsb with every degree that fits in it.
+#
+db_bench_option = " --num=1000000 --benchmarks=fillrandom,readrandom,seekrandom,readseq,deleterandom"
+ycsb_workload = " workloads/1m/a"
+ycsb_threads = " 1"
+
+# [ capacity of the nodes (BTREE_MAXKEYS), [ degrees ] ]
+fanout_list = [
+    [16, [4, 8]],
+    [32, [12, 16]],
+    [64, [24, 32]],
+]
+
+db_list = [
+    ["bin/db_bench_trinvrtl2", "bin/ycsb_trinvrtl2", "results_fanout_trinvrtl2.txt"],
+    ["bin/db_bench_trinvrfc",  "bin/ycsb_trinvrfc",  "results_fanout_trinvrfc.txt"],
+]
+
+print "\n+++ Running B-tree fan-out sweep +++\n"
+for db in db_list:
+    os.system("rm " + db[2])
+    os.system("date >> " + db[2])
+for fanout in fanout_list:
+    maxkeys = str(fanout[0])
+    os.system("make -B BTREE_MAXKEYS=" + maxkeys + " " + " ".join([db[0] + " " + db[1] for db in db_list]))
+    for degree in fanout[1]:
+        for db in db_list:
+            for header in [db[0] + db_bench_option + " --btree_degree=" + str(degree),
+                           db[1] + ycsb_threads + ycsb_workload + " " + str(degree)]:
+                for mmap_attempts in range(10):
+                    os.system("make persistencyclean")
+                    os.system("sleep 2")
+                    print header
+                    os.system("echo >> " + db[2])
+                    os.system("echo BTREE_MAXKEYS=" + maxkeys + " " + header + " >> " + db[2])
+                    ret = os.system(header + " >> " + db[2])
+                    if ret != 42:  # We retry the mmap() if it gave us the wrong address
+                        break
+for db in db_list:
+    os.system("date >> " + db[2])
+
+os.system("make persistencyclean")
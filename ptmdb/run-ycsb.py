@@ -1,8 +1,8 @@
 #!/usr/bin/env python
 import os
 
-# YCSB Workloads A and B
-workload_list = [ " workloads/1m/a", " workloads/1m/b" ] 
+# YCSB Workloads A, B, E and F
+workload_list = [ " workloads/1m/a", " workloads/1m/b", " workloads/1m/e", " workloads/1m/f" ] 
 
 #
 # Databases
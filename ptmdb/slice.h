@@ -275,48 +275,63 @@ private:
 
 
 
+// Keys and values of the BTreeMap up to these sizes (in bytes) are stored inside the node instead of
+// in their own allocation, saving the PTM_MALLOC()/PTM_FREE() and the indirection. The defaults match the
+// 24 byte chunks of the volatile replica in Trinity. Zero means only empty slices are stored in the node.
+#ifndef PTMDB_INLINE_KEY_SIZE
+#define PTMDB_INLINE_KEY_SIZE    24
+#endif
+#ifndef PTMDB_INLINE_VALUE_SIZE
+#define PTMDB_INLINE_VALUE_SIZE  48
+#endif
+
 // This is a variant of PSlice meant to be used ONLY in the BTreeMap
-// The assignment operator does NOT make a copy
-class PBTSlice {
+// The assignment operator does NOT make a copy.
+// Slices of up to INLINE_SIZE bytes are stored in words_, otherwise words_[0] has the pointer to the data,
+// which has an extra NUL byte at the end. The inline data is not NUL terminated.
+template<int INLINE_SIZE>
+class PBTSliceT {
+    static const int NUM_WORDS = (INLINE_SIZE > 8) ? (INLINE_SIZE+7)/8 : 1;
 public:
-    PBTSlice() { }
+    PBTSliceT() { }
 
-    ~PBTSlice() {
-        //printf("PBTSlice destructor of size=%d\n", size_.pload());
-        if (size_ != 0) {
-            PTM_FREE(data_.pload());
-            size_ = 0;
-        }
+    ~PBTSliceT() {
+        reset();
     }
 
     // Assignment operator
     void operator=(const Slice& sl) {
-        //printf("PBTSlice assignment of const Slice\n");
         int32_t size = sl.size();
-        char* addr = data_;
+        if (size <= INLINE_SIZE) {
+            reset();
+            PTM_MEMCPY((void*)words_, sl.data(), size);
+            size_ = size;
+            return;
+        }
+        char* addr = heapData();
         // If different size, delete the old string and make a new one, otherwise re-use
         if (size != size_) {
-            //printf("PBTSlice %d != %d => deleting old data\n", size, size_.pload());
-            // Delete the old data (if there was something)
-            if (size_ != 0) PTM_FREE(data_.pload());
+            reset();
             addr = (char*)PTM_MALLOC(size+1);
-            data_ = addr;
+            words_[0] = (uint64_t)addr;
             size_ = size;
         }
         PTM_MEMCPY(addr, sl.data(), size+1);
     }
 
-    // Assignment operator from a PBTSlice does NOT delete the old data
-    void operator=(PBTSlice& psl) {
-        //printf("PBTSlice assignment PBTSlice\n");
-        size_ = psl.size_;
-        data_ = psl.data_;
+    // Assignment operator from a PBTSliceT does NOT delete the old data
+    void operator=(PBTSliceT& psl) {
+        const int32_t size = psl.size_;
+        const int n = (size <= INLINE_SIZE) ? (size+7)/8 : 1;
+        for (int i = 0; i < n; i++) words_[i] = psl.words_[i].pload();
+        size_ = size;
         psl.size_ = 0;
     }
 
     // Return a pointer to the beginning of the referenced data
     inline const char* data() const {
-        return data_.pload();
+        if (isInline()) return (const char*)words_;
+        return heapData();
     }
 
     // Return the length (in bytes) of the referenced data
@@ -324,15 +339,49 @@ public:
         return size_.pload();
     }
 
-    inline int compare(const Slice& other) {
-        return PTM_STRCMP(data_.pload(), other.data(), size_.pload());
+    inline bool isInline() const {
+        return size_.pload() <= INLINE_SIZE;
+    }
+
+    // Lexicographic order, with a key that is a prefix of another being the smaller one
+    inline int compare(const Slice& other) const {
+        const size_t size = size_.pload();
+        const size_t min_len = (size < other.size()) ? size : other.size();
+        int r = PTM_MEMCMP(data(), other.data(), min_len);
+        if (r == 0) {
+            if (size < other.size()) r = -1;
+            else if (size > other.size()) r = +1;
+        }
+        return r;
+    }
+
+    // Frees the data, leaving the slot empty
+    void reset() {
+        if (!isInline()) PTM_FREE(heapData());
+        if (size_ != 0) size_ = 0;
+    }
+
+    // Moves the data to a new allocation, used by the compaction of the persistent memory pool
+    void relocate() {
+        if (isInline()) return;
+        char* addr = (char*)PTM_MALLOC(size_+1);
+        PTM_MEMCPY(addr, heapData(), size_+1);
+        PTM_FREE(heapData());
+        words_[0] = (uint64_t)addr;
     }
 
 private:
-    PTM_TYPE<char*>   data_ {nullptr};
-    PTM_TYPE<int32_t> size_ {0};
+    inline char* heapData() const {
+        return (char*)words_[0].pload();
+    }
+
+    PTM_TYPE<int32_t>  size_ {0};
+    PTM_TYPE<uint64_t> words_[NUM_WORDS];
 };
 
+using PBTSlice = PBTSliceT<PTMDB_INLINE_KEY_SIZE>;
+using PBTValueSlice = PBTSliceT<PTMDB_INLINE_VALUE_SIZE>;
+
 }  // namespace ptmdb
 
 
@@ -8,7 +8,8 @@
 //    data: record[count]
 // record :=
 //    kTypeValue varstring varstring         |
-//    kTypeDeletion varstring
+//    kTypeDeletion varstring |
+//    kTypeMerge varstring varstring
 // varstring :=
 //    len: varint32
 //    data: uint8[len]
@@ -38,21 +39,53 @@ std::vector<WriteBatch::Op>& WriteBatch::getTransaction() {
 }
 
 void WriteBatch::Put(const Slice& key, const Slice& value) {
+    Put(nullptr, key, value);
+}
+
+void WriteBatch::Delete(const Slice& key) {
+    Delete(nullptr, key);
+}
+
+void WriteBatch::Merge(const Slice& key, const Slice& operand) {
+    Merge(nullptr, key, operand);
+}
+
+// A NULL column family is the default one
+static uint32_t ColumnFamilyID(ColumnFamilyHandle* column_family) {
+    return (column_family == nullptr) ? 0 : column_family->GetID();
+}
+
+static uint32_t ColumnFamilyGeneration(ColumnFamilyHandle* column_family) {
+    return (column_family == nullptr) ? 0 : column_family->GetGeneration();
+}
+
+void WriteBatch::Put(ColumnFamilyHandle* column_family, const Slice& key, const Slice& value) {
     char* k = new char[key.size()+1];
     char* v = new char[value.size()+1];
     std::memcpy(k, key.data(), key.size());
     std::memcpy(v, value.data(), value.size());
     k[key.size()] = 0;
     v[value.size()] = 0;
-    Op operat {true, k, (int)key.size(), v, (int)value.size()};
+    Op operat {kTypeValue, k, (int)key.size(), v, (int)value.size(), ColumnFamilyID(column_family), ColumnFamilyGeneration(column_family)};
     trans.push_back(std::move(operat));
 }
 
-void WriteBatch::Delete(const Slice& key) {
+void WriteBatch::Delete(ColumnFamilyHandle* column_family, const Slice& key) {
+    char* k = new char[key.size()+1];
+    std::memcpy(k, key.data(), key.size());
+    k[key.size()] = 0;
+    Op operat {kTypeDeletion, k, (int)key.size(), nullptr, 0, ColumnFamilyID(column_family), ColumnFamilyGeneration(column_family)};
+    trans.push_back(std::move(operat));
+}
+
+void WriteBatch::Merge(ColumnFamilyHandle* column_family, const Slice& key, const Slice& operand) {
     char* k = new char[key.size()+1];
+    char* v = new char[operand.size()+1];
     std::memcpy(k, key.data(), key.size());
+    std::memcpy(v, operand.data(), operand.size());
     k[key.size()] = 0;
-    Op operat {false, k, (int)key.size(), nullptr, 0};
+    v[operand.size()] = 0;
+    Op operat {kTypeMerge, k, (int)key.size(), v, (int)operand.size(), ColumnFamilyID(column_family), ColumnFamilyGeneration(column_family)};
     trans.push_back(std::move(operat));
 }
 
@@ -24,23 +24,30 @@
 #include <string>
 #include <vector>
 #include <cstring>
+#include <cstdint>
 #include <utility>
 
 namespace ptmdb {
 
 class Slice;
+class ColumnFamilyHandle;
 
 class WriteBatch {
  public:
+  // Type of each Op
+  enum OpType { kTypeDeletion = 0, kTypeValue = 1, kTypeMerge = 2 };
+
   class Op{
    public:
-    bool operation;
+    int operation;
     char* key;
     int key_size;
     char* value;
     int value_size;
-   Op(bool operation, char* key, int key_size, char* value, int value_size):
-       operation{operation},key{key},key_size{key_size},value{value},value_size{value_size}
+    uint32_t cf;        // Id of the column family
+    uint32_t generation;    // Generation of the column family (see ColumnFamilyHandle::GetGeneration())
+   Op(int operation, char* key, int key_size, char* value, int value_size, uint32_t cf = 0, uint32_t generation = 0):
+       operation{operation},key{key},key_size{key_size},value{value},value_size{value_size},cf{cf},generation{generation}
        {};
 
    // Copy constructor
@@ -48,6 +55,8 @@ class WriteBatch {
 	   operation = other.operation;
 	   key_size = other.key_size;
 	   value_size = other.value_size;
+	   cf = other.cf;
+	   generation = other.generation;
 	   key = new char[key_size+1];
 	   value = new char[value_size+1];
 	   std::memcpy(key, other.key, key_size);
@@ -59,11 +68,13 @@ class WriteBatch {
 
    // Move constructor
    Op(Op&& o) noexcept :
+           operation(std::exchange(o.operation, (int)kTypeDeletion)),
            key(std::exchange(o.key, nullptr)),
-           value(std::exchange(o.value, nullptr)),
            key_size(std::exchange(o.key_size, 0)),
+           value(std::exchange(o.value, nullptr)),
            value_size(std::exchange(o.value_size, 0)),
-           operation(std::exchange(o.operation, false)) { }
+           cf(std::exchange(o.cf, 0u)),
+           generation(std::exchange(o.generation, 0u)) { }
 
    ~Op(){
 	   delete[] key;
@@ -82,6 +93,16 @@ class WriteBatch {
   // If the database contains a mapping for "key", erase it.  Else do nothing.
   void Delete(const Slice& key);
 
+  // Replace the value of "key" with the result of the merge operator of the
+  // DB (see Options::merge_operator) applied to its value and "operand".
+  void Merge(const Slice& key, const Slice& operand);
+
+  // The same as the above, in the given column family instead of the
+  // default one.
+  void Put(ColumnFamilyHandle* column_family, const Slice& key, const Slice& value);
+  void Delete(ColumnFamilyHandle* column_family, const Slice& key);
+  void Merge(ColumnFamilyHandle* column_family, const Slice& key, const Slice& operand);
+
   // Clear all updates buffered in this batch.
   void Clear();
 
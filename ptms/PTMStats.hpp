@@ -0,0 +1,228 @@
+/*
+ * Copyright 2018-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.txt
+ */
+
+/*
+ * <h1> Persistence instrumentation for the PTMs </h1>
+ *
+ * Compile with -DPTM_STATS and each PTM counts, for each update transaction:
+ * - stores and store-bytes: the stores done by the user code in persistent types (and their size);
+ * - write-set: the number of entries in the write-set (or redo/undo log) at commit;
+ * - pwbs, pfences and psyncs: the persistence instructions executed by the PTM;
+ * The counters of each transaction go into a histogram (one bucket per power of two) per metric, and a
+ * report with all the histograms is printed to stdout when the process exits, or with PTM_STATS_REPORT().
+ * The write amplification is the number of bytes in the flushed cache lines divided by the store-bytes.
+ *
+ * Each PTM calls PTM_STATS_PWB(), PTM_STATS_PFENCE() and PTM_STATS_PSYNC() in its own definitions of
+ * PWB(), PFENCE() and PSYNC(), and PTM_STATS_TX_BEGIN() when an update transaction starts, which drops
+ * whatever was counted outside of a transaction (the initialization of the pool, for example).
+ * With flat-combining, the PWBs and fences of a batch are accounted to the transaction of the combiner.
+ * Without PTM_STATS, the PTM_STATS_*() macros are empty.
+ */
+#ifndef _PTM_STATS_H_
+#define _PTM_STATS_H_
+
+#ifdef PTM_STATS
+#include <cstdio>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+namespace ptmstats {
+
+enum Metric { STORES, STORE_BYTES, WRITE_SET, PWBS, PFENCES, PSYNCS, NUM_METRICS };
+static const char* const metricNames[NUM_METRICS] = { "stores", "store-bytes", "write-set", "pwbs", "pfences", "psyncs" };
+
+// Histogram where bucket 0 is for zero and bucket i for the values in [2^(i-1), 2^i)
+struct Histogram {
+    static const int NUM_BUCKETS = 65;
+    uint64_t buckets[NUM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+
+    Histogram() { clear(); }
+
+    void clear() {
+        for (int i = 0; i < NUM_BUCKETS; i++) buckets[i] = 0;
+        count = sum = max = 0;
+    }
+
+    inline void add(uint64_t v) {
+        buckets[v == 0 ? 0 : 64 - __builtin_clzll(v)]++;
+        count++;
+        sum += v;
+        if (v > max) max = v;
+    }
+
+    void merge(const Histogram& other) {
+        for (int i = 0; i < NUM_BUCKETS; i++) buckets[i] += other.buckets[i];
+        count += other.count;
+        sum += other.sum;
+        if (other.max > max) max = other.max;
+    }
+
+    // Returns the upper bound of the bucket where the percentile 'p' (0 to 100) is
+    uint64_t percentile(double p) const {
+        if (count == 0) return 0;
+        const uint64_t target = (uint64_t)(count*p/100.);
+        uint64_t acc = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            acc += buckets[i];
+            if (acc <= target && acc != count) continue;
+            if (i == 0) return 0;
+            const uint64_t upper = (i == 64) ? ~0ULL : (1ULL << i)-1;
+            return (upper < max) ? upper : max;
+        }
+        return max;
+    }
+};
+
+struct ThreadStats;
+
+// The histograms of the threads that have exited, and the ones still running
+struct Registry {
+    std::mutex                mutex;
+    std::vector<ThreadStats*> live;
+    Histogram                 hist[NUM_METRICS];
+    uint64_t                  aborts {0};
+    ~Registry();
+};
+
+inline Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+struct ThreadStats {
+    uint64_t  cur[NUM_METRICS] {};    // Counters of the current transaction
+    Histogram hist[NUM_METRICS];
+    uint64_t  aborts {0};
+
+    ThreadStats() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.live.push_back(this);
+    }
+
+    ~ThreadStats() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (int m = 0; m < NUM_METRICS; m++) r.hist[m].merge(hist[m]);
+        r.aborts += aborts;
+        r.live.erase(std::find(r.live.begin(), r.live.end(), this));
+    }
+
+    // Called by the PTM when an update transaction starts (not on each attempt)
+    inline void beginTx() {
+        for (int m = 0; m < NUM_METRICS; m++) cur[m] = 0;
+    }
+
+    // Called by the PTM when an update transaction commits
+    inline void endTx() {
+        for (int m = 0; m < NUM_METRICS; m++) {
+            hist[m].add(cur[m]);
+            cur[m] = 0;
+        }
+    }
+
+    // Called by the PTM when a transaction aborts. Its counters go into the next attempt.
+    inline void abortTx() {
+        aborts++;
+        cur[STORES] = cur[STORE_BYTES] = cur[WRITE_SET] = 0;
+    }
+};
+
+inline ThreadStats& tl() {
+    static thread_local ThreadStats ts;
+    return ts;
+}
+
+// Prints the histograms of all the threads. Threads that are running transactions make it approximate.
+inline void report(FILE* out = stdout) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    Histogram hist[NUM_METRICS];
+    uint64_t aborts = r.aborts;
+    for (int m = 0; m < NUM_METRICS; m++) hist[m].merge(r.hist[m]);
+    for (ThreadStats* ts : r.live) {
+        for (int m = 0; m < NUM_METRICS; m++) hist[m].merge(ts->hist[m]);
+        aborts += ts->aborts;
+    }
+    const uint64_t commits = hist[STORES].count;
+    if (commits == 0 && aborts == 0) return;
+    fprintf(out, "PTM stats: commits=%lu  aborts=%lu  abortRatio=%.1f%%\n", commits, aborts, 100.*aborts/(1+commits));
+    fprintf(out, "  %-12s %12s %12s %10s %10s %10s\n", "per-tx", "total", "mean", "p50", "p99", "max");
+    for (int m = 0; m < NUM_METRICS; m++) {
+        const Histogram& h = hist[m];
+        fprintf(out, "  %-12s %12lu %12.1f %10lu %10lu %10lu\n", metricNames[m], h.sum, (double)h.sum/(h.count ? h.count : 1),
+                h.percentile(50), h.percentile(99), h.max);
+    }
+    if (hist[STORE_BYTES].sum != 0 && hist[PWBS].sum != 0) {
+        fprintf(out, "  write amplification (64*pwbs/store-bytes) = %.2f\n", 64.*hist[PWBS].sum/hist[STORE_BYTES].sum);
+    }
+    for (int m = 0; m < NUM_METRICS; m++) {
+        const Histogram& h = hist[m];
+        if (h.sum == 0) continue;
+        fprintf(out, "  %s histogram:", metricNames[m]);
+        for (int i = 0; i < Histogram::NUM_BUCKETS; i++) {
+            if (h.buckets[i] == 0) continue;
+            if (i <= 1) fprintf(out, " [%d]=%lu", i, h.buckets[i]);
+            else fprintf(out, " [%llu-%llu]=%lu", 1ULL << (i-1), (i == 64) ? ~0ULL : (1ULL << i)-1, h.buckets[i]);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+// Discards the histograms of all the threads. Call it only when no transactions are running.
+inline void reset() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (int m = 0; m < NUM_METRICS; m++) r.hist[m].clear();
+    r.aborts = 0;
+    for (ThreadStats* ts : r.live) {
+        for (int m = 0; m < NUM_METRICS; m++) ts->hist[m].clear();
+        ts->aborts = 0;
+    }
+}
+
+// The threads are gone by now, and the report goes out with the static destructors
+inline Registry::~Registry() {
+    report(stdout);
+}
+
+} // namespace ptmstats
+
+#define PTM_STATS_PWB()            { ptmstats::tl().cur[ptmstats::PWBS]++; }
+#define PTM_STATS_PFENCE()         { ptmstats::tl().cur[ptmstats::PFENCES]++; }
+#define PTM_STATS_PSYNC()          { ptmstats::tl().cur[ptmstats::PSYNCS]++; }
+#define PTM_STATS_TX_BEGIN()       { ptmstats::tl().beginTx(); }
+#define PTM_STATS_STORE(bytes)     { ptmstats::ThreadStats& _ts = ptmstats::tl(); _ts.cur[ptmstats::STORES]++; _ts.cur[ptmstats::STORE_BYTES] += (bytes); }
+#define PTM_STATS_WRITE_SET(n)     { ptmstats::tl().cur[ptmstats::WRITE_SET] += (n); }
+#define PTM_STATS_TX_END()         { ptmstats::tl().endTx(); }
+#define PTM_STATS_ABORT()          { ptmstats::tl().abortTx(); }
+#define PTM_STATS_REPORT()         ptmstats::report()
+#define PTM_STATS_RESET()          ptmstats::reset()
+
+#else  // PTM_STATS is not defined
+
+#define PTM_STATS_PWB()            {}
+#define PTM_STATS_PFENCE()         {}
+#define PTM_STATS_PSYNC()          {}
+#define PTM_STATS_TX_BEGIN()       {}
+#define PTM_STATS_STORE(bytes)     {}
+#define PTM_STATS_WRITE_SET(n)     {}
+#define PTM_STATS_TX_END()         {}
+#define PTM_STATS_ABORT()          {}
+#define PTM_STATS_REPORT()         {}
+#define PTM_STATS_RESET()          {}
+
+#endif // PTM_STATS
+#endif // _PTM_STATS_H_
+
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2018-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.txt
+ */
+#ifndef _PTM_TX_RESULT_H_
+#define _PTM_TX_RESULT_H_
+
+#include <type_traits>
+#include <utility>
+
+namespace ptmtx {
+
+/*
+ * Holds the value returned by the lambda of a transaction, used by the readTx<R>() and updateTx<R>()
+ * of each PTM. The lambda is executed with run(), possibly several times if the transaction aborts or by
+ * another thread when doing flat-combining, and each execution move-assigns its result to 'value'.
+ * After the commit, take() moves the value out to the caller, which means there are no copies of R
+ * nor heap allocations, and the lambda doesn't need to capture any local variable by reference.
+ * Lambdas that return void (capturing the result by reference) are also accepted, and give R{}.
+ */
+template<typename R>
+struct TxResult {
+    R value {};
+
+    template<typename F>
+    inline typename std::enable_if<!std::is_void<typename std::result_of<F&()>::type>::value>::type run(F& func) {
+        value = func();
+    }
+
+    template<typename F>
+    inline typename std::enable_if<std::is_void<typename std::result_of<F&()>::type>::value>::type run(F& func) {
+        func();
+    }
+
+    inline R take() { return std::move(value); }
+};
+
+} // namespace ptmtx
+
+#endif // _PTM_TX_RESULT_H_
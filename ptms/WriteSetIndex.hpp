@@ -0,0 +1,142 @@
+/*
+ * Copyright 2018-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.txt
+ */
+#ifndef _PTM_WRITE_SET_INDEX_H_
+#define _PTM_WRITE_SET_INDEX_H_
+
+#include <cstdint>
+#include <cstring>
+#ifdef __AVX2__
+#include <immintrin.h> // Needed by probe()
+#endif
+
+namespace ptmtx {
+
+/*
+ * Open-addressed index from an address to a value of type V, which the PTMs use to find the entry of an
+ * address in their write-set (its position in the log, or a pointer to it).
+ * Slots are probed in groups of 8 consecutive keys, which are compared all at once with AVX2 (when the
+ * compiler has it enabled, otherwise with a plain loop), and a lookup ends at the first group that has a
+ * free slot. There are no removals, only a clear() at the start of each transaction, which is O(1) because
+ * each key carries the epoch in which it was inserted, in the upper 16 bits of the address (user-space
+ * addresses on x86-64 don't go beyond 47 bits). Keys from previous epochs are free slots.
+ * The slots are allocated on the first insert(), because some PTMs have many write-sets that are never used.
+ */
+template<typename V>
+struct WriteSetIndex {
+    static const uint64_t GROUP = 8;
+    static const uint64_t EPOCH_SHIFT = 48;
+    const uint64_t        initialSlots;  // Power of two, at least GROUP
+    uint64_t              numSlots {0};
+    uint64_t              numKeys {0};   // Number of keys in the current epoch
+    uint64_t              epoch {1};
+    uint64_t*             keys {nullptr};// Address in the lower 48 bits and epoch in the upper 16 bits
+    V*                    vals {nullptr};
+
+    explicit WriteSetIndex(uint64_t initialSlots) : initialSlots{initialSlots} { }
+
+    WriteSetIndex(const WriteSetIndex&) = delete;
+    WriteSetIndex& operator=(const WriteSetIndex&) = delete;
+
+    ~WriteSetIndex() {
+        delete[] keys;
+        delete[] vals;
+    }
+
+    // Forgets all the keys. Called at the start of each transaction
+    inline void clear() {
+        numKeys = 0;
+        if (++epoch < (1ULL << (64-EPOCH_SHIFT))) return;
+        // Wrap around of the epoch: the old keys have to go for real
+        if (keys != nullptr) std::memset(keys, 0, numSlots*sizeof(uint64_t));
+        epoch = 1;
+    }
+
+    // The words of the same cache line start on the same group, and consecutive cache lines on consecutive groups
+    inline uint64_t firstGroup(uint64_t addr) const {
+        return ((addr >> 6) ^ (addr >> 24)) & (numSlots/GROUP-1);
+    }
+
+    // Compares the key with the 8 slots in the group. Returns the bitmap of the slots that
+    // match the key in 'match' and the bitmap of the free slots in 'free'.
+    inline void probe(const uint64_t* group, uint64_t key, uint32_t& match, uint32_t& free) const {
+#ifdef __AVX2__
+        const __m256i vkey = _mm256_set1_epi64x(key);
+        const __m256i vepoch = _mm256_set1_epi64x(epoch);
+        const __m256i lo = _mm256_loadu_si256((const __m256i*)group);
+        const __m256i hi = _mm256_loadu_si256((const __m256i*)(group+4));
+        match = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(lo, vkey))) |
+                (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(hi, vkey))) << 4);
+        const uint32_t live = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_srli_epi64(lo, EPOCH_SHIFT), vepoch))) |
+                (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_srli_epi64(hi, EPOCH_SHIFT), vepoch))) << 4);
+        free = ~live & 0xFF;
+#else
+        match = 0;
+        free = 0;
+        for (uint64_t i = 0; i < GROUP; i++) {
+            match |= (uint32_t)(group[i] == key) << i;
+            free |= (uint32_t)((group[i] >> EPOCH_SHIFT) != epoch) << i;
+        }
+#endif
+    }
+
+    // Returns the value of 'addr', or nullptr if it's not in the index
+    inline V* find(const void* addr) const {
+        if (numKeys == 0) return nullptr;
+        const uint64_t key = (uint64_t)addr | (epoch << EPOCH_SHIFT);
+        uint64_t g = firstGroup((uint64_t)addr);
+        while (true) {
+            uint32_t match, free;
+            probe(&keys[g*GROUP], key, match, free);
+            if (match != 0) return &vals[g*GROUP + __builtin_ctz(match)];
+            if (free != 0) return nullptr;
+            g = (g+1) & (numSlots/GROUP-1);
+        }
+    }
+
+    // Inserts 'addr' with value 'val'. The caller has made sure 'addr' is not in the index.
+    inline void insert(const void* addr, const V& val) {
+        if ((numKeys+1)*4 > numSlots*3) grow();
+        const uint64_t key = (uint64_t)addr | (epoch << EPOCH_SHIFT);
+        uint64_t g = firstGroup((uint64_t)addr);
+        while (true) {
+            uint32_t match, free;
+            probe(&keys[g*GROUP], key, match, free);
+            if (free != 0) {
+                const uint64_t slot = g*GROUP + __builtin_ctz(free);
+                keys[slot] = key;
+                vals[slot] = val;
+                numKeys++;
+                return;
+            }
+            g = (g+1) & (numSlots/GROUP-1);
+        }
+    }
+
+    // Doubles the number of slots (or allocates the initial ones) and re-inserts the keys of the current epoch
+    void grow() {
+        uint64_t* oldKeys = keys;
+        V* oldVals = vals;
+        const uint64_t oldNumSlots = numSlots;
+        numSlots = (numSlots == 0) ? initialSlots : 2*numSlots;
+        keys = new uint64_t[numSlots];
+        vals = new V[numSlots];
+        std::memset(keys, 0, numSlots*sizeof(uint64_t));
+        numKeys = 0;
+        for (uint64_t i = 0; i < oldNumSlots; i++) {
+            if ((oldKeys[i] >> EPOCH_SHIFT) != epoch) continue;
+            insert((void*)(oldKeys[i] & ((1ULL << EPOCH_SHIFT)-1)), oldVals[i]);
+        }
+        delete[] oldKeys;
+        delete[] oldVals;
+    }
+};
+
+}  // namespace ptmtx
+
+#endif  // _PTM_WRITE_SET_INDEX_H_
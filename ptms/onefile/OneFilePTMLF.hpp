@@ -12,6 +12,7 @@
 
 #include <atomic>
 #include <cassert>
+#include <cstdlib>      // Needed by std::abort()
 #include <iostream>
 #include <vector>
 #include <functional>
@@ -31,27 +32,31 @@
    * Intel programming manual at https://www.intel.com/content/dam/www/public/us/en/documents/manuals/64-ia-32-architectures-optimization-manual.pdf
    * Use these for Broadwell CPUs (cervino server)
    */
-  #define PWB(addr)              __asm__ volatile("clflush (%0)" :: "r" (addr) : "memory")                  // Broadwell only works with this.
-  #define PFENCE()               {}                                                                         // No ordering fences needed for CLFLUSH (section 7.4.6 of Intel manual)
-  #define PSYNC()                {}                                                                         // For durability it's not obvious, but CLFLUSH seems to be enough, and PMDK uses the same approach
+  #define PWB(addr)              do { PTM_STATS_PWB(); __asm__ volatile("clflush (%0)" :: "r" (addr) : "memory"); } while (0)  // Broadwell only works with this.
+  #define PFENCE()               do { PTM_STATS_PFENCE(); } while (0)                                       // No ordering fences needed for CLFLUSH (section 7.4.6 of Intel manual)
+  #define PSYNC()                do { PTM_STATS_PSYNC(); } while (0)                                        // For durability it's not obvious, but CLFLUSH seems to be enough, and PMDK uses the same approach
 #elif PWB_IS_CLWB
   /* Use this for CPUs that support clwb, such as the SkyLake SP series (c5 compute intensive instances in AWS are an example of it) */
-  #define PWB(addr)              __asm__ volatile(".byte 0x66; xsaveopt %0" : "+m" (*(volatile char *)(addr)))  // clwb() only for Ice Lake onwards
-  #define PFENCE()               __asm__ volatile("sfence" : : : "memory")
-  #define PSYNC()                __asm__ volatile("sfence" : : : "memory")
+  #define PWB(addr)              do { PTM_STATS_PWB(); __asm__ volatile(".byte 0x66; xsaveopt %0" : "+m" (*(volatile char *)(addr))); } while (0)  // clwb() only for Ice Lake onwards
+  #define PFENCE()               do { PTM_STATS_PFENCE(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+  #define PSYNC()                do { PTM_STATS_PSYNC(); __asm__ volatile("sfence" : : : "memory"); } while (0)
 #elif PWB_IS_NOP
   /* pwbs are not needed for shared memory persistency (i.e. persistency across process failure) */
-  #define PWB(addr)              {}
-  #define PFENCE()               __asm__ volatile("sfence" : : : "memory")
-  #define PSYNC()                __asm__ volatile("sfence" : : : "memory")
+  #define PWB(addr)              do { PTM_STATS_PWB(); } while (0)
+  #define PFENCE()               do { PTM_STATS_PFENCE(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+  #define PSYNC()                do { PTM_STATS_PSYNC(); __asm__ volatile("sfence" : : : "memory"); } while (0)
 #elif PWB_IS_CLFLUSHOPT
   /* Use this for CPUs that support clflushopt, which is most recent x86 */
-  #define PWB(addr)              __asm__ volatile(".byte 0x66; clflush %0" : "+m" (*(volatile char *)(addr)))    // clflushopt (Kaby Lake)
-  #define PFENCE()               __asm__ volatile("sfence" : : : "memory")
-  #define PSYNC()                __asm__ volatile("sfence" : : : "memory")
+  #define PWB(addr)              do { PTM_STATS_PWB(); __asm__ volatile(".byte 0x66; clflush %0" : "+m" (*(volatile char *)(addr))); } while (0)  // clflushopt (Kaby Lake)
+  #define PFENCE()               do { PTM_STATS_PFENCE(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+  #define PSYNC()                do { PTM_STATS_PSYNC(); __asm__ volatile("sfence" : : : "memory"); } while (0)
 #else
 #error "You must define what PWB is. Choose PWB_IS_CLFLUSHOPT if you don't know what your CPU is capable of"
 #endif
+// With -DPTM_STATS, the PWB(), PFENCE() and PSYNC() above count themselves with the PTM_STATS_*() hooks
+#include "../PTMStats.hpp"
+#include "../TxResult.hpp"     // Needed by readTx<R>() and updateTx<R>()
+#include "../WriteSetIndex.hpp"  // Needed by WriteSet
 
 
 /*
@@ -78,10 +83,19 @@ namespace poflf {
 
 // Maximum number of registered threads that can execute transactions
 static const int REGISTRY_MAX_THREADS = 128;
-// Maximum number of stores in the WriteSet per transaction
+// Number of stores that fit in the inline part of the write-sets. Larger transactions add chunks
+// of this size to the volatile and persistent write-sets.
 static const uint64_t TX_MAX_STORES = 40*1024;
-// Number of buckets in the hashmap of the WriteSet.
+// Maximum number of chunks in the volatile write-set, i.e. at most TX_MAX_STORES*(1+WS_MAX_CHUNKS) stores per transaction.
+static const uint64_t WS_MAX_CHUNKS = 1024;
+// Initial number of slots in the index of the WriteSet (a power of two). It grows with the write-set.
 static const uint64_t HASH_BUCKETS = 2048;
+// Write-sets with more stores than this are applied cooperatively, with each helper claiming a range of (at least) this many entries
+static const uint64_t APPLY_RANGE = 64;
+// Maximum number of ranges in a cooperative apply. Larger write-sets have larger ranges
+static const uint64_t APPLY_MAX_RANGES = 1024;
+// Number of bits for the index of the range in WriteSet::applyCursor. The sequence of the transaction is in the remaining bits
+static const uint64_t APPLY_CURSOR_BITS = 20;
 
 // Persistent-specific configuration
 // Start address of mapped persistent memory
@@ -362,18 +376,45 @@ struct PWriteSetEntry {
 };
 
 
+// Extra room for the persistent write-set of a thread, for transactions with more than TX_MAX_STORES stores.
+// Chunks are allocated and linked in a transaction of their own (see growPersistentLog()) and they stay
+// linked to the PWriteSet of the thread, to be re-used by its next large transactions.
+struct PWriteSetChunk {
+    tmtypebase<PWriteSetChunk*> next;
+    PWriteSetEntry              plog[TX_MAX_STORES];
+};
+
+
 // The persistent write-set (undo log)
 struct PWriteSet {
-    uint64_t              numStores {0};          // Number of stores in the writeSet for the current transaction
-    std::atomic<uint64_t> request {0};            // Can be moved to CLOSED by other threads, using a CAS
-    PWriteSetEntry        plog[TX_MAX_STORES];    // Redo log of stores
+    uint64_t                    numStores {0};          // Number of stores in the writeSet for the current transaction
+    std::atomic<uint64_t>       request {0};            // Can be moved to CLOSED by other threads, using a CAS
+    PWriteSetEntry              plog[TX_MAX_STORES];    // Redo log of stores
+    tmtypebase<PWriteSetChunk*> chunks;                 // Redo log of stores beyond TX_MAX_STORES
+
+    // Returns true if there is room for 'nstores' in the inline log plus the chunks
+    bool fits(uint64_t nstores) {
+        if (nstores <= TX_MAX_STORES) return true;
+        uint64_t room = TX_MAX_STORES;
+        for (PWriteSetChunk* chunk = (PWriteSetChunk*)chunks.val.load(); chunk != nullptr; chunk = (PWriteSetChunk*)chunk->next.val.load()) {
+            room += TX_MAX_STORES;
+            if (nstores <= room) return true;
+        }
+        return false;
+    }
 
     // Applies all entries in the log. Called only by recover() which is non-concurrent.
     void applyFromRecover() {
         // We're assuming that 'val' is the size of a uint64_t
+        PWriteSetEntry* log = plog;
+        PWriteSetChunk* chunk = (PWriteSetChunk*)chunks.val.load();
         for (uint64_t i = 0; i < numStores; i++) {
-            *((uint64_t*)plog[i].addr) = plog[i].val;
-            PWB(plog[i].addr);
+            if (i > 0 && i % TX_MAX_STORES == 0) {
+                log = chunk->plog;
+                chunk = (PWriteSetChunk*)chunk->next.val.load();
+            }
+            *((uint64_t*)log[i % TX_MAX_STORES].addr) = log[i % TX_MAX_STORES].val;
+            PWB(log[i % TX_MAX_STORES].addr);
         }
     }
 };
@@ -382,7 +423,7 @@ struct PWriteSet {
 // The persistent metadata is a 'header' that contains all the logs and the persistent curTx variable.
 // It is located at the start of the persistent region, and the remaining region contains the data available for the allocator to use.
 struct PMetadata {
-    static const uint64_t   MAGIC_ID = 0x1337babe;
+    static const uint64_t   MAGIC_ID = 0x1337babf;
     std::atomic<uint64_t>   curTx {seqidx2trans(1,0)};
     std::atomic<uint64_t>   pad1[15];
     tmtypebase<void*>       rootPtrs[MAX_ROOT_POINTERS];
@@ -396,112 +437,132 @@ struct PMetadata {
 struct WriteSetEntry {
     void*          addr {nullptr};  // Address of value+sequence to change
     uint64_t       val;             // Desired value to change to
-    WriteSetEntry* next {nullptr};  // Pointer to next node in the (intrusive) hash map
 };
 
 extern thread_local bool tl_is_read_only;
 
-
 // The write-set is a log of the words modified during the transaction.
-// This log is an array with an intrusive hashmap of size HASH_BUCKETS.
+// This log is an array with an open-addressed index (WriteSetIndex) for the lookups. When the array is full,
+// chunks of TX_MAX_STORES entries are added, and the index grows as needed.
+// Other threads read the log (and the chunks) when they help apply a transaction, therefore, the
+// chunks are never de-allocated while the write-set exists.
+// The applyCursor and rangeDone[] are used by the helpers of the transaction of the owner of this
+// write-set, to split the apply of large write-sets among them (see OneFileLF::cooperativeApply()).
 struct WriteSet {
-    static const uint64_t MAX_ARRAY_LOOKUP = 30;  // Beyond this, it seems to be faster to use the hashmap
     WriteSetEntry         log[TX_MAX_STORES];     // Redo log of stores
     uint64_t              numStores {0};          // Number of stores in the writeSet for the current transaction
-    WriteSetEntry*        buckets[HASH_BUCKETS];  // Intrusive HashMap for fast lookup in large(r) transactions
+    ptmtx::WriteSetIndex<uint32_t> index {HASH_BUCKETS};   // Address -> position in the log, for the lookups
+    std::atomic<WriteSetEntry*> chunks[WS_MAX_CHUNKS]; // Entries beyond TX_MAX_STORES, allocated on demand
+    std::atomic<uint64_t> applyCursor {0};        // Next range to claim, with the seq of the transaction in the upper bits
+    std::atomic<uint64_t> rangeDone[APPLY_MAX_RANGES]; // Seq of the last transaction whose range was applied and flushed
 
     WriteSet() {
         numStores = 0;
-        for (int i = 0; i < HASH_BUCKETS; i++) buckets[i] = &log[TX_MAX_STORES-1];
+        for (uint64_t i = 0; i < WS_MAX_CHUNKS; i++) chunks[i].store(nullptr, std::memory_order_relaxed);
+        for (uint64_t i = 0; i < APPLY_MAX_RANGES; i++) rangeDone[i].store(0, std::memory_order_relaxed);
+    }
+
+    ~WriteSet() {
+        for (uint64_t i = 0; i < WS_MAX_CHUNKS; i++) delete[] chunks[i].load();
+    }
+
+    // Starts a new (empty) write-set
+    inline void reset() {
+        numStores = 0;
+        index.clear();
+    }
+
+    inline WriteSetEntry& entry(uint64_t idx) {
+        if (idx < TX_MAX_STORES) return log[idx];
+        return chunks[idx/TX_MAX_STORES-1].load(std::memory_order_relaxed)[idx % TX_MAX_STORES];
+    }
+
+    // Makes sure there is an entry at 'idx', adding a chunk if needed. Only the owner of the write-set calls this.
+    inline void reserve(uint64_t idx) {
+        if (idx < TX_MAX_STORES || idx % TX_MAX_STORES != 0) return;
+        const uint64_t ichunk = idx/TX_MAX_STORES-1;
+        if (ichunk >= WS_MAX_CHUNKS) {
+            printf("ERROR: transaction with more than %ld stores. Increase WS_MAX_CHUNKS\n", TX_MAX_STORES*(WS_MAX_CHUNKS+1));
+            std::abort();
+        }
+        if (chunks[ichunk].load(std::memory_order_relaxed) == nullptr) {
+            chunks[ichunk].store(new WriteSetEntry[TX_MAX_STORES], std::memory_order_release);
+        }
     }
 
     // Copies the current write set to persistent memory
     inline void persistAndFlushLog(PWriteSet* const pwset) {
-        for (uint64_t i = 0; i < numStores; i++) {
+        const uint64_t n = numStores < TX_MAX_STORES ? numStores : TX_MAX_STORES;
+        for (uint64_t i = 0; i < n; i++) {
             pwset->plog[i].addr = log[i].addr;
             pwset->plog[i].val = log[i].val;
         }
         pwset->numStores = numStores;
         // Flush the log and the numStores variable
-        flushFromTo(&pwset->numStores, &pwset->plog[numStores+1]);
+        flushFromTo(&pwset->numStores, &pwset->plog[n+1]);
+        // The remaining entries go on the persistent chunks, which commitTx() made sure are enough
+        PWriteSetChunk* pchunk = (PWriteSetChunk*)pwset->chunks.val.load();
+        for (uint64_t ichunk = 0; (ichunk+1)*TX_MAX_STORES < numStores; ichunk++) {
+            const WriteSetEntry* chunk = chunks[ichunk].load(std::memory_order_relaxed);
+            const uint64_t m = numStores-(ichunk+1)*TX_MAX_STORES < TX_MAX_STORES ? numStores-(ichunk+1)*TX_MAX_STORES : TX_MAX_STORES;
+            for (uint64_t i = 0; i < m; i++) {
+                pchunk->plog[i].addr = chunk[i].addr;
+                pchunk->plog[i].val = chunk[i].val;
+            }
+            flushFromTo(&pchunk->plog[0], &pchunk->plog[m]);
+            pchunk = (PWriteSetChunk*)pchunk->next.val.load();
+        }
     }
 
     // Uses the log to flush the modifications to NVM.
     // We assume tmtype does not cross cache line boundaries.
     inline void flushModifications() {
-        for (uint64_t i = 0; i < numStores; i++) PWB(log[i].addr);
+        flushRange(0, numStores);
     }
 
-    // Each address on a different bucket
-    inline uint64_t hash(const void* addr) const {
-        return (((uint64_t)addr) >> 3) % HASH_BUCKETS;
+    inline void flushRange(uint64_t from, uint64_t to) {
+        for (uint64_t i = from; i < to; i++) PWB(entry(i).addr);
     }
 
     // Adds a modification to the redo log
     inline void addOrReplace(void* addr, uint64_t val) {
         if (tl_is_read_only) tl_is_read_only = false;
-        const uint64_t hashAddr = hash(addr);
-        if (numStores < MAX_ARRAY_LOOKUP) {
-            // Lookup in array
-            for (unsigned int idx = 0; idx < numStores; idx++) {
-                if (log[idx].addr == addr) {
-                    log[idx].val = val;
-                    return;
-                }
-            }
-        } else {
-            // Lookup in hashmap
-            WriteSetEntry* be = buckets[hashAddr];
-            if (be < &log[numStores] && hash(be->addr) == hashAddr) {
-                while (be != nullptr) {
-                    if (be->addr == addr) {
-                        be->val = val;
-                        return;
-                    }
-                    be = be->next;
-                }
-            }
+        const uint32_t* idx = index.find(addr);
+        if (idx != nullptr) {
+            entry(*idx).val = val;
+            return;
         }
-        // Add to array
-        WriteSetEntry* e = &log[numStores++];
-        assert(numStores < TX_MAX_STORES);
+        // Add to array (or to a chunk)
+        reserve(numStores);
+        WriteSetEntry* e = &entry(numStores);
         e->addr = addr;
         e->val = val;
-        // Add to hashmap
-        WriteSetEntry* be = buckets[hashAddr];
-        // Clear if entry is from previous tx
-        e->next = (be < e && hash(be->addr) == hashAddr) ? be : nullptr;
-        buckets[hashAddr] = e;
+        index.insert(addr, numStores++);
     }
 
     // Does a lookup on the WriteSet for an addr.
-    // If the numStores is lower than MAX_ARRAY_LOOKUP, the lookup is done on the log, otherwise, the lookup is done on the hashmap.
     // If it's not in the write-set, return lval.
     inline uint64_t lookupAddr(const void* addr, uint64_t lval) {
-        if (numStores < MAX_ARRAY_LOOKUP) {
-            // Lookup in array
-            for (unsigned int idx = 0; idx < numStores; idx++) {
-                if (log[idx].addr == addr) return log[idx].val;
-            }
-        } else {
-            // Lookup in hashmap
-            const uint64_t hashAddr = hash(addr);
-            WriteSetEntry* be = buckets[hashAddr];
-            if (be < &log[numStores] && hash(be->addr) == hashAddr) {
-                while (be != nullptr) {
-                    if (be->addr == addr) return be->val;
-                    be = be->next;
-                }
-            }
-        }
-        return lval;
+        if (numStores == 0) return lval;
+        const uint32_t* idx = index.find(addr);
+        if (idx == nullptr) return lval;
+        return entry(*idx).val;
     }
 
-    // Assignment operator, used when making a copy of a WriteSet to help another thread
-    WriteSet& operator = (const WriteSet &other) {
-        numStores = other.numStores;
-        for (uint64_t i = 0; i < numStores; i++) log[i] = other.log[i];
-        return *this;
+    // Makes a copy of the write-set of another thread, to help it.
+    // The other thread may be changing it, therefore, the copy may be inconsistent and the caller has to
+    // validate it afterwards. Returns false if the copy is inconsistent because a chunk is missing.
+    bool copyFrom(WriteSet& other) {
+        const uint64_t n = other.numStores;
+        for (uint64_t i = 0; i < n; i++) {
+            if (i >= TX_MAX_STORES && i % TX_MAX_STORES == 0) {
+                if (i/TX_MAX_STORES-1 >= WS_MAX_CHUNKS || other.chunks[i/TX_MAX_STORES-1].load(std::memory_order_acquire) == nullptr) return false;
+                reserve(i);
+            }
+            entry(i) = other.entry(i);
+        }
+        numStores = n;
+        return true;
     }
 
     // Applies all entries in the log as DCASes.
@@ -509,7 +570,18 @@ struct WriteSet {
     inline void apply(uint64_t seq, const int tid) {
         for (uint64_t i = 0; i < numStores; i++) {
             // Use an heuristic to give each thread 8 consecutive DCAS to apply
-            WriteSetEntry& e = log[(tid*8 + i) % numStores];
+            WriteSetEntry& e = entry((tid*8 + i) % numStores);
+            tmtypebase<uint64_t>* tmte = (tmtypebase<uint64_t>*)e.addr;
+            uint64_t lval = tmte->val.load(std::memory_order_acquire);
+            uint64_t lseq = tmte->seq.load(std::memory_order_acquire);
+            if (lseq < seq) DCAS((uint64_t*)e.addr, lval, lseq, e.val, seq);
+        }
+    }
+
+    // Same as apply() but only for the entries in [from,to)
+    inline void applyRange(uint64_t seq, uint64_t from, uint64_t to) {
+        for (uint64_t i = from; i < to; i++) {
+            WriteSetEntry& e = entry(i);
             tmtypebase<uint64_t>* tmte = (tmtypebase<uint64_t>*)e.addr;
             uint64_t lval = tmte->val.load(std::memory_order_acquire);
             uint64_t lseq = tmte->seq.load(std::memory_order_acquire);
@@ -711,6 +783,8 @@ public:
             PWB(&pmd->id);
             PFENCE();
         }
+        // The initialization of the pool is not part of the workload
+        PTM_STATS_RESET();
     }
 
     // Progress Condition: lock-free
@@ -721,7 +795,7 @@ public:
             myopd.curTx = curTx->load(std::memory_order_acquire);
             helpApply(myopd.curTx, tid);
             // Reset the write-set after (possibly) helping another transaction complete
-            writeSets[tid].numStores = 0;
+            writeSets[tid].reset();
             // Start over if there is already a new transaction
             if (myopd.curTx == curTx->load(std::memory_order_acquire)) return;
         }
@@ -735,6 +809,8 @@ public:
         if (writeSets[tid].numStores == 0) return true;
         // Give up if the curTx has changed sinced our transaction started
         if (myopd.curTx != curTx->load(std::memory_order_acquire)) return false;
+        // Give up if the persistent write-set is too small. The caller adds chunks to it and restarts.
+        if (!myopd.pWriteSet->fits(writeSets[tid].numStores)) return false;
         // Move our request to OPEN, using the sequence of the previous transaction +1
         const uint64_t seq = trans2seq(myopd.curTx);
         const uint64_t newTx = seqidx2trans(seq+1,tid);
@@ -749,6 +825,8 @@ public:
         // Execute each store in the write-set using DCAS() and close the request
         helpApply(newTx, tid);
         // We should need a PSYNC() here to provide durable linearizabilty, but the CAS of the state in helpApply() acts as a PSYNC() (on x86).
+        PTM_STATS_WRITE_SET(writeSets[tid].numStores);
+        PTM_STATS_TX_END();
         if (debug) printf("Committed transaction (%ld,%ld) with %ld stores\n", seq+1, (uint64_t)tid, writeSets[tid].numStores);
         return true;
     }
@@ -785,35 +863,61 @@ public:
         }
         ++myopd.nestedTrans;
         tl_opdata = &myopd;
+        PTM_STATS_TX_BEGIN();
         while (true) {
             beginTx(myopd, tid);
             try {
                 func();
             } catch (AbortedTx&) {
+                PTM_STATS_ABORT();
                 continue;
             }
             if (commitTx(myopd, tid)) break;
+            PTM_STATS_ABORT();
+            // Make room in the persistent write-set before re-executing a large transaction
+            if (!myopd.pWriteSet->fits(writeSets[tid].numStores)) growPersistentLog(myopd, tid, writeSets[tid].numStores);
         }
         tl_opdata = nullptr;
         --myopd.nestedTrans;
     }
 
+    // Adds chunks to the persistent write-set of this thread until it has room for 'numStores'.
+    // Each chunk is allocated and linked to the end of the list in its own (small) transaction.
+    void growPersistentLog(OpData& myopd, const int tid, const uint64_t numStores) {
+        while (!myopd.pWriteSet->fits(numStores)) {
+            while (true) {
+                beginTx(myopd, tid);
+                try {
+                    tmtype<PWriteSetChunk*>* last = (tmtype<PWriteSetChunk*>*)&myopd.pWriteSet->chunks;
+                    while (last->pload() != nullptr) last = (tmtype<PWriteSetChunk*>*)&last->pload()->next;
+                    PWriteSetChunk* chunk = (PWriteSetChunk*)esloco.malloc(sizeof(PWriteSetChunk));
+                    assert(chunk != nullptr);
+                    ((tmtype<PWriteSetChunk*>*)&chunk->next)->pstore(nullptr);
+                    last->pstore(chunk);
+                } catch (AbortedTx&) {
+                    continue;
+                }
+                if (commitTx(myopd, tid)) break;
+            }
+        }
+    }
+
     // It's silly that these have to be static, but we need them for the (SPS) benchmarks due to templatization
-    //template<typename R, typename F> static R updateTx(F&& func) { return gOFLF.transaction<R>(func); }
-    //template<typename R, typename F> static R readTx(F&& func) { return gOFLF.transaction<R>(func); }
     template<typename F> static void updateTx(F&& func) { gOFLF.transaction(func); }
     template<typename F> static void readTx(F&& func) { gOFLF.transaction(func); }
     template<typename F> static void updateTxSeq(F&& func) { gOFLF.transaction(func); }
     template<typename F> static void readTxSeq(F&& func) { gOFLF.transaction(func); }
 
-    // TODO: Remove these two once we make CX have void transactions
+    // Transactions that return the value of func(), moved out to the caller after the commit
     template<typename R,class F> inline static R readTx(F&& func) {
-        gOFLF.transaction([&]() {func();});
-        return R{};
+        ptmtx::TxResult<R> res;
+        gOFLF.transaction([&]() {res.run(func);});
+        return res.take();
     }
     template<typename R,class F> inline static R updateTx(F&& func) {
-        gOFLF.transaction([&]() {func();});
-        return R{};
+        ptmtx::TxResult<R> res;
+        gOFLF.transaction([&]() {res.run(func);});
+        return res.take();
     }
 
     template <typename T, typename... Args> static T* tmNew(Args&&... args) {
@@ -877,20 +981,65 @@ private:
         if (lcurTx != opd.pWriteSet->request.load(std::memory_order_acquire)) return;
         if (idx != tid) {
             // Make a copy of the write-set and check if it is consistent
-            writeSets[tid] = writeSets[idx];
+            if (!writeSets[tid].copyFrom(writeSets[idx])) return;
             std::atomic_thread_fence(std::memory_order_acquire);
             if (lcurTx != curTx->load()) return;
             if (lcurTx != opd.pWriteSet->request.load(std::memory_order_acquire)) return;
         }
         if (debug) printf("Applying %ld stores in write-set\n", writeSets[tid].numStores);
-        writeSets[tid].apply(seq, tid);
-        writeSets[tid].flushModifications();
+        if (writeSets[tid].numStores > APPLY_RANGE) {
+            cooperativeApply(writeSets[idx], writeSets[tid], seq);
+        } else {
+            writeSets[tid].apply(seq, tid);
+            writeSets[tid].flushModifications();
+        }
         const uint64_t newReq = seqidx2trans(seq+1,idx);
         if (opd.pWriteSet->request.load(std::memory_order_acquire) == lcurTx) {
             opd.pWriteSet->request.compare_exchange_strong(lcurTx, newReq);
         }
     }
 
+    // Progress condition: lock-free
+    // Applies and flushes the write-set 'ws', a copy of the write-set of the 'owner' of the transaction 'seq'.
+    // Instead of having each helper DCAS all the entries, the helpers claim disjoint ranges of the write-set
+    // from owner.applyCursor, and mark each range in owner.rangeDone[] after it's applied and flushed.
+    // A helper that claimed a range may be delayed, therefore, no one waits for it: after there are no more
+    // ranges to claim, each helper goes over the ranges that aren't done yet and applies them as well.
+    // When we return, all the ranges are done, either by us or by other helpers that did a PFENCE() before
+    // marking the range as done.
+    inline void cooperativeApply(WriteSet& owner, WriteSet& ws, const uint64_t seq) {
+        const uint64_t n = ws.numStores;
+        const uint64_t rangeSize = (n + APPLY_MAX_RANGES-1)/APPLY_MAX_RANGES > APPLY_RANGE ? (n + APPLY_MAX_RANGES-1)/APPLY_MAX_RANGES : APPLY_RANGE;
+        const uint64_t numRanges = (n + rangeSize-1)/rangeSize;
+        auto doRange = [&] (uint64_t irange) {
+            const uint64_t from = irange*rangeSize;
+            const uint64_t to = (from + rangeSize < n) ? from + rangeSize : n;
+            ws.applyRange(seq, from, to);
+            ws.flushRange(from, to);
+            PFENCE();
+            uint64_t ldone = owner.rangeDone[irange].load(std::memory_order_acquire);
+            while (ldone < seq && !owner.rangeDone[irange].compare_exchange_weak(ldone, seq));
+        };
+        // The first helper moves the cursor to this transaction
+        uint64_t lcursor = owner.applyCursor.load(std::memory_order_acquire);
+        while ((lcursor >> APPLY_CURSOR_BITS) < seq) {
+            if (owner.applyCursor.compare_exchange_strong(lcursor, seq << APPLY_CURSOR_BITS)) break;
+        }
+        // Claim ranges until there are none left. If the cursor moved on to another transaction in the
+        // meantime, we may have taken an index from it, which its helpers will apply in the loop below.
+        while (true) {
+            lcursor = owner.applyCursor.fetch_add(1);
+            if ((lcursor >> APPLY_CURSOR_BITS) != seq) break;
+            const uint64_t irange = lcursor & ((1ULL << APPLY_CURSOR_BITS)-1);
+            if (irange >= numRanges) break;
+            doRange(irange);
+        }
+        // Apply the ranges that were claimed by helpers which didn't finish them (yet)
+        for (uint64_t irange = 0; irange < numRanges; irange++) {
+            if (owner.rangeDone[irange].load(std::memory_order_acquire) < seq) doRange(irange);
+        }
+    }
+
     // Upon restart, re-applies the last transaction, so as to guarantee that
     // we have a consistent state in persistent memory.
     // This is not needed on x86, where the DCAS has atomicity writting to persistent memory.
@@ -911,6 +1060,7 @@ template<typename T> inline void tmtype<T>::pstore(T newVal) {
     if (myopd == nullptr) { // Looks like we're outside a transaction
         tmtypebase<T>::val.store((uint64_t)newVal, std::memory_order_relaxed);
     } else {
+        PTM_STATS_STORE(sizeof(T));
         gOFLF.writeSets[tl_tcico.tid].addOrReplace(this, (uint64_t)newVal);
     }
 }
@@ -939,8 +1089,8 @@ template<typename T> inline T tmtype<T>::pload() const {
 //
 // Wrapper methods to the global TM instance. The user should use these:
 //
-template<typename R, typename F> static R updateTx(F&& func) { return gOFLF.transaction<R>(func); }
-template<typename R, typename F> static R readTx(F&& func) { return gOFLF.transaction<R>(func); }
+template<typename R, typename F> static R updateTx(F&& func) { return gOFLF.updateTx<R>(func); }
+template<typename R, typename F> static R readTx(F&& func) { return gOFLF.readTx<R>(func); }
 template<typename F> static void updateTx(F&& func) { gOFLF.transaction(func); }
 template<typename F> static void readTx(F&& func) { gOFLF.transaction(func); }
 template<typename T, typename... Args> T* tmNew(Args&&... args) { return OneFileLF::tmNew<T>(std::forward<Args>(args)...); }
@@ -16,6 +16,8 @@
 #include <type_traits>
 
 #include "common/pfences.h"
+#include "../PTMStats.hpp"
+#include "../TxResult.hpp"     // Needed by readTx<R>() and updateTx<R>()
 #include "common/ThreadRegistry.hpp"
 #include "common/CRWWP_SpinLock.hpp"
 
@@ -205,6 +207,13 @@ private:
         log_head->next = nullptr;
     }
 
+    // Number of entries in the log, used only by PTM_STATS_WRITE_SET()
+    inline uint64_t log_num_entries() const {
+        uint64_t n = 0;
+        for (LogChunk* chunk = log_head; chunk != nullptr; chunk = chunk->next) n += chunk->num_entries;
+        return n;
+    }
+
 
 public:
 
@@ -327,10 +336,12 @@ public:
             copyMainToBack();
             logEnabled = true;
         }
+        PTM_STATS_WRITE_SET(log_num_entries());
         clear_log();
         log_size = 0;
         PFENCE();
         per->state.store(IDLE, std::memory_order_relaxed);
+        PTM_STATS_TX_END();
     }
 
 
@@ -455,11 +466,13 @@ public:
             copyMainToBack();
             logEnabled = true;
         }
+        PTM_STATS_WRITE_SET(log_num_entries());
         clear_log();
         log_size = 0;
 
         PFENCE();
         per->state.store(IDLE, std::memory_order_relaxed);
+        PTM_STATS_TX_END();
         if(histoflag) histo[storecount]++;
         rwlock.exclusiveUnlock();
         --tl_nested_write_trans;
@@ -580,16 +593,18 @@ public:
     }
 
 
-    // TODO: Remove these two once we make CX have void transactions
+    // Transactions that return the value of func(), moved out to the caller after the commit
     template<typename R,class F>
     inline static R readTx(F&& func) {
-        gRomLog.ns_read_transaction([&]() {func();});
-        return R{};
+        ptmtx::TxResult<R> res;
+        gRomLog.ns_read_transaction([&]() {res.run(func);});
+        return res.take();
     }
     template<typename R,class F>
     inline static R updateTx(F&& func) {
-        gRomLog.ns_write_transaction([&]() {func();});
-        return R{};
+        ptmtx::TxResult<R> res;
+        gRomLog.ns_write_transaction([&]() {res.run(func);});
+        return res.take();
     }
 
 
@@ -718,6 +733,7 @@ struct persist {
         val = newVal;
         const uint8_t* valaddr = (uint8_t*)&val;
         if (valaddr >= g_main_addr && valaddr < g_main_addr+g_main_size) {
+            PTM_STATS_STORE(sizeof(T));
             //PWB(&val);
             gRomLog.add_to_log(&val,sizeof(T));
         }
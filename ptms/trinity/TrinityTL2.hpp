@@ -1,1096 +1,1813 @@
-/*
- * Copyright 2018-2020
- *   Andreia Correia <andreia.veiga@unine.ch>
- *   Pedro Ramalhete <pramalhe@gmail.com>
- *   Pascal Felber <pascal.felber@unine.ch>
- *
- * This work is published under the MIT license. See LICENSE.txt
- */
-#ifndef _TRINITY_TL2_PERSISTENT_TRANSACTIONAL_MEMORY_H_
-#define _TRINITY_TL2_PERSISTENT_TRANSACTIONAL_MEMORY_H_
-
-#include <atomic>
-#include <cassert>
-#include <functional>
-#include <cstring>
-#include <thread>       // Needed by this_thread::yield()
-#include <sys/mman.h>   // Needed if we use mmap()
-#include <sys/types.h>  // Needed by open() and close()
-#include <sys/stat.h>
-#include <linux/mman.h> // Needed by MAP_SHARED_VALIDATE
-#include <fcntl.h>
-#include <unistd.h>     // Needed by close()
-#include <type_traits>
-
-/*
- * <h1> Trinity + Persistent TL2 </h1>
- * See durable transactions paper
- *
- */
-
-
-// Macros needed for persistence
-#ifdef PWB_IS_CLFLUSH
-  /*
-   * More info at http://elixir.free-electrons.com/linux/latest/source/arch/x86/include/asm/special_insns.h#L213
-   * Intel programming manual at https://www.intel.com/content/dam/www/public/us/en/documents/manuals/64-ia-32-architectures-optimization-manual.pdf
-   * Use these for Broadwell CPUs (cervino server)
-   */
-  #define PWB(addr)              __asm__ volatile("clflush (%0)" :: "r" (addr) : "memory")                      // Broadwell only works with this.
-  #define PFENCE()               {}                                                                             // No ordering fences needed for CLFLUSH (section 7.4.6 of Intel manual)
-  #define PSYNC()                {}                                                                             // For durability it's not obvious, but CLFLUSH seems to be enough, and PMDK uses the same approach
-#elif PWB_IS_CLWB
-  /* Use this for CPUs that support clwb, such as the SkyLake SP series (c5 compute intensive instances in AWS are an example of it) */
-  #define PWB(addr)              __asm__ volatile(".byte 0x66; xsaveopt %0" : "+m" (*(volatile char *)(addr)))  // clwb() only for Ice Lake onwards
-  #define PFENCE()               __asm__ volatile("sfence" : : : "memory")
-  #define PSYNC()                __asm__ volatile("sfence" : : : "memory")
-#elif PWB_IS_NOP
-  /* pwbs are not needed for shared memory persistency (i.e. persistency across process failure) */
-  #define PWB(addr)              {}
-  #define PFENCE()               __asm__ volatile("sfence" : : : "memory")
-  #define PSYNC()                __asm__ volatile("sfence" : : : "memory")
-#elif PWB_IS_CLFLUSHOPT
-  /* Use this for CPUs that support clflushopt, which is most recent x86 */
-  #define PWB(addr)              __asm__ volatile(".byte 0x66; clflush %0" : "+m" (*(volatile char *)(addr)))    // clflushopt (Kaby Lake)
-  #define PFENCE()               __asm__ volatile("sfence" : : : "memory")
-  #define PSYNC()                __asm__ volatile("sfence" : : : "memory")
-#else
-#error "You must define what PWB is. Choose PWB_IS_CLFLUSHOPT if you don't know what your CPU is capable of"
-#endif
-
-
-namespace trinitytl2 {
-
-//
-// User configurable variables.
-// Feel free to change these if you need larger transactions, or more threads.
-//
-
-// Start address of persistent memory region
-#ifndef PM_REGION_BEGIN
-#define PM_REGION_BEGIN 0x7fea00000000
-#endif
-// Size of the persistent memory region
-#ifndef PM_REGION_SIZE
-#define PM_REGION_SIZE 1024*1024*1024ULL // 1GB for now
-#endif
-// Name of persistent file mapping (back)
-#ifndef PM_FILE_NAME
-#define PM_FILE_NAME   "/dev/shm/trinitytl2_shared"
-#endif
-
-// Maximum number of registered threads that can execute transactions
-static const int REGISTRY_MAX_THREADS = 128;
-// Maximum number of stores in the WriteSet per transaction
-static const uint64_t TX_MAX_STORES = 40*1024;
-// Maximum number of loads in one transaction
-static const uint64_t TX_MAX_LOADS = 1024*1024;
-
-// End address of mapped persistent memory
-static uint8_t* PM_REGION_END = ((uint8_t*)PM_REGION_BEGIN+PM_REGION_SIZE);
-// Maximum number of root pointers available for the user
-static const uint64_t MAX_ROOT_POINTERS = 64;
-
-// TL2 constants
-static const uint64_t LOCKED  = 0x8000000000000000ULL;
-static const int TX_IS_NONE   = 0;
-static const int TX_IS_READ   = 1;
-static const int TX_IS_UPDATE = 2;
-
-// Returns the cache line of the address (this is for x86 only)
-#define ADDR2CL(_addr) (uint8_t*)((size_t)(_addr) & (~63ULL))
-
-
-
-// A 'Locked-Sequence' is a uint64_t which has a sequence (56 bits) a thread-id (7 bits) and a lock/unlock state (1 bit)
-typedef uint64_t lseq_t;
-// Function that returns the tid of a p.seq. The lock+tid is the 8 highest bits of p.seq.
-inline static uint64_t lseq2tid(lseq_t lseq) { return (lseq >> (64-8)) & 0x7F; }
-// Returns the sequence in a lseq
-inline static uint64_t lseq2seq(lseq_t lseq) { return (lseq & 0xFFFFFFFFFFFFFFULL); }
-// Creates a new locked-sequence
-inline static lseq_t composeLseq(uint64_t lock, uint64_t tid, uint64_t seq) { return (lock | (tid << (64-8)) | seq); }
-// Helper functions
-inline static bool isLocked(uint64_t lseq) { return (lseq & LOCKED); }
-inline static bool isUnlocked(uint64_t lseq) { return !(lseq & LOCKED); }
-// Helper method: sl is unlocked and lower than the clock, or it's locked by me
-static inline bool isUnlockedOrLockedByMe(uint64_t rClock, uint64_t tid, uint64_t sl) {
-    return ( (isUnlocked(sl) && (lseq2seq(sl) <= rClock)) || (isLocked(sl) && lseq2tid(sl) == tid) );
-}
-
-
-//
-// Thread Registry stuff
-//
-extern void thread_registry_deregister_thread(const int tid);
-
-// An helper class to do the checkin and checkout of the thread registry
-struct ThreadCheckInCheckOut {
-    static const int NOT_ASSIGNED = -1;
-    int tid { NOT_ASSIGNED };
-    ~ThreadCheckInCheckOut() {
-        if (tid == NOT_ASSIGNED) return;
-        thread_registry_deregister_thread(tid);
-    }
-};
-
-extern thread_local ThreadCheckInCheckOut tl_tcico;
-
-// Forward declaration of global/singleton instance
-class ThreadRegistry;
-extern ThreadRegistry gThreadRegistry;
-
-/*
- * <h1> Registry for threads </h1>
- *
- * This is singleton type class that allows assignement of a unique id to each thread.
- * The first time a thread calls ThreadRegistry::getTID() it will allocate a free slot in 'usedTID[]'.
- * This tid wil be saved in a thread-local variable of the type ThreadCheckInCheckOut which
- * upon destruction of the thread will call the destructor of ThreadCheckInCheckOut and free the
- * corresponding slot to be used by a later thread.
- */
-class ThreadRegistry {
-private:
-    alignas(128) std::atomic<bool>      usedTID[REGISTRY_MAX_THREADS];   // Which TIDs are in use by threads
-    alignas(128) std::atomic<int>       maxTid {-1};                     // Highest TID (+1) in use by threads
-
-public:
-    ThreadRegistry() {
-        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
-            usedTID[it].store(false, std::memory_order_relaxed);
-        }
-    }
-
-    // Progress condition: wait-free bounded (by the number of threads)
-    int register_thread_new(void) {
-        for (int tid = 0; tid < REGISTRY_MAX_THREADS; tid++) {
-            if (usedTID[tid].load(std::memory_order_acquire)) continue;
-            bool unused = false;
-            if (!usedTID[tid].compare_exchange_strong(unused, true)) continue;
-            // Increase the current maximum to cover our thread id
-            int curMax = maxTid.load();
-            while (curMax <= tid) {
-                maxTid.compare_exchange_strong(curMax, tid+1);
-                curMax = maxTid.load();
-            }
-            tl_tcico.tid = tid;
-            return tid;
-        }
-        printf("ERROR: Too many threads, registry can only hold %d threads\n", REGISTRY_MAX_THREADS);
-        assert(false);
-    }
-
-    // Progress condition: wait-free population oblivious
-    inline void deregister_thread(const int tid) {
-        usedTID[tid].store(false, std::memory_order_release);
-    }
-
-    // Progress condition: wait-free population oblivious
-    static inline uint64_t getMaxThreads(void) {
-        return gThreadRegistry.maxTid.load(std::memory_order_acquire);
-    }
-
-    // Progress condition: wait-free bounded (by the number of threads)
-    static inline int getTID(void) {
-        int tid = tl_tcico.tid;
-        if (tid != ThreadCheckInCheckOut::NOT_ASSIGNED) return tid;
-        return gThreadRegistry.register_thread_new();
-    }
-};
-
-
-// T is typically a pointer to a node, but it can be integers or other stuff, as long as it fits in 64 bits
-template<typename T> struct persist {
-    // We mark these as 'volatile' to ensure that the stores are ordered
-    alignas(32) volatile uint64_t main;
-    volatile uint64_t             back;
-    std::atomic<lseq_t>           lseq;  // Lock plus sequence (for TL2 and Trinity)
-    uint64_t                      pad;
-
-    persist() { }
-
-    persist(T initVal) { pstore(initVal); }
-
-    // Casting operator
-    operator T() { return pload(); }
-    // Casting to const
-    operator T() const { return pload(); }
-
-    // Prefix increment operator: ++x
-    void operator++ () { pstore(pload()+1); }
-    // Prefix decrement operator: --x
-    void operator-- () { pstore(pload()-1); }
-    void operator++ (int) { pstore(pload()+1); }
-    void operator-- (int) { pstore(pload()-1); }
-    persist<T>& operator+= (const T& rhs) { pstore(pload() + rhs); return *this; }
-    persist<T>& operator-= (const T& rhs) { pstore(pload() - rhs); return *this; }
-
-    // Equals operator
-    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
-    bool operator == (const persist<Y> &rhs) { return pload() == rhs; }
-    // Difference operator: first downcast to T and then compare
-    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
-    bool operator != (const persist<Y> &rhs) { return pload() != rhs; }
-    // Relational operators
-    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
-    bool operator < (const persist<Y> &rhs) { return pload() < rhs; }
-    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
-    bool operator > (const persist<Y> &rhs) { return pload() > rhs; }
-    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
-    bool operator <= (const persist<Y> &rhs) { return pload() <= rhs; }
-    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
-    bool operator >= (const persist<Y> &rhs) { return pload() >= rhs; }
-
-    // Operator arrow ->
-    T operator->() { return pload(); }
-
-    // Copy constructor
-    persist<T>(const persist<T>& other) { pstore(other.pload()); }
-
-    // Assignment operator from a persist<T>
-    persist<T>& operator=(const persist<T>& other) {
-        pstore(other.pload());
-        return *this;
-    }
-
-    // Assignment operator from a value
-    persist<T>& operator=(T value) {
-        pstore(value);
-        return *this;
-    }
-
-    // Operator &
-    T* operator&() {
-        return (T*)this;
-    }
-
-    // Methods that are defined later because they have compilation dependencies
-    inline T pload() const;
-    inline void pstore(T newVal);
-};
-
-
-/*
- * EsLocoTu? is an Extremely Simple memory aLOCatOr Two
- *
- * It is based on intrusive singly-linked stacks (a free-list), one for each power of two size.
- * All blocks are powers of two, the smallest size enough to contain the desired user data plus the block header.
- * There is an array named 'freelists' where each entry is a pointer to the head of a stack for that respective block size.
- * Blocks are allocated in powers of 2 of words (64bit words).
- * Each block has an header with two words: the size of the node (in words), the pointer to the next node.
- * The minimum block size is 4 words, with 2 for the header and 2 for the user.
- * When there is no suitable block in the freelist, it will create a new block from the remaining pool.
- *
- * EsLoco was designed for usage in PTMs but it doesn't have to be used only for that.
- * EsLocoTu scales while EsLoco does not.
- * Average number of stores for an allocation is 1.
- * Average number of stores for a de-allocation is 2.
- *
- * Memory layout:
- * ---------------------------------------------------------------------------------------------------
- * | poolTop | gfreelists[0..50] | threadflists[0..REGISTRY_MAX_THREADS] | ... allocated objects ... |
- * ---------------------------------------------------------------------------------------------------
- */
-template <template <typename> class P>
-class EsLoco2 {
-private:
-    const bool debugOn = false;
-    // Number of blocks in the freelists array.
-    // Each entry corresponds to an exponent of the block size: 2^4, 2^5, 2^6... 2^40
-    static const int kMaxBlockSize = 50; // 1024 TB of memory should be enough
-    // Size after which we trigger a cleanup of the thread-local list/pool
-    static const uint64_t kMaxListSize = 64;
-    // Size of a thread-local slab (in bytes). When it runs out, we take another slab from poolTop.
-    // Larger allocations go directly on poolTop which means doing a lot of large allocations from
-    // multiple threads will result in contention.
-    static const uint64_t kSlabSize = 4*1024*1024;
-
-    struct block {
-        P<block*>   next;   // Pointer to next block in free-list (when block is in free-list)
-        P<uint64_t> size2;   // Exponent of power of two of the size of this block in bytes.
-    };
-
-    // A persistent free-list of blocks
-    struct FList {
-        P<uint64_t> count;   // Number of blocks in the stack
-        P<block*>   head;    // Head of the stack (where we push and pop)
-        P<block*>   tail;    // Tail of the stack (used for faster transfers to/from gflist)
-
-        // Push a block into this free list, incrementing the volatile
-        // counter and adjusting the tail if needed. Does two pstores min.
-        void pushBlock(block* myblock) {
-            block* lhead = head;
-            if (lhead == nullptr) {
-                assert(count == 0);
-                tail = myblock;                    // pstore()
-            }
-            myblock->next = lhead;                 // pstore()
-            head = myblock;                        // pstore()
-            count++;
-        }
-
-        // Pops a block from a given (persistent) free list, decrementing the
-        // volatile counter and setting the tail to nullptr if list becomes empty.
-        // Does 2 pstores.
-        block* popBlock(void) {
-            assert(count != 0);
-            assert(tail != nullptr);
-            count--;
-            block* myblock = head;
-            head = myblock->next;                // pstore()
-            if (head == nullptr) tail = nullptr; // pstore()
-            return myblock;
-        }
-
-        bool isFull(void) { return (count >= kMaxListSize); }
-        bool isEmpty() { return (count == 0); }
-
-        // Transfer this list to another free-list (oflist).
-        // We use this method to transfer from the thread-local list to the global list.
-        void transfer(FList* oflist) {
-            assert(count != 0);
-            assert(tail != nullptr);
-            if (oflist->tail == nullptr) {
-                assert (oflist->head == nullptr);
-                oflist->tail = tail;                           // pstore()
-            }
-            tail->next = oflist->head;                         // pstore()
-            oflist->head = head;                               // pstore()
-            oflist->count += count;                            // pstore()
-            count = 0;                                         // pstore()
-            tail = nullptr;                                    // pstore()
-            head = nullptr;                                    // pstore()
-        }
-    };
-
-    // To avoid false sharing and lock conflicts, we put each thread-local data in one of these.
-    // This is persistent (in PM).
-    struct TLData {
-        uint64_t     padding[8];
-        // Thread-local array of persistent heads of free-list
-        FList        tflists[kMaxBlockSize];
-        // Thread-local slab pointer
-        P<uint8_t*>  slabtop;
-        // Thread-loal slab size
-        P<uint64_t>  slabsize;
-        TLData() {
-            for (int i = 0; i < kMaxBlockSize; i++) {
-                tflists[i].count = 0;             // pstore()
-                tflists[i].head = nullptr;        // pstore()
-                tflists[i].tail = nullptr;        // pstore()
-            }
-            slabtop = nullptr;                    // pstore()
-            slabsize = 0;                         // pstore()
-        }
-    };
-
-    // Complete metadata. This is PM
-    struct ELMetadata {
-        P<uint8_t*> top;
-        FList       gflists[kMaxBlockSize];
-        TLData      tldata[REGISTRY_MAX_THREADS];
-        // This constructor should be called from within a transaction
-        ELMetadata() {
-            // The 'top' starts after the metadata header
-            top = ((uint8_t*)this) + sizeof(ELMetadata);         // pstore()
-            for (int i = 0; i < kMaxBlockSize; i++) {
-                gflists[i].count = 0;             // pstore()
-                gflists[i].head = nullptr;        // pstore()
-                gflists[i].tail = nullptr;        // pstore()
-            }
-            for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
-                new (&tldata[it]) TLData();                      // pstores()
-            }
-        }
-    };
-
-    // Volatile data
-    uint8_t* poolAddr {nullptr};
-    uint64_t poolSize {0};
-
-    // Pointer to location of PM metadata of EsLoco
-    ELMetadata* meta {nullptr};
-
-
-    // For powers of 2, returns the highest bit, otherwise, returns the next highest bit
-    uint64_t highestBit(uint64_t val) {
-        uint64_t b = 0;
-        while ((val >> (b+1)) != 0) b++;
-        if (val > (1ULL << b)) return b+1;
-        return b;
-    }
-
-    uint8_t* aligned(uint8_t* addr) {
-        return (uint8_t*)((size_t)addr & (~0x3FULL)) + 128;
-    }
-
-
-public:
-    void init(void* addressOfMemoryPool, size_t sizeOfMemoryPool, bool clearPool=true) {
-        // Align the base address of the memory pool
-        poolAddr = aligned((uint8_t*)addressOfMemoryPool);
-        poolSize = sizeOfMemoryPool + (uint8_t*)addressOfMemoryPool - poolAddr;
-        // The first thing in the pool is the ELMetadata
-        meta = (ELMetadata*)poolAddr;
-        if (clearPool) new (meta) ELMetadata();
-        if (debugOn) printf("Starting EsLoco2 with poolAddr=%p and poolSize=%ld, up to %p\n", poolAddr, poolSize, poolAddr+poolSize);
-    }
-
-    // Resets the metadata of the allocator back to its defaults
-    void reset() {
-        std::memset(poolAddr, 0, sizeof(block)*kMaxBlockSize*(REGISTRY_MAX_THREADS+1));
-        meta->top.pstore(nullptr);
-    }
-
-    // Returns the number of bytes that may (or may not) have allocated objects, from the base address to the top address
-    uint64_t getUsedSize() {
-        return meta->top.pload() - poolAddr;
-    }
-
-    // Takes the desired size of the object in bytes.
-    // Returns pointer to memory in pool, or nullptr.
-    // Does on average 1 store to persistent memory when re-utilizing blocks.
-    void* malloc(size_t size) {
-        const int tid = ThreadRegistry::getTID();
-        // Adjust size to nearest (highest) power of 2
-        uint64_t bsize = highestBit(size + sizeof(block));
-        uint64_t asize = (1ULL << bsize);
-        if (debugOn) printf("malloc(%ld) requested,  block size exponent = %ld\n", size, bsize);
-        block* myblock = nullptr;
-        // Check if there is a block of that size in the corresponding freelist
-        if (!meta->tldata[tid].tflists[bsize].isEmpty()) {
-            if (debugOn) printf("Found available block in thread-local freelist\n");
-            myblock = meta->tldata[tid].tflists[bsize].popBlock();
-        } else if (asize < kSlabSize/2) {
-            // Allocations larger than kSlabSize/2 go on the global top
-            if (asize >= meta->tldata[tid].slabsize.pload()) {
-                if (debugOn) printf("Not enough space on current slab of thread %d for %ld bytes. Taking new slab from top\n",tid, asize);
-                // Not enough space for allocation. Take a new slab from the global top and
-                // discard the old one. This means fragmentation/leak is at most kSlabSize/2.
-                if (meta->top.pload() + kSlabSize > poolSize + poolAddr) {
-                    printf("EsLoco2: Out of memory for slab %ld for %ld bytes allocation\n", kSlabSize, size);
-                    return nullptr;
-                }
-                meta->tldata[tid].slabtop = meta->top.pload();   // pstore()
-                meta->tldata[tid].slabsize = kSlabSize;          // pstore()
-                meta->top.pstore(meta->top.pload() + kSlabSize); // pstore()
-                // TODO: add the remains of the slab to thread-local freelist
-            }
-            // Take space from the slab
-            myblock = (block*)meta->tldata[tid].slabtop.pload();
-            myblock->size2 = bsize;                                       // pstore()
-            meta->tldata[tid].slabtop.pstore((uint8_t*)myblock + asize); // pstore()
-            meta->tldata[tid].slabsize -= asize;                         // pstore()
-        } else if (!meta->gflists[bsize].isEmpty()) {
-            if (debugOn) printf("Found available block in thread-global freelist\n");
-            myblock = meta->gflists[bsize].popBlock();
-        } else {
-            if (debugOn) printf("Creating new block from top, currently at %p\n", meta->top.pload());
-            // Couldn't find a suitable block, get one from the top of the pool if there is one available
-            if (meta->top.pload() + asize > poolSize + poolAddr) {
-                printf("EsLoco2: Out of memory for %ld bytes allocation\n", size);
-                return nullptr;
-            }
-            myblock = (block*)meta->top.pload();
-            meta->top.pstore(meta->top.pload() + asize);                 // pstore()
-            myblock->size2 = bsize;                                       // pstore()
-        }
-        if (debugOn) printf("returning ptr = %p\n", (void*)((uint8_t*)myblock + sizeof(block)));
-        //printf("malloc(%ld) = %p\n", asize, (void*)((uint8_t*)myblock + sizeof(block)));
-        // Return the block, minus the header
-        return (void*)((uint8_t*)myblock + sizeof(block));
-    }
-
-    // Takes a pointer to an object and puts the block on the free-list.
-    // When the thread-local freelist becomes too large, all blocks are moved to the thread-global free-list.
-    // Does on average 2 stores to persistent memory.
-    void free(void* ptr) {
-        //printf("free(%p)\n", ptr);
-        if (ptr == nullptr) return;
-        const int tid = ThreadRegistry::getTID();
-        block* myblock = (block*)((uint8_t*)ptr - sizeof(block));
-        if (debugOn) printf("free(%p)  block size exponent = %ld\n", ptr, myblock->size2.pload());
-        // Insert the block in the corresponding freelist
-        uint64_t bsize = myblock->size2;
-        meta->tldata[tid].tflists[bsize].pushBlock(myblock);
-        if (meta->tldata[tid].tflists[bsize].isFull()) {
-            if (debugOn) printf("Moving thread-local flist for bsize=%ld to thread-global flist\n", bsize);
-            // Move all objects in the thread-local list to the corresponding thread-global list
-            meta->tldata[tid].tflists[bsize].transfer(&meta->gflists[bsize]);
-        }
-    }
-};
-
-
-// Needed by our benchmarks
-struct tmbase {
-};
-
-
-struct ReadSet {
-    std::atomic<uint64_t>*  log[TX_MAX_LOADS];
-    uint64_t                size {0};          // Number of loads in the readSet for the current transaction
-
-    inline bool validate(uint64_t rClock, uint64_t tid) {
-        for (uint64_t i = 0; i < size; i++) {
-            uint64_t sl = log[i]->load(std::memory_order_acquire);
-            if (!isUnlockedOrLockedByMe(rClock, tid, sl)) return false;
-        }
-        return true;
-    }
-
-    inline void add(std::atomic<uint64_t>* mutex) {
-        log[size++] = mutex;
-        assert (size != TX_MAX_LOADS);
-    }
-};
-
-// Size of an Optane block in 64bit words. Used to prevent "false sharing".
-#define PM_PAD  (256/sizeof(uint64_t))
-
-// The persistent metadata is a 'header'.
-struct PMetadata {
-    static const uint64_t   MAGIC_ID = 0x1337bab4;
-    void*                   root {nullptr}; // Immutable once assigned
-    uint64_t                id {0};
-    uint64_t                padding[8-2];
-    // Each thread has its own p_seq
-    volatile uint64_t       p_seq[REGISTRY_MAX_THREADS*PM_PAD];
-    PMetadata() {
-        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
-            p_seq[it*PM_PAD] = 1;
-            PWB(&p_seq[it*PM_PAD]);
-        }
-    }
-};
-
-// Address of Persistent Metadata.
-// This relies on PMetadata being the first thing in the persistent region.
-static PMetadata* const pmd = (PMetadata*)PM_REGION_BEGIN;
-
-// Used to identify aborted transactions
-struct AbortedTx {};
-static constexpr AbortedTx AbortedTxException {};
-
-// Volatile log (write-set)
-// One day in the future, if we want to suport large transactions we can make this a dynamic array.
-struct AppendLog {
-    static const uint64_t CHUNK_SIZE = 16*1024*1024ULL; // Maximum transaction size (in number of modified persist<T>)
-    uint64_t   size {0};
-    void**     addr;
-    AppendLog* next {nullptr};
-
-    AppendLog() {
-        addr = new void*[CHUNK_SIZE];
-    }
-    ~AppendLog() {
-        delete[] addr;
-    }
-
-    inline void add(void* ptr) {
-        addr[size++] = ptr;
-        assert (size != CHUNK_SIZE);
-    }
-
-    // Apply all the modifications on each back.
-    inline void applyOnBack() {
-        for (uint64_t i = 0; i < size; i++) {
-            persist<uint64_t>* p = (persist<uint64_t>*)addr[i];
-            p->back = p->main;
-        }
-    }
-
-    // Rollback modifications: called from abortTx() to revert changes.
-    inline void rollbackMain() {
-        for (uint64_t i = 0; i < size; i++) {
-            persist<uint64_t>* p = (persist<uint64_t>*)addr[i];
-            p->main = p->back;
-        }
-    }
-
-    // Unlock the lseq in all persist
-    inline void unlock(uint64_t nextClock, uint64_t tid) {
-        for (uint64_t i = 0; i < size; i++) {
-            persist<uint64_t>* p = (persist<uint64_t>*)addr[i];
-            p->lseq.store(composeLseq(0,tid,nextClock), std::memory_order_release);
-            // We don't really need to flush, but let's do it anyways: it's faster than
-            // letting the cache coherence system do it for us.
-            //PWB(p);
-        }
-        // No need for fence, flushing is just to improve performance
-    }
-
-    // TODO: fine tune this to see if it really is an optimization in all cases
-    inline void flushPWB() {
-        // If we have more than 16 modified persist<T>, we just flush all, otherwise,
-        // we try to group per cache line, in the hopes of saving a couple of PWB().
-        if (size > 16) {
-            for (uint64_t i = 0; i < size; i++) PWB(addr[i]);
-        } else {
-            for (uint64_t i = 0; i < size; i++) {
-                // Check if we already flushed this cache line
-                const void* addr_i_cl = ADDR2CL(addr[i]);
-                bool flushit = true;
-                for (uint64_t j = 0; j < i; j++) {
-                    if (ADDR2CL(addr[j]) == addr_i_cl) {
-                        flushit = false;
-                        break;
-                    }
-                }
-                if (flushit) PWB(addr[i]);
-            }
-        }
-    }
-};
-
-
-// Thread-local data
-struct OpData {
-    uint64_t              tid;
-    uint64_t              rClock {0};
-    int                   tx_type {TX_IS_NONE}; // This is used by persist::load() to figure out if it needs to save a load on the read-set or not
-    ReadSet               readSet;              // The (volatile) read set
-    AppendLog             v_log {};             // Write-set: The append-only log of modified persist<T>
-    uint64_t              nestedTrans {0};      // Number of nested transactions
-    uint64_t              myrand;
-    uint64_t              numAborts {0};
-    uint64_t              numCommits {0};
-    uint64_t              padding[16];
-};
-
-// This is used by addToLog() to know which OpData instance to use for the current transaction
-extern thread_local OpData* tl_opdata;
-
-class Trinity;
-extern Trinity gTrinity;
-
-
-class Trinity {
-private:
-    // Padding on x86 should be on 2 cache lines
-    static const int                       CLPAD = 128/sizeof(uintptr_t);
-    bool                                   reuseRegion {false};                 // used by the constructor and initialization
-    int                                    pfd {-1};
-    alignas(128) std::atomic<uint64_t>     gClock {1};
-    alignas(128) OpData                   *opDesc;
-    EsLoco2<persist>                       esloco {};
-
-public:
-    struct tmbase : public trinitytl2::tmbase { };
-
-    Trinity() {
-        opDesc = new OpData[REGISTRY_MAX_THREADS];
-        for (uint64_t it=0; it < REGISTRY_MAX_THREADS; it++) {
-            opDesc[it].tid = it;
-            opDesc[it].myrand = (it+1)*12345678901234567ULL;
-        }
-        mapPersistentRegion(PM_FILE_NAME, (uint8_t*)PM_REGION_BEGIN, PM_REGION_SIZE);
-    }
-
-    ~Trinity() {
-        uint64_t totalAborts = 0;
-        uint64_t totalCommits = 0;
-        for (int it=0; it < REGISTRY_MAX_THREADS; it++) {
-            totalAborts += opDesc[it].numAborts;
-            totalCommits += opDesc[it].numCommits;
-        }
-        printf("totalAborts=%ld  totalCommits=%ld  abortRatio=%.1f%% \n", totalAborts, totalCommits, 100.*totalAborts/(1+totalCommits));
-        delete[] opDesc;
-    }
-
-    static std::string className() { return "Trinity-TL2"; }
-
-    void mapPersistentRegion(const char* filename, uint8_t* regionAddr, const uint64_t regionSize) {
-        // Check that the header with the logs leaves at least half the memory available to the user
-        if (sizeof(PMetadata) > regionSize/2) {
-            printf("ERROR: the size of the header in persistent memory is so large that it takes more than half the whole persistent memory\n");
-            printf("Please reduce some of the settings in TrinityTL2.hpp and try again\n");
-            assert(false);
-        }
-        // Check if the file already exists or not
-        struct stat buf;
-        if (stat(filename, &buf) == 0) {
-            // File exists
-            pfd = open(filename, O_RDWR|O_CREAT, 0755);
-            assert(pfd >= 0);
-            reuseRegion = true;
-        } else {
-            // File doesn't exist
-            pfd = open(filename, O_RDWR|O_CREAT, 0755);
-            assert(pfd >= 0);
-            if (lseek(pfd, regionSize-1, SEEK_SET) == -1) {
-                perror("lseek() error");
-            }
-            if (write(pfd, "", 1) == -1) {
-                perror("write() error");
-            }
-        }
-        // Try one time to mmap() with DAX. If it fails due to MAP_FAILED, then retry without DAX.
-        // We may fail because the address is not available. Retry at most 4 times, then give up.
-        uint64_t dax_flag = MAP_SYNC;
-        void* got_addr = NULL;
-        for (int i = 0; i < 4; i++) {
-            got_addr = mmap(regionAddr, regionSize, (PROT_READ | PROT_WRITE), MAP_SHARED_VALIDATE | dax_flag, pfd, 0);
-            if (got_addr == regionAddr) {
-                if (dax_flag == 0) printf("WARNING: running without DAX enabled\n");
-                break;
-            }
-            if (got_addr == MAP_FAILED) {
-                // Failed to mmap(). Let's try without DAX.
-                dax_flag = 0;
-            } else {
-                // mmap() worked but in wrong address. Let's unmap() and try again.
-                munmap(got_addr, regionSize);
-                // Sleep for a second before retrying the mmap()
-                usleep(1000);
-            }
-        }
-        if (got_addr == MAP_FAILED) {
-            perror("ERROR: mmap() returned MAP_FAILED !!! ");
-            assert(false);
-        }
-        if (got_addr != regionAddr) {
-            printf("got_addr = %p instead of %p\n", got_addr, regionAddr);
-            perror("Retry mmap() in a couple of seconds");
-            std::exit(42);
-        }
-        // If the file has just been created or if the header is not consistent, clear everything.
-        // Otherwise, re-use and recover to a consistent state.
-        if (reuseRegion) {
-            recover();
-            readTx([&]{
-            	esloco.init(regionAddr+sizeof(PMetadata), regionSize-sizeof(PMetadata), false);
-            });
-        } else {
-            new (regionAddr) PMetadata();
-            // We reset the entire memory region because the 'lseq' have to be zero
-            resetPM(regionAddr, regionSize);
-            updateTx([&]{
-            	esloco.init(regionAddr+sizeof(PMetadata), regionSize-sizeof(PMetadata), true);
-            	pmd->root = esloco.malloc(sizeof(persist<void*>)*MAX_ROOT_POINTERS);
-            });
-            PWB(&pmd->root);
-            PFENCE();
-            pmd->id = PMetadata::MAGIC_ID;
-            PWB(&pmd->id);
-            PFENCE();
-        }
-    }
-
-    // This is equivalent to
-    // std:memset(regionAddr+sizeof(PMetadata), 0, regionSize-sizeof(PMetadata));
-    void resetPM(uint8_t* regionAddr, const uint64_t regionSize) {
-        // TODO: we can optimize by doing a memcmp() first, block by block
-        if (regionSize > 4*1024*1024*1024ULL) printf("memset() on large PM region. This will take a while...\n");
-        const uint64_t kPageSize = 4*1024*1024; // 4 MB pages
-        uint8_t* zpage = new uint8_t[kPageSize];
-        std::memset(zpage, 0, kPageSize);
-        uint8_t* page = regionAddr + sizeof(PMetadata);
-        uint8_t* end = regionAddr + regionSize;
-        std:memset(page, 0, ((uint64_t)page) % kPageSize);
-        while (page+kPageSize < end) {
-            if (!std::memcmp(page, zpage, kPageSize)) std::memset(page, 0, kPageSize);
-            page += kPageSize;
-        }
-        // TODO: last section
-        delete[] zpage;
-    }
-
-    inline void beginTx(OpData* myd, const int tid) {
-        // Clear the logs of the previous transaction
-        myd->v_log.size = 0;
-        myd->readSet.size = 0;
-        myd->rClock = gClock.load(); // This is GVRead()
-        if (myd->tx_type == TX_IS_UPDATE) {
-            pmd->p_seq[tid*PM_PAD] = myd->rClock;
-            PWB(&pmd->p_seq[tid*PM_PAD]);
-            // No need for pfence because the first pstore() will issue a CAS
-        }
-    }
-
-    // This PTM uses redo-log with eager locking, which means that by now all locks have been acquired.
-    inline bool endTx(OpData* myd, const int tid) {
-        // Check if this is a read-only transaction and if so, commit immediately
-        if (myd->v_log.size == 0) return true;
-        // This fence is needed by undo log to prevent re-ordering with the last store
-        // and the reading of the gClock.
-        std::atomic_thread_fence(std::memory_order_seq_cst);
-        // Validate the read-set
-        if (!myd->readSet.validate(myd->rClock, tid)) {
-            abortTx(myd, tid);
-            return false;
-        }
-        // Flush seq+main modifications
-        myd->v_log.flushPWB();
-        // The FAA is 'hijacked' to act as a persistence fence
-        uint64_t nextClock = gClock.fetch_add(1)+1;
-        // Modifications in persist<T> must be flushed before advancing p_seq
-        pmd->p_seq[tid*PM_PAD] = nextClock;
-        PWB(&pmd->p_seq[tid*PM_PAD]);
-        PSYNC();
-        // Apply modifications on back
-        myd->v_log.applyOnBack();
-        // Unlock and set new sequence and flush them (no fence needed)
-        myd->v_log.unlock(nextClock, tid);
-        myd->numCommits++;
-        return true;
-    }
-
-    // This is called only from persist::load()/store() and endTx() if the read-set validation fails.
-    inline void abortTx(OpData* myd, const int tid) {
-        // Rollback modifications and flush them
-        myd->v_log.rollbackMain();
-        myd->v_log.flushPWB();
-        // The FAA acts a PFENCE() and seq-cst fence
-        uint64_t nextClock = gClock.fetch_add(1)+1;
-        pmd->p_seq[tid*PM_PAD] = nextClock;
-        PWB(&pmd->p_seq[tid*PM_PAD]);
-        PFENCE();                               // Modifications in persist<T> are done before incrementing p_seq
-        // Unlock and set new sequence and flush them (no fence needed)
-        myd->v_log.unlock(nextClock, tid);
-        myd->numAborts++;
-    }
-
-    template<typename F> void transaction(F&& func, int txType=TX_IS_UPDATE) {
-        const int tid = ThreadRegistry::getTID();
-        OpData* myd = &opDesc[tid];
-        if (myd->nestedTrans > 0) {
-            func();
-            return ;
-        }
-        tl_opdata = myd;
-        myd->tx_type = txType;
-        ++myd->nestedTrans;
-        for (uint64_t attempt = 0; ; attempt++) {
-            backoff(myd, attempt);
-            beginTx(myd, tid);
-            try {
-                func();
-            } catch (AbortedTx&) {
-                abortTx(myd, tid);
-                continue;
-            }
-            if (endTx(myd, tid)) break;
-        }
-        tl_opdata = nullptr;
-        --myd->nestedTrans;
-    }
-
-    // It's silly that these have to be static, but we need them for the (SPS) benchmarks due to templatization
-    //template<typename R, typename F> static R updateTx(F&& func) { return gTrinity.transaction<R>(func, TX_IS_UPDATE); }
-    //template<typename R, typename F> static R readTx(F&& func) { return gTrinity.transaction<R>(func, TX_IS_READ); }
-    template<typename F> static void updateTx(F&& func) { gTrinity.transaction(func, TX_IS_UPDATE); }
-    template<typename F> static void readTx(F&& func) { gTrinity.transaction(func, TX_IS_READ); }
-    // There are no sequential durable transactions in TL2 but we "emulate it" with a concurrent+durable tx
-    template<typename F> static void updateTxSeq(F&& func) { gTrinity.transaction(func, TX_IS_UPDATE); }
-    template<typename F> static void readTxSeq(F&& func) { gTrinity.transaction(func, TX_IS_READ); }
-
-
-    // Scan the PM for any persist<> with a sequence equal to p_seq.
-    // If there are any, revert them by copying back to main and resetting
-    // the seq to zero.
-    //
-    // If p_seq == seq+1 then copy back to main
-    // If p_seq == seq   then copy main to back
-    void recover() {
-        // The persists start after PMetadata
-        persist<uint64_t>* pstart = (persist<uint64_t>*)(PM_REGION_BEGIN + sizeof(PMetadata));
-        persist<uint64_t>* pend = (persist<uint64_t>*)(PM_REGION_BEGIN + PM_REGION_SIZE);
-        persist<uint64_t>* p; // iterator variable
-        for (p = pstart; p < pend; p++) {
-            const lseq_t lseq = p->lseq.load(std::memory_order_relaxed);
-        	if (isUnlocked(lseq)) continue;
-        	const uint64_t tid = lseq2tid(lseq);
-            if (lseq2seq(lseq) == pmd->p_seq[tid*PM_PAD]) {
-                p->main = p->back;    // ordered store
-            } else {
-                p->back = p->main;    // ordered store
-            }
-            p->lseq = 0;              // ordered store
-            PWB(p);
-        }
-        PSYNC();
-        // The global clock must be equal to the highest of the p_seqs
-        uint64_t maxClock = 0;
-        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
-            if (pmd->p_seq[it*PM_PAD] > maxClock) maxClock = pmd->p_seq[it*PM_PAD];
-        }
-        gClock.store(maxClock);
-    }
-
-    // Random number generator used by the backoff scheme
-    inline uint64_t marsagliaXORV(uint64_t x) {
-        if (x == 0) x = 1;
-        x ^= x << 6;
-        x ^= x >> 21;
-        x ^= x << 7;
-        return x;
-    }
-
-    // Backoff for a random amount of steps in the range [16, 16*attempt]. Inspired by TL2
-    inline void backoff(OpData* myopd, uint64_t attempt) {
-        if (attempt < 3) return;
-        if (attempt == 10000) printf("Ooops, looks like we're stuck attempt=%ld\n", attempt);
-        myopd->myrand = marsagliaXORV(myopd->myrand);
-        uint64_t stall = (myopd->myrand & attempt) + 1;
-        stall *= 16;
-        std::atomic<uint64_t> iter {0};
-        while (iter.load() < stall) iter.fetch_add(1);
-        if (stall > 1000) std::this_thread::yield();
-    }
-
-    // TODO: Remove these two once we make CX have void transactions
-    template<typename R,class F> inline static R readTx(F&& func) {
-        gTrinity.transaction([&]() {func();}, TX_IS_READ);
-        return R{};
-    }
-    template<typename R,class F> inline static R updateTx(F&& func) {
-        gTrinity.transaction([&]() {func();}, TX_IS_UPDATE);
-        return R{};
-    }
-
-    template <typename T, typename... Args> static T* tmNew(Args&&... args) {
-        OpData* const myd = tl_opdata;
-        if (myd->nestedTrans == 0) {
-            printf("ERROR: Can not allocate outside a transaction\n");
-            return nullptr;
-        }
-        void* ptr = gTrinity.esloco.malloc(sizeof(T));
-        // If we get nullptr then we've ran out of PM space
-        assert(ptr != nullptr);
-        // If there is an abort during the 'new placement', the transactions rolls
-        // back and will automatically revert the changes in the allocator metadata.
-        new (ptr) T(std::forward<Args>(args)...);  // new placement
-        return (T*)ptr;
-    }
-
-    template<typename T> static void tmDelete(T* obj) {
-        if (obj == nullptr) return;
-        OpData* const myd = tl_opdata;
-        if (myd->nestedTrans == 0) {
-            printf("ERROR: Can not de-allocate outside a transaction\n");
-            return;
-        }
-        obj->~T();
-        gTrinity.esloco.free(obj);
-    }
-
-    static void* tmMalloc(size_t size) {
-        OpData* const myopd = tl_opdata;
-        if (myopd->nestedTrans == 0) {
-            printf("ERROR: Can not allocate outside a transaction\n");
-            return nullptr;
-        }
-        void* obj = gTrinity.esloco.malloc(size);
-        return obj;
-    }
-
-    static void tmFree(void* obj) {
-        if (obj == nullptr) return;
-        OpData* const myopd = tl_opdata;
-        if (myopd->nestedTrans == 0) {
-            printf("ERROR: Can not de-allocate outside a transaction\n");
-            return;
-        }
-        gTrinity.esloco.free(obj);
-    }
-
-    static void* pmalloc(size_t size) {
-        OpData* const myopd = tl_opdata;
-        if (myopd->nestedTrans == 0) {
-            printf("ERROR: Can not allocate outside a transaction\n");
-            return nullptr;
-        }
-        return gTrinity.esloco.malloc(size);
-    }
-
-    static void pfree(void* obj) {
-        if (obj == nullptr) return;
-        OpData* const myopd = tl_opdata;
-        if (myopd->nestedTrans == 0) {
-            printf("ERROR: Can not de-allocate outside a transaction\n");
-            return;
-        }
-        gTrinity.esloco.free(obj);
-    }
-
-    // Get a root pointer
-    static inline void* get_object(int idx) {
-        return ((persist<void*>*)pmd->root)[idx].pload();
-    }
-
-    // Set a root pointer
-    static inline void put_object(int idx, void* obj) {
-        ((persist<void*>*)pmd->root)[idx].pstore(obj);
-    }
-};
-
-
-// Store interposing: acquire the lock and write in 'main'
-template<typename T> inline void persist<T>::pstore(T newVal) {
-    OpData* const myd = tl_opdata;
-    const uint8_t* valaddr = (uint8_t*)this;
-    // Do not log nor lock this store unless it's in the memory region and we're in a transaction
-    if (myd == nullptr || valaddr < (uint8_t*)PM_REGION_BEGIN || valaddr > PM_REGION_END) {
-        main = (uint64_t)newVal;
-        return;
-    }
-    lseq_t sl = lseq.load(std::memory_order_acquire);
-    if (isUnlockedOrLockedByMe(myd->rClock, myd->tid, sl)) {
-    	const uint64_t p_seq = pmd->p_seq[myd->tid*PM_PAD];
-        if ((sl & LOCKED) || lseq.compare_exchange_strong(sl, composeLseq(LOCKED, myd->tid, p_seq))) {
-            // If it's the first time we touch this persist<T> in this tx: log it.
-            if (isUnlocked(sl)) myd->v_log.add(this);
-            main = (uint64_t)newVal;
-            return;
-        }
-    }
-    throw AbortedTxException;
-}
-
-// This is similar to an undo-log load interposing: do single check
-template<typename T> inline T persist<T>::pload() const {
-    OpData* const myd = tl_opdata;
-    // Check if we're outside a transaction
-    if (myd == nullptr) return (T)main;
-    uint64_t lval = main;
-    lseq_t sl = lseq.load(std::memory_order_acquire);
-    if (!isUnlockedOrLockedByMe(myd->rClock, myd->tid, sl)) throw AbortedTxException;
-    // When in a write tx, loads must be added to the read-set
-    if (myd->tx_type == TX_IS_UPDATE && isUnlocked(sl)) myd->readSet.add((std::atomic<uint64_t>*)&lseq);
-    return (T)lval;
-}
-
-
-//
-// Wrapper methods to the global TM instance. The user should use these:
-//
-template<typename R, typename F> static R updateTx(F&& func) { return gTrinity.transaction<R>(func, TX_IS_UPDATE); }
-template<typename R, typename F> static R readTx(F&& func) { return gTrinity.transaction<R>(func, TX_IS_READ); }
-template<typename F> static void updateTx(F&& func) { gTrinity.transaction(func, TX_IS_UPDATE); }
-template<typename F> static void readTx(F&& func) { gTrinity.transaction(func, TX_IS_READ); }
-template<typename T, typename... Args> T* tmNew(Args&&... args) { return Trinity::tmNew<T>(args...); }
-template<typename T> void tmDelete(T* obj) { Trinity::tmDelete<T>(obj); }
-static void* tmMalloc(size_t size) { return Trinity::tmMalloc(size); }
-static void tmFree(void* obj) { Trinity::tmFree(obj); }
-
-
-//
-// Place these in a .cpp if you include this header from multiple files (compilation units)
-//
-// Global/singleton to hold all the thread registry functionality
-ThreadRegistry gThreadRegistry {};
-// PTM singleton
-Trinity gTrinity {};
-// Thread-local data of the current ongoing transaction
-thread_local OpData* tl_opdata {nullptr};
-// This is where every thread stores the tid it has been assigned when it calls getTID() for the first time.
-// When the thread dies, the destructor of ThreadCheckInCheckOut will be called and de-register the thread.
-thread_local ThreadCheckInCheckOut tl_tcico {};
-// Helper function for thread de-registration
-void thread_registry_deregister_thread(const int tid) {
-    gThreadRegistry.deregister_thread(tid);
-}
-
-}
-#endif /* _TRINITY_TL2_PERSISTENT_TRANSACTIONAL_MEMORY_H_ */
+/*
+ * Copyright 2018-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.txt
+ */
+#ifndef _TRINITY_TL2_PERSISTENT_TRANSACTIONAL_MEMORY_H_
+#define _TRINITY_TL2_PERSISTENT_TRANSACTIONAL_MEMORY_H_
+
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <mutex>        // Needed by std::lock_guard when growing the region
+#include <cstdlib>      // Needed by std::abort()
+#include <cstring>
+#include <cstdio>       // Needed by snprintf() in the allocator stats
+#include <string>
+#include <thread>       // Needed by this_thread::yield()
+#include <sys/mman.h>   // Needed if we use mmap()
+#include <sys/types.h>  // Needed by open() and close()
+#include <sys/stat.h>
+#include <linux/mman.h> // Needed by MAP_SHARED_VALIDATE
+#include <fcntl.h>
+#include <unistd.h>     // Needed by close()
+#include <type_traits>
+
+/*
+ * <h1> Trinity + Persistent TL2 </h1>
+ * See durable transactions paper
+ *
+ * Besides the global instance 'gTrinity', a process can open more pools (instances of Trinity), each with
+ * its own file, address range, allocator and clock. A transaction runs on a single pool, and the transactions
+ * on different pools never conflict with each other.
+ * The allocator and the root pointers are position-independent. A pool whose data structures use persist_ptr
+ * instead of raw pointers (see persist_pi) can be opened without a fixed address, at any address.
+ */
+
+
+// Macros needed for persistence
+#ifdef PWB_IS_CLFLUSH
+  /*
+   * More info at http://elixir.free-electrons.com/linux/latest/source/arch/x86/include/asm/special_insns.h#L213
+   * Intel programming manual at https://www.intel.com/content/dam/www/public/us/en/documents/manuals/64-ia-32-architectures-optimization-manual.pdf
+   * Use these for Broadwell CPUs (cervino server)
+   */
+  #define PWB(addr)              do { PTM_STATS_PWB(); __asm__ volatile("clflush (%0)" :: "r" (addr) : "memory"); } while (0)  // Broadwell only works with this.
+  #define PFENCE()               do { PTM_STATS_PFENCE(); } while (0)                                           // No ordering fences needed for CLFLUSH (section 7.4.6 of Intel manual)
+  #define PSYNC()                do { PTM_STATS_PSYNC(); } while (0)                                            // For durability it's not obvious, but CLFLUSH seems to be enough, and PMDK uses the same approach
+#elif PWB_IS_CLWB
+  /* Use this for CPUs that support clwb, such as the SkyLake SP series (c5 compute intensive instances in AWS are an example of it) */
+  #define PWB(addr)              do { PTM_STATS_PWB(); __asm__ volatile(".byte 0x66; xsaveopt %0" : "+m" (*(volatile char *)(addr))); } while (0)  // clwb() only for Ice Lake onwards
+  #define PFENCE()               do { PTM_STATS_PFENCE(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+  #define PSYNC()                do { PTM_STATS_PSYNC(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+#elif PWB_IS_NOP
+  /* pwbs are not needed for shared memory persistency (i.e. persistency across process failure) */
+  #define PWB(addr)              do { PTM_STATS_PWB(); } while (0)
+  #define PFENCE()               do { PTM_STATS_PFENCE(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+  #define PSYNC()                do { PTM_STATS_PSYNC(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+#elif PWB_IS_CLFLUSHOPT
+  /* Use this for CPUs that support clflushopt, which is most recent x86 */
+  #define PWB(addr)              do { PTM_STATS_PWB(); __asm__ volatile(".byte 0x66; clflush %0" : "+m" (*(volatile char *)(addr))); } while (0)  // clflushopt (Kaby Lake)
+  #define PFENCE()               do { PTM_STATS_PFENCE(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+  #define PSYNC()                do { PTM_STATS_PSYNC(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+#else
+#error "You must define what PWB is. Choose PWB_IS_CLFLUSHOPT if you don't know what your CPU is capable of"
+#endif
+// With -DPTM_STATS, the PWB(), PFENCE() and PSYNC() above count themselves with the PTM_STATS_*() hooks
+#include "../PTMStats.hpp"
+#include "../TxResult.hpp"     // Needed by readTx<R>() and updateTx<R>()
+
+
+namespace trinitytl2 {
+
+//
+// User configurable variables.
+// Feel free to change these if you need larger transactions, or more threads.
+//
+
+// Start address of persistent memory region. With 0, the region is mapped wherever there is room for it,
+// which requires the data structures to use persist_ptr instead of raw pointers.
+#ifndef PM_REGION_BEGIN
+#define PM_REGION_BEGIN 0x7fea00000000
+#endif
+// Maximum size of the persistent memory region. This much address space is reserved up front.
+#ifndef PM_REGION_SIZE
+#define PM_REGION_SIZE 1024*1024*1024ULL // 1GB for now
+#endif
+// Size of the file when the persistent memory region is created. The region then grows in place,
+// in steps of PM_REGION_GROW_SIZE, when the allocator runs out of memory.
+#ifndef PM_REGION_INITIAL_SIZE
+#define PM_REGION_INITIAL_SIZE PM_REGION_SIZE
+#endif
+#ifndef PM_REGION_GROW_SIZE
+#define PM_REGION_GROW_SIZE 64*1024*1024ULL
+#endif
+// Name of persistent file mapping (back)
+#ifndef PM_FILE_NAME
+#define PM_FILE_NAME   "/dev/shm/trinitytl2_shared"
+#endif
+
+// Maximum number of registered threads that can execute transactions
+static const int REGISTRY_MAX_THREADS = 128;
+// Maximum number of stores in the WriteSet per transaction
+static const uint64_t TX_MAX_STORES = 40*1024;
+// Maximum number of loads in one transaction
+static const uint64_t TX_MAX_LOADS = 1024*1024;
+
+// Maximum number of root pointers available for the user
+static const uint64_t MAX_ROOT_POINTERS = 64;
+
+// TL2 constants
+static const uint64_t LOCKED  = 0x8000000000000000ULL;
+static const int TX_IS_NONE   = 0;
+static const int TX_IS_READ   = 1;
+static const int TX_IS_UPDATE = 2;
+
+// Returns the cache line of the address (this is for x86 only)
+#define ADDR2CL(_addr) (uint8_t*)((size_t)(_addr) & (~63ULL))
+
+
+
+// A 'Locked-Sequence' is a uint64_t which has a sequence (56 bits) a thread-id (7 bits) and a lock/unlock state (1 bit)
+typedef uint64_t lseq_t;
+// Function that returns the tid of a p.seq. The lock+tid is the 8 highest bits of p.seq.
+inline static uint64_t lseq2tid(lseq_t lseq) { return (lseq >> (64-8)) & 0x7F; }
+// Returns the sequence in a lseq
+inline static uint64_t lseq2seq(lseq_t lseq) { return (lseq & 0xFFFFFFFFFFFFFFULL); }
+// Creates a new locked-sequence
+inline static lseq_t composeLseq(uint64_t lock, uint64_t tid, uint64_t seq) { return (lock | (tid << (64-8)) | seq); }
+// Helper functions
+inline static bool isLocked(uint64_t lseq) { return (lseq & LOCKED); }
+inline static bool isUnlocked(uint64_t lseq) { return !(lseq & LOCKED); }
+// Helper method: sl is unlocked and lower than the clock, or it's locked by me
+static inline bool isUnlockedOrLockedByMe(uint64_t rClock, uint64_t tid, uint64_t sl) {
+    return ( (isUnlocked(sl) && (lseq2seq(sl) <= rClock)) || (isLocked(sl) && lseq2tid(sl) == tid) );
+}
+
+
+//
+// Thread Registry stuff
+//
+extern void thread_registry_deregister_thread(const int tid);
+
+// An helper class to do the checkin and checkout of the thread registry
+struct ThreadCheckInCheckOut {
+    static const int NOT_ASSIGNED = -1;
+    int tid { NOT_ASSIGNED };
+    ~ThreadCheckInCheckOut() {
+        if (tid == NOT_ASSIGNED) return;
+        thread_registry_deregister_thread(tid);
+    }
+};
+
+extern thread_local ThreadCheckInCheckOut tl_tcico;
+
+// Forward declaration of global/singleton instance
+class ThreadRegistry;
+extern ThreadRegistry gThreadRegistry;
+
+/*
+ * <h1> Registry for threads </h1>
+ *
+ * This is singleton type class that allows assignement of a unique id to each thread.
+ * The first time a thread calls ThreadRegistry::getTID() it will allocate a free slot in 'usedTID[]'.
+ * This tid wil be saved in a thread-local variable of the type ThreadCheckInCheckOut which
+ * upon destruction of the thread will call the destructor of ThreadCheckInCheckOut and free the
+ * corresponding slot to be used by a later thread.
+ */
+class ThreadRegistry {
+private:
+    alignas(128) std::atomic<bool>      usedTID[REGISTRY_MAX_THREADS];   // Which TIDs are in use by threads
+    alignas(128) std::atomic<int>       maxTid {-1};                     // Highest TID (+1) in use by threads
+
+public:
+    ThreadRegistry() {
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+            usedTID[it].store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // Progress condition: wait-free bounded (by the number of threads)
+    int register_thread_new(void) {
+        for (int tid = 0; tid < REGISTRY_MAX_THREADS; tid++) {
+            if (usedTID[tid].load(std::memory_order_acquire)) continue;
+            bool unused = false;
+            if (!usedTID[tid].compare_exchange_strong(unused, true)) continue;
+            // Increase the current maximum to cover our thread id
+            int curMax = maxTid.load();
+            while (curMax <= tid) {
+                maxTid.compare_exchange_strong(curMax, tid+1);
+                curMax = maxTid.load();
+            }
+            tl_tcico.tid = tid;
+            return tid;
+        }
+        printf("ERROR: Too many threads, registry can only hold %d threads\n", REGISTRY_MAX_THREADS);
+        assert(false);
+    }
+
+    // Progress condition: wait-free population oblivious
+    inline void deregister_thread(const int tid) {
+        usedTID[tid].store(false, std::memory_order_release);
+    }
+
+    // Progress condition: wait-free population oblivious
+    static inline uint64_t getMaxThreads(void) {
+        return gThreadRegistry.maxTid.load(std::memory_order_acquire);
+    }
+
+    // Progress condition: wait-free bounded (by the number of threads)
+    static inline int getTID(void) {
+        int tid = tl_tcico.tid;
+        if (tid != ThreadCheckInCheckOut::NOT_ASSIGNED) return tid;
+        return gThreadRegistry.register_thread_new();
+    }
+};
+
+
+// T is typically a pointer to a node, but it can be integers or other stuff, as long as it fits in 64 bits
+template<typename T> struct persist {
+    // We mark these as 'volatile' to ensure that the stores are ordered
+    alignas(32) volatile uint64_t main;
+    volatile uint64_t             back;
+    std::atomic<lseq_t>           lseq;  // Lock plus sequence (for TL2 and Trinity)
+    uint64_t                      pad;
+
+    persist() { }
+
+    persist(T initVal) { pstore(initVal); }
+
+    // Casting operator
+    operator T() { return pload(); }
+    // Casting to const
+    operator T() const { return pload(); }
+
+    // Prefix increment operator: ++x
+    void operator++ () { pstore(pload()+1); }
+    // Prefix decrement operator: --x
+    void operator-- () { pstore(pload()-1); }
+    void operator++ (int) { pstore(pload()+1); }
+    void operator-- (int) { pstore(pload()-1); }
+    persist<T>& operator+= (const T& rhs) { pstore(pload() + rhs); return *this; }
+    persist<T>& operator-= (const T& rhs) { pstore(pload() - rhs); return *this; }
+
+    // Equals operator
+    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
+    bool operator == (const persist<Y> &rhs) { return pload() == rhs; }
+    // Difference operator: first downcast to T and then compare
+    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
+    bool operator != (const persist<Y> &rhs) { return pload() != rhs; }
+    // Relational operators
+    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
+    bool operator < (const persist<Y> &rhs) { return pload() < rhs; }
+    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
+    bool operator > (const persist<Y> &rhs) { return pload() > rhs; }
+    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
+    bool operator <= (const persist<Y> &rhs) { return pload() <= rhs; }
+    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
+    bool operator >= (const persist<Y> &rhs) { return pload() >= rhs; }
+
+    // Operator arrow ->
+    T operator->() { return pload(); }
+
+    // Copy constructor
+    persist<T>(const persist<T>& other) { pstore(other.pload()); }
+
+    // Assignment operator from a persist<T>
+    persist<T>& operator=(const persist<T>& other) {
+        pstore(other.pload());
+        return *this;
+    }
+
+    // Assignment operator from a value
+    persist<T>& operator=(T value) {
+        pstore(value);
+        return *this;
+    }
+
+    // Operator &
+    T* operator&() {
+        return (T*)this;
+    }
+
+    // Methods that are defined later because they have compilation dependencies
+    inline T pload() const;
+    inline void pstore(T newVal);
+};
+
+
+/*
+ * Position-independent persistent pointer.
+ * Instead of the address of the object, it stores the distance from itself to the object, which means
+ * the pool can be mapped at a different address on each run and the pointer still points to the same object.
+ * Decoding is a single add to 'this', without looking up the base of the pool, therefore, it works
+ * the same inside and outside of transactions, and in any pool.
+ * A distance of zero is the nullptr (a persist_ptr can not point to itself), which means zeroed memory is a nullptr.
+ * Copies between persist_ptr go through T* so that the distance is re-computed for the new location.
+ */
+template<typename T> struct persist_ptr {
+    persist<int64_t> off;
+
+    persist_ptr() { }
+
+    persist_ptr(T* initVal) { pstore(initVal); }
+
+    // Casting operator
+    operator T*() const { return pload(); }
+
+    // Operator arrow ->
+    T* operator->() const { return pload(); }
+
+    // Pointer arithmetic, used by the allocator on uint8_t*
+    persist_ptr<T>& operator+= (int64_t rhs) { pstore(pload() + rhs); return *this; }
+    persist_ptr<T>& operator-= (int64_t rhs) { pstore(pload() - rhs); return *this; }
+
+    // Copy constructor
+    persist_ptr<T>(const persist_ptr<T>& other) { pstore(other.pload()); }
+
+    // Assignment operator from a persist_ptr<T>
+    persist_ptr<T>& operator=(const persist_ptr<T>& other) {
+        pstore(other.pload());
+        return *this;
+    }
+
+    // Assignment operator from a value
+    persist_ptr<T>& operator=(T* value) {
+        pstore(value);
+        return *this;
+    }
+
+    inline T* pload() const {
+        const int64_t o = off.pload();
+        return (o == 0) ? nullptr : (T*)((uint8_t*)this + o);
+    }
+
+    inline void pstore(T* newVal) {
+        off.pstore((newVal == nullptr) ? 0 : (int64_t)((uint8_t*)newVal - (uint8_t*)this));
+    }
+};
+
+// Same as persist<T> but with the pointers replaced by persist_ptr. Pass it instead of persist<T> to the
+// data structures (as their TMTYPE) to make them position-independent.
+template<typename T> using persist_pi = typename std::conditional<std::is_pointer<T>::value,
+        persist_ptr<typename std::remove_pointer<T>::type>, persist<T>>::type;
+
+
+/*
+ * EsLocoTu? is an Extremely Simple memory aLOCatOr Two
+ *
+ * It is based on intrusive singly-linked stacks (a free-list), one for each size class.
+ * Blocks up to 128 bytes come in steps of 16 bytes. Above that, each power of two is split into
+ * four size classes (quarter-power-of-two), for example 160, 192, 224, 256, 320, 384, 448, 512, ...
+ * which means the internal fragmentation is at most 25% instead of the 50% of pure powers of two.
+ * Each block is the smallest size class enough to contain the desired user data plus the block header.
+ * There is an array named 'freelists' where each entry is a pointer to the head of a stack for that respective size class.
+ * Each block has an header with two words: the size class of the node, the pointer to the next node.
+ * The minimum block size is 4 words, with 2 for the header and 2 for the user.
+ * When there is no suitable block in the freelist, it will create a new block from the thread-local slab,
+ * or from the remaining pool for large blocks.
+ * When a thread-local slab doesn't have enough space for a new block, the remains of the slab are
+ * split into blocks and placed in the thread-local free-lists, to be re-used by later allocations.
+ * Slabs are always fully split into blocks, which means the pool can be walked block by block, from
+ * the end of the metadata up to the top, skipping only the part of each slab that is still being carved.
+ * This is what the online compaction relies on, see the comment on compactScan().
+ * The pool may be smaller than the range reserved for it. When the top reaches the end of the pool, the
+ * PTM is asked to grow it (see init()), therefore, the pool can start small and grow with the data.
+ *
+ * EsLoco was designed for usage in PTMs but it doesn't have to be used only for that.
+ * EsLocoTu scales while EsLoco does not.
+ * Average number of stores for an allocation is 1.
+ * Average number of stores for a de-allocation is 2.
+ * Statistics on the usage of each size class can be obtained with getStats().
+ * On PTMs where P<> is larger than a word, the blocks are aligned to alignof(P<>) instead of 16 bytes.
+ * With P<> = persist_pi, the pointers in the metadata and in the block headers are relative, and the
+ * pool can be mapped at a different address on each run.
+ *
+ * Memory layout:
+ * ----------------------------------------------------------------------------------------------------------
+ * | poolTop | gfreelists[0..kNumClasses] | threadflists[0..REGISTRY_MAX_THREADS] | ... allocated objects ... |
+ * ----------------------------------------------------------------------------------------------------------
+ */
+template <template <typename> class P>
+class EsLoco2 {
+private:
+    const bool debugOn = false;
+    // Exponent of the largest block size: 2^49 bytes. 1024 TB of memory should be enough
+    static const int kMaxBlockSize = 50;
+    // Number of size classes (and of entries in each freelists array).
+    // The first 8 are 16, 32, 48... 128 bytes, and then 4 classes for each power of two up to 2^kMaxBlockSize
+    static const int kNumClasses = 8 + (kMaxBlockSize-8)*4;
+    // Size after which we trigger a cleanup of the thread-local list/pool
+    static const uint64_t kMaxListSize = 64;
+    // Size of a thread-local slab (in bytes). When it runs out, we take another slab from poolTop.
+    // Larger allocations go directly on poolTop which means doing a lot of large allocations from
+    // multiple threads will result in contention.
+    static const uint64_t kSlabSize = 4*1024*1024;
+    // The compaction looks at the pool in windows of this size
+    static const uint64_t kWindowSize = kSlabSize;
+
+    // Flags kept in the high bits of the size class of a block, so that the compaction knows the state of each block
+    static const uint64_t kFreeFlag     = 1ULL << 62;   // Block is in a free-list
+    static const uint64_t kDetachedFlag = 1ULL << 61;   // Block is free but the compaction is keeping it out of the free-lists
+    static const uint64_t kChunkFlag    = 1ULL << 60;   // Not a block, but a Chunk
+    static const uint64_t kClassMask    = kChunkFlag - 1;
+
+    struct block {
+        P<block*>   next;    // Pointer to next block in free-list (when block is in free-list)
+        P<uint64_t> sclass;  // Size class of this block plus flags. Use classToSize() to get the size in bytes.
+    };
+
+    // A run of contiguous free memory reclaimed by the compaction. Chunks are re-used as slabs.
+    // The header of a chunk overlaps the header of a block, therefore, the pool can still be walked.
+    struct Chunk {
+        P<Chunk*>   next;    // Next chunk in the list of chunks
+        P<uint64_t> sclass;  // Always kChunkFlag
+        P<uint64_t> size;    // Size of this chunk in bytes, including the header
+    };
+
+    // Blocks are multiples of 16 bytes, or of the alignment of P<>, whichever is larger
+    static constexpr uint64_t kQuantum = alignof(block) > 16 ? alignof(block) : 16;
+    // Smallest block, which is just the header. When splitting the remains of a slab, nothing smaller than this is left behind.
+    static constexpr uint64_t kMinBlockSize = sizeof(block);
+
+    // A persistent free-list of blocks
+    struct FList {
+        P<uint64_t> count;   // Number of blocks in the stack
+        P<block*>   head;    // Head of the stack (where we push and pop)
+        P<block*>   tail;    // Tail of the stack (used for faster transfers to/from gflist)
+
+        // Push a block into this free list, incrementing the volatile
+        // counter and adjusting the tail if needed. Does two pstores min.
+        void pushBlock(block* myblock) {
+            block* lhead = head;
+            if (lhead == nullptr) {
+                assert(count == 0);
+                tail = myblock;                    // pstore()
+            }
+            myblock->next = lhead;                 // pstore()
+            head = myblock;                        // pstore()
+            count++;
+        }
+
+        // Pops a block from a given (persistent) free list, decrementing the
+        // volatile counter and setting the tail to nullptr if list becomes empty.
+        // Does 2 pstores.
+        block* popBlock(void) {
+            assert(count != 0);
+            assert(tail != nullptr);
+            count--;
+            block* myblock = head;
+            head = myblock->next;                // pstore()
+            if (head == nullptr) tail = nullptr; // pstore()
+            return myblock;
+        }
+
+        bool isFull(void) { return (count >= kMaxListSize); }
+        bool isEmpty() { return (count == 0); }
+
+        // Transfer this list to another free-list (oflist).
+        // We use this method to transfer from the thread-local list to the global list.
+        void transfer(FList* oflist) {
+            assert(count != 0);
+            assert(tail != nullptr);
+            if (oflist->tail == nullptr) {
+                assert (oflist->head == nullptr);
+                oflist->tail = tail;                           // pstore()
+            }
+            tail->next = oflist->head;                         // pstore()
+            oflist->head = head;                               // pstore()
+            oflist->count += count;                            // pstore()
+            count = 0;                                         // pstore()
+            tail = nullptr;                                    // pstore()
+            head = nullptr;                                    // pstore()
+        }
+    };
+
+    // To avoid false sharing and lock conflicts, we put each thread-local data in one of these.
+    // This is persistent (in PM).
+    struct TLData {
+        uint64_t     padding[8];
+        // Thread-local array of persistent heads of free-list
+        FList        tflists[kNumClasses];
+        // Thread-local slab pointer
+        P<uint8_t*>  slabtop;
+        // Thread-loal slab size
+        P<uint64_t>  slabsize;
+        // Number of blocks this thread has carved from slabs or from the top, per size class.
+        // Only used by getStats(), to know how many blocks exist of each size class.
+        P<uint64_t>  carved[kNumClasses];
+        TLData() {
+            for (int i = 0; i < kNumClasses; i++) {
+                tflists[i].count = 0;             // pstore()
+                tflists[i].head = nullptr;        // pstore()
+                tflists[i].tail = nullptr;        // pstore()
+                carved[i] = 0;                    // pstore()
+            }
+            slabtop = nullptr;                    // pstore()
+            slabsize = 0;                         // pstore()
+        }
+    };
+
+    // Complete metadata. This is PM
+    struct ELMetadata {
+        P<uint8_t*> top;
+        P<Chunk*>   chunks;      // Chunks reclaimed by the compaction and not yet re-used as slabs
+        P<uint64_t> chunkBytes;  // Sum of the sizes of all those chunks
+        FList       gflists[kNumClasses];
+        TLData      tldata[REGISTRY_MAX_THREADS];
+        // This constructor should be called from within a transaction
+        ELMetadata() {
+            // The 'top' starts after the metadata header
+            top = ((uint8_t*)this) + sizeof(ELMetadata);         // pstore()
+            chunks = nullptr;                                    // pstore()
+            chunkBytes = 0;                                      // pstore()
+            for (int i = 0; i < kNumClasses; i++) {
+                gflists[i].count = 0;             // pstore()
+                gflists[i].head = nullptr;        // pstore()
+                gflists[i].tail = nullptr;        // pstore()
+            }
+            for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+                new (&tldata[it]) TLData();                      // pstores()
+            }
+        }
+    };
+
+    // Volatile data
+    uint8_t* poolAddr {nullptr};
+    std::atomic<uint64_t> poolSize {0};
+    uint64_t poolMaxSize {0};
+    std::function<uint8_t*(uint8_t*)> growPool {nullptr};
+
+    // Pointer to location of PM metadata of EsLoco
+    ELMetadata* meta {nullptr};
+
+    // Volatile state of the compaction. The windows are only accessed by the thread doing the compaction,
+    // while the ranges being evacuated are read by free() on all threads.
+    struct Window {
+        uint8_t* beg;          // First block in this window
+        uint8_t* end;          // First block of the next window, which may be after the window boundary
+        uint64_t liveBytes;    // In blocks not free
+        bool     walkable;     // False if a slab is still being carved in this window, or there is a chunk
+        bool     evacuate;     // Picked by compactSelect()
+    };
+    struct EvacRange {
+        std::atomic<uint8_t*> beg {nullptr};
+        std::atomic<uint8_t*> end {nullptr};
+    };
+    uint64_t                  maxWindows {0};
+    uint64_t                  numWindows {0};
+    Window*                   windows {nullptr};
+    EvacRange*                evacRanges {nullptr};
+    std::atomic<bool>         compacting {false};   // True while there is a compaction running
+    std::atomic<bool>         evacuating {false};   // True while there are windows being evacuated
+
+    // For powers of 2, returns the highest bit, otherwise, returns the next highest bit
+    static uint64_t highestBit(uint64_t val) {
+        uint64_t b = 0;
+        while ((val >> (b+1)) != 0) b++;
+        if (val > (1ULL << b)) return b+1;
+        return b;
+    }
+
+    // Returns the smallest size class that can hold 'bsize' bytes (including the block header)
+    static uint64_t sizeToClass(uint64_t bsize) {
+        bsize = (bsize + kQuantum - 1) & ~(kQuantum - 1);
+        if (bsize <= 128) return (bsize+15)/16 - 1;
+        const uint64_t b = highestBit(bsize);                     // 2^(b-1) < bsize <= 2^b
+        const uint64_t quarter = 1ULL << (b-3);
+        const uint64_t sub = (bsize - (1ULL << (b-1)) + quarter - 1)/quarter;  // 1 to 4
+        return 8 + (b-8)*4 + sub - 1;
+    }
+
+    // Returns the size in bytes of the blocks of a size class (including the block header)
+    static uint64_t classToSize(uint64_t sclass) {
+        if (sclass < 8) return (sclass+1)*16;
+        const uint64_t b = 8 + (sclass-8)/4;
+        return (1ULL << (b-1)) + ((sclass-8)%4 + 1)*(1ULL << (b-3));
+    }
+
+    // Returns the largest size class that can be carved from 'ssize' free bytes, leaving behind either
+    // nothing or enough for other blocks. 'ssize' must be a multiple of kQuantum and at least kMinBlockSize.
+    static uint64_t fitClass(uint64_t ssize) {
+        uint64_t sclass = sizeToClass(ssize);
+        if (classToSize(sclass) > ssize) sclass--;
+        while (classToSize(sclass) % kQuantum != 0 ||
+               (classToSize(sclass) != ssize && ssize - classToSize(sclass) < kMinBlockSize)) sclass--;
+        return sclass;
+    }
+
+    uint8_t* aligned(uint8_t* addr) {
+        return (uint8_t*)((size_t)addr & (~0x3FULL)) + 128;
+    }
+
+    // Places a block in the thread-local free-list of its size class.
+    // When the thread-local freelist becomes too large, all blocks are moved to the thread-global free-list.
+    void pushToFreeList(const int tid, block* myblock, uint64_t sclass) {
+        myblock->sclass = sclass | kFreeFlag;                                // pstore()
+        meta->tldata[tid].tflists[sclass].pushBlock(myblock);
+        if (meta->tldata[tid].tflists[sclass].isFull()) {
+            if (debugOn) printf("Moving thread-local flist for sclass=%ld to thread-global flist\n", sclass);
+            // Move all objects in the thread-local list to the corresponding thread-global list
+            meta->tldata[tid].tflists[sclass].transfer(&meta->gflists[sclass]);
+        }
+    }
+
+    // Splits the free memory in [addr, addr+ssize) into the largest blocks that fit, and places them
+    // in the thread-local free-lists. Nothing is lost because the slabs never have less than kMinBlockSize left.
+    void splitIntoFreeList(const int tid, uint8_t* addr, uint64_t ssize) {
+        while (ssize != 0) {
+            assert(ssize >= kMinBlockSize);
+            const uint64_t sclass = fitClass(ssize);
+            pushToFreeList(tid, (block*)addr, sclass);
+            meta->tldata[tid].carved[sclass]++;                          // pstore()
+            addr += classToSize(sclass);
+            ssize -= classToSize(sclass);
+        }
+    }
+
+    // Splits whatever remains of the current slab into blocks, and places them in the thread-local free-lists
+    void recycleSlab(const int tid) {
+        splitIntoFreeList(tid, meta->tldata[tid].slabtop.pload(), meta->tldata[tid].slabsize.pload());
+    }
+
+    // Returns true if the block is in one of the windows being evacuated by the compaction
+    bool inEvacuatedWindow(const uint8_t* addr) {
+        if (!evacuating.load(std::memory_order_acquire)) return false;
+        const uint8_t* heap = poolAddr + sizeof(ELMetadata);
+        if (addr < heap || addr >= poolAddr + poolSize) return false;
+        const EvacRange& range = evacRanges[(addr - heap)/kWindowSize];
+        return addr >= range.beg.load(std::memory_order_relaxed) && addr < range.end.load(std::memory_order_relaxed);
+    }
+
+    // Walks the blocks from 'addr' up to the first block at or after 'end' (or the top), calling func(myblock, sclass)
+    // for each one, where 'sclass' includes the flags. Skips the chunks and the parts of the slabs still being carved,
+    // in which case it returns false. On return, 'addr' is the first block not walked.
+    template<typename F> bool walk(uint8_t*& addr, uint8_t* end, F&& func) {
+        uint8_t* slabs[REGISTRY_MAX_THREADS];
+        uint64_t sizes[REGISTRY_MAX_THREADS];
+        int numSlabs = 0;
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+            sizes[numSlabs] = meta->tldata[it].slabsize.pload();
+            if (sizes[numSlabs] == 0) continue;
+            slabs[numSlabs++] = meta->tldata[it].slabtop.pload();
+        }
+        uint8_t* top = meta->top.pload();
+        bool walkable = true;
+        while (addr < end && addr < top) {
+            uint64_t skip = 0;
+            for (int i = 0; i < numSlabs; i++) {
+                if (slabs[i] == addr) skip = sizes[i];
+            }
+            if (skip == 0) {
+                const uint64_t sclass = ((block*)addr)->sclass.pload();
+                if (sclass & kChunkFlag) {
+                    skip = ((Chunk*)addr)->size.pload();
+                } else {
+                    assert((sclass & kClassMask) < kNumClasses);
+                    func((block*)addr, sclass);
+                    addr += classToSize(sclass & kClassMask);
+                    continue;
+                }
+            }
+            walkable = false;
+            addr += skip;
+        }
+        return walkable;
+    }
+
+public:
+    ~EsLoco2() {
+        delete[] windows;
+        delete[] evacRanges;
+    }
+
+    // Snapshot of the state of the allocator, filled by getStats().
+    // All sizes are in bytes and include the block headers.
+    struct Stats {
+        uint64_t poolSize {0};                     // Size of the whole memory pool
+        uint64_t usedSize {0};                     // From the start of the pool up to the top (high-water mark)
+        uint64_t metadataSize {0};                 // Taken by the allocator metadata (free-lists and counters)
+        uint64_t liveBytes {0};                    // In blocks currently allocated by the user
+        uint64_t freeBytes {0};                    // In blocks sitting in the free-lists, thread-local or global
+        uint64_t slabBytes {0};                    // Not yet carved from the thread-local slabs
+        uint64_t chunkBytes {0};                   // Reclaimed by the compaction and not yet re-used as slabs
+        uint64_t blockSize[kNumClasses];           // Size of the blocks of each size class
+        uint64_t liveBlocks[kNumClasses];          // Number of allocated blocks, per size class
+        uint64_t freeBlocks[kNumClasses];          // Number of blocks in all the free-lists, per size class
+        uint64_t globalFreeBlocks[kNumClasses];    // Number of blocks in the global free-lists, per size class
+        uint64_t threadSlabBytes[REGISTRY_MAX_THREADS]; // Not yet carved from the slab of each thread
+
+        // How much of the snapshot getStats() fills in
+        enum Detail {
+            kUsage,      // Only the pool, used and metadata sizes, with two loads
+            kTotals,     // Also the live, free, slab and chunk bytes, but not the arrays
+            kAll,        // Everything
+        };
+
+        // Fraction of the used pool which is not holding user data. The metadata, the chunks and the tails
+        // of the slabs that haven't been carved into blocks yet don't count, otherwise a fresh pool, where
+        // most of the used pool is in the slabs of the threads, would look fragmented.
+        double fragmentation() const {
+            const uint64_t unused = metadataSize + chunkBytes + slabBytes;
+            if (usedSize <= unused) return 0;
+            return 1. - (double)liveBytes/(usedSize - unused);
+        }
+
+        // Human readable report, one line per size class in use
+        std::string toString() const {
+            std::string s;
+            char line[256];
+            std::snprintf(line, sizeof(line), "EsLoco2: pool=%ld MB  used=%ld MB  live=%ld MB  free=%ld MB  slabs=%ld MB  chunks=%ld MB  fragmentation=%.1f%%\n",
+                    poolSize>>20, usedSize>>20, liveBytes>>20, freeBytes>>20, slabBytes>>20, chunkBytes>>20, 100.*fragmentation());
+            s += line;
+            s += "  block size       live blocks     free blocks    (in global)\n";
+            for (int i = 0; i < kNumClasses; i++) {
+                if (liveBlocks[i] == 0 && freeBlocks[i] == 0) continue;
+                std::snprintf(line, sizeof(line), "  %10ld  %16ld  %14ld  %13ld\n", blockSize[i], liveBlocks[i], freeBlocks[i], globalFreeBlocks[i]);
+                s += line;
+            }
+            for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+                if (threadSlabBytes[it] == 0) continue;
+                std::snprintf(line, sizeof(line), "  slab of thread %d has %ld KB left\n", it, threadSlabBytes[it]>>10);
+                s += line;
+            }
+            return s;
+        }
+    };
+
+    // The pool starts with 'sizeOfMemoryPool' bytes and may grow up to 'maxSizeOfMemoryPool'. When it needs to,
+    // malloc() calls 'grow' with the end address it needs, and 'grow' returns the new end of the pool, which
+    // may be smaller than what was asked if the PTM can't grow its region that much.
+    void init(void* addressOfMemoryPool, size_t sizeOfMemoryPool, bool clearPool=true,
+              size_t maxSizeOfMemoryPool=0, std::function<uint8_t*(uint8_t*)> grow=nullptr) {
+        // Align the base address of the memory pool
+        poolAddr = aligned((uint8_t*)addressOfMemoryPool);
+        poolSize = sizeOfMemoryPool + (uint8_t*)addressOfMemoryPool - poolAddr;
+        poolMaxSize = (maxSizeOfMemoryPool > sizeOfMemoryPool ? maxSizeOfMemoryPool : sizeOfMemoryPool) + (uint8_t*)addressOfMemoryPool - poolAddr;
+        growPool = grow;
+        // The first thing in the pool is the ELMetadata
+        meta = (ELMetadata*)poolAddr;
+        if (clearPool) new (meta) ELMetadata();
+        // Volatile state of the compaction
+        delete[] windows;
+        delete[] evacRanges;
+        maxWindows = poolMaxSize/kWindowSize + 1;
+        windows = new Window[maxWindows];
+        evacRanges = new EvacRange[maxWindows];
+        if (debugOn) printf("Starting EsLoco2 with poolAddr=%p and poolSize=%ld, up to %p\n", poolAddr, poolSize.load(), poolAddr+poolSize);
+    }
+
+    // Resets the metadata of the allocator back to its defaults
+    void reset() {
+        std::memset(poolAddr, 0, sizeof(FList)*kNumClasses*(REGISTRY_MAX_THREADS+1));
+        meta->top.pstore(nullptr);
+    }
+
+    // Returns the number of bytes that may (or may not) have allocated objects, from the base address to the top address
+    uint64_t getUsedSize() {
+        return meta->top.pload() - poolAddr;
+    }
+
+    // Fills 'stats' with the current state of the allocator, up to 'detail'. Costs a few loads for each size
+    // class and thread, regardless of the number of allocated objects, or just two loads for kUsage.
+    // Call it from within a transaction (a read-only one is enough) to get a consistent snapshot.
+    void getStats(Stats& stats, typename Stats::Detail detail=Stats::kAll) {
+        stats = Stats();
+        stats.poolSize = poolSize;
+        stats.usedSize = getUsedSize();
+        stats.metadataSize = sizeof(ELMetadata);
+        if (detail == Stats::kUsage) return;
+        for (int i = 0; i < kNumClasses; i++) {
+            uint64_t carved = 0;
+            uint64_t tfree = 0;
+            for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+                carved += meta->tldata[it].carved[i].pload();
+                tfree += meta->tldata[it].tflists[i].count.pload();
+            }
+            const uint64_t gfree = meta->gflists[i].count.pload();
+            const uint64_t bsize = classToSize(i);
+            stats.liveBytes += (carved - tfree - gfree)*bsize;
+            stats.freeBytes += (tfree + gfree)*bsize;
+            if (detail != Stats::kAll) continue;
+            stats.blockSize[i] = bsize;
+            stats.globalFreeBlocks[i] = gfree;
+            stats.freeBlocks[i] = tfree + gfree;
+            stats.liveBlocks[i] = carved - stats.freeBlocks[i];
+        }
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+            const uint64_t ssize = meta->tldata[it].slabsize.pload();
+            stats.slabBytes += ssize;
+            if (detail == Stats::kAll) stats.threadSlabBytes[it] = ssize;
+        }
+        stats.chunkBytes = meta->chunkBytes.pload();
+    }
+
+    // Returns true if the pool goes at least up to 'end', growing it if needed
+    bool reservePool(uint8_t* end) {
+        uint64_t curSize = poolSize.load();
+        if (end <= poolAddr + curSize) return true;
+        if (growPool == nullptr || end > poolAddr + poolMaxSize) return false;
+        uint64_t newSize = growPool(end) - poolAddr;
+        if (newSize > poolMaxSize) newSize = poolMaxSize;
+        while (curSize < newSize && !poolSize.compare_exchange_weak(curSize, newSize)) { }
+        return end <= poolAddr + poolSize.load();
+    }
+
+    // Takes the desired size of the object in bytes.
+    // Returns pointer to memory in pool, or nullptr.
+    // Does on average 1 store to persistent memory when re-utilizing blocks.
+    void* malloc(size_t size) {
+        const int tid = ThreadRegistry::getTID();
+        // Adjust size to nearest (highest) size class
+        uint64_t sclass = sizeToClass(size + sizeof(block));
+        uint64_t asize = classToSize(sclass);
+        if (debugOn) printf("malloc(%ld) requested,  size class = %ld (%ld bytes)\n", size, sclass, asize);
+        block* myblock = nullptr;
+        // Check if there is a block of that size in the corresponding freelist
+        if (!meta->tldata[tid].tflists[sclass].isEmpty()) {
+            if (debugOn) printf("Found available block in thread-local freelist\n");
+            myblock = meta->tldata[tid].tflists[sclass].popBlock();
+        } else if (asize < kSlabSize/2) {
+            // Allocations larger than kSlabSize/2 go on the global top
+            // The slab can't be left with less than kMinBlockSize, otherwise it could not be split into blocks
+            const uint64_t ssize = meta->tldata[tid].slabsize.pload();
+            const bool fitsInSlab = (asize == ssize || asize + kMinBlockSize <= ssize);
+            if (!fitsInSlab && !meta->gflists[sclass].isEmpty()) {
+                // Before taking a new slab, re-use a block that some thread has placed in the global list
+                if (debugOn) printf("Found available block in thread-global freelist\n");
+                myblock = meta->gflists[sclass].popBlock();
+            } else {
+                if (!fitsInSlab) {
+                    if (debugOn) printf("Not enough space on current slab of thread %d for %ld bytes. Taking new slab\n",tid, asize);
+                    // Not enough space for allocation. Take a new slab, preferably a chunk reclaimed by the
+                    // compaction, otherwise from the global top, and add the remains of the old one to the thread-local freelists.
+                    Chunk* chunk = meta->chunks.pload();
+                    if (chunk == nullptr && !reservePool(meta->top.pload() + kSlabSize)) {
+                        printf("EsLoco2: Out of memory for slab %ld for %ld bytes allocation\n", kSlabSize, size);
+                        return nullptr;
+                    }
+                    recycleSlab(tid);
+                    if (chunk != nullptr) {
+                        // Chunks are at least kSlabSize/2, therefore, large enough for this block
+                        meta->chunks = chunk->next.pload();                  // pstore()
+                        meta->chunkBytes -= chunk->size.pload();             // pstore()
+                        meta->tldata[tid].slabtop = (uint8_t*)chunk;         // pstore()
+                        meta->tldata[tid].slabsize = chunk->size.pload();    // pstore()
+                    } else {
+                        meta->tldata[tid].slabtop = meta->top.pload();       // pstore()
+                        meta->tldata[tid].slabsize = kSlabSize;              // pstore()
+                        meta->top.pstore(meta->top.pload() + kSlabSize);     // pstore()
+                    }
+                }
+                // Take space from the slab
+                myblock = (block*)meta->tldata[tid].slabtop.pload();
+                meta->tldata[tid].slabtop.pstore((uint8_t*)myblock + asize); // pstore()
+                meta->tldata[tid].slabsize -= asize;                         // pstore()
+                meta->tldata[tid].carved[sclass]++;                          // pstore()
+            }
+        } else if (!meta->gflists[sclass].isEmpty()) {
+            if (debugOn) printf("Found available block in thread-global freelist\n");
+            myblock = meta->gflists[sclass].popBlock();
+        } else {
+            if (debugOn) printf("Creating new block from top, currently at %p\n", meta->top.pload());
+            // Couldn't find a suitable block, get one from the top of the pool if there is one available
+            if (!reservePool(meta->top.pload() + asize)) {
+                printf("EsLoco2: Out of memory for %ld bytes allocation\n", size);
+                return nullptr;
+            }
+            myblock = (block*)meta->top.pload();
+            meta->top.pstore(meta->top.pload() + asize);                 // pstore()
+            meta->tldata[tid].carved[sclass]++;                           // pstore()
+        }
+        // Clears the flags, in case the block came from a free-list
+        myblock->sclass = sclass;                                         // pstore()
+        if (debugOn) printf("returning ptr = %p\n", (void*)((uint8_t*)myblock + sizeof(block)));
+        // Return the block, minus the header
+        return (void*)((uint8_t*)myblock + sizeof(block));
+    }
+
+    // Takes a pointer to an object and puts the block on the free-list.
+    // When the thread-local freelist becomes too large, all blocks are moved to the thread-global free-list.
+    // Does on average 3 stores to persistent memory.
+    void free(void* ptr) {
+        if (ptr == nullptr) return;
+        const int tid = ThreadRegistry::getTID();
+        block* myblock = (block*)((uint8_t*)ptr - sizeof(block));
+        const uint64_t sclass = myblock->sclass.pload();
+        if (debugOn) printf("free(%p)  size class = %ld\n", ptr, sclass);
+        assert((sclass & ~kClassMask) == 0);  // Double free?
+        if (inEvacuatedWindow((uint8_t*)myblock)) {
+            // The compaction is going to reclaim this window, keep the block out of the free-lists
+            myblock->sclass = sclass | kDetachedFlag;                     // pstore()
+            return;
+        }
+        // Insert the block in the corresponding freelist
+        pushToFreeList(tid, myblock, sclass);
+    }
+
+    /*
+     * Online compaction
+     *
+     * Blocks of different size classes never coalesce and the top only grows, therefore, a long running
+     * pool where the sizes of the objects keep changing becomes fragmented. The compaction is done by the
+     * PTM in several small transactions, with the following steps:
+     * 1. compactScan() walks the pool one window at a time, measuring how much of each window is live;
+     * 2. compactSelect() picks the windows with a low ratio of live bytes to be evacuated;
+     * 3. compactDetach() takes the free blocks of those windows out of the free-lists. From then on,
+     *    the blocks freed in those windows are 'detached' (kept out of the free-lists) instead;
+     * 4. the user relocates each live object for which isEvacuating() is true, to a newly allocated block;
+     * 5. compactReclaim() coalesces each window left with only detached blocks. The space is handed
+     *    back to the top if it is at the end of the pool, otherwise it becomes a Chunk, which
+     *    malloc() prefers to the top when it needs a new slab;
+     * 6. compactRelist() puts the detached blocks of the windows that were not reclaimed back in the free-lists.
+     * Windows where a slab is being carved are never evacuated. A crash in the middle of a compaction may
+     * leave detached blocks behind, which the next compactScan() places back in the free-lists.
+     */
+
+    // Returns false if there is already a compaction running. Otherwise, the caller must call compactEnd() when done.
+    bool compactBegin() {
+        bool expected = false;
+        if (!compacting.compare_exchange_strong(expected, true)) return false;
+        numWindows = 0;
+        return true;
+    }
+
+    void compactEnd() {
+        for (uint64_t w = 0; w < numWindows; w++) {
+            evacRanges[w].beg.store(nullptr, std::memory_order_relaxed);
+            evacRanges[w].end.store(nullptr, std::memory_order_relaxed);
+        }
+        evacuating.store(false, std::memory_order_release);
+        compacting.store(false, std::memory_order_release);
+    }
+
+    // Step 1: walks the blocks of window 'w' and returns false if there are no more windows.
+    // Must be called from within an update transaction, for w = 0, 1, 2... because each window starts where the previous one ended.
+    bool compactScan(uint64_t w) {
+        uint8_t* heap = poolAddr + sizeof(ELMetadata);
+        uint8_t* addr = (w == 0) ? heap : windows[w-1].end;
+        if (addr >= meta->top.pload() || w == maxWindows) return false;
+        const int tid = ThreadRegistry::getTID();
+        Window& win = windows[w];
+        win.beg = addr;
+        win.liveBytes = 0;
+        win.evacuate = false;
+        win.walkable = walk(addr, heap + (w+1)*kWindowSize, [&] (block* myblock, uint64_t sclass) {
+            if (sclass & kDetachedFlag) {
+                // Left over from a compaction that did not complete
+                pushToFreeList(tid, myblock, sclass & kClassMask);
+            } else if (!(sclass & kFreeFlag)) {
+                win.liveBytes += classToSize(sclass);
+            }
+        });
+        win.end = addr;
+        numWindows = w+1;
+        return true;
+    }
+
+    // Step 2: picks the windows where less than 'maxLiveRatio' of the bytes are live, and starts evacuating them.
+    // Returns the number of windows picked.
+    uint64_t compactSelect(double maxLiveRatio) {
+        uint64_t picked = 0;
+        for (uint64_t w = 0; w < numWindows; w++) {
+            Window& win = windows[w];
+            if (!win.walkable || win.liveBytes >= maxLiveRatio*(win.end - win.beg)) continue;
+            win.evacuate = true;
+            evacRanges[w].beg.store(win.beg, std::memory_order_relaxed);
+            evacRanges[w].end.store(win.end, std::memory_order_relaxed);
+            picked++;
+        }
+        if (picked != 0) evacuating.store(true, std::memory_order_release);
+        return picked;
+    }
+
+    // Step 3: takes the free blocks in the windows being evacuated out of the free-lists of thread 'it',
+    // or out of the global free-lists when 'it' is REGISTRY_MAX_THREADS. Must be called from within an update transaction.
+    void compactDetach(int it) {
+        for (int i = 0; i < kNumClasses; i++) {
+            FList& fl = (it == REGISTRY_MAX_THREADS) ? meta->gflists[i] : meta->tldata[it].tflists[i];
+            if (fl.count.pload() == 0) continue;
+            block* prev = nullptr;
+            uint64_t count = 0;
+            bool changed = false;
+            for (block* myblock = fl.head.pload(); myblock != nullptr; ) {
+                block* next = myblock->next.pload();
+                if (inEvacuatedWindow((uint8_t*)myblock)) {
+                    myblock->sclass = i | kDetachedFlag;                  // pstore()
+                    if (prev == nullptr) fl.head = next;                  // pstore()
+                    else prev->next = next;                               // pstore()
+                    changed = true;
+                } else {
+                    prev = myblock;
+                    count++;
+                }
+                myblock = next;
+            }
+            if (!changed) continue;
+            fl.tail = prev;                                               // pstore()
+            fl.count = count;                                             // pstore()
+        }
+    }
+
+    // Returns true if the object at 'ptr' is in a window being evacuated and should be relocated (step 4)
+    bool isEvacuating(const void* ptr) {
+        return inEvacuatedWindow((const uint8_t*)ptr - sizeof(block));
+    }
+
+    // Step 5: if window 'w' is being evacuated and has only detached blocks, coalesces them and returns
+    // the number of bytes reclaimed. Must be called from within an update transaction, from the last window to the first.
+    uint64_t compactReclaim(uint64_t w) {
+        Window& win = windows[w];
+        if (!win.evacuate) return 0;
+        uint64_t numBlocks[kNumClasses];
+        std::memset(numBlocks, 0, sizeof(numBlocks));
+        bool reclaim = true;
+        uint8_t* addr = win.beg;
+        walk(addr, win.end, [&] (block* myblock, uint64_t sclass) {
+            if (sclass & kDetachedFlag) numBlocks[sclass & kClassMask]++;
+            else reclaim = false;
+        });
+        if (!reclaim || addr != win.end) return 0;
+        // Blocks freed in this window from now on go to the free-lists
+        evacRanges[w].beg.store(nullptr, std::memory_order_relaxed);
+        evacRanges[w].end.store(nullptr, std::memory_order_relaxed);
+        const int tid = ThreadRegistry::getTID();
+        for (int i = 0; i < kNumClasses; i++) {
+            if (numBlocks[i] != 0) meta->tldata[tid].carved[i] -= numBlocks[i];  // pstore()
+        }
+        const uint64_t size = win.end - win.beg;
+        if (win.end == meta->top.pload()) {
+            // This is the end of the pool, hand it back to the top
+            meta->top = win.beg;                                          // pstore()
+        } else if (size >= kSlabSize/2) {
+            Chunk* chunk = (Chunk*)win.beg;
+            chunk->sclass = kChunkFlag;                                   // pstore()
+            chunk->size = size;                                           // pstore()
+            chunk->next = meta->chunks.pload();                           // pstore()
+            meta->chunks = chunk;                                         // pstore()
+            meta->chunkBytes += size;                                     // pstore()
+        } else {
+            // Too small to be a slab, split it into blocks as large as possible
+            splitIntoFreeList(tid, win.beg, size);
+        }
+        win.evacuate = false;
+        return size;
+    }
+
+    // Step 6: stops evacuating window 'w' and places its detached blocks back in the free-lists.
+    // Must be called from within an update transaction, after compactReclaim().
+    void compactRelist(uint64_t w) {
+        Window& win = windows[w];
+        evacRanges[w].beg.store(nullptr, std::memory_order_relaxed);
+        evacRanges[w].end.store(nullptr, std::memory_order_relaxed);
+        if (!win.evacuate) return;
+        const int tid = ThreadRegistry::getTID();
+        uint8_t* addr = win.beg;
+        walk(addr, win.end, [&] (block* myblock, uint64_t sclass) {
+            if (sclass & kDetachedFlag) pushToFreeList(tid, myblock, sclass & kClassMask);
+        });
+    }
+
+    // Number of windows walked by compactScan()
+    uint64_t compactNumWindows() { return numWindows; }
+};
+
+
+// Needed by our benchmarks
+struct tmbase {
+};
+
+
+struct ReadSet {
+    std::atomic<uint64_t>*  log[TX_MAX_LOADS];
+    uint64_t                size {0};          // Number of loads in the readSet for the current transaction
+
+    inline bool validate(uint64_t rClock, uint64_t tid) {
+        for (uint64_t i = 0; i < size; i++) {
+            uint64_t sl = log[i]->load(std::memory_order_acquire);
+            if (!isUnlockedOrLockedByMe(rClock, tid, sl)) return false;
+        }
+        return true;
+    }
+
+    inline void add(std::atomic<uint64_t>* mutex) {
+        log[size++] = mutex;
+        assert (size != TX_MAX_LOADS);
+    }
+};
+
+// Size of an Optane block in 64bit words. Used to prevent "false sharing".
+#define PM_PAD  (256/sizeof(uint64_t))
+
+// The persistent metadata is a 'header'.
+struct PMetadata {
+    // Changes with the persistent layout, so that pools in another layout are not used. Bumped when
+    // EsLoco2 moved to quarter-power-of-two size classes.
+    static const uint64_t   MAGIC_ID = 0x1337bac4;
+    uint64_t                root {0};       // Offset of the root pointers from the start of the region. Immutable once assigned
+    uint64_t                id {0};
+    uint64_t                padding[8-2];
+    // Each thread has its own p_seq
+    volatile uint64_t       p_seq[REGISTRY_MAX_THREADS*PM_PAD];
+    PMetadata() {
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+            p_seq[it*PM_PAD] = 1;
+            PWB(&p_seq[it*PM_PAD]);
+        }
+    }
+};
+
+// Used to identify aborted transactions
+struct AbortedTx {};
+static constexpr AbortedTx AbortedTxException {};
+
+// Volatile log (write-set)
+// One day in the future, if we want to suport large transactions we can make this a dynamic array.
+struct AppendLog {
+    static const uint64_t CHUNK_SIZE = 16*1024*1024ULL; // Maximum transaction size (in number of modified persist<T>)
+    uint64_t   size {0};
+    void**     addr;
+    AppendLog* next {nullptr};
+
+    AppendLog() {
+        addr = new void*[CHUNK_SIZE];
+    }
+    ~AppendLog() {
+        delete[] addr;
+    }
+
+    inline void add(void* ptr) {
+        addr[size++] = ptr;
+        assert (size != CHUNK_SIZE);
+    }
+
+    // Apply all the modifications on each back.
+    inline void applyOnBack() {
+        for (uint64_t i = 0; i < size; i++) {
+            persist<uint64_t>* p = (persist<uint64_t>*)addr[i];
+            p->back = p->main;
+        }
+    }
+
+    // Rollback modifications: called from abortTx() to revert changes.
+    inline void rollbackMain() {
+        for (uint64_t i = 0; i < size; i++) {
+            persist<uint64_t>* p = (persist<uint64_t>*)addr[i];
+            p->main = p->back;
+        }
+    }
+
+    // Unlock the lseq in all persist
+    inline void unlock(uint64_t nextClock, uint64_t tid) {
+        for (uint64_t i = 0; i < size; i++) {
+            persist<uint64_t>* p = (persist<uint64_t>*)addr[i];
+            p->lseq.store(composeLseq(0,tid,nextClock), std::memory_order_release);
+            // We don't really need to flush, but let's do it anyways: it's faster than
+            // letting the cache coherence system do it for us.
+            //PWB(p);
+        }
+        // No need for fence, flushing is just to improve performance
+    }
+
+    // TODO: fine tune this to see if it really is an optimization in all cases
+    inline void flushPWB() {
+        // If we have more than 16 modified persist<T>, we just flush all, otherwise,
+        // we try to group per cache line, in the hopes of saving a couple of PWB().
+        if (size > 16) {
+            for (uint64_t i = 0; i < size; i++) PWB(addr[i]);
+        } else {
+            for (uint64_t i = 0; i < size; i++) {
+                // Check if we already flushed this cache line
+                const void* addr_i_cl = ADDR2CL(addr[i]);
+                bool flushit = true;
+                for (uint64_t j = 0; j < i; j++) {
+                    if (ADDR2CL(addr[j]) == addr_i_cl) {
+                        flushit = false;
+                        break;
+                    }
+                }
+                if (flushit) PWB(addr[i]);
+            }
+        }
+    }
+};
+
+
+class Trinity;
+
+// Thread-local data
+struct OpData {
+    uint64_t              tid;
+    Trinity*              tm {nullptr};         // The pool this OpData belongs to
+    PMetadata*            pmd {nullptr};        // Header of the pool, at the start of its region
+    uint8_t*              regionEnd {nullptr};  // End of the range reserved for the pool
+    uint64_t              rClock {0};
+    int                   tx_type {TX_IS_NONE}; // This is used by persist::load() to figure out if it needs to save a load on the read-set or not
+    ReadSet               readSet;              // The (volatile) read set
+    AppendLog             v_log {};             // Write-set: The append-only log of modified persist<T>
+    uint64_t              nestedTrans {0};      // Number of nested transactions
+    uint64_t              myrand;
+    uint64_t              padding[16];
+};
+
+// This is used by addToLog() to know which OpData instance to use for the current transaction
+extern thread_local OpData* tl_opdata;
+
+extern Trinity gTrinity;
+
+
+class Trinity {
+private:
+    // Padding on x86 should be on 2 cache lines
+    static const int                       CLPAD = 128/sizeof(uintptr_t);
+    bool                                   reuseRegion {false};                 // used by the constructor and initialization
+    int                                    pfd {-1};
+    int                                    pmapFlags {0};                       // used to mmap() the file when growing the region
+    PMetadata*                             pmd {nullptr};                       // the header is at the start of the region
+    uint8_t*                               regionBase {nullptr};
+    uint64_t                               regionMaxSize;                       // reserved address range
+    uint64_t                               regionSize {0};                      // currently mapped, up to regionMaxSize
+    std::mutex                             growMutex;
+    alignas(128) std::atomic<uint64_t>     gClock {1};
+    alignas(128) OpData                   *opDesc;
+    EsLoco2<persist_pi>                    esloco {};      // position-independent, so the pool can be mapped anywhere
+
+public:
+    struct tmbase : public trinitytl2::tmbase { };
+
+    Trinity() : Trinity(PM_FILE_NAME, (uint8_t*)PM_REGION_BEGIN, PM_REGION_SIZE, PM_REGION_INITIAL_SIZE) { }
+
+    // Opens the pool in 'filename', or creates it with 'initialRegionSize' bytes if the file doesn't exist.
+    // The pool is mapped at 'regionAddr' and can grow up to 'maxRegionSize', therefore, the address
+    // ranges of the pools in the same process must not overlap.
+    // If 'regionAddr' is nullptr the pool is mapped wherever the kernel finds room for it. Its address may then
+    // change from one run to the next, and the pointers in the pool must be persist_ptr (see persist_pi).
+    Trinity(const char* filename, uint8_t* regionAddr, uint64_t maxRegionSize, uint64_t initialRegionSize)
+            : regionMaxSize{maxRegionSize} {
+        opDesc = new OpData[REGISTRY_MAX_THREADS];
+        for (uint64_t it=0; it < REGISTRY_MAX_THREADS; it++) {
+            opDesc[it].tid = it;
+            opDesc[it].tm = this;
+            opDesc[it].myrand = (it+1)*12345678901234567ULL;
+        }
+        mapPersistentRegion(filename, regionAddr, maxRegionSize, initialRegionSize);
+    }
+
+    // Opens (or creates) a pool at whichever address is available
+    Trinity(const char* filename, uint64_t maxRegionSize, uint64_t initialRegionSize)
+            : Trinity(filename, nullptr, maxRegionSize, initialRegionSize) { }
+
+    ~Trinity() {
+        delete[] opDesc;
+        // The global pool stays mapped until the process exits because static objects in other compilation
+        // units may still access it. The other pools are closed here.
+        if (this != &gTrinity) {
+            munmap(regionBase, regionMaxSize);
+            close(pfd);
+        }
+    }
+
+    static std::string className() { return "Trinity-TL2"; }
+
+    void mapPersistentRegion(const char* filename, uint8_t* regionAddr, const uint64_t maxRegionSize, const uint64_t initialRegionSize) {
+        regionSize = roundToPage(initialRegionSize < maxRegionSize ? initialRegionSize : maxRegionSize);
+        // Check that the header with the logs leaves at least half the memory available to the user
+        if (sizeof(PMetadata) > regionSize/2) {
+            printf("ERROR: the size of the header in persistent memory is so large that it takes more than half the whole persistent memory\n");
+            printf("Please reduce some of the settings in TrinityTL2.hpp and try again\n");
+            assert(false);
+        }
+        // Check if the file already exists or not
+        struct stat buf;
+        if (stat(filename, &buf) == 0) {
+            // File exists, and it may have grown in a previous run
+            pfd = open(filename, O_RDWR|O_CREAT, 0755);
+            assert(pfd >= 0);
+            reuseRegion = true;
+            if ((uint64_t)buf.st_size > regionSize) regionSize = roundToPage(buf.st_size);
+            if (regionSize > roundToPage(maxRegionSize)) {
+                printf("ERROR: file %s has %ld bytes, which is more than PM_REGION_SIZE\n", filename, (long)buf.st_size);
+                assert(false);
+            }
+        } else {
+            // File doesn't exist
+            pfd = open(filename, O_RDWR|O_CREAT, 0755);
+            assert(pfd >= 0);
+        }
+        // Reserve the addresses for the largest the region can grow, so that it can grow in place.
+        // We may fail because the address is not available. Retry at most 4 times, then give up.
+        regionAddr = reserveRegion(regionAddr, maxRegionSize);
+        regionBase = regionAddr;
+        pmd = (PMetadata*)regionAddr;
+        for (uint64_t it=0; it < REGISTRY_MAX_THREADS; it++) {
+            opDesc[it].pmd = pmd;
+            opDesc[it].regionEnd = regionAddr + maxRegionSize;
+        }
+        // Map the file over the start of the reserved range. Try one time to mmap() with DAX and if it fails, retry without DAX.
+        if (fallocate(pfd, 0, 0, regionSize) != 0) {
+            perror("fallocate() error");
+            assert(false);
+        }
+        pmapFlags = MAP_SHARED_VALIDATE | MAP_SYNC | MAP_FIXED;
+        void* got_addr = mmap(regionAddr, regionSize, (PROT_READ | PROT_WRITE), pmapFlags, pfd, 0);
+        if (got_addr == MAP_FAILED) {
+            // Failed to mmap(). Let's try without DAX.
+            pmapFlags = MAP_SHARED_VALIDATE | MAP_FIXED;
+            got_addr = mmap(regionAddr, regionSize, (PROT_READ | PROT_WRITE), pmapFlags, pfd, 0);
+            if (got_addr != MAP_FAILED) printf("WARNING: running without DAX enabled\n");
+        }
+        if (got_addr == MAP_FAILED) {
+            perror("ERROR: mmap() returned MAP_FAILED !!! ");
+            assert(false);
+        }
+        // A pool whose creation did not complete has no id yet and is cleared. One with the id of another
+        // layout (from an older version of this PTM) can not be used, because the allocator would corrupt it.
+        if (reuseRegion && pmd->id != PMetadata::MAGIC_ID) {
+            if (pmd->id != 0) {
+                fprintf(stderr, "ERROR: file %s has a pool in a different format. Delete the file to create a new pool\n", filename);
+                std::abort();
+            }
+            reuseRegion = false;
+        }
+        // If the file has just been created or if the header is not consistent, clear everything.
+        // Otherwise, re-use and recover to a consistent state.
+        if (reuseRegion) {
+            recover();
+            transaction([&]{
+            	esloco.init(regionAddr+sizeof(PMetadata), regionSize-sizeof(PMetadata), false,
+            	            maxRegionSize-sizeof(PMetadata), [this] (uint8_t* end) { return growRegion(end); });
+            }, TX_IS_READ);
+        } else {
+            new (regionAddr) PMetadata();
+            // We reset the entire memory region because the 'lseq' have to be zero
+            resetPM(regionAddr, regionSize);
+            transaction([&]{
+            	esloco.init(regionAddr+sizeof(PMetadata), regionSize-sizeof(PMetadata), true,
+            	            maxRegionSize-sizeof(PMetadata), [this] (uint8_t* end) { return growRegion(end); });
+            	pmd->root = (uint8_t*)esloco.malloc(sizeof(persist_ptr<void>)*MAX_ROOT_POINTERS) - regionBase;
+            }, TX_IS_UPDATE);
+            PWB(&pmd->root);
+            PFENCE();
+            pmd->id = PMetadata::MAGIC_ID;
+            PWB(&pmd->id);
+            PFENCE();
+        }
+        // The initialization of the pool is not part of the workload
+        PTM_STATS_RESET();
+    }
+
+    static uint64_t roundToPage(uint64_t size) {
+        const uint64_t pageSize = sysconf(_SC_PAGESIZE);
+        return (size + pageSize - 1)/pageSize*pageSize;
+    }
+
+    // Reserves the address range without any memory behind it, so that the file can later be mapped there.
+    // With a nullptr the kernel picks the address. Returns the start of the reserved range.
+    static uint8_t* reserveRegion(uint8_t* regionAddr, const uint64_t regionSize) {
+        void* got_addr = NULL;
+        if (regionAddr == nullptr) {
+            got_addr = mmap(nullptr, regionSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (got_addr == MAP_FAILED) {
+                perror("ERROR: mmap() returned MAP_FAILED !!! ");
+                assert(false);
+            }
+            return (uint8_t*)got_addr;
+        }
+        for (int i = 0; i < 4; i++) {
+            got_addr = mmap(regionAddr, regionSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (got_addr == regionAddr || got_addr == MAP_FAILED) break;
+            // mmap() worked but in wrong address. Let's unmap() and try again.
+            munmap(got_addr, regionSize);
+            // Sleep for a second before retrying the mmap()
+            usleep(1000);
+        }
+        if (got_addr == MAP_FAILED) {
+            perror("ERROR: mmap() returned MAP_FAILED !!! ");
+            assert(false);
+        }
+        if (got_addr != regionAddr) {
+            printf("got_addr = %p instead of %p\n", got_addr, regionAddr);
+            perror("Retry mmap() in a couple of seconds");
+            std::exit(42);
+        }
+        return regionAddr;
+    }
+
+    // Extends the file from 'oldSize' to 'newSize' bytes and maps the new part at the same offset from 'regionAddr'.
+    // fallocate() fills the new part with zeros, which is the same as a formatted region, and fdatasync() makes
+    // the new size durable before any transaction stores there.
+    static bool growMapping(int fd, uint8_t* regionAddr, uint64_t oldSize, uint64_t newSize, int flags) {
+        if (newSize <= oldSize) return true;
+        if (fallocate(fd, 0, oldSize, newSize-oldSize) != 0 || fdatasync(fd) != 0) {
+            perror("ERROR: fallocate() failed to grow the file");
+            return false;
+        }
+        if (mmap(regionAddr+oldSize, newSize-oldSize, (PROT_READ | PROT_WRITE), flags, fd, oldSize) == MAP_FAILED) {
+            perror("ERROR: mmap() returned MAP_FAILED !!! ");
+            return false;
+        }
+        return true;
+    }
+
+    // Called by the allocator when it reaches the end of the region, possibly from within a transaction.
+    // Grows the region in steps of PM_REGION_GROW_SIZE until it goes at least up to 'end' and returns
+    // the new end of the region, which is left as it was if the region can not grow.
+    uint8_t* growRegion(uint8_t* end) {
+        std::lock_guard<std::mutex> lock(growMutex);
+        uint8_t* regionAddr = regionBase;
+        // Some other thread may have grown it already
+        if (end <= regionAddr + regionSize) return regionAddr + regionSize;
+        const uint64_t growSize = PM_REGION_GROW_SIZE;
+        uint64_t newSize = (end - regionAddr + growSize - 1)/growSize*growSize;
+        newSize = roundToPage(newSize < regionMaxSize ? newSize : regionMaxSize);
+        if (newSize > regionSize && growMapping(pfd, regionAddr, regionSize, newSize, pmapFlags)) regionSize = newSize;
+        return regionAddr + regionSize;
+    }
+
+    // This is equivalent to
+    // std:memset(regionAddr+sizeof(PMetadata), 0, regionSize-sizeof(PMetadata));
+    void resetPM(uint8_t* regionAddr, const uint64_t regionSize) {
+        // TODO: we can optimize by doing a memcmp() first, block by block
+        if (regionSize > 4*1024*1024*1024ULL) printf("memset() on large PM region. This will take a while...\n");
+        const uint64_t kPageSize = 4*1024*1024; // 4 MB pages
+        uint8_t* zpage = new uint8_t[kPageSize];
+        std::memset(zpage, 0, kPageSize);
+        uint8_t* page = regionAddr + sizeof(PMetadata);
+        uint8_t* end = regionAddr + regionSize;
+        std:memset(page, 0, ((uint64_t)page) % kPageSize);
+        while (page+kPageSize < end) {
+            if (!std::memcmp(page, zpage, kPageSize)) std::memset(page, 0, kPageSize);
+            page += kPageSize;
+        }
+        // TODO: last section
+        delete[] zpage;
+    }
+
+    inline void beginTx(OpData* myd, const int tid) {
+        // Clear the logs of the previous transaction
+        myd->v_log.size = 0;
+        myd->readSet.size = 0;
+        myd->rClock = gClock.load(); // This is GVRead()
+        if (myd->tx_type == TX_IS_UPDATE) {
+            pmd->p_seq[tid*PM_PAD] = myd->rClock;
+            PWB(&pmd->p_seq[tid*PM_PAD]);
+            // No need for pfence because the first pstore() will issue a CAS
+        }
+    }
+
+    // This PTM uses redo-log with eager locking, which means that by now all locks have been acquired.
+    inline bool endTx(OpData* myd, const int tid) {
+        // Check if this is a read-only transaction and if so, commit immediately
+        if (myd->v_log.size == 0) return true;
+        // This fence is needed by undo log to prevent re-ordering with the last store
+        // and the reading of the gClock.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // Validate the read-set
+        if (!myd->readSet.validate(myd->rClock, tid)) {
+            abortTx(myd, tid);
+            return false;
+        }
+        // Flush seq+main modifications
+        myd->v_log.flushPWB();
+        // The FAA is 'hijacked' to act as a persistence fence
+        uint64_t nextClock = gClock.fetch_add(1)+1;
+        // Modifications in persist<T> must be flushed before advancing p_seq
+        pmd->p_seq[tid*PM_PAD] = nextClock;
+        PWB(&pmd->p_seq[tid*PM_PAD]);
+        PSYNC();
+        // Apply modifications on back
+        myd->v_log.applyOnBack();
+        // Unlock and set new sequence and flush them (no fence needed)
+        myd->v_log.unlock(nextClock, tid);
+        PTM_STATS_WRITE_SET(myd->v_log.size);
+        PTM_STATS_TX_END();
+        return true;
+    }
+
+    // This is called only from persist::load()/store() and endTx() if the read-set validation fails.
+    inline void abortTx(OpData* myd, const int tid) {
+        // Rollback modifications and flush them
+        myd->v_log.rollbackMain();
+        myd->v_log.flushPWB();
+        // The FAA acts a PFENCE() and seq-cst fence
+        uint64_t nextClock = gClock.fetch_add(1)+1;
+        pmd->p_seq[tid*PM_PAD] = nextClock;
+        PWB(&pmd->p_seq[tid*PM_PAD]);
+        PFENCE();                               // Modifications in persist<T> are done before incrementing p_seq
+        // Unlock and set new sequence and flush them (no fence needed)
+        myd->v_log.unlock(nextClock, tid);
+        PTM_STATS_ABORT();
+    }
+
+    template<typename F> void transaction(F&& func, int txType=TX_IS_UPDATE) {
+        const int tid = ThreadRegistry::getTID();
+        OpData* myd = &opDesc[tid];
+        if (myd->nestedTrans > 0) {
+            func();
+            return ;
+        }
+        if (tl_opdata != nullptr) {
+            // It would overwrite tl_opdata and the outer transaction would write on the wrong pool
+            fprintf(stderr, "ERROR: Can not start a transaction on a pool from within a transaction on another pool\n");
+            std::abort();
+        }
+        tl_opdata = myd;
+        myd->tx_type = txType;
+        ++myd->nestedTrans;
+        PTM_STATS_TX_BEGIN();
+        for (uint64_t attempt = 0; ; attempt++) {
+            backoff(myd, attempt);
+            beginTx(myd, tid);
+            try {
+                func();
+            } catch (AbortedTx&) {
+                abortTx(myd, tid);
+                continue;
+            }
+            if (endTx(myd, tid)) break;
+        }
+        tl_opdata = nullptr;
+        --myd->nestedTrans;
+    }
+
+    // It's silly that these have to be static, but we need them for the (SPS) benchmarks due to templatization
+    template<typename F> static void updateTx(F&& func) { gTrinity.transaction(func, TX_IS_UPDATE); }
+    template<typename F> static void readTx(F&& func) { gTrinity.transaction(func, TX_IS_READ); }
+    // There are no sequential durable transactions in TL2 but we "emulate it" with a concurrent+durable tx
+    template<typename F> static void updateTxSeq(F&& func) { gTrinity.transaction(func, TX_IS_UPDATE); }
+    template<typename F> static void readTxSeq(F&& func) { gTrinity.transaction(func, TX_IS_READ); }
+    // Transactions on a pool other than the global one. They can only access objects of that pool.
+    template<typename F> static void updateTx(Trinity& pool, F&& func) { pool.transaction(func, TX_IS_UPDATE); }
+    template<typename F> static void readTx(Trinity& pool, F&& func) { pool.transaction(func, TX_IS_READ); }
+
+    // The pool of the ongoing transaction, or the global pool if there is no transaction
+    static inline Trinity& currentPool() {
+        OpData* const myd = tl_opdata;
+        return (myd != nullptr) ? *myd->tm : gTrinity;
+    }
+
+    // The array of root pointers of this pool
+    inline persist_ptr<void>* roots() {
+        return (persist_ptr<void>*)(regionBase + pmd->root);
+    }
+
+
+    // Scan the PM for any persist<> with a sequence equal to p_seq.
+    // If there are any, revert them by copying back to main and resetting
+    // the seq to zero.
+    //
+    // If p_seq == seq+1 then copy back to main
+    // If p_seq == seq   then copy main to back
+    void recover() {
+        // The persists start after PMetadata
+        persist<uint64_t>* pstart = (persist<uint64_t>*)(regionBase + sizeof(PMetadata));
+        persist<uint64_t>* pend = (persist<uint64_t>*)(regionBase + regionSize);
+        persist<uint64_t>* p; // iterator variable
+        for (p = pstart; p < pend; p++) {
+            const lseq_t lseq = p->lseq.load(std::memory_order_relaxed);
+        	if (isUnlocked(lseq)) continue;
+        	const uint64_t tid = lseq2tid(lseq);
+            if (lseq2seq(lseq) == pmd->p_seq[tid*PM_PAD]) {
+                p->main = p->back;    // ordered store
+            } else {
+                p->back = p->main;    // ordered store
+            }
+            p->lseq = 0;              // ordered store
+            PWB(p);
+        }
+        PSYNC();
+        // The global clock must be equal to the highest of the p_seqs
+        uint64_t maxClock = 0;
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+            if (pmd->p_seq[it*PM_PAD] > maxClock) maxClock = pmd->p_seq[it*PM_PAD];
+        }
+        gClock.store(maxClock);
+    }
+
+    // Random number generator used by the backoff scheme
+    inline uint64_t marsagliaXORV(uint64_t x) {
+        if (x == 0) x = 1;
+        x ^= x << 6;
+        x ^= x >> 21;
+        x ^= x << 7;
+        return x;
+    }
+
+    // Backoff for a random amount of steps in the range [16, 16*attempt]. Inspired by TL2
+    inline void backoff(OpData* myopd, uint64_t attempt) {
+        if (attempt < 3) return;
+        if (attempt == 10000) printf("Ooops, looks like we're stuck attempt=%ld\n", attempt);
+        myopd->myrand = marsagliaXORV(myopd->myrand);
+        uint64_t stall = (myopd->myrand & attempt) + 1;
+        stall *= 16;
+        std::atomic<uint64_t> iter {0};
+        while (iter.load() < stall) iter.fetch_add(1);
+        if (stall > 1000) std::this_thread::yield();
+    }
+
+    // Transactions that return the value of func(), moved out to the caller after the commit
+    template<typename R,class F> inline static R readTx(F&& func) {
+        ptmtx::TxResult<R> res;
+        gTrinity.transaction([&]() {res.run(func);}, TX_IS_READ);
+        return res.take();
+    }
+    template<typename R,class F> inline static R updateTx(F&& func) {
+        ptmtx::TxResult<R> res;
+        gTrinity.transaction([&]() {res.run(func);}, TX_IS_UPDATE);
+        return res.take();
+    }
+
+    template <typename T, typename... Args> static T* tmNew(Args&&... args) {
+        OpData* const myd = tl_opdata;
+        if (myd->nestedTrans == 0) {
+            printf("ERROR: Can not allocate outside a transaction\n");
+            return nullptr;
+        }
+        void* ptr = myd->tm->esloco.malloc(sizeof(T));
+        // If we get nullptr then we've ran out of PM space
+        assert(ptr != nullptr);
+        // If there is an abort during the 'new placement', the transactions rolls
+        // back and will automatically revert the changes in the allocator metadata.
+        new (ptr) T(std::forward<Args>(args)...);  // new placement
+        return (T*)ptr;
+    }
+
+    template<typename T> static void tmDelete(T* obj) {
+        if (obj == nullptr) return;
+        OpData* const myd = tl_opdata;
+        if (myd->nestedTrans == 0) {
+            printf("ERROR: Can not de-allocate outside a transaction\n");
+            return;
+        }
+        obj->~T();
+        myd->tm->esloco.free(obj);
+    }
+
+    static void* tmMalloc(size_t size) {
+        OpData* const myopd = tl_opdata;
+        if (myopd->nestedTrans == 0) {
+            printf("ERROR: Can not allocate outside a transaction\n");
+            return nullptr;
+        }
+        void* obj = myopd->tm->esloco.malloc(size);
+        return obj;
+    }
+
+    static void tmFree(void* obj) {
+        if (obj == nullptr) return;
+        OpData* const myopd = tl_opdata;
+        if (myopd->nestedTrans == 0) {
+            printf("ERROR: Can not de-allocate outside a transaction\n");
+            return;
+        }
+        myopd->tm->esloco.free(obj);
+    }
+
+    static void* pmalloc(size_t size) {
+        OpData* const myopd = tl_opdata;
+        if (myopd->nestedTrans == 0) {
+            printf("ERROR: Can not allocate outside a transaction\n");
+            return nullptr;
+        }
+        return myopd->tm->esloco.malloc(size);
+    }
+
+    static void pfree(void* obj) {
+        if (obj == nullptr) return;
+        OpData* const myopd = tl_opdata;
+        if (myopd->nestedTrans == 0) {
+            printf("ERROR: Can not de-allocate outside a transaction\n");
+            return;
+        }
+        myopd->tm->esloco.free(obj);
+    }
+
+    // Get a root pointer
+    static inline void* get_object(int idx) {
+        return currentPool().roots()[idx].pload();
+    }
+
+    // Set a root pointer
+    static inline void put_object(int idx, void* obj) {
+        currentPool().roots()[idx].pstore(obj);
+    }
+
+    // Statistics of the persistent memory allocator
+    using AllocStats = EsLoco2<persist_pi>::Stats;
+
+    // Fills 'stats' with a snapshot of the allocator, up to 'detail' (see AllocStats::Detail).
+    // Call this from within a transaction (a readTx is enough) to get a consistent snapshot.
+    static void getAllocStats(AllocStats& stats, AllocStats::Detail detail=AllocStats::kAll) {
+        currentPool().esloco.getStats(stats, detail);
+    }
+
+    // Dumps the allocator statistics to stdout, in its own read-only transaction
+    static void printAllocStats() {
+        AllocStats stats;
+        readTx([&] () { getAllocStats(stats); });
+        printf("%s", stats.toString().c_str());
+    }
+
+    // Online compaction of the global pool (see the comment on EsLoco2::compactBegin()).
+    // The windows of the pool with less than 'maxLiveRatio' of their bytes in use are evacuated:
+    // 'relocator' must move to a new allocation (in its own small transactions) each live object
+    // for which mustRelocate() returns true. This can run while other threads execute transactions.
+    // Returns the number of bytes reclaimed, or zero if there is another compaction running.
+    static uint64_t compact(const std::function<void()>& relocator, double maxLiveRatio=0.5) {
+        auto& esloco = gTrinity.esloco;
+        if (!esloco.compactBegin()) return 0;
+        bool more = true;
+        for (uint64_t w = 0; more; w++) {
+            updateTx([&] () { more = esloco.compactScan(w); });
+        }
+        uint64_t reclaimed = 0;
+        if (esloco.compactSelect(maxLiveRatio) != 0) {
+            for (int it = 0; it <= REGISTRY_MAX_THREADS; it++) {
+                updateTx([&] () { esloco.compactDetach(it); });
+            }
+            relocator();
+            // From the last to the first window, so that contiguous windows at the end can go back to the top
+            for (uint64_t w = esloco.compactNumWindows(); w-- > 0; ) {
+                uint64_t bytes = 0;
+                updateTx([&] () { bytes = esloco.compactReclaim(w); });
+                reclaimed += bytes;
+            }
+            for (uint64_t w = 0; w < esloco.compactNumWindows(); w++) {
+                updateTx([&] () { esloco.compactRelist(w); });
+            }
+        }
+        esloco.compactEnd();
+        return reclaimed;
+    }
+
+    // Returns true if the object at 'ptr' must be relocated by the ongoing compaction
+    static inline bool mustRelocate(const void* ptr) {
+        return currentPool().esloco.isEvacuating(ptr);
+    }
+};
+
+
+// Store interposing: acquire the lock and write in 'main'
+template<typename T> inline void persist<T>::pstore(T newVal) {
+    OpData* const myd = tl_opdata;
+    const uint8_t* valaddr = (uint8_t*)this;
+    // Do not log nor lock this store unless it's in the memory region and we're in a transaction
+    if (myd == nullptr || valaddr < (uint8_t*)myd->pmd || valaddr >= myd->regionEnd) {
+        main = (uint64_t)newVal;
+        return;
+    }
+    PTM_STATS_STORE(sizeof(T));
+    lseq_t sl = lseq.load(std::memory_order_acquire);
+    if (isUnlockedOrLockedByMe(myd->rClock, myd->tid, sl)) {
+    	const uint64_t p_seq = myd->pmd->p_seq[myd->tid*PM_PAD];
+        if ((sl & LOCKED) || lseq.compare_exchange_strong(sl, composeLseq(LOCKED, myd->tid, p_seq))) {
+            // If it's the first time we touch this persist<T> in this tx: log it.
+            if (isUnlocked(sl)) myd->v_log.add(this);
+            main = (uint64_t)newVal;
+            return;
+        }
+    }
+    throw AbortedTxException;
+}
+
+// This is similar to an undo-log load interposing: do single check
+template<typename T> inline T persist<T>::pload() const {
+    OpData* const myd = tl_opdata;
+    // Check if we're outside a transaction
+    if (myd == nullptr) return (T)main;
+    uint64_t lval = main;
+    lseq_t sl = lseq.load(std::memory_order_acquire);
+    if (!isUnlockedOrLockedByMe(myd->rClock, myd->tid, sl)) throw AbortedTxException;
+    // When in a write tx, loads must be added to the read-set
+    if (myd->tx_type == TX_IS_UPDATE && isUnlocked(sl)) myd->readSet.add((std::atomic<uint64_t>*)&lseq);
+    return (T)lval;
+}
+
+
+//
+// Wrapper methods to the global TM instance. The user should use these:
+//
+template<typename R, typename F> static R updateTx(F&& func) { return gTrinity.updateTx<R>(func); }
+template<typename R, typename F> static R readTx(F&& func) { return gTrinity.readTx<R>(func); }
+template<typename F> static void updateTx(F&& func) { gTrinity.transaction(func, TX_IS_UPDATE); }
+template<typename F> static void readTx(F&& func) { gTrinity.transaction(func, TX_IS_READ); }
+template<typename F> static void updateTx(Trinity& pool, F&& func) { pool.transaction(func, TX_IS_UPDATE); }
+template<typename F> static void readTx(Trinity& pool, F&& func) { pool.transaction(func, TX_IS_READ); }
+template<typename T, typename... Args> T* tmNew(Args&&... args) { return Trinity::tmNew<T>(args...); }
+template<typename T> void tmDelete(T* obj) { Trinity::tmDelete<T>(obj); }
+static void* tmMalloc(size_t size) { return Trinity::tmMalloc(size); }
+static void tmFree(void* obj) { Trinity::tmFree(obj); }
+
+
+//
+// Place these in a .cpp if you include this header from multiple files (compilation units)
+//
+// Global/singleton to hold all the thread registry functionality
+ThreadRegistry gThreadRegistry {};
+// PTM singleton
+Trinity gTrinity {};
+// Thread-local data of the current ongoing transaction
+thread_local OpData* tl_opdata {nullptr};
+// This is where every thread stores the tid it has been assigned when it calls getTID() for the first time.
+// When the thread dies, the destructor of ThreadCheckInCheckOut will be called and de-register the thread.
+thread_local ThreadCheckInCheckOut tl_tcico {};
+// Helper function for thread de-registration
+void thread_registry_deregister_thread(const int tid) {
+    gThreadRegistry.deregister_thread(tid);
+}
+
+}
+#endif /* _TRINITY_TL2_PERSISTENT_TRANSACTIONAL_MEMORY_H_ */
@@ -1,1364 +1,2328 @@
-/*
- * Copyright 2018-2020
- *   Andreia Correia <andreia.veiga@unine.ch>
- *   Pedro Ramalhete <pramalhe@gmail.com>
- *   Pascal Felber <pascal.felber@unine.ch>
- *
- * This work is published under the MIT license. See LICENSE.txt
- */
-#pragma once
-
-#include <atomic>
-#include <cassert>
-#include <functional>
-#include <cstring>
-#include <thread>       // Needed by this_thread::yield()
-#include <sys/mman.h>   // Needed if we use mmap()
-#include <sys/types.h>  // Needed by open() and close()
-#include <sys/stat.h>
-#include <linux/mman.h> // Needed by MAP_SHARED_VALIDATE
-#include <fcntl.h>
-#include <unistd.h>     // Needed by close()
-#include <filesystem>   // Needed by std::filesystem::space()
-#include <type_traits>
-#include <sched.h>      // sched_setaffinity()
-#include <csetjmp>      // Needed by sigjmp_buf
-#include <cstdlib>      // Needed by exit()
-
-/*
- * <h1> Trinity + Volatile Region + Persistent TL2 + volatile locks</h1>
- *
- * This variant has a volatile replica of 'main', which means we can use ranges and it is much faster.
- * There is a volatile region (VR) and a PM region. Each consecutive 24 bytes (3x64bit words) in the VR region
- * maps to a cacheline in the PM region. A cacheline in the PM region is composed of:
- * main    - 24 bytes
- * back    - 24 bytes
- * seq     - 8 bytes
- * padding - 8 bytes
- *
- * For concurrency we use something similar to TL2, but not quite the same:
- * - Load interposing is made with post-validation, no pre-validation is made. See persistvr::load();
- * - On abort, we must increment the global clock;
- * - A full fence is done before the commit of the transaction in endTx(), to prevent re-ordering
- *   of the last modification in the transaction with the rad-set validation;
- * - The global clock and the locks are all kept in volatile memory for efficiency;
- * - The write-set does not contain any data. On commit, the data is taken from VR and written to PR
- *   using the Trinity algorithm. On abort, the opposite is done;
- *
- * Other characteristics:
- * - Durable commit is done after concurrent commit, without modification on PM unless the tx is (concurrent) committed;
- * - Supports ranges
- * - Has improved error handling in mmap() and file opening
- *
- * See durable transactions paper
- */
-
-
-// Macros needed for persistence
-#ifdef PWB_IS_CLFLUSH
-  /*
-   * More info at http://elixir.free-electrons.com/linux/latest/source/arch/x86/include/asm/special_insns.h#L213
-   * Intel programming manual at https://www.intel.com/content/dam/www/public/us/en/documents/manuals/64-ia-32-architectures-optimization-manual.pdf
-   * Use these for Broadwell CPUs (cervino server)
-   */
-  #define PWB(addr)              __asm__ volatile("clflush (%0)" :: "r" (addr) : "memory")                      // Broadwell only works with this.
-  #define PFENCE()               {}                                                                             // No ordering fences needed for CLFLUSH (section 7.4.6 of Intel manual)
-  #define PSYNC()                {}                                                                             // For durability it's not obvious, but CLFLUSH seems to be enough, and PMDK uses the same approach
-#elif PWB_IS_CLWB
-  /* Use this for CPUs that support clwb, such as the SkyLake SP series (c5 compute intensive instances in AWS are an example of it) */
-  #define PWB(addr)              __asm__ volatile(".byte 0x66; xsaveopt %0" : "+m" (*(volatile char *)(addr)))  // clwb() only for Ice Lake onwards
-  #define PFENCE()               __asm__ volatile("sfence" : : : "memory")
-  #define PSYNC()                __asm__ volatile("sfence" : : : "memory")
-#elif PWB_IS_NOP
-  /* pwbs are not needed for shared memory persistency (i.e. persistency across process failure) */
-  #define PWB(addr)              {}
-  #define PFENCE()               __asm__ volatile("sfence" : : : "memory")
-  #define PSYNC()                __asm__ volatile("sfence" : : : "memory")
-#elif PWB_IS_CLFLUSHOPT
-  /* Use this for CPUs that support clflushopt, which is most recent x86 */
-  #define PWB(addr)              __asm__ volatile(".byte 0x66; clflush %0" : "+m" (*(volatile char *)(addr)))    // clflushopt (Kaby Lake)
-  #define PFENCE()               __asm__ volatile("sfence" : : : "memory")
-  #define PSYNC()                __asm__ volatile("sfence" : : : "memory")
-#else
-#error "You must define what PWB is. Choose PWB_IS_CLFLUSHOPT if you don't know what your CPU is capable of"
-#endif
-
-
-namespace trinityvrtl2 {
-
-//
-// User configurable variables.
-// Feel free to change these if you need larger transactions, or more threads.
-//
-
-// Start address of persistent memory region
-#ifndef PM_REGION_BEGIN
-#define PM_REGION_BEGIN 0x7fea00000000
-#endif
-// Size of the persistent memory region
-#ifndef PM_REGION_SIZE
-#define PM_REGION_SIZE 1024*1024*1024ULL // 1GB for now
-#endif
-// Name of persistent file mapping (back)
-#ifndef PM_FILE_NAME
-#define PM_FILE_NAME   "/dev/shm/trinityvrtl2_shared"
-#endif
-
-// Maximum number of registered threads that can execute transactions
-static const int REGISTRY_MAX_THREADS = 128;
-
-// End address of mapped persistent memory
-static uint8_t* PM_REGION_END = ((uint8_t*)PM_REGION_BEGIN+PM_REGION_SIZE);
-// Maximum number of root pointers available for the user
-static const uint64_t MAX_ROOT_POINTERS = 64;
-
-static const char * VFILE_NAME = "/dev/shm/trinityvrtl2_shared_main";
-// Start address of volatile memory region (VR)
-static uint8_t* VREGION_ADDR = (uint8_t*)0x7f0000000000;
-
-
-
-// TL2 constants
-static const uint64_t LOCKED  = 0x8000000000000000ULL;
-static const int TX_IS_NONE   = 0;
-static const int TX_IS_READ   = 1;
-static const int TX_IS_UPDATE = 2;
-// Number of striped locks. Each lock protects one PMCacheLine. _Must_ be a power of 2.
-static const uint64_t NUM_LOCKS = 4*1024*1024;
-
-// Returns the cache line of the address (this is for x86 only)
-#define ADDR2CL(_addr) (uint8_t*)((size_t)(_addr) & (~63ULL))
-
-
-// Function that hashes a PMCacheLine address to a lock index.
-inline static uint64_t hidx(size_t pcl) {
-    return ((pcl/256) & (NUM_LOCKS-1)); // One lock per 4 persistent cache lines
-}
-// A 'Tid-Sequence' is a uint64_t which has a sequence (56 bits) and a thread-id (8 bits)
-typedef uint64_t tseq_t;
-// Function that returns the tid of a p.seq. The tid is the 8 highest bits of p.seq.
-inline static uint64_t tseq2tid(tseq_t lseq) { return (lseq >> (64-8)) & 0xFF; }
-// Returns the sequence in a lseq
-inline static uint64_t tseq2seq(tseq_t lseq) { return (lseq & 0x00FFFFFFFFFFFFFFULL); }
-// Creates a new Tid-sequence
-inline static tseq_t composeTseq(uint64_t tid, uint64_t seq) { return ((tid << (64-8)) | seq); }
-// Helper functions
-inline static bool isLocked(uint64_t sl) { return (sl & LOCKED); }
-inline static bool isUnlocked(uint64_t sl) { return !(sl & LOCKED); }
-// Helper method: sl is unlocked and lower than the clock, or it's locked by me
-static inline bool isUnlockedOrLockedByMe(uint64_t rClock, uint64_t tid, uint64_t sl) {
-    return ( (!(sl & LOCKED) && (sl <= rClock)) || (sl == (tid|LOCKED)) );
-}
-
-
-//
-// Thread Registry stuff
-//
-extern void thread_registry_deregister_thread(const int tid);
-
-// An helper class to do the checkin and checkout of the thread registry
-struct ThreadCheckInCheckOut {
-    static const int NOT_ASSIGNED = -1;
-    int tid { NOT_ASSIGNED };
-    ~ThreadCheckInCheckOut() {
-        if (tid == NOT_ASSIGNED) return;
-        thread_registry_deregister_thread(tid);
-    }
-};
-
-extern thread_local ThreadCheckInCheckOut tl_tcico;
-
-// Forward declaration of global/singleton instance
-class ThreadRegistry;
-extern ThreadRegistry gThreadRegistry;
-
-/*
- * <h1> Registry for threads </h1>
- *
- * This is singleton type class that allows assignement of a unique id to each thread.
- * The first time a thread calls ThreadRegistry::getTID() it will allocate a free slot in 'usedTID[]'.
- * This tid wil be saved in a thread-local variable of the type ThreadCheckInCheckOut which
- * upon destruction of the thread will call the destructor of ThreadCheckInCheckOut and free the
- * corresponding slot to be used by a later thread.
- */
-class ThreadRegistry {
-private:
-    static const bool kThreadPining = false;
-    alignas(128) std::atomic<bool>      usedTID[REGISTRY_MAX_THREADS];   // Which TIDs are in use by threads
-    alignas(128) std::atomic<int>       maxTid {-1};                     // Highest TID (+1) in use by threads
-
-public:
-    ThreadRegistry() {
-        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
-            usedTID[it].store(false, std::memory_order_relaxed);
-        }
-    }
-
-    // Progress condition: wait-free bounded (by the number of threads)
-    int register_thread_new(void) {
-        for (int tid = 0; tid < REGISTRY_MAX_THREADS; tid++) {
-            if (usedTID[tid].load(std::memory_order_acquire)) continue;
-            bool unused = false;
-            if (!usedTID[tid].compare_exchange_strong(unused, true)) continue;
-            // Increase the current maximum to cover our thread id
-            int curMax = maxTid.load();
-            while (curMax <= tid) {
-                maxTid.compare_exchange_strong(curMax, tid+1);
-                curMax = maxTid.load();
-            }
-            tl_tcico.tid = tid;
-            // If thread pinning enabled, set it here
-            if (kThreadPining) pinThread(tid);
-            return tid;
-        }
-        printf("ERROR: Too many threads, registry can only hold %d threads\n", REGISTRY_MAX_THREADS);
-        assert(false);
-    }
-
-    // Progress condition: wait-free population oblivious
-    inline void deregister_thread(const int tid) {
-        usedTID[tid].store(false, std::memory_order_release);
-    }
-
-    // Progress condition: wait-free population oblivious
-    static inline uint64_t getMaxThreads(void) {
-        return gThreadRegistry.maxTid.load(std::memory_order_acquire);
-    }
-
-    // Progress condition: wait-free bounded (by the number of threads)
-    static inline int getTID(void) {
-        int tid = tl_tcico.tid;
-        if (tid != ThreadCheckInCheckOut::NOT_ASSIGNED) return tid;
-        return gThreadRegistry.register_thread_new();
-    }
-
-    // Handle pinning
-    inline void pinThread(const int tid) {
-        cpu_set_t set;
-        // tid 0 is usually 'main' so we pin it to first CPU too
-        if (tid <= 20) {  // Our server (castor-1) has 10 cores => 20 HW threads and two CPUs
-            CPU_ZERO(&set);
-            sched_setaffinity(getpid(), sizeof(set), &set);
-        }
-    }
-};
-
-struct UData {
-    uint8_t data[24];  // 3 words of 8 bytes
-};
-
-// Each cache line in the PM region is one of these
-struct PMCacheLine {
-    UData     main;
-    UData     back;
-    tseq_t    tseq;    // Lock plus sequence (for TL2 and Trinity)
-    uint64_t  pad;
-} __attribute__((packed));
-
-/*
- * EsLocoTu? is an Extremely Simple memory aLOCatOr Two
- *
- * It is based on intrusive singly-linked stacks (a free-list), one for each power of two size.
- * All blocks are powers of two, the smallest size enough to contain the desired user data plus the block header.
- * There is an array named 'freelists' where each entry is a pointer to the head of a stack for that respective block size.
- * Blocks are allocated in powers of 2 of words (64bit words).
- * Each block has an header with two words: the size of the node (in words), the pointer to the next node.
- * The minimum block size is 4 words, with 2 for the header and 2 for the user.
- * When there is no suitable block in the freelist, it will create a new block from the remaining pool.
- *
- * EsLoco was designed for usage in PTMs but it doesn't have to be used only for that.
- * EsLocoTu scales while EsLoco does not.
- * Average number of stores for an allocation is 1.
- * Average number of stores for a de-allocation is 2.
- *
- * Memory layout:
- * ---------------------------------------------------------------------------------------------------
- * | poolTop | gfreelists[0..50] | threadflists[0..REGISTRY_MAX_THREADS] | ... allocated objects ... |
- * ---------------------------------------------------------------------------------------------------
- */
-template <template <typename> class P>
-class EsLoco2 {
-private:
-    const bool debugOn = false;
-    // Number of blocks in the freelists array.
-    // Each entry corresponds to an exponent of the block size: 2^4, 2^5, 2^6... 2^40
-    static const int kMaxBlockSize = 50; // 1024 TB of memory should be enough
-    // Size after which we trigger a cleanup of the thread-local list/pool
-    static const uint64_t kMaxListSize = 64;
-    // Size of a thread-local slab (in bytes). When it runs out, we take another slab from poolTop.
-    // Larger allocations go directly on poolTop which means doing a lot of large allocations from
-    // multiple threads will result in contention.
-    static const uint64_t kSlabSize = 4*1024*1024;
-
-    struct block {
-        P<block*>   next;    // Pointer to next block in free-list (when block is in free-list)
-        P<uint64_t> size2;   // Exponent of power of two of the size of this block in bytes.
-    };
-
-    // A persistent free-list of blocks
-    struct FList {
-        P<uint64_t> count;   // Number of blocks in the stack
-        P<block*>   head;    // Head of the stack (where we push and pop)
-        P<block*>   tail;    // Tail of the stack (used for faster transfers to/from gflist)
-
-        // Push a block into this free list, incrementing the volatile
-        // counter and adjusting the tail if needed. Does two pstores min.
-        void pushBlock(block* myblock) {
-            block* lhead = head;
-            if (lhead == nullptr) {
-                assert(count == 0);
-                tail = myblock;                    // pstore()
-            }
-            myblock->next = lhead;                 // pstore()
-            head = myblock;                        // pstore()
-            count++;
-        }
-
-        // Pops a block from a given (persistent) free list, decrementing the
-        // volatile counter and setting the tail to nullptr if list becomes empty.
-        // Does 2 pstores.
-        block* popBlock(void) {
-            assert(count != 0);
-            assert(tail != nullptr);
-            count--;
-            block* myblock = head;
-            head = myblock->next;                // pstore()
-            if (head == nullptr) tail = nullptr; // pstore()
-            return myblock;
-        }
-
-        bool isFull(void) { return (count >= kMaxListSize); }
-        bool isEmpty() { return (count == 0); }
-
-        // Transfer this list to another free-list (oflist).
-        // We use this method to transfer from the thread-local list to the global list.
-        void transfer(FList* oflist) {
-            assert(count != 0);
-            assert(tail != nullptr);
-            if (oflist->tail == nullptr) {
-                assert (oflist->head == nullptr);
-                oflist->tail = tail;                           // pstore()
-            }
-            tail->next = oflist->head;                         // pstore()
-            oflist->head = head;                               // pstore()
-            oflist->count += count;                            // pstore()
-            count = 0;                                         // pstore()
-            tail = nullptr;                                    // pstore()
-            head = nullptr;                                    // pstore()
-        }
-    };
-
-    // To avoid false sharing and lock conflicts, we put each thread-local data in one of these.
-    // This is persistent (in PM).
-    struct TLData {
-        uint64_t     padding[8];
-        // Thread-local array of persistent heads of free-list
-        FList        tflists[kMaxBlockSize];
-        // Thread-local slab pointer
-        P<uint8_t*>  slabtop;
-        // Thread-loal slab size
-        P<uint64_t>  slabsize;
-        TLData() {
-            for (int i = 0; i < kMaxBlockSize; i++) {
-                tflists[i].count = 0;             // pstore()
-                tflists[i].head = nullptr;        // pstore()
-                tflists[i].tail = nullptr;        // pstore()
-            }
-            slabtop = nullptr;                    // pstore()
-            slabsize = 0;                         // pstore()
-        }
-    };
-
-    // Complete metadata. This is PM
-    struct ELMetadata {
-        P<uint8_t*> top;
-        FList       gflists[kMaxBlockSize];
-        TLData      tldata[REGISTRY_MAX_THREADS];
-        // This constructor should be called from within a transaction
-        ELMetadata() {
-            // The 'top' starts after the metadata header
-            top = ((uint8_t*)this) + sizeof(ELMetadata);         // pstore()
-            for (int i = 0; i < kMaxBlockSize; i++) {
-                gflists[i].count = 0;             // pstore()
-                gflists[i].head = nullptr;        // pstore()
-                gflists[i].tail = nullptr;        // pstore()
-            }
-            for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
-                new (&tldata[it]) TLData();                      // pstores()
-            }
-        }
-    };
-
-    // Volatile data
-    uint8_t* poolAddr {nullptr};
-    uint64_t poolSize {0};
-
-    // Pointer to location of PM metadata of EsLoco
-    ELMetadata* meta {nullptr};
-
-    // For powers of 2, returns the highest bit, otherwise, returns the next highest bit
-    uint64_t highestBit(uint64_t val) {
-        uint64_t b = 0;
-        while ((val >> (b+1)) != 0) b++;
-        if (val > (1ULL << b)) return b+1;
-        return b;
-    }
-
-    uint8_t* aligned(uint8_t* addr) {
-        return (uint8_t*)((size_t)addr & (~0x3FULL)) + 128;
-    }
-
-public:
-    void init(void* addressOfMemoryPool, size_t sizeOfMemoryPool, bool clearPool=true) {
-        // Align the base address of the memory pool
-        poolAddr = aligned((uint8_t*)addressOfMemoryPool);
-        poolSize = sizeOfMemoryPool + (uint8_t*)addressOfMemoryPool - poolAddr;
-        // The first thing in the pool is the ELMetadata
-        meta = (ELMetadata*)poolAddr;
-        if (clearPool) new (meta) ELMetadata();
-        if (debugOn) printf("Starting EsLoco2 with poolAddr=%p and poolSize=%ld, up to %p\n", poolAddr, poolSize, poolAddr+poolSize);
-    }
-
-    // Resets the metadata of the allocator back to its defaults
-    void reset() {
-        std::memset(poolAddr, 0, sizeof(block)*kMaxBlockSize*(REGISTRY_MAX_THREADS+1));
-        meta->top.pstore(nullptr);
-    }
-
-    // Returns the number of bytes that may (or may not) have allocated objects, from the base address to the top address
-    uint64_t getUsedSize() {
-        return meta->top.pload() - poolAddr;
-    }
-
-    // Takes the desired size of the object in bytes.
-    // Returns pointer to memory in pool, or nullptr.
-    // Does on average 1 store to persistent memory when re-utilizing blocks.
-    void* malloc(size_t size) {
-        const int tid = ThreadRegistry::getTID();
-        // Adjust size to nearest (highest) power of 2
-        uint64_t bsize = highestBit(size + sizeof(block));
-        uint64_t asize = (1ULL << bsize);
-        if (debugOn) printf("malloc(%ld) requested,  block size exponent = %ld\n", size, bsize);
-        block* myblock = nullptr;
-        // Check if there is a block of that size in the corresponding freelist
-        if (!meta->tldata[tid].tflists[bsize].isEmpty()) {
-            if (debugOn) printf("Found available block in thread-local freelist\n");
-            myblock = meta->tldata[tid].tflists[bsize].popBlock();
-        } else if (asize < kSlabSize/2) {
-            // Allocations larger than kSlabSize/2 go on the global top
-            if (asize >= meta->tldata[tid].slabsize.pload()) {
-                if (debugOn) printf("Not enough space on current slab of thread %d for %ld bytes. Taking new slab from top\n",tid, asize);
-                // Not enough space for allocation. Take a new slab from the global top and
-                // discard the old one. This means fragmentation/leak is at most kSlabSize/2.
-                if (meta->top.pload() + kSlabSize > poolSize + poolAddr) {
-                    printf("EsLoco2: Out of memory for slab %ld for %ld bytes allocation\n", kSlabSize, size);
-                    return nullptr;
-                }
-                meta->tldata[tid].slabtop = meta->top.pload();   // pstore()
-                meta->tldata[tid].slabsize = kSlabSize;          // pstore()
-                meta->top.pstore(meta->top.pload() + kSlabSize); // pstore()
-                // TODO: add the remains of the slab to thread-local freelist
-            }
-            // Take space from the slab
-            myblock = (block*)meta->tldata[tid].slabtop.pload();
-            myblock->size2 = bsize;                                      // pstore()
-            meta->tldata[tid].slabtop.pstore((uint8_t*)myblock + asize); // pstore()
-            meta->tldata[tid].slabsize -= asize;                         // pstore()
-        } else if (!meta->gflists[bsize].isEmpty()) {
-            if (debugOn) printf("Found available block in thread-global freelist\n");
-            myblock = meta->gflists[bsize].popBlock();
-        } else {
-            if (debugOn) printf("Creating new block from top, currently at %p\n", meta->top.pload());
-            // Couldn't find a suitable block, get one from the top of the pool if there is one available
-            if (meta->top.pload() + asize > poolSize + poolAddr) {
-                printf("EsLoco2: Out of memory for %ld bytes allocation\n", size);
-                return nullptr;
-            }
-            myblock = (block*)meta->top.pload();
-            meta->top.pstore(meta->top.pload() + asize);                 // pstore()
-            myblock->size2 = bsize;                                       // pstore()
-        }
-        if (debugOn) printf("returning ptr = %p\n", (void*)((uint8_t*)myblock + sizeof(block)));
-        //printf("malloc:%ld = %p\n", asize, (void*)((uint8_t*)myblock + sizeof(block)));
-        // Return the block, minus the header
-        return (void*)((uint8_t*)myblock + sizeof(block));
-    }
-
-    // Takes a pointer to an object and puts the block on the free-list.
-    // When the thread-local freelist becomes too large, all blocks are moved to the thread-global free-list.
-    // Does on average 2 stores to persistent memory.
-    void free(void* ptr) {
-        if (ptr == nullptr) return;
-        const int tid = ThreadRegistry::getTID();
-        block* myblock = (block*)((uint8_t*)ptr - sizeof(block));
-        if (debugOn) printf("free:%ld %p\n", 1UL << myblock->size2.pload(), ptr);
-        // Insert the block in the corresponding freelist
-        uint64_t bsize = myblock->size2;
-        meta->tldata[tid].tflists[bsize].pushBlock(myblock);
-        if (meta->tldata[tid].tflists[bsize].isFull()) {
-            if (debugOn) printf("Moving thread-local flist for bsize=%ld to thread-global flist\n", bsize);
-            // Move all objects in the thread-local list to the corresponding thread-global list
-            meta->tldata[tid].tflists[bsize].transfer(&meta->gflists[bsize]);
-        }
-    }
-};
-
-
-// Needed by our benchmarks and to prevent destructor from being called automatically on abort/retry
-struct tmbase {
-    ~tmbase() { }
-};
-
-
-struct ReadSet {
-    struct ReadSetEntry {
-        std::atomic<uint64_t>* mBeg;
-        std::atomic<uint64_t>* mEnd;
-    };
-
-    // We pre-allocate a read-set with this many entries and if more are needed,
-    // we grow them dynamically during the transaction and then delete them when
-    // reset() is called on beginTx().
-    static const int64_t MAX_ENTRIES = 16*1024;
-
-    ReadSetEntry  entries[MAX_ENTRIES];
-    uint64_t      size {0};          // Number of loads in the readSet for the current transaction
-    ReadSet*      next {nullptr};
-
-    inline void reset() {
-        if (next != nullptr) {
-            next->reset();   // Recursive call on the linked list of logs
-            delete next;
-            next = nullptr;
-        }
-        size = 0;
-    }
-
-    inline bool validate(uint64_t rClock, uint64_t tid) {
-        for (uint64_t i = 0; i < size; i++) {
-            for (std::atomic<uint64_t>* mutex = entries[i].mBeg; mutex <= entries[i].mEnd; mutex++) {
-                uint64_t sl = mutex->load(std::memory_order_acquire);
-                if (!isUnlockedOrLockedByMe(rClock, tid, sl)) return false;
-            }
-        }
-        if (next != nullptr) return next->validate(rClock, tid); // Recursive call to validate()
-        return true;
-    }
-
-    inline void add(std::atomic<uint64_t>* mBeg, std::atomic<uint64_t>* mEnd) {
-        if (size != MAX_ENTRIES) {
-            entries[size].mBeg = mBeg;
-            entries[size].mEnd = mEnd;
-            size++;
-        } else {
-            // The current node is full, therefore, search a vacant node or create a new one
-            if (next == nullptr) next = new ReadSet();
-            next->add(mBeg, mEnd);    // Recursive call to add()
-        }
-    }
-};
-
-// Size of an Optane block in 64bit words. Used to prevent "false sharing".
-#define PM_PAD  (256/sizeof(uint64_t))
-
-// The persistent metadata is a 'header'.
-struct PMetadata {
-    static const uint64_t   MAGIC_ID = 0x1337bab4;
-    void*                   root {nullptr}; // Immutable once assigned
-    uint64_t                id {0};
-    uint64_t                padding[8-2];
-    // Each thread has its own p_seq
-    volatile uint64_t       p_seq[REGISTRY_MAX_THREADS*PM_PAD];
-
-    PMetadata() {
-        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
-        	p_seq[it*PM_PAD] = 1;
-        	PWB(&p_seq[it*PM_PAD]);
-        }
-    }
-};
-
-// Size of presistent memory region without metadata
-static uint64_t PM_SIZE = (PM_REGION_SIZE-sizeof(PMetadata));
-// Size of volatile memory region (VR)
-static uint64_t VR_SIZE = (PM_SIZE)*24ULL/64;
-// End address of volatile memory region (VR)
-static uint8_t* VREGION_END = VREGION_ADDR+VR_SIZE;
-// start of PM without metadata
-static uint8_t* PM_REGION_START = ((uint8_t*)PM_REGION_BEGIN+sizeof(PMetadata));
-// Get the address of the PMCacheLine in PM
-#define VR_2_PCL(_addr)  ((((size_t)_addr - (size_t)VREGION_ADDR)/24)*64 + (size_t)PM_REGION_START)
-// Convert an address of a volatile byte into a PM byte of 'main'.
-#define VR_2_PM(_addr)   ((((size_t)_addr - (size_t)VREGION_ADDR)/24)*64 + ( ((size_t)_addr-(size_t)VREGION_ADDR)%24 ) + (size_t)PM_REGION_START)
-// Convert from a generic PM address to a VR address
-#define PM_2_VR(_addr)   ((((size_t)_addr - (size_t)PM_REGION_START)/64)*24 + ( ((size_t)_addr-(size_t)PM_REGION_START)%64 ) + (size_t)VREGION_ADDR)
-// Convert an address of a volatile byte into a PM byte of 'main'.
-#define PCL_2_VCL(_addrpcl)   (((((size_t)_addrpcl)-(size_t)PM_REGION_START)/64)*24 + (size_t)VREGION_ADDR)
-
-
-// Address of Persistent Metadata.
-// This relies on PMetadata being the first thing in the persistent region.
-static PMetadata* const pmd = (PMetadata*)PM_REGION_BEGIN;
-
-// Helper function to save a range of modifications.
-inline void storeRange(void* vraddr, uint64_t size, tseq_t p_tseq) {
-    PMCacheLine* pclBeg = (PMCacheLine*)VR_2_PCL(vraddr);
-    PMCacheLine* pclEnd = (PMCacheLine*)VR_2_PCL(((uint8_t*)vraddr) + size-1);
-    // If (T) is large, it may be stored across multiple PMCacheLines
-    for (PMCacheLine* pcl = pclBeg; pcl <= pclEnd; pcl++) {
-        if (pcl->tseq == p_tseq) continue;
-        // Copy main to back for each pcl
-        pcl->back = pcl->main;                         // Ordered store
-        asm volatile ("" : : : "memory");
-        pcl->tseq = p_tseq;                            // Ordered store
-        asm volatile ("" : : : "memory");
-        // Copy VR to main (all 24 bytes)
-        pcl->main = *(UData*)PM_2_VR(&pcl->main);      // Ordered store
-        // We know we're only going to touch each pcl one time, therefore, flush it as we go
-        PWB(pcl);
-    }
-}
-
-// We put the array of locks outside the PTM because we want to access it from stand-alone static methods
-extern std::atomic<uint64_t> *gHashLock;
-
-
-// Volatile log (write-set)
-struct AppendLog {
-    // We pre-allocate a write-set with this many entries and if more are needed,
-    // we grow them dynamically during the transaction and then delete them when
-    // reset() is called on beginTx().
-    static const int64_t MAX_ENTRIES = 8*1024;
-
-    struct LogEntry {
-        void*     vraddr;
-        uint32_t  length;
-    };
-
-    int64_t       size {0};
-    LogEntry      entries[MAX_ENTRIES];
-    AppendLog*    next {nullptr};
-
-    inline void reset() {
-        if (next != nullptr) {
-            next->reset();   // Recursive call on the linked list of logs
-            delete next;
-            next = nullptr;
-        }
-        size = 0;
-    }
-
-    // Adds VR ranges to the log
-    inline void add(void* vraddr, uint32_t length) {
-        if (size != MAX_ENTRIES) {
-            entries[size].vraddr = vraddr;
-            entries[size].length = length;
-            size++;
-        } else {
-            // The current node is full, therefore, search a vacant node or create a new one
-            if (next == nullptr) next = new AppendLog();
-            next->add(vraddr, length); // recursive call to add()
-        }
-    }
-
-    // Copies a single range from PM to VR, breaking up into PMCacheLines
-    inline void copyRange(void* vraddr, uint32_t length) {
-        PMCacheLine* pclBeg = (PMCacheLine*)VR_2_PCL(vraddr);
-        PMCacheLine* pclEnd = (PMCacheLine*)VR_2_PCL(((uint8_t*)vraddr) + length-1);
-        // If (T) is large, it may be stored across multiple PMCacheLines
-        for (PMCacheLine* pcl = pclBeg; pcl <= pclEnd; pcl++) {
-            // The whole pcl is protected by the lock, so let's copy the whole thing,
-            // regardless of how many words/bytes in the pcl need to be reverted.
-            *(UData*)PM_2_VR(&pcl->main) = pcl->main;
-        }
-    }
-
-    // Helper function for rollbackVR()
-    inline bool rangeIsLockedByMe(void* vraddr, uint32_t length, uint64_t tid) {
-        std::atomic<uint64_t>* mBeg  = &gHashLock[hidx(VR_2_PCL(vraddr))];
-        std::atomic<uint64_t>* mEnd  = &gHashLock[hidx(VR_2_PCL(((uint8_t*)vraddr) + length-1))];
-        for (std::atomic<uint64_t>* mutex = mBeg; mutex <= mEnd; mutex++) {
-            uint64_t sl = mutex->load(std::memory_order_acquire);
-            if (sl != (LOCKED | tid)) return false;
-        }
-        return true;
-    }
-
-    // Rollback modifications on VR: called from abortTx() to revert changes.
-    void rollbackVR(uint64_t tid) {
-        if (size == 0) return;
-        if (next == nullptr) {
-            for (int64_t i = 0; i < size-1; i++) {
-                copyRange(entries[i].vraddr, entries[i].length);
-            }
-            // The last entry in the log is special: we don't revert it unless
-            // we have all the locks protecting it. The reason being that maybe the
-            // abort was triggered due to failed lock acquisition and therefore,
-            // reverting it would be incorrect (is already locked by another tx).
-            if (rangeIsLockedByMe(entries[size-1].vraddr, entries[size-1].length, tid)) {
-                copyRange(entries[size-1].vraddr, entries[size-1].length);
-            }
-        }
-        if (next != nullptr) {
-            for (int64_t i = 0; i < size; i++) {
-                copyRange(entries[i].vraddr, entries[i].length);
-            }
-            next->rollbackVR(tid); // Recursive call to rollbackVR()
-        }
-    }
-
-    // Unlock all the locks acquired by this thread
-    inline void unlock(uint64_t nextClock, uint64_t tid) {
-        for (uint64_t i = 0; i < size; i++) {
-            void* vraddr = entries[i].vraddr;
-            int32_t length = entries[i].length;
-            // Handle ranges correctly
-            std::atomic<uint64_t>* mBeg  = &gHashLock[hidx(VR_2_PCL(vraddr))];
-            std::atomic<uint64_t>* mEnd  = &gHashLock[hidx(VR_2_PCL(((uint8_t*)vraddr) + length-1))];
-            for (std::atomic<uint64_t>* mutex = mBeg; mutex <= mEnd; mutex++) {
-                if (mutex->load(std::memory_order_relaxed) == (LOCKED | tid)) {
-                    mutex->store(nextClock, std::memory_order_release);
-                }
-            }
-        }
-        if (next != nullptr) next->unlock(nextClock, tid);  // Recursive cal to unlock()
-    }
-
-    // We know we're only going to touch each pcl one time, therefore, flush it as we go
-    inline void persistAndFlush(tseq_t p_tseq) {
-        for (int64_t i = size-1; i >= 0; i--) {
-            storeRange(entries[i].vraddr, entries[i].length, p_tseq);
-        }
-        if (next != nullptr) next->persistAndFlush(p_tseq);  // Recursive call to persistAndFlush()
-    }
-};
-
-
-// Thread-local data
-struct OpData {
-    std::jmp_buf env;
-    uint64_t     attempt {0};
-    uint64_t     tid;
-    uint64_t     rClock {0};
-    tseq_t       p_tseq {0};
-    int          tx_type {TX_IS_NONE}; // This is used by persist::load() to figure out if it needs to save a load on the read-set or not
-    ReadSet      readSet;              // The (volatile) read set
-    AppendLog    writeSet {};          // Write-set: The append-only log of modified persist<T>
-    uint64_t     myrand;
-    uint64_t     numAborts {0};
-    uint64_t     numCommits {0};
-    uint64_t     padding[16];
-};
-
-extern std::atomic<uint64_t> gClock;
-
-extern void abortTx(OpData* myd);
-
-// This is used by addToLog() to know which OpData instance to use for the current transaction
-extern thread_local OpData* tl_opdata;
-
-// Helper function to lock an entire range. Used by pstore() and some of the string utils
-inline static void logLockRange(void* vraddr, int32_t length) {
-    OpData* const myd = tl_opdata;
-    // We must log _before_ locking because, in case of an abort half-way through
-    // the lock acquisitions on a range, we want to revert those acquisitions and
-    // for that, we need to have that range kept already in the log.
-    myd->writeSet.add(vraddr, length);
-    std::atomic<uint64_t>* mBeg  = &gHashLock[hidx(VR_2_PCL(vraddr))];
-    std::atomic<uint64_t>* mEnd  = &gHashLock[hidx(VR_2_PCL(((uint8_t*)vraddr) + length-1))];
-    for (std::atomic<uint64_t>* mutex = mBeg; mutex <= mEnd; mutex++) {
-        uint64_t sl = mutex->load(std::memory_order_acquire);
-        if (!isUnlockedOrLockedByMe(myd->rClock, myd->tid, sl)) abortTx(myd);
-        if (isUnlocked(sl) && !mutex->compare_exchange_strong(sl, LOCKED | myd->tid)) abortTx(myd);
-    }
-}
-
-// Same as checkRange(), but handles a range and is not inlined (slow-path)
-static void checkRangeSlow(OpData* const myd, std::atomic<uint64_t>* mBeg, std::atomic<uint64_t>* mEnd) {
-    // Handle wrap-around of lock ranges
-    if (mEnd < mBeg) {
-        if (myd->tx_type == TX_IS_UPDATE) myd->readSet.add(&gHashLock[0], mBeg);
-        for (std::atomic<uint64_t>* mutex = &gHashLock[0]; mutex <= mBeg; mutex++) {
-            uint64_t sl = mutex->load(std::memory_order_acquire);
-            if (!isUnlockedOrLockedByMe(myd->rClock, myd->tid, sl)) abortTx(myd);
-        }
-        mBeg = mEnd;
-        mEnd = &gHashLock[NUM_LOCKS-1];
-    }
-    // When in a write tx, loads must be added to the read-set
-    if (myd->tx_type == TX_IS_UPDATE) myd->readSet.add(mBeg, mEnd);
-    for (std::atomic<uint64_t>* mutex = mBeg; mutex <= mEnd; mutex++) {
-        uint64_t sl = mutex->load(std::memory_order_acquire);
-        if (!isUnlockedOrLockedByMe(myd->rClock, myd->tid, sl)) abortTx(myd);
-    }
-}
-
-// Helper function to check an entire (VR) range. Used by pload() and string utils
-// Make sure to issue a "asm volatile ("" : : : "memory")" before calling this.
-inline static void checkRange(OpData* const myd, void* vraddr, std::size_t length) {
-    if (myd == nullptr || vraddr < VREGION_ADDR || vraddr >= VREGION_END) return;
-    std::atomic<uint64_t>* mBeg  = &gHashLock[hidx(VR_2_PCL(vraddr))];
-    std::atomic<uint64_t>* mEnd  = &gHashLock[hidx(VR_2_PCL(((uint8_t*)vraddr) + length-1))];
-    if (mBeg == mEnd) {
-        // Fast path for single-lock checks
-        if (myd->tx_type == TX_IS_UPDATE) myd->readSet.add(mBeg, mEnd);
-        uint64_t sl = mBeg->load(std::memory_order_acquire);
-        if (!isUnlockedOrLockedByMe(myd->rClock, myd->tid, sl)) abortTx(myd);
-    } else {
-        // Slow path for multi-lock checks
-        checkRangeSlow(myd, mBeg, mEnd);
-    }
-}
-
-// T is typically a pointer to a node, but it can be integers or other stuff, as long as it fits in 64 bits
-template<typename T> struct persist {
-    T vrmain;
-
-    persist() { }
-
-    persist(T initVal) { pstore(initVal); }
-
-    // Casting operator
-    operator T() { return pload(); }
-    // Casting to const
-    operator T() const { return pload(); }
-
-    // Prefix increment operator: ++x
-    void operator++ () { pstore(pload()+1); }
-    // Prefix decrement operator: --x
-    void operator-- () { pstore(pload()-1); }
-    void operator++ (int) { pstore(pload()+1); }
-    void operator-- (int) { pstore(pload()-1); }
-    persist<T>& operator+= (const T& rhs) { pstore(pload() + rhs); return *this; }
-    persist<T>& operator-= (const T& rhs) { pstore(pload() - rhs); return *this; }
-
-    // Equals operator
-    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
-    bool operator == (const persist<Y> &rhs) { return pload() == rhs; }
-    // Difference operator: first downcast to T and then compare
-    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
-    bool operator != (const persist<Y> &rhs) { return pload() != rhs; }
-    // Relational operators
-    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
-    bool operator < (const persist<Y> &rhs) { return pload() < rhs; }
-    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
-    bool operator > (const persist<Y> &rhs) { return pload() > rhs; }
-    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
-    bool operator <= (const persist<Y> &rhs) { return pload() <= rhs; }
-    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
-    bool operator >= (const persist<Y> &rhs) { return pload() >= rhs; }
-
-    // Operator arrow ->
-    T operator->() { return pload(); }
-
-    // Copy constructor
-    persist<T>(const persist<T>& other) { pstore(other.pload()); }
-
-    // Assignment operator from a persist<T>
-    persist<T>& operator=(const persist<T>& other) {
-        pstore(other.pload());
-        return *this;
-    }
-
-    // Assignment operator from a value
-    persist<T>& operator=(T value) {
-        pstore(value);
-        return *this;
-    }
-
-    // Operator &
-    T* operator&() {
-        return (T*)this;
-    }
-
-    // Store interposing: acquire the lock and write in 'main'
-    inline void pstore(T newVal) {
-        uint8_t* vraddr = (uint8_t*)&vrmain;
-        OpData* const myd = tl_opdata;
-        // We don't acquire locks for data outside PM (that woud make more overhead on the logging system)
-        if (myd != nullptr && vraddr >= VREGION_ADDR && vraddr < VREGION_END) {
-            // Logs stores and acquires locks, or aborts
-            logLockRange(vraddr, sizeof(T));
-        }
-        vrmain = newVal;
-    }
-
-    // This is similar to an undo-log load interposing: do a single post-check
-    inline T pload() const {
-        T lval = vrmain;
-        asm volatile ("" : : : "memory");
-        checkRange(tl_opdata, (void*)&vrmain, sizeof(T)); // Aborts if lock is inconsistent or taken
-        return lval;
-    }
-};
-
-
-class Trinity;
-extern Trinity gTrinity;
-
-
-class Trinity {
-private:
-    // Padding on x86 should be on 2 cache lines
-    static const int                       CLPAD = 128/sizeof(uintptr_t);
-    bool                                   reuseRegion {false};                 // used by the constructor and initialization
-    int                                    pfd {-1};
-    int                                    vfd {-1};
-    alignas(128) OpData                   *opDesc;
-    EsLoco2<persist>                       esloco {};
-
-public:
-    struct tmbase : public trinityvrtl2::tmbase { };
-
-    Trinity() {
-        assert(sizeof(PMCacheLine) == 64);
-    	assert(sizeof(PMetadata)%64 == 0);
-    	gHashLock = new std::atomic<uint64_t>[NUM_LOCKS];
-    	for (int i=0; i < NUM_LOCKS; i++) gHashLock[i].store(0, std::memory_order_relaxed);
-        opDesc = new OpData[REGISTRY_MAX_THREADS];
-        for (uint64_t it=0; it < REGISTRY_MAX_THREADS; it++) {
-            opDesc[it].tid = it;
-            opDesc[it].myrand = (it+1)*12345678901234567ULL;
-            opDesc[it].p_tseq = composeTseq(it, 1);  // This better match 'pmd->p_seq[it*PM_PAD]'
-        }
-        mapPersistentRegion(PM_FILE_NAME, (uint8_t*)PM_REGION_BEGIN, PM_REGION_SIZE);
-        // The size of the volatile region is 24/64 the size of the PM region
-        mapVolatileRegion(VFILE_NAME, VREGION_ADDR, VR_SIZE);
-    }
-
-    ~Trinity() {
-        uint64_t totalAborts = 0;
-        uint64_t totalCommits = 0;
-        for (int it=0; it < REGISTRY_MAX_THREADS; it++) {
-            totalAborts += opDesc[it].numAborts;
-            totalCommits += opDesc[it].numCommits;
-        }
-        printf("totalAborts=%ld  totalCommits=%ld  abortRatio=%.1f%%   usedPM=%ld MB\n",
-                totalAborts, totalCommits, 100.*totalAborts/(1+totalCommits), (esloco.getUsedSize()*64)/(24*1024*1024));
-        delete[] opDesc;
-        delete[] gHashLock;
-    }
-
-    static std::string className() { return "TrinityVR-TL2"; }
-
-    void mapPersistentRegion(const char* filename, uint8_t* regionAddr, const uint64_t regionSize) {
-        // Check that the header with the logs leaves at least half the memory available to the user
-        if (sizeof(PMetadata) > regionSize/2) {
-            printf("ERROR: the size of the header in persistent memory is so large that it takes more than half the whole persistent memory\n");
-            printf("Please reduce some of the settings in TrinityVRTL2.hpp and try again\n");
-            assert(false);
-        }
-        // Check if the file already exists or not
-        struct stat buf;
-        if (stat(filename, &buf) == 0) {
-            // File exists
-            pfd = open(filename, O_RDWR|O_CREAT, 0755);
-            if (pfd < 0) {
-                perror("open() error");
-                assert(pfd >= 0);
-            }
-            reuseRegion = true;
-        } else {
-            // File doesn't exist
-            pfd = open(filename, O_RDWR|O_CREAT, 0755);
-            if (pfd < 0) {
-                perror("open() error");
-                assert(pfd >= 0);
-            }
-            if (lseek(pfd, regionSize-1, SEEK_SET) == -1) {
-                perror("lseek() error");
-            }
-            if (write(pfd, "", 1) == -1) {
-                perror("write() error");
-            }
-        }
-        // Try one time to mmap() with DAX. If it fails due to MAP_FAILED, then retry without DAX.
-        // We may fail because the address is not available. Retry at most 4 times, then give up.
-        uint64_t dax_flag = MAP_SYNC;
-        void* got_addr = NULL;
-        for (int i = 0; i < 4; i++) {
-            got_addr = mmap(regionAddr, regionSize, (PROT_READ | PROT_WRITE), MAP_SHARED_VALIDATE | dax_flag, pfd, 0);
-            if (got_addr == regionAddr) {
-                if (dax_flag == 0) printf("WARNING: running without DAX enabled\n");
-                break;
-            }
-            if (got_addr == MAP_FAILED) {
-                // Failed to mmap(). Let's try without DAX.
-                dax_flag = 0;
-            } else {
-                // mmap() worked but in wrong address. Let's unmap() and try again.
-                munmap(got_addr, regionSize);
-                // Sleep for a second before retrying the mmap()
-                usleep(1000);
-            }
-        }
-        if (got_addr == MAP_FAILED) {
-            perror("ERROR: mmap() returned MAP_FAILED !!! ");
-            assert(false);
-        }
-        if (got_addr != regionAddr) {
-            printf("got_addr = %p instead of %p\n", got_addr, regionAddr);
-            perror("Retry mmap() in a couple of seconds");
-            std::exit(42);
-        }
-        // Check if the header is consistent and only then can we attempt to re-use, otherwise we clear everything that's there
-        if (reuseRegion) reuseRegion = (pmd->id == PMetadata::MAGIC_ID);
-    }
-
-    // Maps the volatile memory region
-    void mapVolatileRegion(const char* filename, uint8_t* regionAddr, const uint64_t regionSize) {
-        // Check if the file already exists or not
-        struct stat buf;
-        if (stat(filename, &buf) == 0) {
-            // File exists
-            vfd = open(filename, O_RDWR|O_CREAT, 0755);
-            if (vfd < 0) {
-                perror("open() error");
-                assert(vfd >= 0);
-            }
-        } else {
-            // File doesn't exist
-            // Lets check for enough storage space:
-            /*
-            std::filesystem::space_info sp = std::filesystem::space(filename);
-            if (sp.available < regionSize) {
-                printf("ERROR: %ld MB isn't enough space to create VR file [%s] with %ld MB\n",
-                        sp.available/(1024*1024), filename, regionSize/(1024*1024));
-            }
-            */
-            vfd = open(filename, O_RDWR|O_CREAT, 0755);
-            if (vfd < 0) {
-                perror("open() error");
-                assert(vfd >= 0);
-            }
-            if (lseek(vfd, regionSize-1, SEEK_SET) == -1) {
-                perror("lseek() error");
-            }
-            if (write(vfd, "", 1) == -1) {
-                perror("write() error");
-            }
-        }
-        // mmap() volatile memory range 'main'
-        uint8_t* got_addr = (uint8_t *)mmap(regionAddr, regionSize, (PROT_READ | PROT_WRITE), MAP_SHARED, vfd, 0);
-        if (got_addr == MAP_FAILED) {
-            perror("ERROR: mmap() returned MAP_FAILED !!! ");
-            assert(false);
-        }
-        if (got_addr != regionAddr) {
-            printf("got_addr = %p instead of %p\n", got_addr, regionAddr);
-            perror("Retry mmap() in a couple of seconds");
-            std::exit(42);
-        }
-        // If the file has just been created or if the header is not consistent, clear everything.
-        // Otherwise, re-use and recover to a consistent state.
-        if (reuseRegion) {
-            recover();
-            // Copy all contents of PM's 'main's to VR, making them continuous
-            for (uint64_t cl = 0; cl < PM_SIZE/64; cl++) {
-                std::memcpy(VREGION_ADDR+(cl*24), (uint8_t*)PM_REGION_START+(cl*64), 24);
-            }
-            readTx([&] () {
-                esloco.init(regionAddr, regionSize, false);
-            });
-        } else {
-            // Call PMedata constructor
-            new (pmd) PMetadata();
-            // We reset the entire memory region because the 'seq' have to be zero.
-            // This operation can be be super SLOOWWW on a large PM region.
-            // Think of this memset() as "formatting' the PM.
-            std::memset(PM_REGION_START, 0, PM_SIZE);
-            // Reset VR
-            std::memset(regionAddr, 0, regionSize);
-            updateTx([&] () {
-                // Initialize the allocator and allocate an array for the root pointers
-                esloco.init(regionAddr, regionSize, true);
-                pmd->root = esloco.malloc(sizeof(persist<void*>)*MAX_ROOT_POINTERS);
-            });
-            PWB(&pmd->root);
-            PFENCE();
-            pmd->id = PMetadata::MAGIC_ID;
-            PWB(&pmd->id);
-            PFENCE();
-            // From this point on, a crash will trigger the "reuseRegion" code path
-        }
-    }
-
-    inline void beginTx(OpData* myd, const int tid) {
-        // Clear the logs of the previous transaction
-        myd->writeSet.reset();
-        myd->readSet.reset();
-        myd->rClock = gClock.load(); // This is GVRead()
-        myd->p_tseq = composeTseq(tid, pmd->p_seq[tid*PM_PAD]); // Shortcut to p_seq (used in pstore())
-    }
-
-    // This PTM does eager locking, which means that by now all locks have been acquired.
-    inline bool endTx(OpData* myd, const int tid) {
-        // Check if this is a read-only transaction and if so, commit immediately
-        if (myd->writeSet.size == 0) {
-            myd->attempt = 0;
-            return true;
-        }
-        // This fence is needed by undo log to prevent re-ordering with the last store
-        // and the reading of the gClock.
-        std::atomic_thread_fence(std::memory_order_seq_cst);
-        // Validate the read-set
-        if (!myd->readSet.validate(myd->rClock, tid)) abortTx(myd);
-        // Tx is now committed and holding all the locks. Start the durable commit
-        myd->writeSet.persistAndFlush(myd->p_tseq);
-        // The FAA is 'hijacked' to act as a persistence fence
-        uint64_t nextClock = gClock.fetch_add(1)+1;
-        // Modifications in persist<T> must be flushed before advancing p_seq
-        pmd->p_seq[tid*PM_PAD] = pmd->p_seq[tid*PM_PAD] + 1;
-        PWB(&pmd->p_seq[tid*PM_PAD]);
-        PSYNC();
-        // Unlock and set new sequence on the locks
-        myd->writeSet.unlock(nextClock, tid);
-        myd->numCommits++;
-        myd->attempt = 0;
-        return true;
-    }
-
-    template<typename F> void transaction(F&& func, int txType=TX_IS_UPDATE) {
-        if (tl_opdata != nullptr) {
-            func();
-            return ;
-        }
-        const int tid = ThreadRegistry::getTID();
-        OpData* myd = &opDesc[tid];
-        tl_opdata = myd;
-        myd->tx_type = txType;
-        setjmp(myd->env);
-        myd->attempt++;
-        backoff(myd, myd->attempt);
-        beginTx(myd, tid);
-        func();
-        endTx(myd, tid);
-        tl_opdata = nullptr;
-    }
-
-    // It's silly that these have to be static, but we need them for the (SPS) benchmarks due to templatization
-    //template<typename R, typename F> static R updateTx(F&& func) { return gTrinity.transaction<R>(func, TX_IS_UPDATE); }
-    //template<typename R, typename F> static R readTx(F&& func) { return gTrinity.transaction<R>(func, TX_IS_READ); }
-    template<typename F> static void updateTx(F&& func) { gTrinity.transaction(func, TX_IS_UPDATE); }
-    template<typename F> static void readTx(F&& func) { gTrinity.transaction(func, TX_IS_READ); }
-    // There are no sequential durable transactions in TL2 but we "emulate it" with a concurrent+durable tx
-    template<typename F> static void updateTxSeq(F&& func) { gTrinity.transaction(func, TX_IS_UPDATE); }
-    template<typename F> static void readTxSeq(F&& func) { gTrinity.transaction(func, TX_IS_READ); }
-
-
-    // Scan the PM for any persist<> with a sequence equal to p_seq.
-    // If there are any, revert them by copying back to main and resetting
-    // the seq to zero.
-    //
-    // If p_seq == seq+1 then copy back to main
-    // If p_seq == seq   then copy main to back
-    void recover() {
-        // The persists start after PMetadata
-    	PMCacheLine* pstartvol = (PMCacheLine*)(VREGION_ADDR);
-    	PMCacheLine* pstart = (PMCacheLine*)(PM_REGION_START);
-    	PMCacheLine* pend = (PMCacheLine*)(PM_REGION_END);
-    	PMCacheLine* p; // iterator variable
-        for (p = pstart; p < pend; p++) {
-            const tseq_t tseq = p->tseq;
-        	const uint64_t tid = tseq2tid(tseq);
-            if (tseq2seq(tseq) == pmd->p_seq[tid*PM_PAD]) {
-                p->main = p->back;    // ordered stores
-            }
-            asm volatile("": : :"memory");
-            p->tseq = 0;              // ordered store
-            PWB(p);
-        }
-        PSYNC();
-    }
-
-    // Random number generator used by the backoff scheme
-    inline uint64_t marsagliaXORV(uint64_t x) {
-        if (x == 0) x = 1;
-        x ^= x << 6;
-        x ^= x >> 21;
-        x ^= x << 7;
-        return x;
-    }
-
-    // Backoff for a random amount of steps in the range [16, 16*attempt]. Inspired by TL2
-    inline void backoff(OpData* myopd, uint64_t attempt) {
-        if (attempt < 3) return;
-        if (attempt == 10000) printf("Ooops, looks like we're stuck attempt=%ld\n", attempt);
-        myopd->myrand = marsagliaXORV(myopd->myrand);
-        uint64_t stall = (myopd->myrand & attempt) + 1;
-        stall *= 16;
-        std::atomic<uint64_t> iter {0};
-        while (iter.load() < stall) iter.fetch_add(1);
-        if (stall > 1000) std::this_thread::yield();
-    }
-
-    template<typename R,class F> inline static R readTx(F&& func) {
-        gTrinity.transaction([&]() {func();}, TX_IS_READ);
-        return R{};
-    }
-    template<typename R,class F> inline static R updateTx(F&& func) {
-        gTrinity.transaction([&]() {func();}, TX_IS_UPDATE);
-        return R{};
-    }
-
-    template <typename T, typename... Args> static T* tmNew(Args&&... args) {
-        if (tl_opdata == nullptr) {
-            printf("ERROR: Can not allocate outside a transaction\n");
-            return nullptr;
-        }
-        void* ptr = gTrinity.esloco.malloc(sizeof(T));
-        // If we get nullptr then we've ran out of PM space
-        assert(ptr != nullptr);
-        // If there is an abort during the 'new placement', the transactions rolls
-        // back and will automatically revert the changes in the allocator metadata.
-        new (ptr) T(std::forward<Args>(args)...);  // new placement
-        return (T*)ptr;
-    }
-
-    template<typename T> static void tmDelete(T* obj) {
-        if (obj == nullptr) return;
-        if (tl_opdata == nullptr) {
-            printf("ERROR: Can not de-allocate outside a transaction\n");
-            return;
-        }
-        obj->~T();
-        gTrinity.esloco.free(obj);
-    }
-
-    static void* tmMalloc(size_t size) {
-        if (tl_opdata == nullptr) {
-            printf("ERROR: Can not allocate outside a transaction\n");
-            return nullptr;
-        }
-        void* obj = gTrinity.esloco.malloc(size);
-        return obj;
-    }
-
-    static void tmFree(void* obj) {
-        if (obj == nullptr) return;
-        if (tl_opdata == nullptr) {
-            printf("ERROR: Can not de-allocate outside a transaction\n");
-            return;
-        }
-        gTrinity.esloco.free(obj);
-    }
-
-    static void* pmalloc(size_t size) {
-        if (tl_opdata == nullptr) {
-            printf("ERROR: Can not allocate outside a transaction\n");
-            return nullptr;
-        }
-        return gTrinity.esloco.malloc(size);
-    }
-
-    static void pfree(void* obj) {
-        if (obj == nullptr) return;
-        if (tl_opdata == nullptr) {
-            printf("ERROR: Can not de-allocate outside a transaction\n");
-            return;
-        }
-        gTrinity.esloco.free(obj);
-    }
-
-    static void* tmMemcpy(void* dst, const void* src, std::size_t count) {
-        void* result = nullptr;
-        OpData* const myd = tl_opdata;
-        if (myd != nullptr) {
-            logLockRange(dst, count);   // Aborts if 'dst' is already locked
-            result = std::memcpy(dst, src, count);
-            asm volatile ("" : : : "memory");
-            checkRange(myd, (void*)src, count);  // Aborts if 'src' is locked or was modified during tx
-        } else {
-            result = std::memcpy(dst, src, count);
-        }
-        return result;
-    }
-
-    static int tmMemcmp(const void* lhs, const void* rhs, std::size_t count) {
-        int result = std::memcmp(lhs, rhs, count);
-        asm volatile ("" : : : "memory");
-        OpData* const myd = tl_opdata;
-        if (myd != nullptr) {
-            checkRange(myd, (void*)lhs, count);
-            checkRange(myd, (void*)rhs, count);
-        }
-        return result;
-    }
-
-    static int tmStrcmp(const char* lhs, const char* rhs, std::size_t count) {
-        int result = std::strncmp(lhs, rhs, count);
-        asm volatile ("" : : : "memory");
-        OpData* const myd = tl_opdata;
-        if (myd != nullptr) {
-            checkRange(myd, (void*)lhs, count);
-            checkRange(myd, (void*)rhs, count);
-        }
-        return result;
-    }
-
-    static void* tmMemset(void* dst, int ch, std::size_t count) {
-        if (tl_opdata != nullptr) logLockRange(dst, count);   // Aborts if 'dst' is already locked
-        return std::memset(dst, ch, count);
-    }
-
-    // Get a root pointer
-    static inline void* get_object(int idx) {
-        return ((persist<void*>*)pmd->root)[idx].pload();
-    }
-
-    // Set a root pointer
-    static inline void put_object(int idx, void* obj) {
-        ((persist<void*>*)pmd->root)[idx].pstore(obj);
-    }
-};
-
-
-//
-// Wrapper methods to the global TM instance. The user should use these:
-//
-template<typename R, typename F> static R updateTx(F&& func) { return gTrinity.transaction<R>(func, TX_IS_UPDATE); }
-template<typename R, typename F> static R readTx(F&& func) { return gTrinity.transaction<R>(func, TX_IS_READ); }
-template<typename F> static void updateTx(F&& func) { gTrinity.transaction(func, TX_IS_UPDATE); }
-template<typename F> static void readTx(F&& func) { gTrinity.transaction(func, TX_IS_READ); }
-template<typename T, typename... Args> T* tmNew(Args&&... args) { return Trinity::tmNew<T>(args...); }
-template<typename T> void tmDelete(T* obj) { Trinity::tmDelete<T>(obj); }
-static void* tmMalloc(size_t size) { return Trinity::tmMalloc(size); }
-static void tmFree(void* obj) { Trinity::tmFree(obj); }
-
-
-#ifndef INCLUDED_FROM_MULTIPLE_CPP
-//
-// Place these in a .cpp if you include this header from multiple files (compilation units)
-//
-// Global/singleton to hold all the thread registry functionality
-ThreadRegistry gThreadRegistry {};
-// Array of locks
-std::atomic<uint64_t> *gHashLock {nullptr};
-// Global clock for TL2
-alignas(128) std::atomic<uint64_t> gClockPaddingA {0};
-alignas(128) std::atomic<uint64_t> gClock {1};
-alignas(128) std::atomic<uint64_t> gClockPaddingB {0};
-// PTM singleton
-Trinity gTrinity {};
-// Thread-local data of the current ongoing transaction
-thread_local OpData* tl_opdata {nullptr};
-// This is where every thread stores the tid it has been assigned when it calls getTID() for the first time.
-// When the thread dies, the destructor of ThreadCheckInCheckOut will be called and de-register the thread.
-thread_local ThreadCheckInCheckOut tl_tcico {};
-// Helper function for thread de-registration
-void thread_registry_deregister_thread(const int tid) {
-    gThreadRegistry.deregister_thread(tid);
-}
-// This is called from persist::load()/store() and endTx() if the read-set validation fails.
-[[noreturn]] void abortTx(OpData* myd) {
-    myd->writeSet.rollbackVR(myd->tid);
-    uint64_t nextClock = gClock.fetch_add(1)+1;
-    // Unlock with the new sequence
-    myd->writeSet.unlock(nextClock, myd->tid);
-    myd->numAborts++;
-    std::longjmp(myd->env, 1);
-}
-#endif // INCLUDED_FROM_MULTIPLE_CPP
-
-}
-
+/*
+ * Copyright 2018-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.txt
+ */
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <mutex>        // Needed by std::lock_guard when growing the region
+#include <cstring>
+#include <cstdio>       // Needed by snprintf() in the allocator stats
+#include <string>
+#include <thread>       // Needed by this_thread::yield()
+#include <sys/mman.h>   // Needed if we use mmap()
+#include <sys/types.h>  // Needed by open() and close()
+#include <sys/stat.h>
+#include <linux/mman.h> // Needed by MAP_SHARED_VALIDATE
+#include <fcntl.h>
+#include <unistd.h>     // Needed by close()
+#include <filesystem>   // Needed by std::filesystem::space()
+#include <type_traits>
+#include <sched.h>      // sched_setaffinity()
+#include <csetjmp>      // Needed by sigjmp_buf
+#include <cstdlib>      // Needed by exit() and std::abort()
+#include <unordered_map> // Needed by the conflict tracer report
+#include <vector>
+#include <algorithm>
+
+/*
+ * <h1> Trinity + Volatile Region + Persistent TL2 + volatile locks</h1>
+ *
+ * This variant has a volatile replica of 'main', which means we can use ranges and it is much faster.
+ * There is a volatile region (VR) and a PM region. Each consecutive 24 bytes (3x64bit words) in the VR region
+ * maps to a cacheline in the PM region. A cacheline in the PM region is composed of:
+ * main    - 24 bytes
+ * back    - 24 bytes
+ * seq     - 8 bytes
+ * padding - 8 bytes
+ *
+ * For concurrency we use something similar to TL2, but not quite the same:
+ * - Load interposing is made with post-validation, no pre-validation is made. See persistvr::load();
+ * - On abort, we must increment the global clock;
+ * - A full fence is done before the commit of the transaction in endTx(), to prevent re-ordering
+ *   of the last modification in the transaction with the rad-set validation;
+ * - The global clock and the locks are all kept in volatile memory for efficiency;
+ * - The write-set does not contain any data. On commit, the data is taken from VR and written to PR
+ *   using the Trinity algorithm. On abort, the opposite is done;
+ *
+ * Other characteristics:
+ * - Durable commit is done after concurrent commit, without modification on PM unless the tx is (concurrent) committed;
+ * - Supports ranges
+ * - Has improved error handling in mmap() and file opening
+ * - Nested update transactions are closed: on a conflict, a nested transaction is rolled back to its savepoint
+ *   and retried on its own, without restarting the enclosing transaction (see Trinity::nestedTransaction());
+ *
+ * See durable transactions paper
+ */
+
+
+// Macros needed for persistence
+#ifdef PWB_IS_CLFLUSH
+  /*
+   * More info at http://elixir.free-electrons.com/linux/latest/source/arch/x86/include/asm/special_insns.h#L213
+   * Intel programming manual at https://www.intel.com/content/dam/www/public/us/en/documents/manuals/64-ia-32-architectures-optimization-manual.pdf
+   * Use these for Broadwell CPUs (cervino server)
+   */
+  #define PWB(addr)              do { PTM_STATS_PWB(); __asm__ volatile("clflush (%0)" :: "r" (addr) : "memory"); } while (0)  // Broadwell only works with this.
+  #define PFENCE()               do { PTM_STATS_PFENCE(); } while (0)                                           // No ordering fences needed for CLFLUSH (section 7.4.6 of Intel manual)
+  #define PSYNC()                do { PTM_STATS_PSYNC(); } while (0)                                            // For durability it's not obvious, but CLFLUSH seems to be enough, and PMDK uses the same approach
+#elif PWB_IS_CLWB
+  /* Use this for CPUs that support clwb, such as the SkyLake SP series (c5 compute intensive instances in AWS are an example of it) */
+  #define PWB(addr)              do { PTM_STATS_PWB(); __asm__ volatile(".byte 0x66; xsaveopt %0" : "+m" (*(volatile char *)(addr))); } while (0)  // clwb() only for Ice Lake onwards
+  #define PFENCE()               do { PTM_STATS_PFENCE(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+  #define PSYNC()                do { PTM_STATS_PSYNC(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+#elif PWB_IS_NOP
+  /* pwbs are not needed for shared memory persistency (i.e. persistency across process failure) */
+  #define PWB(addr)              do { PTM_STATS_PWB(); } while (0)
+  #define PFENCE()               do { PTM_STATS_PFENCE(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+  #define PSYNC()                do { PTM_STATS_PSYNC(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+#elif PWB_IS_CLFLUSHOPT
+  /* Use this for CPUs that support clflushopt, which is most recent x86 */
+  #define PWB(addr)              do { PTM_STATS_PWB(); __asm__ volatile(".byte 0x66; clflush %0" : "+m" (*(volatile char *)(addr))); } while (0)  // clflushopt (Kaby Lake)
+  #define PFENCE()               do { PTM_STATS_PFENCE(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+  #define PSYNC()                do { PTM_STATS_PSYNC(); __asm__ volatile("sfence" : : : "memory"); } while (0)
+#else
+#error "You must define what PWB is. Choose PWB_IS_CLFLUSHOPT if you don't know what your CPU is capable of"
+#endif
+// With -DPTM_STATS, the PWB(), PFENCE() and PSYNC() above count themselves with the PTM_STATS_*() hooks
+#include "../PTMStats.hpp"
+#include "../TxResult.hpp"     // Needed by readTx<R>() and updateTx<R>()
+
+
+namespace trinityvrtl2 {
+
+//
+// User configurable variables.
+// Feel free to change these if you need larger transactions, or more threads.
+//
+
+// Start address of persistent memory region
+#ifndef PM_REGION_BEGIN
+#define PM_REGION_BEGIN 0x7fea00000000
+#endif
+// Maximum size of the persistent memory region. This much address space is reserved up front.
+#ifndef PM_REGION_SIZE
+#define PM_REGION_SIZE 1024*1024*1024ULL // 1GB for now
+#endif
+// Size of the file when the persistent memory region is created. The region (and the VR) then grow
+// in place, in steps of PM_REGION_GROW_SIZE, when the allocator runs out of memory.
+#ifndef PM_REGION_INITIAL_SIZE
+#define PM_REGION_INITIAL_SIZE PM_REGION_SIZE
+#endif
+#ifndef PM_REGION_GROW_SIZE
+#define PM_REGION_GROW_SIZE 64*1024*1024ULL
+#endif
+// Name of persistent file mapping (back)
+#ifndef PM_FILE_NAME
+#define PM_FILE_NAME   "/dev/shm/trinityvrtl2_shared"
+#endif
+
+// Maximum number of registered threads that can execute transactions
+static const int REGISTRY_MAX_THREADS = 128;
+
+// Maximum number of root pointers available for the user
+static const uint64_t MAX_ROOT_POINTERS = 64;
+// Number of times a nested transaction is retried on its own before a conflict restarts the whole transaction
+static const uint64_t MAX_NESTED_ATTEMPTS = 8;
+// Maximum depth of the nested transactions that can be rolled back on their own. Deeper ones are flattened.
+static const uint64_t MAX_NESTED_DEPTH = 16;
+
+static const char * VFILE_NAME = "/dev/shm/trinityvrtl2_shared_main";
+// Start address of volatile memory region (VR)
+static uint8_t* VREGION_ADDR = (uint8_t*)0x7f0000000000;
+
+
+
+// TL2 constants
+static const uint64_t LOCKED  = 0x8000000000000000ULL;
+static const int TX_IS_NONE   = 0;
+static const int TX_IS_READ   = 1;
+static const int TX_IS_UPDATE = 2;
+// Number of striped locks. Each lock protects one PMCacheLine. _Must_ be a power of 2.
+static const uint64_t NUM_LOCKS = 4*1024*1024;
+
+// Returns the cache line of the address (this is for x86 only)
+#define ADDR2CL(_addr) (uint8_t*)((size_t)(_addr) & (~63ULL))
+
+
+// Function that hashes a PMCacheLine address to a lock index.
+inline static uint64_t hidx(size_t pcl) {
+    return ((pcl/256) & (NUM_LOCKS-1)); // One lock per 4 persistent cache lines
+}
+// A 'Tid-Sequence' is a uint64_t which has a sequence (56 bits) and a thread-id (8 bits)
+typedef uint64_t tseq_t;
+// Function that returns the tid of a p.seq. The tid is the 8 highest bits of p.seq.
+inline static uint64_t tseq2tid(tseq_t lseq) { return (lseq >> (64-8)) & 0xFF; }
+// Returns the sequence in a lseq
+inline static uint64_t tseq2seq(tseq_t lseq) { return (lseq & 0x00FFFFFFFFFFFFFFULL); }
+// Creates a new Tid-sequence
+inline static tseq_t composeTseq(uint64_t tid, uint64_t seq) { return ((tid << (64-8)) | seq); }
+// Helper functions
+inline static bool isLocked(uint64_t sl) { return (sl & LOCKED); }
+inline static bool isUnlocked(uint64_t sl) { return !(sl & LOCKED); }
+// Helper method: sl is unlocked and lower than the clock, or it's locked by me
+static inline bool isUnlockedOrLockedByMe(uint64_t rClock, uint64_t tid, uint64_t sl) {
+    return ( (!(sl & LOCKED) && (sl <= rClock)) || (sl == (tid|LOCKED)) );
+}
+
+
+//
+// Thread Registry stuff
+//
+extern void thread_registry_deregister_thread(const int tid);
+
+// An helper class to do the checkin and checkout of the thread registry
+struct ThreadCheckInCheckOut {
+    static const int NOT_ASSIGNED = -1;
+    int tid { NOT_ASSIGNED };
+    ~ThreadCheckInCheckOut() {
+        if (tid == NOT_ASSIGNED) return;
+        thread_registry_deregister_thread(tid);
+    }
+};
+
+extern thread_local ThreadCheckInCheckOut tl_tcico;
+
+// Forward declaration of global/singleton instance
+class ThreadRegistry;
+extern ThreadRegistry gThreadRegistry;
+
+/*
+ * <h1> Registry for threads </h1>
+ *
+ * This is singleton type class that allows assignement of a unique id to each thread.
+ * The first time a thread calls ThreadRegistry::getTID() it will allocate a free slot in 'usedTID[]'.
+ * This tid wil be saved in a thread-local variable of the type ThreadCheckInCheckOut which
+ * upon destruction of the thread will call the destructor of ThreadCheckInCheckOut and free the
+ * corresponding slot to be used by a later thread.
+ */
+class ThreadRegistry {
+private:
+    static const bool kThreadPining = false;
+    alignas(128) std::atomic<bool>      usedTID[REGISTRY_MAX_THREADS];   // Which TIDs are in use by threads
+    alignas(128) std::atomic<int>       maxTid {-1};                     // Highest TID (+1) in use by threads
+
+public:
+    ThreadRegistry() {
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+            usedTID[it].store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // Progress condition: wait-free bounded (by the number of threads)
+    int register_thread_new(void) {
+        for (int tid = 0; tid < REGISTRY_MAX_THREADS; tid++) {
+            if (usedTID[tid].load(std::memory_order_acquire)) continue;
+            bool unused = false;
+            if (!usedTID[tid].compare_exchange_strong(unused, true)) continue;
+            // Increase the current maximum to cover our thread id
+            int curMax = maxTid.load();
+            while (curMax <= tid) {
+                maxTid.compare_exchange_strong(curMax, tid+1);
+                curMax = maxTid.load();
+            }
+            tl_tcico.tid = tid;
+            // If thread pinning enabled, set it here
+            if (kThreadPining) pinThread(tid);
+            return tid;
+        }
+        printf("ERROR: Too many threads, registry can only hold %d threads\n", REGISTRY_MAX_THREADS);
+        assert(false);
+    }
+
+    // Progress condition: wait-free population oblivious
+    inline void deregister_thread(const int tid) {
+        usedTID[tid].store(false, std::memory_order_release);
+    }
+
+    // Progress condition: wait-free population oblivious
+    static inline uint64_t getMaxThreads(void) {
+        return gThreadRegistry.maxTid.load(std::memory_order_acquire);
+    }
+
+    // Progress condition: wait-free bounded (by the number of threads)
+    static inline int getTID(void) {
+        int tid = tl_tcico.tid;
+        if (tid != ThreadCheckInCheckOut::NOT_ASSIGNED) return tid;
+        return gThreadRegistry.register_thread_new();
+    }
+
+    // Handle pinning
+    inline void pinThread(const int tid) {
+        cpu_set_t set;
+        // tid 0 is usually 'main' so we pin it to first CPU too
+        if (tid <= 20) {  // Our server (castor-1) has 10 cores => 20 HW threads and two CPUs
+            CPU_ZERO(&set);
+            sched_setaffinity(getpid(), sizeof(set), &set);
+        }
+    }
+};
+
+struct UData {
+    uint8_t data[24];  // 3 words of 8 bytes
+};
+
+// Each cache line in the PM region is one of these
+struct PMCacheLine {
+    UData     main;
+    UData     back;
+    tseq_t    tseq;    // Lock plus sequence (for TL2 and Trinity)
+    uint64_t  pad;
+} __attribute__((packed));
+
+/*
+ * EsLocoTu? is an Extremely Simple memory aLOCatOr Two
+ *
+ * It is based on intrusive singly-linked stacks (a free-list), one for each size class.
+ * Blocks up to 128 bytes come in steps of 16 bytes. Above that, each power of two is split into
+ * four size classes (quarter-power-of-two), for example 160, 192, 224, 256, 320, 384, 448, 512, ...
+ * which means the internal fragmentation is at most 25% instead of the 50% of pure powers of two.
+ * Each block is the smallest size class enough to contain the desired user data plus the block header.
+ * There is an array named 'freelists' where each entry is a pointer to the head of a stack for that respective size class.
+ * Each block has an header with two words: the size class of the node, the pointer to the next node.
+ * The minimum block size is 4 words, with 2 for the header and 2 for the user.
+ * When there is no suitable block in the freelist, it will create a new block from the thread-local slab,
+ * or from the remaining pool for large blocks.
+ * When a thread-local slab doesn't have enough space for a new block, the remains of the slab are
+ * split into blocks and placed in the thread-local free-lists, to be re-used by later allocations.
+ * Slabs are always fully split into blocks, which means the pool can be walked block by block, from
+ * the end of the metadata up to the top, skipping only the part of each slab that is still being carved.
+ * This is what the online compaction relies on, see the comment on compactScan().
+ * The pool may be smaller than the range reserved for it. When the top reaches the end of the pool, the
+ * PTM is asked to grow it (see init()), therefore, the pool can start small and grow with the data.
+ *
+ * EsLoco was designed for usage in PTMs but it doesn't have to be used only for that.
+ * EsLocoTu scales while EsLoco does not.
+ * Average number of stores for an allocation is 1.
+ * Average number of stores for a de-allocation is 2.
+ * Statistics on the usage of each size class can be obtained with getStats().
+ * On PTMs where P<> is larger than a word, the blocks are aligned to alignof(P<>) instead of 16 bytes.
+ *
+ * Memory layout:
+ * ----------------------------------------------------------------------------------------------------------
+ * | poolTop | gfreelists[0..kNumClasses] | threadflists[0..REGISTRY_MAX_THREADS] | ... allocated objects ... |
+ * ----------------------------------------------------------------------------------------------------------
+ */
+template <template <typename> class P>
+class EsLoco2 {
+private:
+    const bool debugOn = false;
+    // Exponent of the largest block size: 2^49 bytes. 1024 TB of memory should be enough
+    static const int kMaxBlockSize = 50;
+    // Number of size classes (and of entries in each freelists array).
+    // The first 8 are 16, 32, 48... 128 bytes, and then 4 classes for each power of two up to 2^kMaxBlockSize
+    static const int kNumClasses = 8 + (kMaxBlockSize-8)*4;
+    // Size after which we trigger a cleanup of the thread-local list/pool
+    static const uint64_t kMaxListSize = 64;
+    // Size of a thread-local slab (in bytes). When it runs out, we take another slab from poolTop.
+    // Larger allocations go directly on poolTop which means doing a lot of large allocations from
+    // multiple threads will result in contention.
+    static const uint64_t kSlabSize = 4*1024*1024;
+    // The compaction looks at the pool in windows of this size
+    static const uint64_t kWindowSize = kSlabSize;
+
+    // Flags kept in the high bits of the size class of a block, so that the compaction knows the state of each block
+    static const uint64_t kFreeFlag     = 1ULL << 62;   // Block is in a free-list
+    static const uint64_t kDetachedFlag = 1ULL << 61;   // Block is free but the compaction is keeping it out of the free-lists
+    static const uint64_t kChunkFlag    = 1ULL << 60;   // Not a block, but a Chunk
+    static const uint64_t kClassMask    = kChunkFlag - 1;
+
+    struct block {
+        P<block*>   next;    // Pointer to next block in free-list (when block is in free-list)
+        P<uint64_t> sclass;  // Size class of this block plus flags. Use classToSize() to get the size in bytes.
+    };
+
+    // A run of contiguous free memory reclaimed by the compaction. Chunks are re-used as slabs.
+    // The header of a chunk overlaps the header of a block, therefore, the pool can still be walked.
+    struct Chunk {
+        P<Chunk*>   next;    // Next chunk in the list of chunks
+        P<uint64_t> sclass;  // Always kChunkFlag
+        P<uint64_t> size;    // Size of this chunk in bytes, including the header
+    };
+
+    // Blocks are multiples of 16 bytes, or of the alignment of P<>, whichever is larger
+    static constexpr uint64_t kQuantum = alignof(block) > 16 ? alignof(block) : 16;
+    // Smallest block, which is just the header. When splitting the remains of a slab, nothing smaller than this is left behind.
+    static constexpr uint64_t kMinBlockSize = sizeof(block);
+
+    // A persistent free-list of blocks
+    struct FList {
+        P<uint64_t> count;   // Number of blocks in the stack
+        P<block*>   head;    // Head of the stack (where we push and pop)
+        P<block*>   tail;    // Tail of the stack (used for faster transfers to/from gflist)
+
+        // Push a block into this free list, incrementing the volatile
+        // counter and adjusting the tail if needed. Does two pstores min.
+        void pushBlock(block* myblock) {
+            block* lhead = head;
+            if (lhead == nullptr) {
+                assert(count == 0);
+                tail = myblock;                    // pstore()
+            }
+            myblock->next = lhead;                 // pstore()
+            head = myblock;                        // pstore()
+            count++;
+        }
+
+        // Pops a block from a given (persistent) free list, decrementing the
+        // volatile counter and setting the tail to nullptr if list becomes empty.
+        // Does 2 pstores.
+        block* popBlock(void) {
+            assert(count != 0);
+            assert(tail != nullptr);
+            count--;
+            block* myblock = head;
+            head = myblock->next;                // pstore()
+            if (head == nullptr) tail = nullptr; // pstore()
+            return myblock;
+        }
+
+        bool isFull(void) { return (count >= kMaxListSize); }
+        bool isEmpty() { return (count == 0); }
+
+        // Transfer this list to another free-list (oflist).
+        // We use this method to transfer from the thread-local list to the global list.
+        void transfer(FList* oflist) {
+            assert(count != 0);
+            assert(tail != nullptr);
+            if (oflist->tail == nullptr) {
+                assert (oflist->head == nullptr);
+                oflist->tail = tail;                           // pstore()
+            }
+            tail->next = oflist->head;                         // pstore()
+            oflist->head = head;                               // pstore()
+            oflist->count += count;                            // pstore()
+            count = 0;                                         // pstore()
+            tail = nullptr;                                    // pstore()
+            head = nullptr;                                    // pstore()
+        }
+    };
+
+    // To avoid false sharing and lock conflicts, we put each thread-local data in one of these.
+    // This is persistent (in PM).
+    struct TLData {
+        uint64_t     padding[8];
+        // Thread-local array of persistent heads of free-list
+        FList        tflists[kNumClasses];
+        // Thread-local slab pointer
+        P<uint8_t*>  slabtop;
+        // Thread-loal slab size
+        P<uint64_t>  slabsize;
+        // Number of blocks this thread has carved from slabs or from the top, per size class.
+        // Only used by getStats(), to know how many blocks exist of each size class.
+        P<uint64_t>  carved[kNumClasses];
+        TLData() {
+            for (int i = 0; i < kNumClasses; i++) {
+                tflists[i].count = 0;             // pstore()
+                tflists[i].head = nullptr;        // pstore()
+                tflists[i].tail = nullptr;        // pstore()
+                carved[i] = 0;                    // pstore()
+            }
+            slabtop = nullptr;                    // pstore()
+            slabsize = 0;                         // pstore()
+        }
+    };
+
+    // Complete metadata. This is PM
+    struct ELMetadata {
+        P<uint8_t*> top;
+        P<Chunk*>   chunks;      // Chunks reclaimed by the compaction and not yet re-used as slabs
+        P<uint64_t> chunkBytes;  // Sum of the sizes of all those chunks
+        FList       gflists[kNumClasses];
+        TLData      tldata[REGISTRY_MAX_THREADS];
+        // This constructor should be called from within a transaction
+        ELMetadata() {
+            // The 'top' starts after the metadata header
+            top = ((uint8_t*)this) + sizeof(ELMetadata);         // pstore()
+            chunks = nullptr;                                    // pstore()
+            chunkBytes = 0;                                      // pstore()
+            for (int i = 0; i < kNumClasses; i++) {
+                gflists[i].count = 0;             // pstore()
+                gflists[i].head = nullptr;        // pstore()
+                gflists[i].tail = nullptr;        // pstore()
+            }
+            for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+                new (&tldata[it]) TLData();                      // pstores()
+            }
+        }
+    };
+
+    // Volatile data
+    uint8_t* poolAddr {nullptr};
+    std::atomic<uint64_t> poolSize {0};
+    uint64_t poolMaxSize {0};
+    std::function<uint8_t*(uint8_t*)> growPool {nullptr};
+
+    // Pointer to location of PM metadata of EsLoco
+    ELMetadata* meta {nullptr};
+
+    // Volatile state of the compaction. The windows are only accessed by the thread doing the compaction,
+    // while the ranges being evacuated are read by free() on all threads.
+    struct Window {
+        uint8_t* beg;          // First block in this window
+        uint8_t* end;          // First block of the next window, which may be after the window boundary
+        uint64_t liveBytes;    // In blocks not free
+        bool     walkable;     // False if a slab is still being carved in this window, or there is a chunk
+        bool     evacuate;     // Picked by compactSelect()
+    };
+    struct EvacRange {
+        std::atomic<uint8_t*> beg {nullptr};
+        std::atomic<uint8_t*> end {nullptr};
+    };
+    uint64_t                  maxWindows {0};
+    uint64_t                  numWindows {0};
+    Window*                   windows {nullptr};
+    EvacRange*                evacRanges {nullptr};
+    std::atomic<bool>         compacting {false};   // True while there is a compaction running
+    std::atomic<bool>         evacuating {false};   // True while there are windows being evacuated
+
+    // For powers of 2, returns the highest bit, otherwise, returns the next highest bit
+    static uint64_t highestBit(uint64_t val) {
+        uint64_t b = 0;
+        while ((val >> (b+1)) != 0) b++;
+        if (val > (1ULL << b)) return b+1;
+        return b;
+    }
+
+    // Returns the smallest size class that can hold 'bsize' bytes (including the block header)
+    static uint64_t sizeToClass(uint64_t bsize) {
+        bsize = (bsize + kQuantum - 1) & ~(kQuantum - 1);
+        if (bsize <= 128) return (bsize+15)/16 - 1;
+        const uint64_t b = highestBit(bsize);                     // 2^(b-1) < bsize <= 2^b
+        const uint64_t quarter = 1ULL << (b-3);
+        const uint64_t sub = (bsize - (1ULL << (b-1)) + quarter - 1)/quarter;  // 1 to 4
+        return 8 + (b-8)*4 + sub - 1;
+    }
+
+    // Returns the size in bytes of the blocks of a size class (including the block header)
+    static uint64_t classToSize(uint64_t sclass) {
+        if (sclass < 8) return (sclass+1)*16;
+        const uint64_t b = 8 + (sclass-8)/4;
+        return (1ULL << (b-1)) + ((sclass-8)%4 + 1)*(1ULL << (b-3));
+    }
+
+    // Returns the largest size class that can be carved from 'ssize' free bytes, leaving behind either
+    // nothing or enough for other blocks. 'ssize' must be a multiple of kQuantum and at least kMinBlockSize.
+    static uint64_t fitClass(uint64_t ssize) {
+        uint64_t sclass = sizeToClass(ssize);
+        if (classToSize(sclass) > ssize) sclass--;
+        while (classToSize(sclass) % kQuantum != 0 ||
+               (classToSize(sclass) != ssize && ssize - classToSize(sclass) < kMinBlockSize)) sclass--;
+        return sclass;
+    }
+
+    uint8_t* aligned(uint8_t* addr) {
+        return (uint8_t*)((size_t)addr & (~0x3FULL)) + 128;
+    }
+
+    // Places a block in the thread-local free-list of its size class.
+    // When the thread-local freelist becomes too large, all blocks are moved to the thread-global free-list.
+    void pushToFreeList(const int tid, block* myblock, uint64_t sclass) {
+        myblock->sclass = sclass | kFreeFlag;                                // pstore()
+        meta->tldata[tid].tflists[sclass].pushBlock(myblock);
+        if (meta->tldata[tid].tflists[sclass].isFull()) {
+            if (debugOn) printf("Moving thread-local flist for sclass=%ld to thread-global flist\n", sclass);
+            // Move all objects in the thread-local list to the corresponding thread-global list
+            meta->tldata[tid].tflists[sclass].transfer(&meta->gflists[sclass]);
+        }
+    }
+
+    // Splits the free memory in [addr, addr+ssize) into the largest blocks that fit, and places them
+    // in the thread-local free-lists. Nothing is lost because the slabs never have less than kMinBlockSize left.
+    void splitIntoFreeList(const int tid, uint8_t* addr, uint64_t ssize) {
+        while (ssize != 0) {
+            assert(ssize >= kMinBlockSize);
+            const uint64_t sclass = fitClass(ssize);
+            pushToFreeList(tid, (block*)addr, sclass);
+            meta->tldata[tid].carved[sclass]++;                          // pstore()
+            addr += classToSize(sclass);
+            ssize -= classToSize(sclass);
+        }
+    }
+
+    // Splits whatever remains of the current slab into blocks, and places them in the thread-local free-lists
+    void recycleSlab(const int tid) {
+        splitIntoFreeList(tid, meta->tldata[tid].slabtop.pload(), meta->tldata[tid].slabsize.pload());
+    }
+
+    // Returns true if the block is in one of the windows being evacuated by the compaction
+    bool inEvacuatedWindow(const uint8_t* addr) {
+        if (!evacuating.load(std::memory_order_acquire)) return false;
+        const uint8_t* heap = poolAddr + sizeof(ELMetadata);
+        if (addr < heap || addr >= poolAddr + poolSize) return false;
+        const EvacRange& range = evacRanges[(addr - heap)/kWindowSize];
+        return addr >= range.beg.load(std::memory_order_relaxed) && addr < range.end.load(std::memory_order_relaxed);
+    }
+
+    // Walks the blocks from 'addr' up to the first block at or after 'end' (or the top), calling func(myblock, sclass)
+    // for each one, where 'sclass' includes the flags. Skips the chunks and the parts of the slabs still being carved,
+    // in which case it returns false. On return, 'addr' is the first block not walked.
+    template<typename F> bool walk(uint8_t*& addr, uint8_t* end, F&& func) {
+        uint8_t* slabs[REGISTRY_MAX_THREADS];
+        uint64_t sizes[REGISTRY_MAX_THREADS];
+        int numSlabs = 0;
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+            sizes[numSlabs] = meta->tldata[it].slabsize.pload();
+            if (sizes[numSlabs] == 0) continue;
+            slabs[numSlabs++] = meta->tldata[it].slabtop.pload();
+        }
+        uint8_t* top = meta->top.pload();
+        bool walkable = true;
+        while (addr < end && addr < top) {
+            uint64_t skip = 0;
+            for (int i = 0; i < numSlabs; i++) {
+                if (slabs[i] == addr) skip = sizes[i];
+            }
+            if (skip == 0) {
+                const uint64_t sclass = ((block*)addr)->sclass.pload();
+                if (sclass & kChunkFlag) {
+                    skip = ((Chunk*)addr)->size.pload();
+                } else {
+                    assert((sclass & kClassMask) < kNumClasses);
+                    func((block*)addr, sclass);
+                    addr += classToSize(sclass & kClassMask);
+                    continue;
+                }
+            }
+            walkable = false;
+            addr += skip;
+        }
+        return walkable;
+    }
+
+public:
+    ~EsLoco2() {
+        delete[] windows;
+        delete[] evacRanges;
+    }
+
+    // Snapshot of the state of the allocator, filled by getStats().
+    // All sizes are in bytes and include the block headers.
+    struct Stats {
+        uint64_t poolSize {0};                     // Size of the whole memory pool
+        uint64_t usedSize {0};                     // From the start of the pool up to the top (high-water mark)
+        uint64_t metadataSize {0};                 // Taken by the allocator metadata (free-lists and counters)
+        uint64_t liveBytes {0};                    // In blocks currently allocated by the user
+        uint64_t freeBytes {0};                    // In blocks sitting in the free-lists, thread-local or global
+        uint64_t slabBytes {0};                    // Not yet carved from the thread-local slabs
+        uint64_t chunkBytes {0};                   // Reclaimed by the compaction and not yet re-used as slabs
+        uint64_t blockSize[kNumClasses];           // Size of the blocks of each size class
+        uint64_t liveBlocks[kNumClasses];          // Number of allocated blocks, per size class
+        uint64_t freeBlocks[kNumClasses];          // Number of blocks in all the free-lists, per size class
+        uint64_t globalFreeBlocks[kNumClasses];    // Number of blocks in the global free-lists, per size class
+        uint64_t threadSlabBytes[REGISTRY_MAX_THREADS]; // Not yet carved from the slab of each thread
+
+        // How much of the snapshot getStats() fills in
+        enum Detail {
+            kUsage,      // Only the pool, used and metadata sizes, with two loads
+            kTotals,     // Also the live, free, slab and chunk bytes, but not the arrays
+            kAll,        // Everything
+        };
+
+        // Fraction of the used pool which is not holding user data. The metadata, the chunks and the tails
+        // of the slabs that haven't been carved into blocks yet don't count, otherwise a fresh pool, where
+        // most of the used pool is in the slabs of the threads, would look fragmented.
+        double fragmentation() const {
+            const uint64_t unused = metadataSize + chunkBytes + slabBytes;
+            if (usedSize <= unused) return 0;
+            return 1. - (double)liveBytes/(usedSize - unused);
+        }
+
+        // Human readable report, one line per size class in use
+        std::string toString() const {
+            std::string s;
+            char line[256];
+            std::snprintf(line, sizeof(line), "EsLoco2: pool=%ld MB  used=%ld MB  live=%ld MB  free=%ld MB  slabs=%ld MB  chunks=%ld MB  fragmentation=%.1f%%\n",
+                    poolSize>>20, usedSize>>20, liveBytes>>20, freeBytes>>20, slabBytes>>20, chunkBytes>>20, 100.*fragmentation());
+            s += line;
+            s += "  block size       live blocks     free blocks    (in global)\n";
+            for (int i = 0; i < kNumClasses; i++) {
+                if (liveBlocks[i] == 0 && freeBlocks[i] == 0) continue;
+                std::snprintf(line, sizeof(line), "  %10ld  %16ld  %14ld  %13ld\n", blockSize[i], liveBlocks[i], freeBlocks[i], globalFreeBlocks[i]);
+                s += line;
+            }
+            for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+                if (threadSlabBytes[it] == 0) continue;
+                std::snprintf(line, sizeof(line), "  slab of thread %d has %ld KB left\n", it, threadSlabBytes[it]>>10);
+                s += line;
+            }
+            return s;
+        }
+    };
+
+    // The pool starts with 'sizeOfMemoryPool' bytes and may grow up to 'maxSizeOfMemoryPool'. When it needs to,
+    // malloc() calls 'grow' with the end address it needs, and 'grow' returns the new end of the pool, which
+    // may be smaller than what was asked if the PTM can't grow its region that much.
+    void init(void* addressOfMemoryPool, size_t sizeOfMemoryPool, bool clearPool=true,
+              size_t maxSizeOfMemoryPool=0, std::function<uint8_t*(uint8_t*)> grow=nullptr) {
+        // Align the base address of the memory pool
+        poolAddr = aligned((uint8_t*)addressOfMemoryPool);
+        poolSize = sizeOfMemoryPool + (uint8_t*)addressOfMemoryPool - poolAddr;
+        poolMaxSize = (maxSizeOfMemoryPool > sizeOfMemoryPool ? maxSizeOfMemoryPool : sizeOfMemoryPool) + (uint8_t*)addressOfMemoryPool - poolAddr;
+        growPool = grow;
+        // The first thing in the pool is the ELMetadata
+        meta = (ELMetadata*)poolAddr;
+        if (clearPool) new (meta) ELMetadata();
+        // Volatile state of the compaction
+        delete[] windows;
+        delete[] evacRanges;
+        maxWindows = poolMaxSize/kWindowSize + 1;
+        windows = new Window[maxWindows];
+        evacRanges = new EvacRange[maxWindows];
+        if (debugOn) printf("Starting EsLoco2 with poolAddr=%p and poolSize=%ld, up to %p\n", poolAddr, poolSize.load(), poolAddr+poolSize);
+    }
+
+    // Resets the metadata of the allocator back to its defaults
+    void reset() {
+        std::memset(poolAddr, 0, sizeof(FList)*kNumClasses*(REGISTRY_MAX_THREADS+1));
+        meta->top.pstore(nullptr);
+    }
+
+    // Returns the number of bytes that may (or may not) have allocated objects, from the base address to the top address
+    uint64_t getUsedSize() {
+        return meta->top.pload() - poolAddr;
+    }
+
+    // Fills 'stats' with the current state of the allocator, up to 'detail'. Costs a few loads for each size
+    // class and thread, regardless of the number of allocated objects, or just two loads for kUsage.
+    // Call it from within a transaction (a read-only one is enough) to get a consistent snapshot.
+    void getStats(Stats& stats, typename Stats::Detail detail=Stats::kAll) {
+        stats = Stats();
+        stats.poolSize = poolSize;
+        stats.usedSize = getUsedSize();
+        stats.metadataSize = sizeof(ELMetadata);
+        if (detail == Stats::kUsage) return;
+        for (int i = 0; i < kNumClasses; i++) {
+            uint64_t carved = 0;
+            uint64_t tfree = 0;
+            for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+                carved += meta->tldata[it].carved[i].pload();
+                tfree += meta->tldata[it].tflists[i].count.pload();
+            }
+            const uint64_t gfree = meta->gflists[i].count.pload();
+            const uint64_t bsize = classToSize(i);
+            stats.liveBytes += (carved - tfree - gfree)*bsize;
+            stats.freeBytes += (tfree + gfree)*bsize;
+            if (detail != Stats::kAll) continue;
+            stats.blockSize[i] = bsize;
+            stats.globalFreeBlocks[i] = gfree;
+            stats.freeBlocks[i] = tfree + gfree;
+            stats.liveBlocks[i] = carved - stats.freeBlocks[i];
+        }
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+            const uint64_t ssize = meta->tldata[it].slabsize.pload();
+            stats.slabBytes += ssize;
+            if (detail == Stats::kAll) stats.threadSlabBytes[it] = ssize;
+        }
+        stats.chunkBytes = meta->chunkBytes.pload();
+    }
+
+    // Returns true if the pool goes at least up to 'end', growing it if needed
+    bool reservePool(uint8_t* end) {
+        uint64_t curSize = poolSize.load();
+        if (end <= poolAddr + curSize) return true;
+        if (growPool == nullptr || end > poolAddr + poolMaxSize) return false;
+        uint64_t newSize = growPool(end) - poolAddr;
+        if (newSize > poolMaxSize) newSize = poolMaxSize;
+        while (curSize < newSize && !poolSize.compare_exchange_weak(curSize, newSize)) { }
+        return end <= poolAddr + poolSize.load();
+    }
+
+    // Takes the desired size of the object in bytes.
+    // Returns pointer to memory in pool, or nullptr.
+    // Does on average 1 store to persistent memory when re-utilizing blocks.
+    void* malloc(size_t size) {
+        const int tid = ThreadRegistry::getTID();
+        // Adjust size to nearest (highest) size class
+        uint64_t sclass = sizeToClass(size + sizeof(block));
+        uint64_t asize = classToSize(sclass);
+        if (debugOn) printf("malloc(%ld) requested,  size class = %ld (%ld bytes)\n", size, sclass, asize);
+        block* myblock = nullptr;
+        // Check if there is a block of that size in the corresponding freelist
+        if (!meta->tldata[tid].tflists[sclass].isEmpty()) {
+            if (debugOn) printf("Found available block in thread-local freelist\n");
+            myblock = meta->tldata[tid].tflists[sclass].popBlock();
+        } else if (asize < kSlabSize/2) {
+            // Allocations larger than kSlabSize/2 go on the global top
+            // The slab can't be left with less than kMinBlockSize, otherwise it could not be split into blocks
+            const uint64_t ssize = meta->tldata[tid].slabsize.pload();
+            const bool fitsInSlab = (asize == ssize || asize + kMinBlockSize <= ssize);
+            if (!fitsInSlab && !meta->gflists[sclass].isEmpty()) {
+                // Before taking a new slab, re-use a block that some thread has placed in the global list
+                if (debugOn) printf("Found available block in thread-global freelist\n");
+                myblock = meta->gflists[sclass].popBlock();
+            } else {
+                if (!fitsInSlab) {
+                    if (debugOn) printf("Not enough space on current slab of thread %d for %ld bytes. Taking new slab\n",tid, asize);
+                    // Not enough space for allocation. Take a new slab, preferably a chunk reclaimed by the
+                    // compaction, otherwise from the global top, and add the remains of the old one to the thread-local freelists.
+                    Chunk* chunk = meta->chunks.pload();
+                    if (chunk == nullptr && !reservePool(meta->top.pload() + kSlabSize)) {
+                        printf("EsLoco2: Out of memory for slab %ld for %ld bytes allocation\n", kSlabSize, size);
+                        return nullptr;
+                    }
+                    recycleSlab(tid);
+                    if (chunk != nullptr) {
+                        // Chunks are at least kSlabSize/2, therefore, large enough for this block
+                        meta->chunks = chunk->next.pload();                  // pstore()
+                        meta->chunkBytes -= chunk->size.pload();             // pstore()
+                        meta->tldata[tid].slabtop = (uint8_t*)chunk;         // pstore()
+                        meta->tldata[tid].slabsize = chunk->size.pload();    // pstore()
+                    } else {
+                        meta->tldata[tid].slabtop = meta->top.pload();       // pstore()
+                        meta->tldata[tid].slabsize = kSlabSize;              // pstore()
+                        meta->top.pstore(meta->top.pload() + kSlabSize);     // pstore()
+                    }
+                }
+                // Take space from the slab
+                myblock = (block*)meta->tldata[tid].slabtop.pload();
+                meta->tldata[tid].slabtop.pstore((uint8_t*)myblock + asize); // pstore()
+                meta->tldata[tid].slabsize -= asize;                         // pstore()
+                meta->tldata[tid].carved[sclass]++;                          // pstore()
+            }
+        } else if (!meta->gflists[sclass].isEmpty()) {
+            if (debugOn) printf("Found available block in thread-global freelist\n");
+            myblock = meta->gflists[sclass].popBlock();
+        } else {
+            if (debugOn) printf("Creating new block from top, currently at %p\n", meta->top.pload());
+            // Couldn't find a suitable block, get one from the top of the pool if there is one available
+            if (!reservePool(meta->top.pload() + asize)) {
+                printf("EsLoco2: Out of memory for %ld bytes allocation\n", size);
+                return nullptr;
+            }
+            myblock = (block*)meta->top.pload();
+            meta->top.pstore(meta->top.pload() + asize);                 // pstore()
+            meta->tldata[tid].carved[sclass]++;                           // pstore()
+        }
+        // Clears the flags, in case the block came from a free-list
+        myblock->sclass = sclass;                                         // pstore()
+        if (debugOn) printf("returning ptr = %p\n", (void*)((uint8_t*)myblock + sizeof(block)));
+        // Return the block, minus the header
+        return (void*)((uint8_t*)myblock + sizeof(block));
+    }
+
+    // Takes a pointer to an object and puts the block on the free-list.
+    // When the thread-local freelist becomes too large, all blocks are moved to the thread-global free-list.
+    // Does on average 3 stores to persistent memory.
+    void free(void* ptr) {
+        if (ptr == nullptr) return;
+        const int tid = ThreadRegistry::getTID();
+        block* myblock = (block*)((uint8_t*)ptr - sizeof(block));
+        const uint64_t sclass = myblock->sclass.pload();
+        if (debugOn) printf("free(%p)  size class = %ld\n", ptr, sclass);
+        assert((sclass & ~kClassMask) == 0);  // Double free?
+        if (inEvacuatedWindow((uint8_t*)myblock)) {
+            // The compaction is going to reclaim this window, keep the block out of the free-lists
+            myblock->sclass = sclass | kDetachedFlag;                     // pstore()
+            return;
+        }
+        // Insert the block in the corresponding freelist
+        pushToFreeList(tid, myblock, sclass);
+    }
+
+    /*
+     * Online compaction
+     *
+     * Blocks of different size classes never coalesce and the top only grows, therefore, a long running
+     * pool where the sizes of the objects keep changing becomes fragmented. The compaction is done by the
+     * PTM in several small transactions, with the following steps:
+     * 1. compactScan() walks the pool one window at a time, measuring how much of each window is live;
+     * 2. compactSelect() picks the windows with a low ratio of live bytes to be evacuated;
+     * 3. compactDetach() takes the free blocks of those windows out of the free-lists. From then on,
+     *    the blocks freed in those windows are 'detached' (kept out of the free-lists) instead;
+     * 4. the user relocates each live object for which isEvacuating() is true, to a newly allocated block;
+     * 5. compactReclaim() coalesces each window left with only detached blocks. The space is handed
+     *    back to the top if it is at the end of the pool, otherwise it becomes a Chunk, which
+     *    malloc() prefers to the top when it needs a new slab;
+     * 6. compactRelist() puts the detached blocks of the windows that were not reclaimed back in the free-lists.
+     * Windows where a slab is being carved are never evacuated. A crash in the middle of a compaction may
+     * leave detached blocks behind, which the next compactScan() places back in the free-lists.
+     */
+
+    // Returns false if there is already a compaction running. Otherwise, the caller must call compactEnd() when done.
+    bool compactBegin() {
+        bool expected = false;
+        if (!compacting.compare_exchange_strong(expected, true)) return false;
+        numWindows = 0;
+        return true;
+    }
+
+    void compactEnd() {
+        for (uint64_t w = 0; w < numWindows; w++) {
+            evacRanges[w].beg.store(nullptr, std::memory_order_relaxed);
+            evacRanges[w].end.store(nullptr, std::memory_order_relaxed);
+        }
+        evacuating.store(false, std::memory_order_release);
+        compacting.store(false, std::memory_order_release);
+    }
+
+    // Step 1: walks the blocks of window 'w' and returns false if there are no more windows.
+    // Must be called from within an update transaction, for w = 0, 1, 2... because each window starts where the previous one ended.
+    bool compactScan(uint64_t w) {
+        uint8_t* heap = poolAddr + sizeof(ELMetadata);
+        uint8_t* addr = (w == 0) ? heap : windows[w-1].end;
+        if (addr >= meta->top.pload() || w == maxWindows) return false;
+        const int tid = ThreadRegistry::getTID();
+        Window& win = windows[w];
+        win.beg = addr;
+        win.liveBytes = 0;
+        win.evacuate = false;
+        win.walkable = walk(addr, heap + (w+1)*kWindowSize, [&] (block* myblock, uint64_t sclass) {
+            if (sclass & kDetachedFlag) {
+                // Left over from a compaction that did not complete
+                pushToFreeList(tid, myblock, sclass & kClassMask);
+            } else if (!(sclass & kFreeFlag)) {
+                win.liveBytes += classToSize(sclass);
+            }
+        });
+        win.end = addr;
+        numWindows = w+1;
+        return true;
+    }
+
+    // Step 2: picks the windows where less than 'maxLiveRatio' of the bytes are live, and starts evacuating them.
+    // Returns the number of windows picked.
+    uint64_t compactSelect(double maxLiveRatio) {
+        uint64_t picked = 0;
+        for (uint64_t w = 0; w < numWindows; w++) {
+            Window& win = windows[w];
+            if (!win.walkable || win.liveBytes >= maxLiveRatio*(win.end - win.beg)) continue;
+            win.evacuate = true;
+            evacRanges[w].beg.store(win.beg, std::memory_order_relaxed);
+            evacRanges[w].end.store(win.end, std::memory_order_relaxed);
+            picked++;
+        }
+        if (picked != 0) evacuating.store(true, std::memory_order_release);
+        return picked;
+    }
+
+    // Step 3: takes the free blocks in the windows being evacuated out of the free-lists of thread 'it',
+    // or out of the global free-lists when 'it' is REGISTRY_MAX_THREADS. Must be called from within an update transaction.
+    void compactDetach(int it) {
+        for (int i = 0; i < kNumClasses; i++) {
+            FList& fl = (it == REGISTRY_MAX_THREADS) ? meta->gflists[i] : meta->tldata[it].tflists[i];
+            if (fl.count.pload() == 0) continue;
+            block* prev = nullptr;
+            uint64_t count = 0;
+            bool changed = false;
+            for (block* myblock = fl.head.pload(); myblock != nullptr; ) {
+                block* next = myblock->next.pload();
+                if (inEvacuatedWindow((uint8_t*)myblock)) {
+                    myblock->sclass = i | kDetachedFlag;                  // pstore()
+                    if (prev == nullptr) fl.head = next;                  // pstore()
+                    else prev->next = next;                               // pstore()
+                    changed = true;
+                } else {
+                    prev = myblock;
+                    count++;
+                }
+                myblock = next;
+            }
+            if (!changed) continue;
+            fl.tail = prev;                                               // pstore()
+            fl.count = count;                                             // pstore()
+        }
+    }
+
+    // Returns true if the object at 'ptr' is in a window being evacuated and should be relocated (step 4)
+    bool isEvacuating(const void* ptr) {
+        return inEvacuatedWindow((const uint8_t*)ptr - sizeof(block));
+    }
+
+    // Step 5: if window 'w' is being evacuated and has only detached blocks, coalesces them and returns
+    // the number of bytes reclaimed. Must be called from within an update transaction, from the last window to the first.
+    uint64_t compactReclaim(uint64_t w) {
+        Window& win = windows[w];
+        if (!win.evacuate) return 0;
+        uint64_t numBlocks[kNumClasses];
+        std::memset(numBlocks, 0, sizeof(numBlocks));
+        bool reclaim = true;
+        uint8_t* addr = win.beg;
+        walk(addr, win.end, [&] (block* myblock, uint64_t sclass) {
+            if (sclass & kDetachedFlag) numBlocks[sclass & kClassMask]++;
+            else reclaim = false;
+        });
+        if (!reclaim || addr != win.end) return 0;
+        // Blocks freed in this window from now on go to the free-lists
+        evacRanges[w].beg.store(nullptr, std::memory_order_relaxed);
+        evacRanges[w].end.store(nullptr, std::memory_order_relaxed);
+        const int tid = ThreadRegistry::getTID();
+        for (int i = 0; i < kNumClasses; i++) {
+            if (numBlocks[i] != 0) meta->tldata[tid].carved[i] -= numBlocks[i];  // pstore()
+        }
+        const uint64_t size = win.end - win.beg;
+        if (win.end == meta->top.pload()) {
+            // This is the end of the pool, hand it back to the top
+            meta->top = win.beg;                                          // pstore()
+        } else if (size >= kSlabSize/2) {
+            Chunk* chunk = (Chunk*)win.beg;
+            chunk->sclass = kChunkFlag;                                   // pstore()
+            chunk->size = size;                                           // pstore()
+            chunk->next = meta->chunks.pload();                           // pstore()
+            meta->chunks = chunk;                                         // pstore()
+            meta->chunkBytes += size;                                     // pstore()
+        } else {
+            // Too small to be a slab, split it into blocks as large as possible
+            splitIntoFreeList(tid, win.beg, size);
+        }
+        win.evacuate = false;
+        return size;
+    }
+
+    // Step 6: stops evacuating window 'w' and places its detached blocks back in the free-lists.
+    // Must be called from within an update transaction, after compactReclaim().
+    void compactRelist(uint64_t w) {
+        Window& win = windows[w];
+        evacRanges[w].beg.store(nullptr, std::memory_order_relaxed);
+        evacRanges[w].end.store(nullptr, std::memory_order_relaxed);
+        if (!win.evacuate) return;
+        const int tid = ThreadRegistry::getTID();
+        uint8_t* addr = win.beg;
+        walk(addr, win.end, [&] (block* myblock, uint64_t sclass) {
+            if (sclass & kDetachedFlag) pushToFreeList(tid, myblock, sclass & kClassMask);
+        });
+    }
+
+    // Number of windows walked by compactScan()
+    uint64_t compactNumWindows() { return numWindows; }
+};
+
+
+// Needed by our benchmarks and to prevent destructor from being called automatically on abort/retry
+struct tmbase {
+    ~tmbase() { }
+};
+
+
+#ifdef PTM_CONFLICT_TRACE
+/*
+ * Sampling tracer of the conflicts on the striped locks (gHashLock).
+ * Compile with -DPTM_CONFLICT_TRACE and one in every CONFLICT_TRACE_PERIOD conflicts of each thread is
+ * recorded with the lock that caused it, the VR address being accessed, and where it was detected:
+ * on the lock acquisition in logLockRange(), in checkRange() or in ReadSet::validate().
+ * At exit, ~Trinity() prints the CONFLICT_TRACE_TOPN locks with the most sampled conflicts and the ranges
+ * of VR addresses each of them protects, which is what is needed to find the fields that serialize a workload.
+ */
+#ifndef CONFLICT_TRACE_PERIOD
+#define CONFLICT_TRACE_PERIOD 1
+#endif
+#ifndef CONFLICT_TRACE_TOPN
+#define CONFLICT_TRACE_TOPN   20
+#endif
+static const int CONFLICT_ON_LOCK     = 0;
+static const int CONFLICT_ON_CHECK    = 1;
+static const int CONFLICT_ON_VALIDATE = 2;
+
+struct ConflictTracer {
+    struct Sample {
+        std::atomic<uint64_t>* mutex;      // The lock that was taken or had a newer version
+        void*                  vraddr;     // Address accessed by the transaction (nullptr if found by validate())
+        uint64_t               sl;         // Content of the lock
+        uint64_t               cause;      // One of the CONFLICT_ON_*
+    };
+    // Samples kept per thread. When full, the oldest samples are overwritten.
+    static const uint64_t MAX_SAMPLES = 64*1024;
+    struct ThreadSamples {
+        uint64_t numConflicts {0};
+        uint64_t numSamples {0};
+        Sample   samples[MAX_SAMPLES];
+    };
+    // Each entry is allocated and written only by the thread with that tid
+    std::atomic<ThreadSamples*> perThread[REGISTRY_MAX_THREADS] {};
+
+    ~ConflictTracer() {
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) delete perThread[it].load();
+    }
+
+    inline void record(uint64_t tid, std::atomic<uint64_t>* mutex, uint64_t cause, void* vraddr, uint64_t sl) {
+        ThreadSamples* ts = perThread[tid].load(std::memory_order_acquire);
+        if (ts == nullptr) {
+            ts = new ThreadSamples();
+            perThread[tid].store(ts, std::memory_order_release);
+        }
+        if (ts->numConflicts++ % CONFLICT_TRACE_PERIOD != 0) return;
+        ts->samples[ts->numSamples++ % MAX_SAMPLES] = {mutex, vraddr, sl, cause};
+    }
+
+    void report(std::atomic<uint64_t>* hashLock);
+};
+
+extern ConflictTracer gConflictTracer;
+#define TRACE_CONFLICT(_tid, _mutex, _cause, _vraddr, _sl)  gConflictTracer.record((_tid), (_mutex), (_cause), (_vraddr), (_sl))
+#else
+#define TRACE_CONFLICT(_tid, _mutex, _cause, _vraddr, _sl)  {}
+#endif
+
+
+struct ReadSet {
+    struct ReadSetEntry {
+        std::atomic<uint64_t>* mBeg;
+        std::atomic<uint64_t>* mEnd;
+    };
+
+    // We pre-allocate a read-set with this many entries and if more are needed,
+    // we grow them dynamically during the transaction and then delete them when
+    // reset() is called on beginTx().
+    static const int64_t MAX_ENTRIES = 16*1024;
+
+    ReadSetEntry  entries[MAX_ENTRIES];
+    uint64_t      size {0};          // Number of loads in the readSet for the current transaction
+    ReadSet*      next {nullptr};
+
+    inline void reset() {
+        if (next != nullptr) {
+            next->reset();   // Recursive call on the linked list of logs
+            delete next;
+            next = nullptr;
+        }
+        size = 0;
+    }
+
+    // Number of entries, including the ones in the next nodes
+    inline uint64_t count() const {
+        return size + ((next != nullptr) ? next->count() : 0);
+    }
+
+    // Discards all but the first 'n' entries. Used to roll back a nested transaction to its savepoint.
+    inline void truncate(uint64_t n) {
+        if (n <= size) {
+            size = n;
+            if (next != nullptr) {
+                next->reset();
+                delete next;
+                next = nullptr;
+            }
+        } else {
+            next->truncate(n - size);   // Recursive call to truncate()
+        }
+    }
+
+    inline bool validate(uint64_t rClock, uint64_t tid) {
+        for (uint64_t i = 0; i < size; i++) {
+            for (std::atomic<uint64_t>* mutex = entries[i].mBeg; mutex <= entries[i].mEnd; mutex++) {
+                uint64_t sl = mutex->load(std::memory_order_acquire);
+                if (!isUnlockedOrLockedByMe(rClock, tid, sl)) {
+                    TRACE_CONFLICT(tid, mutex, CONFLICT_ON_VALIDATE, nullptr, sl);
+                    return false;
+                }
+            }
+        }
+        if (next != nullptr) return next->validate(rClock, tid); // Recursive call to validate()
+        return true;
+    }
+
+    inline void add(std::atomic<uint64_t>* mBeg, std::atomic<uint64_t>* mEnd) {
+        if (size != MAX_ENTRIES) {
+            entries[size].mBeg = mBeg;
+            entries[size].mEnd = mEnd;
+            size++;
+        } else {
+            // The current node is full, therefore, search a vacant node or create a new one
+            if (next == nullptr) next = new ReadSet();
+            next->add(mBeg, mEnd);    // Recursive call to add()
+        }
+    }
+};
+
+// Size of an Optane block in 64bit words. Used to prevent "false sharing".
+#define PM_PAD  (256/sizeof(uint64_t))
+
+// The persistent metadata is a 'header'.
+struct PMetadata {
+    // Changes with the persistent layout, so that pools in another layout are not used. Bumped when
+    // EsLoco2 moved to quarter-power-of-two size classes.
+    static const uint64_t   MAGIC_ID = 0x1337bac4;
+    void*                   root {nullptr}; // Immutable once assigned
+    uint64_t                id {0};
+    uint64_t                padding[8-2];
+    // Each thread has its own p_seq
+    volatile uint64_t       p_seq[REGISTRY_MAX_THREADS*PM_PAD];
+
+    PMetadata() {
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+        	p_seq[it*PM_PAD] = 1;
+        	PWB(&p_seq[it*PM_PAD]);
+        }
+    }
+};
+
+// Maximum size of presistent memory region without metadata
+static uint64_t PM_SIZE = (PM_REGION_SIZE-sizeof(PMetadata));
+// Maximum size of volatile memory region (VR)
+static uint64_t VR_SIZE = (PM_SIZE)*24ULL/64;
+// End address of the range reserved for the volatile memory region (VR)
+static uint8_t* VREGION_END = VREGION_ADDR+VR_SIZE;
+// start of PM without metadata
+static uint8_t* PM_REGION_START = ((uint8_t*)PM_REGION_BEGIN+sizeof(PMetadata));
+// Get the address of the PMCacheLine in PM
+#define VR_2_PCL(_addr)  ((((size_t)_addr - (size_t)VREGION_ADDR)/24)*64 + (size_t)PM_REGION_START)
+// Convert an address of a volatile byte into a PM byte of 'main'.
+#define VR_2_PM(_addr)   ((((size_t)_addr - (size_t)VREGION_ADDR)/24)*64 + ( ((size_t)_addr-(size_t)VREGION_ADDR)%24 ) + (size_t)PM_REGION_START)
+// Convert from a generic PM address to a VR address
+#define PM_2_VR(_addr)   ((((size_t)_addr - (size_t)PM_REGION_START)/64)*24 + ( ((size_t)_addr-(size_t)PM_REGION_START)%64 ) + (size_t)VREGION_ADDR)
+// Convert an address of a volatile byte into a PM byte of 'main'.
+#define PCL_2_VCL(_addrpcl)   (((((size_t)_addrpcl)-(size_t)PM_REGION_START)/64)*24 + (size_t)VREGION_ADDR)
+
+
+// Address of Persistent Metadata.
+// This relies on PMetadata being the first thing in the persistent region.
+static PMetadata* const pmd = (PMetadata*)PM_REGION_BEGIN;
+
+// Helper function to save a range of modifications.
+inline void storeRange(void* vraddr, uint64_t size, tseq_t p_tseq) {
+    PMCacheLine* pclBeg = (PMCacheLine*)VR_2_PCL(vraddr);
+    PMCacheLine* pclEnd = (PMCacheLine*)VR_2_PCL(((uint8_t*)vraddr) + size-1);
+    // If (T) is large, it may be stored across multiple PMCacheLines
+    for (PMCacheLine* pcl = pclBeg; pcl <= pclEnd; pcl++) {
+        if (pcl->tseq == p_tseq) continue;
+        // Copy main to back for each pcl
+        pcl->back = pcl->main;                         // Ordered store
+        asm volatile ("" : : : "memory");
+        pcl->tseq = p_tseq;                            // Ordered store
+        asm volatile ("" : : : "memory");
+        // Copy VR to main (all 24 bytes)
+        pcl->main = *(UData*)PM_2_VR(&pcl->main);      // Ordered store
+        // We know we're only going to touch each pcl one time, therefore, flush it as we go
+        PWB(pcl);
+    }
+}
+
+// We put the array of locks outside the PTM because we want to access it from stand-alone static methods
+extern std::atomic<uint64_t> *gHashLock;
+
+#ifdef PTM_CONFLICT_TRACE
+// Prints the locks with the most sampled conflicts. This is approximate if there are ongoing transactions.
+inline void ConflictTracer::report(std::atomic<uint64_t>* hashLock) {
+    struct LockStats {
+        uint64_t lockIdx;
+        uint64_t total {0};
+        uint64_t causes[3] {};
+        uint64_t held {0};                 // Number of conflicts where the lock was taken (the others had a newer version)
+        uint8_t* minAddr {nullptr};        // Lowest and highest VR addresses sampled on this lock
+        uint8_t* maxAddr {nullptr};
+    };
+    std::unordered_map<uint64_t,LockStats> locks;
+    uint64_t numConflicts = 0, numSamples = 0;
+    for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+        ThreadSamples* ts = perThread[it].load(std::memory_order_acquire);
+        if (ts == nullptr) continue;
+        numConflicts += ts->numConflicts;
+        const uint64_t n = ts->numSamples < MAX_SAMPLES ? ts->numSamples : MAX_SAMPLES;
+        numSamples += n;
+        for (uint64_t i = 0; i < n; i++) {
+            const Sample& smp = ts->samples[i];
+            const uint64_t idx = smp.mutex - hashLock;
+            LockStats& ls = locks[idx];
+            ls.lockIdx = idx;
+            ls.total++;
+            ls.causes[smp.cause]++;
+            if (isLocked(smp.sl)) ls.held++;
+            uint8_t* addr = (uint8_t*)smp.vraddr;
+            if (addr == nullptr) continue;
+            if (ls.minAddr == nullptr || addr < ls.minAddr) ls.minAddr = addr;
+            if (addr > ls.maxAddr) ls.maxAddr = addr;
+        }
+    }
+    if (numConflicts == 0) return;
+    std::vector<LockStats> top;
+    for (auto& kv : locks) top.push_back(kv.second);
+    std::sort(top.begin(), top.end(), [] (const LockStats& a, const LockStats& b) { return a.total > b.total; });
+    if (top.size() > CONFLICT_TRACE_TOPN) top.resize(CONFLICT_TRACE_TOPN);
+    printf("Conflict trace: %ld conflicts, %ld samples (1 in %d) on %ld distinct locks\n",
+            numConflicts, numSamples, CONFLICT_TRACE_PERIOD, (uint64_t)locks.size());
+    printf("  %-8s %8s %8s %8s %8s %8s  %-31s  %s\n", "lock", "samples", "onLock", "onCheck", "onValid", "held", "sampled VR addresses", "VR ranges protected by the lock");
+    for (const LockStats& ls : top) {
+        printf("  %-8ld %8ld %8ld %8ld %8ld %8ld  ", ls.lockIdx, ls.total, ls.causes[CONFLICT_ON_LOCK], ls.causes[CONFLICT_ON_CHECK],
+                ls.causes[CONFLICT_ON_VALIDATE], ls.held);
+        if (ls.minAddr != nullptr) printf("%14p-%-16p ", ls.minAddr, ls.maxAddr);
+        else printf("%-31s  ", "-");
+        // The lock protects each 256 bytes of PM whose (address/256) matches the lock index, see hidx().
+        // Convert each of those PM ranges into the range of VR addresses that maps to it.
+        const size_t pmBeg = (size_t)PM_REGION_START;
+        const size_t pmEnd = pmBeg + PM_SIZE;
+        uint64_t q = ((pmBeg/256) & ~(NUM_LOCKS-1)) | ls.lockIdx;
+        for (; q*256 < pmEnd; q += NUM_LOCKS) {
+            const size_t lo = (q*256 < pmBeg) ? pmBeg : q*256;
+            const size_t hi = (q*256+256 > pmEnd) ? pmEnd : q*256+256;
+            if (lo >= hi) continue;
+            const size_t clBeg = (lo - pmBeg + 63)/64;
+            const size_t clEnd = (hi - pmBeg + 63)/64;
+            if (clBeg < clEnd) printf("[%p,%p) ", VREGION_ADDR + clBeg*24, VREGION_ADDR + clEnd*24);
+        }
+        printf("\n");
+    }
+}
+#endif
+
+
+// Volatile log (write-set)
+struct AppendLog {
+    // We pre-allocate a write-set with this many entries and if more are needed,
+    // we grow them dynamically during the transaction and then delete them when
+    // reset() is called on beginTx().
+    static const int64_t MAX_ENTRIES = 8*1024;
+
+    struct LogEntry {
+        void*     vraddr;
+        uint32_t  length;
+    };
+
+    int64_t       size {0};
+    LogEntry      entries[MAX_ENTRIES];
+    AppendLog*    next {nullptr};
+
+    inline void reset() {
+        if (next != nullptr) {
+            next->reset();   // Recursive call on the linked list of logs
+            delete next;
+            next = nullptr;
+        }
+        size = 0;
+    }
+
+    // Adds VR ranges to the log
+    inline void add(void* vraddr, uint32_t length) {
+        if (size != MAX_ENTRIES) {
+            entries[size].vraddr = vraddr;
+            entries[size].length = length;
+            size++;
+        } else {
+            // The current node is full, therefore, search a vacant node or create a new one
+            if (next == nullptr) next = new AppendLog();
+            next->add(vraddr, length); // recursive call to add()
+        }
+    }
+
+    // Removes the last entry. Used when the lock acquisition for that range fails without locking anything.
+    inline void pop() {
+        if (next != nullptr && next->size != 0) next->pop();   // Recursive call to pop()
+        else size--;
+    }
+
+    // Copies a single range from PM to VR, breaking up into PMCacheLines
+    inline void copyRange(void* vraddr, uint32_t length) {
+        PMCacheLine* pclBeg = (PMCacheLine*)VR_2_PCL(vraddr);
+        PMCacheLine* pclEnd = (PMCacheLine*)VR_2_PCL(((uint8_t*)vraddr) + length-1);
+        // If (T) is large, it may be stored across multiple PMCacheLines
+        for (PMCacheLine* pcl = pclBeg; pcl <= pclEnd; pcl++) {
+            // The whole pcl is protected by the lock, so let's copy the whole thing,
+            // regardless of how many words/bytes in the pcl need to be reverted.
+            *(UData*)PM_2_VR(&pcl->main) = pcl->main;
+        }
+    }
+
+    // Helper function for rollbackVR()
+    inline bool rangeIsLockedByMe(void* vraddr, uint32_t length, uint64_t tid) {
+        std::atomic<uint64_t>* mBeg  = &gHashLock[hidx(VR_2_PCL(vraddr))];
+        std::atomic<uint64_t>* mEnd  = &gHashLock[hidx(VR_2_PCL(((uint8_t*)vraddr) + length-1))];
+        for (std::atomic<uint64_t>* mutex = mBeg; mutex <= mEnd; mutex++) {
+            uint64_t sl = mutex->load(std::memory_order_acquire);
+            if (sl != (LOCKED | tid)) return false;
+        }
+        return true;
+    }
+
+    // Returns true if all the locks of the last range are held by this thread, which is not the
+    // case when the lock acquisition for that range failed half-way through the range.
+    bool lastIsLockedByMe(uint64_t tid) {
+        if (next != nullptr && next->size != 0) return next->lastIsLockedByMe(tid);  // Recursive call
+        if (size == 0) return true;
+        return rangeIsLockedByMe(entries[size-1].vraddr, entries[size-1].length, tid);
+    }
+
+    // Rollback modifications on VR: called from abortTx() to revert changes.
+    void rollbackVR(uint64_t tid) {
+        if (size == 0) return;
+        if (next == nullptr) {
+            for (int64_t i = 0; i < size-1; i++) {
+                copyRange(entries[i].vraddr, entries[i].length);
+            }
+            // The last entry in the log is special: we don't revert it unless
+            // we have all the locks protecting it. The reason being that maybe the
+            // abort was triggered due to failed lock acquisition and therefore,
+            // reverting it would be incorrect (is already locked by another tx).
+            if (rangeIsLockedByMe(entries[size-1].vraddr, entries[size-1].length, tid)) {
+                copyRange(entries[size-1].vraddr, entries[size-1].length);
+            }
+        }
+        if (next != nullptr) {
+            for (int64_t i = 0; i < size; i++) {
+                copyRange(entries[i].vraddr, entries[i].length);
+            }
+            next->rollbackVR(tid); // Recursive call to rollbackVR()
+        }
+    }
+
+    // Unlock all the locks acquired by this thread
+    inline void unlock(uint64_t nextClock, uint64_t tid) {
+        for (uint64_t i = 0; i < size; i++) {
+            void* vraddr = entries[i].vraddr;
+            int32_t length = entries[i].length;
+            // Handle ranges correctly
+            std::atomic<uint64_t>* mBeg  = &gHashLock[hidx(VR_2_PCL(vraddr))];
+            std::atomic<uint64_t>* mEnd  = &gHashLock[hidx(VR_2_PCL(((uint8_t*)vraddr) + length-1))];
+            for (std::atomic<uint64_t>* mutex = mBeg; mutex <= mEnd; mutex++) {
+                if (mutex->load(std::memory_order_relaxed) == (LOCKED | tid)) {
+                    mutex->store(nextClock, std::memory_order_release);
+                }
+            }
+        }
+        if (next != nullptr) next->unlock(nextClock, tid);  // Recursive cal to unlock()
+    }
+
+    // We know we're only going to touch each pcl one time, therefore, flush it as we go
+    inline void persistAndFlush(tseq_t p_tseq) {
+        for (int64_t i = size-1; i >= 0; i--) {
+            storeRange(entries[i].vraddr, entries[i].length, p_tseq);
+        }
+        if (next != nullptr) next->persistAndFlush(p_tseq);  // Recursive call to persistAndFlush()
+    }
+};
+
+
+// Volatile undo log with the contents of the ranges before they were modified by a nested transaction.
+// A nested transaction can not be rolled back from PM like the whole transaction is, because 'main' in PM
+// has the contents from before the enclosing transaction, which may have modified the same ranges.
+struct UndoLog {
+    struct Entry {
+        void*     vraddr;
+        uint32_t  length;
+        uint32_t  offset;   // Of the old contents in 'data'
+    };
+
+    // We pre-allocate an undo log with this many entries and bytes of old contents and if more are needed,
+    // we grow it dynamically during the transaction and then delete the extra nodes when reset() is called
+    // on beginTx(). Ranges larger than MAX_DATA are split.
+    static const int64_t  MAX_ENTRIES = 1024;
+    static const uint32_t MAX_DATA = 32*1024;
+
+    int64_t       size {0};          // Number of entries in this node
+    uint32_t      used {0};          // Bytes of 'data' in use in this node
+    Entry         entries[MAX_ENTRIES];
+    uint8_t       data[MAX_DATA];
+    UndoLog*      next {nullptr};
+
+    inline void reset() {
+        if (next != nullptr) {
+            next->reset();   // Recursive call on the linked list of logs
+            delete next;
+            next = nullptr;
+        }
+        size = 0;
+        used = 0;
+    }
+
+    // Number of entries, including the ones in the next nodes
+    inline uint64_t count() const {
+        return size + ((next != nullptr) ? next->count() : 0);
+    }
+
+    // Keeps the current contents of a VR range, before it is modified
+    inline void add(void* vraddr, uint32_t length) {
+        while (length > MAX_DATA) {
+            add(vraddr, MAX_DATA);
+            vraddr = (uint8_t*)vraddr + MAX_DATA;
+            length -= MAX_DATA;
+        }
+        if (next == nullptr && size != MAX_ENTRIES && length <= MAX_DATA - used) {
+            entries[size] = {vraddr, length, used};
+            std::memcpy(&data[used], vraddr, length);
+            used += length;
+            size++;
+        } else {
+            // The current node is full, therefore, search a vacant node or create a new one
+            if (next == nullptr) next = new UndoLog();
+            next->add(vraddr, length); // recursive call to add()
+        }
+    }
+
+    // Puts back the contents of the ranges logged after the first 'n' entries, from the last to the first,
+    // and discards them
+    inline void rollback(uint64_t n) {
+        if (next != nullptr) {
+            next->rollback(n > (uint64_t)size ? n - size : 0);   // Recursive call, the later entries go first
+            if (n <= (uint64_t)size) {
+                delete next;
+                next = nullptr;
+            }
+        }
+        if (n >= (uint64_t)size) return;
+        for (int64_t i = size-1; i >= (int64_t)n; i--) {
+            std::memcpy(entries[i].vraddr, &data[entries[i].offset], entries[i].length);
+        }
+        used = entries[n].offset;
+        size = n;
+    }
+};
+
+// A nested update transaction, with the sizes of the logs when it started (see Trinity::nestedTransaction())
+struct Savepoint {
+    std::jmp_buf env;
+    uint64_t     readSetSize;
+    uint64_t     undoLogSize;
+    uint64_t     attempt {0};
+    Savepoint*   prev;                 // Savepoint of the enclosing nested transaction, or nullptr
+};
+
+// Thread-local data
+struct OpData {
+    std::jmp_buf env;
+    Savepoint*   savepoint {nullptr};  // Innermost nested transaction, or nullptr if not in a nested transaction
+    Savepoint    savepoints[MAX_NESTED_DEPTH]; // Of the nested transactions in progress, from the outermost
+    uint64_t     attempt {0};
+    uint64_t     tid;
+    uint64_t     rClock {0};
+    tseq_t       p_tseq {0};
+    int          tx_type {TX_IS_NONE}; // This is used by persist::load() to figure out if it needs to save a load on the read-set or not
+    ReadSet      readSet;              // The (volatile) read set
+    AppendLog    writeSet {};          // Write-set: The append-only log of modified persist<T>
+    UndoLog      undoLog {};           // Old contents of the ranges modified in nested transactions
+    uint64_t     myrand;
+    uint64_t     padding[16];
+};
+
+extern std::atomic<uint64_t> gClock;
+
+extern void abortTx(OpData* myd);
+
+// This is used by addToLog() to know which OpData instance to use for the current transaction
+extern thread_local OpData* tl_opdata;
+
+// Helper function to lock an entire range. Used by pstore() and some of the string utils
+inline static void logLockRange(void* vraddr, int32_t length) {
+    OpData* const myd = tl_opdata;
+    // We must log _before_ locking because, in case of an abort half-way through
+    // the lock acquisitions on a range, we want to revert those acquisitions and
+    // for that, we need to have that range kept already in the log.
+    myd->writeSet.add(vraddr, length);
+    std::atomic<uint64_t>* mBeg  = &gHashLock[hidx(VR_2_PCL(vraddr))];
+    std::atomic<uint64_t>* mEnd  = &gHashLock[hidx(VR_2_PCL(((uint8_t*)vraddr) + length-1))];
+    for (std::atomic<uint64_t>* mutex = mBeg; mutex <= mEnd; mutex++) {
+        uint64_t sl = mutex->load(std::memory_order_acquire);
+        if (!isUnlockedOrLockedByMe(myd->rClock, myd->tid, sl)) {
+            TRACE_CONFLICT(myd->tid, mutex, CONFLICT_ON_LOCK, vraddr, sl);
+            if (mutex == mBeg) myd->writeSet.pop();   // Nothing was locked, no need to keep the range
+            abortTx(myd);
+        }
+        if (isUnlocked(sl) && !mutex->compare_exchange_strong(sl, LOCKED | myd->tid)) {
+            TRACE_CONFLICT(myd->tid, mutex, CONFLICT_ON_LOCK, vraddr, sl);
+            if (mutex == mBeg) myd->writeSet.pop();
+            abortTx(myd);
+        }
+    }
+    // Inside a nested transaction, keep the contents before they are modified, to roll back to the savepoint
+    if (myd->savepoint != nullptr) myd->undoLog.add(vraddr, length);
+}
+
+// Same as checkRange(), but handles a range and is not inlined (slow-path)
+static void checkRangeSlow(OpData* const myd, void* vraddr, std::atomic<uint64_t>* mBeg, std::atomic<uint64_t>* mEnd) {
+    // Handle wrap-around of lock ranges
+    if (mEnd < mBeg) {
+        if (myd->tx_type == TX_IS_UPDATE) myd->readSet.add(&gHashLock[0], mBeg);
+        for (std::atomic<uint64_t>* mutex = &gHashLock[0]; mutex <= mBeg; mutex++) {
+            uint64_t sl = mutex->load(std::memory_order_acquire);
+            if (!isUnlockedOrLockedByMe(myd->rClock, myd->tid, sl)) {
+                TRACE_CONFLICT(myd->tid, mutex, CONFLICT_ON_CHECK, vraddr, sl);
+                abortTx(myd);
+            }
+        }
+        mBeg = mEnd;
+        mEnd = &gHashLock[NUM_LOCKS-1];
+    }
+    // When in a write tx, loads must be added to the read-set
+    if (myd->tx_type == TX_IS_UPDATE) myd->readSet.add(mBeg, mEnd);
+    for (std::atomic<uint64_t>* mutex = mBeg; mutex <= mEnd; mutex++) {
+        uint64_t sl = mutex->load(std::memory_order_acquire);
+        if (!isUnlockedOrLockedByMe(myd->rClock, myd->tid, sl)) {
+            TRACE_CONFLICT(myd->tid, mutex, CONFLICT_ON_CHECK, vraddr, sl);
+            abortTx(myd);
+        }
+    }
+}
+
+// Helper function to check an entire (VR) range. Used by pload() and string utils
+// Make sure to issue a "asm volatile ("" : : : "memory")" before calling this.
+inline static void checkRange(OpData* const myd, void* vraddr, std::size_t length) {
+    if (myd == nullptr || vraddr < VREGION_ADDR || vraddr >= VREGION_END) return;
+    std::atomic<uint64_t>* mBeg  = &gHashLock[hidx(VR_2_PCL(vraddr))];
+    std::atomic<uint64_t>* mEnd  = &gHashLock[hidx(VR_2_PCL(((uint8_t*)vraddr) + length-1))];
+    if (mBeg == mEnd) {
+        // Fast path for single-lock checks
+        if (myd->tx_type == TX_IS_UPDATE) myd->readSet.add(mBeg, mEnd);
+        uint64_t sl = mBeg->load(std::memory_order_acquire);
+        if (!isUnlockedOrLockedByMe(myd->rClock, myd->tid, sl)) {
+            TRACE_CONFLICT(myd->tid, mBeg, CONFLICT_ON_CHECK, vraddr, sl);
+            abortTx(myd);
+        }
+    } else {
+        // Slow path for multi-lock checks
+        checkRangeSlow(myd, vraddr, mBeg, mEnd);
+    }
+}
+
+// T is typically a pointer to a node, but it can be integers or other stuff, as long as it fits in 64 bits
+template<typename T> struct persist {
+    T vrmain;
+
+    persist() { }
+
+    persist(T initVal) { pstore(initVal); }
+
+    // Casting operator
+    operator T() { return pload(); }
+    // Casting to const
+    operator T() const { return pload(); }
+
+    // Prefix increment operator: ++x
+    void operator++ () { pstore(pload()+1); }
+    // Prefix decrement operator: --x
+    void operator-- () { pstore(pload()-1); }
+    void operator++ (int) { pstore(pload()+1); }
+    void operator-- (int) { pstore(pload()-1); }
+    persist<T>& operator+= (const T& rhs) { pstore(pload() + rhs); return *this; }
+    persist<T>& operator-= (const T& rhs) { pstore(pload() - rhs); return *this; }
+
+    // Equals operator
+    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
+    bool operator == (const persist<Y> &rhs) { return pload() == rhs; }
+    // Difference operator: first downcast to T and then compare
+    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
+    bool operator != (const persist<Y> &rhs) { return pload() != rhs; }
+    // Relational operators
+    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
+    bool operator < (const persist<Y> &rhs) { return pload() < rhs; }
+    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
+    bool operator > (const persist<Y> &rhs) { return pload() > rhs; }
+    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
+    bool operator <= (const persist<Y> &rhs) { return pload() <= rhs; }
+    template <typename Y, typename = typename std::enable_if<std::is_convertible<Y, T>::value>::type>
+    bool operator >= (const persist<Y> &rhs) { return pload() >= rhs; }
+
+    // Operator arrow ->
+    T operator->() { return pload(); }
+
+    // Copy constructor
+    persist<T>(const persist<T>& other) { pstore(other.pload()); }
+
+    // Assignment operator from a persist<T>
+    persist<T>& operator=(const persist<T>& other) {
+        pstore(other.pload());
+        return *this;
+    }
+
+    // Assignment operator from a value
+    persist<T>& operator=(T value) {
+        pstore(value);
+        return *this;
+    }
+
+    // Operator &
+    T* operator&() {
+        return (T*)this;
+    }
+
+    // Store interposing: acquire the lock and write in 'main'
+    inline void pstore(T newVal) {
+        uint8_t* vraddr = (uint8_t*)&vrmain;
+        OpData* const myd = tl_opdata;
+        // We don't acquire locks for data outside PM (that woud make more overhead on the logging system)
+        if (myd != nullptr && vraddr >= VREGION_ADDR && vraddr < VREGION_END) {
+            PTM_STATS_STORE(sizeof(T));
+            // Logs stores and acquires locks, or aborts
+            logLockRange(vraddr, sizeof(T));
+        }
+        vrmain = newVal;
+    }
+
+    // This is similar to an undo-log load interposing: do a single post-check
+    inline T pload() const {
+        T lval = vrmain;
+        asm volatile ("" : : : "memory");
+        checkRange(tl_opdata, (void*)&vrmain, sizeof(T)); // Aborts if lock is inconsistent or taken
+        return lval;
+    }
+};
+
+
+class Trinity;
+extern Trinity gTrinity;
+
+
+class Trinity {
+private:
+    // Padding on x86 should be on 2 cache lines
+    static const int                       CLPAD = 128/sizeof(uintptr_t);
+    bool                                   reuseRegion {false};                 // used by the constructor and initialization
+    int                                    pfd {-1};
+    int                                    vfd {-1};
+    int                                    pmapFlags {0};                       // used to mmap() the file when growing the region
+    uint64_t                               regionSize {0};                      // currently mapped, up to PM_REGION_SIZE
+    std::mutex                             growMutex;
+    alignas(128) OpData                   *opDesc;
+    EsLoco2<persist>                       esloco {};
+
+public:
+    struct tmbase : public trinityvrtl2::tmbase { };
+
+    Trinity() {
+        assert(sizeof(PMCacheLine) == 64);
+    	assert(sizeof(PMetadata)%64 == 0);
+    	gHashLock = new std::atomic<uint64_t>[NUM_LOCKS];
+    	for (int i=0; i < NUM_LOCKS; i++) gHashLock[i].store(0, std::memory_order_relaxed);
+        opDesc = new OpData[REGISTRY_MAX_THREADS];
+        for (uint64_t it=0; it < REGISTRY_MAX_THREADS; it++) {
+            opDesc[it].tid = it;
+            opDesc[it].myrand = (it+1)*12345678901234567ULL;
+            opDesc[it].p_tseq = composeTseq(it, 1);  // This better match 'pmd->p_seq[it*PM_PAD]'
+        }
+        mapPersistentRegion(PM_FILE_NAME, (uint8_t*)PM_REGION_BEGIN, PM_REGION_SIZE);
+        // The size of the volatile region is 24/64 the size of the PM region, and so are the currently mapped parts
+        mapVolatileRegion(VFILE_NAME, VREGION_ADDR, VR_SIZE);
+    }
+
+    ~Trinity() {
+#ifdef PTM_CONFLICT_TRACE
+        gConflictTracer.report(gHashLock);
+#endif
+        delete[] opDesc;
+        delete[] gHashLock;
+    }
+
+    static std::string className() { return "TrinityVR-TL2"; }
+
+    void mapPersistentRegion(const char* filename, uint8_t* regionAddr, const uint64_t maxRegionSize) {
+        regionSize = roundToPage(PM_REGION_INITIAL_SIZE < maxRegionSize ? PM_REGION_INITIAL_SIZE : maxRegionSize);
+        // Check that the header with the logs leaves at least half the memory available to the user
+        if (sizeof(PMetadata) > regionSize/2) {
+            printf("ERROR: the size of the header in persistent memory is so large that it takes more than half the whole persistent memory\n");
+            printf("Please reduce some of the settings in TrinityVRTL2.hpp and try again\n");
+            assert(false);
+        }
+        // Check if the file already exists or not
+        struct stat buf;
+        if (stat(filename, &buf) == 0) {
+            // File exists, and it may have grown in a previous run
+            pfd = open(filename, O_RDWR|O_CREAT, 0755);
+            if (pfd < 0) {
+                perror("open() error");
+                assert(pfd >= 0);
+            }
+            reuseRegion = true;
+            if ((uint64_t)buf.st_size > regionSize) regionSize = roundToPage(buf.st_size);
+            if (regionSize > roundToPage(maxRegionSize)) {
+                printf("ERROR: file %s has %ld bytes, which is more than PM_REGION_SIZE\n", filename, (long)buf.st_size);
+                assert(false);
+            }
+        } else {
+            // File doesn't exist
+            pfd = open(filename, O_RDWR|O_CREAT, 0755);
+            if (pfd < 0) {
+                perror("open() error");
+                assert(pfd >= 0);
+            }
+        }
+        // Reserve the addresses for the largest the region can grow, so that it can grow in place.
+        // We may fail because the address is not available. Retry at most 4 times, then give up.
+        reserveRegion(regionAddr, maxRegionSize);
+        // Map the file over the start of the reserved range. Try one time to mmap() with DAX and if it fails, retry without DAX.
+        if (fallocate(pfd, 0, 0, regionSize) != 0) {
+            perror("fallocate() error");
+            assert(false);
+        }
+        pmapFlags = MAP_SHARED_VALIDATE | MAP_SYNC | MAP_FIXED;
+        void* got_addr = mmap(regionAddr, regionSize, (PROT_READ | PROT_WRITE), pmapFlags, pfd, 0);
+        if (got_addr == MAP_FAILED) {
+            // Failed to mmap(). Let's try without DAX.
+            pmapFlags = MAP_SHARED_VALIDATE | MAP_FIXED;
+            got_addr = mmap(regionAddr, regionSize, (PROT_READ | PROT_WRITE), pmapFlags, pfd, 0);
+            if (got_addr != MAP_FAILED) printf("WARNING: running without DAX enabled\n");
+        }
+        if (got_addr == MAP_FAILED) {
+            perror("ERROR: mmap() returned MAP_FAILED !!! ");
+            assert(false);
+        }
+        // A pool whose creation did not complete has no id yet and is cleared. One with the id of another
+        // layout (from an older version of this PTM) can not be used, because the allocator would corrupt it.
+        if (reuseRegion && pmd->id != PMetadata::MAGIC_ID) {
+            if (pmd->id != 0) {
+                fprintf(stderr, "ERROR: file %s has a pool in a different format. Delete the file to create a new pool\n", filename);
+                std::abort();
+            }
+            reuseRegion = false;
+        }
+    }
+
+    // Maps the volatile memory region
+    void mapVolatileRegion(const char* filename, uint8_t* regionAddr, const uint64_t maxRegionSize) {
+        vfd = open(filename, O_RDWR|O_CREAT, 0755);
+        if (vfd < 0) {
+            perror("open() error");
+            assert(vfd >= 0);
+        }
+        // The VR is rebuilt from PM on startup, so we drop whatever the file had, which also makes sure
+        // that it is zero when it grows, like the PM. Then reserve the addresses and map as much as we need.
+        if (ftruncate(vfd, 0) != 0) perror("ftruncate() error");
+        reserveRegion(regionAddr, maxRegionSize);
+        if (!growMapping(vfd, regionAddr, 0, roundToPage(vrSize()), MAP_SHARED | MAP_FIXED)) assert(false);
+        // If the file has just been created or if the header is not consistent, clear everything.
+        // Otherwise, re-use and recover to a consistent state.
+        if (reuseRegion) {
+            recover();
+            // Copy all contents of PM's 'main's to VR, making them continuous
+            for (uint64_t cl = 0; cl < (regionSize-sizeof(PMetadata))/64; cl++) {
+                std::memcpy(VREGION_ADDR+(cl*24), (uint8_t*)PM_REGION_START+(cl*64), 24);
+            }
+            readTx([&] () {
+                esloco.init(regionAddr, vrSize(), false, maxRegionSize, [this] (uint8_t* end) { return growRegion(end); });
+            });
+        } else {
+            // Call PMedata constructor
+            new (pmd) PMetadata();
+            // We reset the entire memory region because the 'seq' have to be zero.
+            // This operation can be be super SLOOWWW on a large PM region.
+            // Think of this memset() as "formatting' the PM.
+            std::memset(PM_REGION_START, 0, regionSize-sizeof(PMetadata));
+            // Reset VR
+            std::memset(regionAddr, 0, vrSize());
+            updateTx([&] () {
+                // Initialize the allocator and allocate an array for the root pointers
+                esloco.init(regionAddr, vrSize(), true, maxRegionSize, [this] (uint8_t* end) { return growRegion(end); });
+                pmd->root = esloco.malloc(sizeof(persist<void*>)*MAX_ROOT_POINTERS);
+            });
+            PWB(&pmd->root);
+            PFENCE();
+            pmd->id = PMetadata::MAGIC_ID;
+            PWB(&pmd->id);
+            PFENCE();
+            // From this point on, a crash will trigger the "reuseRegion" code path
+        }
+        // The initialization of the pool is not part of the workload
+        PTM_STATS_RESET();
+    }
+
+    // Size of the part of the VR that matches the mapped part of the PM region
+    inline uint64_t vrSize() { return (regionSize-sizeof(PMetadata))*24ULL/64; }
+
+    static uint64_t roundToPage(uint64_t size) {
+        const uint64_t pageSize = sysconf(_SC_PAGESIZE);
+        return (size + pageSize - 1)/pageSize*pageSize;
+    }
+
+    // Reserves the address range without any memory behind it, so that the files can later be mapped there
+    static void reserveRegion(uint8_t* regionAddr, const uint64_t regionSize) {
+        void* got_addr = NULL;
+        for (int i = 0; i < 4; i++) {
+            got_addr = mmap(regionAddr, regionSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (got_addr == regionAddr || got_addr == MAP_FAILED) break;
+            // mmap() worked but in wrong address. Let's unmap() and try again.
+            munmap(got_addr, regionSize);
+            // Sleep for a second before retrying the mmap()
+            usleep(1000);
+        }
+        if (got_addr == MAP_FAILED) {
+            perror("ERROR: mmap() returned MAP_FAILED !!! ");
+            assert(false);
+        }
+        if (got_addr != regionAddr) {
+            printf("got_addr = %p instead of %p\n", got_addr, regionAddr);
+            perror("Retry mmap() in a couple of seconds");
+            std::exit(42);
+        }
+    }
+
+    // Extends the file from 'oldSize' to 'newSize' bytes and maps the new part at the same offset from 'regionAddr'.
+    // fallocate() fills the new part with zeros, which is the same as a formatted region, and fdatasync() makes
+    // the new size durable before any transaction stores there.
+    static bool growMapping(int fd, uint8_t* regionAddr, uint64_t oldSize, uint64_t newSize, int flags) {
+        if (newSize <= oldSize) return true;
+        if (fallocate(fd, 0, oldSize, newSize-oldSize) != 0 || fdatasync(fd) != 0) {
+            perror("ERROR: fallocate() failed to grow the file");
+            return false;
+        }
+        if (mmap(regionAddr+oldSize, newSize-oldSize, (PROT_READ | PROT_WRITE), flags, fd, oldSize) == MAP_FAILED) {
+            perror("ERROR: mmap() returned MAP_FAILED !!! ");
+            return false;
+        }
+        return true;
+    }
+
+    // Called by the allocator when it reaches the end of the VR, possibly from within a transaction.
+    // Grows the PM region in steps of PM_REGION_GROW_SIZE, and the VR along with it, until the VR goes at
+    // least up to 'vrEnd'. Returns the new end of the VR, which is left as it was if the region can not grow.
+    uint8_t* growRegion(uint8_t* vrEnd) {
+        std::lock_guard<std::mutex> lock(growMutex);
+        // Each 24 bytes of VR take one cache line of PM
+        const uint64_t needed = sizeof(PMetadata) + ((vrEnd - VREGION_ADDR) + 23)/24*64;
+        if (needed > regionSize) {
+            const uint64_t growSize = PM_REGION_GROW_SIZE;
+            uint64_t newSize = (needed + growSize - 1)/growSize*growSize;
+            newSize = roundToPage(newSize < PM_REGION_SIZE ? newSize : PM_REGION_SIZE);
+            const uint64_t oldVRSize = roundToPage(vrSize());
+            if (growMapping(pfd, (uint8_t*)PM_REGION_BEGIN, regionSize, newSize, pmapFlags)) {
+                const uint64_t oldSize = regionSize;
+                regionSize = newSize;
+                if (!growMapping(vfd, VREGION_ADDR, oldVRSize, roundToPage(vrSize()), MAP_SHARED | MAP_FIXED)) regionSize = oldSize;
+            }
+        }
+        return VREGION_ADDR + vrSize();
+    }
+
+    inline void beginTx(OpData* myd, const int tid) {
+        // Clear the logs of the previous transaction
+        myd->writeSet.reset();
+        myd->readSet.reset();
+        myd->undoLog.reset();
+        myd->rClock = gClock.load(); // This is GVRead()
+        myd->p_tseq = composeTseq(tid, pmd->p_seq[tid*PM_PAD]); // Shortcut to p_seq (used in pstore())
+    }
+
+    // This PTM does eager locking, which means that by now all locks have been acquired.
+    inline bool endTx(OpData* myd, const int tid) {
+        // Check if this is a read-only transaction and if so, commit immediately
+        if (myd->writeSet.size == 0) {
+            myd->attempt = 0;
+            return true;
+        }
+        // This fence is needed by undo log to prevent re-ordering with the last store
+        // and the reading of the gClock.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // Validate the read-set
+        if (!myd->readSet.validate(myd->rClock, tid)) abortTx(myd);
+        // Tx is now committed and holding all the locks. Start the durable commit
+        myd->writeSet.persistAndFlush(myd->p_tseq);
+        // The FAA is 'hijacked' to act as a persistence fence
+        uint64_t nextClock = gClock.fetch_add(1)+1;
+        // Modifications in persist<T> must be flushed before advancing p_seq
+        pmd->p_seq[tid*PM_PAD] = pmd->p_seq[tid*PM_PAD] + 1;
+        PWB(&pmd->p_seq[tid*PM_PAD]);
+        PSYNC();
+        // Unlock and set new sequence on the locks
+        myd->writeSet.unlock(nextClock, tid);
+        PTM_STATS_WRITE_SET(myd->writeSet.size);
+        PTM_STATS_TX_END();
+        myd->attempt = 0;
+        return true;
+    }
+
+    template<typename F> void transaction(F&& func, int txType=TX_IS_UPDATE) {
+        if (tl_opdata != nullptr) {
+            if (txType == TX_IS_UPDATE && tl_opdata->tx_type == TX_IS_UPDATE) nestedTransaction(tl_opdata, func);
+            else func();
+            return ;
+        }
+        const int tid = ThreadRegistry::getTID();
+        OpData* myd = &opDesc[tid];
+        tl_opdata = myd;
+        myd->tx_type = txType;
+        PTM_STATS_TX_BEGIN();
+        setjmp(myd->env);
+        myd->attempt++;
+        backoff(myd, myd->attempt);
+        beginTx(myd, tid);
+        func();
+        endTx(myd, tid);
+        tl_opdata = nullptr;
+    }
+
+    // Closed nesting: an update transaction inside another one starts at a savepoint. On a conflict,
+    // abortTx() reverts the stores of the nested transaction with the undo log, drops its reads from the
+    // read-set and restarts only the nested transaction, on a snapshot extended to the current clock.
+    // The locks it acquired stay with the enclosing transaction. When it completes, its stores become part
+    // of the enclosing transaction. If the conflict can not be handled this way, or after MAX_NESTED_ATTEMPTS,
+    // the whole transaction restarts.
+    template<typename F> void nestedTransaction(OpData* myd, F&& func) {
+        // The savepoint is modified between the setjmp() and the longjmp() of abortTx(), therefore, it is
+        // kept in the OpData instead of in this stack frame. Beyond MAX_NESTED_DEPTH, a nested transaction
+        // is part of its enclosing one.
+        Savepoint* const sp = (myd->savepoint == nullptr) ? &myd->savepoints[0] : myd->savepoint + 1;
+        if (sp == &myd->savepoints[MAX_NESTED_DEPTH]) {
+            func();
+            return;
+        }
+        sp->readSetSize = myd->readSet.count();
+        sp->undoLogSize = myd->undoLog.count();
+        sp->attempt = 0;
+        sp->prev = myd->savepoint;
+        myd->savepoint = sp;
+        setjmp(sp->env);
+        backoff(myd, sp->attempt);
+        func();
+        myd->savepoint = sp->prev;
+    }
+
+    // It's silly that these have to be static, but we need them for the (SPS) benchmarks due to templatization
+    template<typename F> static void updateTx(F&& func) { gTrinity.transaction(func, TX_IS_UPDATE); }
+    template<typename F> static void readTx(F&& func) { gTrinity.transaction(func, TX_IS_READ); }
+    // There are no sequential durable transactions in TL2 but we "emulate it" with a concurrent+durable tx
+    template<typename F> static void updateTxSeq(F&& func) { gTrinity.transaction(func, TX_IS_UPDATE); }
+    template<typename F> static void readTxSeq(F&& func) { gTrinity.transaction(func, TX_IS_READ); }
+
+
+    // Scan the PM for any persist<> with a sequence equal to p_seq.
+    // If there are any, revert them by copying back to main and resetting
+    // the seq to zero.
+    //
+    // If p_seq == seq+1 then copy back to main
+    // If p_seq == seq   then copy main to back
+    void recover() {
+        // The persists start after PMetadata
+    	PMCacheLine* pstartvol = (PMCacheLine*)(VREGION_ADDR);
+    	PMCacheLine* pstart = (PMCacheLine*)(PM_REGION_START);
+    	PMCacheLine* pend = (PMCacheLine*)(PM_REGION_START + (regionSize-sizeof(PMetadata)));
+    	PMCacheLine* p; // iterator variable
+        for (p = pstart; p < pend; p++) {
+            const tseq_t tseq = p->tseq;
+        	const uint64_t tid = tseq2tid(tseq);
+            if (tseq2seq(tseq) == pmd->p_seq[tid*PM_PAD]) {
+                p->main = p->back;    // ordered stores
+            }
+            asm volatile("": : :"memory");
+            p->tseq = 0;              // ordered store
+            PWB(p);
+        }
+        PSYNC();
+    }
+
+    // Random number generator used by the backoff scheme
+    inline uint64_t marsagliaXORV(uint64_t x) {
+        if (x == 0) x = 1;
+        x ^= x << 6;
+        x ^= x >> 21;
+        x ^= x << 7;
+        return x;
+    }
+
+    // Backoff for a random amount of steps in the range [16, 16*attempt]. Inspired by TL2
+    inline void backoff(OpData* myopd, uint64_t attempt) {
+        if (attempt < 3) return;
+        if (attempt == 10000) printf("Ooops, looks like we're stuck attempt=%ld\n", attempt);
+        myopd->myrand = marsagliaXORV(myopd->myrand);
+        uint64_t stall = (myopd->myrand & attempt) + 1;
+        stall *= 16;
+        std::atomic<uint64_t> iter {0};
+        while (iter.load() < stall) iter.fetch_add(1);
+        if (stall > 1000) std::this_thread::yield();
+    }
+
+    // Transactions that return the value of func(), moved out to the caller after the commit
+    template<typename R,class F> inline static R readTx(F&& func) {
+        ptmtx::TxResult<R> res;
+        gTrinity.transaction([&]() {res.run(func);}, TX_IS_READ);
+        return res.take();
+    }
+    template<typename R,class F> inline static R updateTx(F&& func) {
+        ptmtx::TxResult<R> res;
+        gTrinity.transaction([&]() {res.run(func);}, TX_IS_UPDATE);
+        return res.take();
+    }
+
+    template <typename T, typename... Args> static T* tmNew(Args&&... args) {
+        if (tl_opdata == nullptr) {
+            printf("ERROR: Can not allocate outside a transaction\n");
+            return nullptr;
+        }
+        void* ptr = gTrinity.esloco.malloc(sizeof(T));
+        // If we get nullptr then we've ran out of PM space
+        assert(ptr != nullptr);
+        // If there is an abort during the 'new placement', the transactions rolls
+        // back and will automatically revert the changes in the allocator metadata.
+        new (ptr) T(std::forward<Args>(args)...);  // new placement
+        return (T*)ptr;
+    }
+
+    template<typename T> static void tmDelete(T* obj) {
+        if (obj == nullptr) return;
+        if (tl_opdata == nullptr) {
+            printf("ERROR: Can not de-allocate outside a transaction\n");
+            return;
+        }
+        obj->~T();
+        gTrinity.esloco.free(obj);
+    }
+
+    static void* tmMalloc(size_t size) {
+        if (tl_opdata == nullptr) {
+            printf("ERROR: Can not allocate outside a transaction\n");
+            return nullptr;
+        }
+        void* obj = gTrinity.esloco.malloc(size);
+        return obj;
+    }
+
+    static void tmFree(void* obj) {
+        if (obj == nullptr) return;
+        if (tl_opdata == nullptr) {
+            printf("ERROR: Can not de-allocate outside a transaction\n");
+            return;
+        }
+        gTrinity.esloco.free(obj);
+    }
+
+    static void* pmalloc(size_t size) {
+        if (tl_opdata == nullptr) {
+            printf("ERROR: Can not allocate outside a transaction\n");
+            return nullptr;
+        }
+        return gTrinity.esloco.malloc(size);
+    }
+
+    static void pfree(void* obj) {
+        if (obj == nullptr) return;
+        if (tl_opdata == nullptr) {
+            printf("ERROR: Can not de-allocate outside a transaction\n");
+            return;
+        }
+        gTrinity.esloco.free(obj);
+    }
+
+    static void* tmMemcpy(void* dst, const void* src, std::size_t count) {
+        void* result = nullptr;
+        OpData* const myd = tl_opdata;
+        if (myd != nullptr) {
+            logLockRange(dst, count);   // Aborts if 'dst' is already locked
+            result = std::memcpy(dst, src, count);
+            asm volatile ("" : : : "memory");
+            checkRange(myd, (void*)src, count);  // Aborts if 'src' is locked or was modified during tx
+        } else {
+            result = std::memcpy(dst, src, count);
+        }
+        return result;
+    }
+
+    // Number of bytes from 'addr' up to the end of its 24-byte chunk of the VR, all of them protected by
+    // the same lock, or 'count' if it's less than that or 'addr' is not in the VR
+    static inline std::size_t vrChunkLeft(const void* addr, std::size_t count) {
+        if (addr < VREGION_ADDR || addr >= VREGION_END) return count;
+        const std::size_t left = 24 - ((uint8_t*)addr - VREGION_ADDR) % 24;
+        return (left < count) ? left : count;
+    }
+
+    // memcmp() of a piece of up to 24 bytes, 8 bytes at a time. The first word that differs gives the
+    // result, after swapping its bytes so that comparing the words is the same as comparing the bytes.
+    static inline int memcmpChunk(const uint8_t* lhs, const uint8_t* rhs, std::size_t count) {
+        for (; count >= 8; lhs += 8, rhs += 8, count -= 8) {
+            uint64_t l, r;
+            std::memcpy(&l, lhs, 8);
+            std::memcpy(&r, rhs, 8);
+            if (l != r) return (__builtin_bswap64(l) < __builtin_bswap64(r)) ? -1 : 1;
+        }
+        for (; count != 0; lhs++, rhs++, count--) {
+            if (*lhs != *rhs) return (*lhs < *rhs) ? -1 : 1;
+        }
+        return 0;
+    }
+
+    // The comparisons are done one piece at a time, where a piece doesn't cross the end of a 24-byte chunk of
+    // the VR in either of the ranges, and the lock of each piece is checked right after comparing it.
+    // The result depends only on the bytes up to the first difference, therefore, the comparison stops at the
+    // piece with the first difference and the rest of the ranges is neither validated nor added to the read-set.
+    static int tmMemcmp(const void* lhs, const void* rhs, std::size_t count) {
+        OpData* const myd = tl_opdata;
+        if (myd == nullptr) return std::memcmp(lhs, rhs, count);
+        const uint8_t* l = (const uint8_t*)lhs;
+        const uint8_t* r = (const uint8_t*)rhs;
+        while (count != 0) {
+            const std::size_t len = vrChunkLeft(r, vrChunkLeft(l, count));
+            const int result = memcmpChunk(l, r, len);
+            asm volatile ("" : : : "memory");
+            checkRange(myd, (void*)l, len);
+            checkRange(myd, (void*)r, len);
+            if (result != 0) return result;
+            l += len;
+            r += len;
+            count -= len;
+        }
+        return 0;
+    }
+
+    // Same as tmMemcmp(), with strncmp(), which also stops at the end of the string
+    static int tmStrcmp(const char* lhs, const char* rhs, std::size_t count) {
+        OpData* const myd = tl_opdata;
+        if (myd == nullptr) return std::strncmp(lhs, rhs, count);
+        while (count != 0) {
+            const std::size_t len = vrChunkLeft(rhs, vrChunkLeft(lhs, count));
+            const int result = std::strncmp(lhs, rhs, len);
+            const bool ended = (result != 0 || std::memchr(lhs, 0, len) != nullptr);
+            asm volatile ("" : : : "memory");
+            checkRange(myd, (void*)lhs, len);
+            checkRange(myd, (void*)rhs, len);
+            if (ended) return result;
+            lhs += len;
+            rhs += len;
+            count -= len;
+        }
+        return 0;
+    }
+
+    static std::size_t tmStrlen(const char* str) {
+        const std::size_t len = std::strlen(str);
+        asm volatile ("" : : : "memory");
+        OpData* const myd = tl_opdata;
+        if (myd != nullptr) checkRange(myd, (void*)str, len+1);
+        return len;
+    }
+
+    // Call this after reading the range [addr, addr+count) in place, without pload(), for example with
+    // SIMD instructions. Aborts if the range was modified during the transaction or is locked.
+    static inline void tmCheckLoads(const void* addr, std::size_t count) {
+        asm volatile ("" : : : "memory");
+        OpData* const myd = tl_opdata;
+        if (myd != nullptr && count != 0) checkRange(myd, (void*)addr, count);
+    }
+
+    // A lock covers a group of 4 PMCacheLines (see hidx()), which is 256 bytes of PM, the size of an Optane
+    // block, and 96 bytes of the VR. Objects that start at a group and take whole groups share no lock.
+    static const std::size_t PCL_GROUP_SIZE = 4*24;
+
+    // Returns the offset of the VR address 'addr' in its group of PMCacheLines
+    static inline std::size_t pclGroupOffset(const void* addr) {
+        return ((VR_2_PCL(addr) % 256)/64)*24 + ((std::size_t)addr - (std::size_t)VREGION_ADDR) % 24;
+    }
+
+    static void* tmMemset(void* dst, int ch, std::size_t count) {
+        if (tl_opdata != nullptr) logLockRange(dst, count);   // Aborts if 'dst' is already locked
+        return std::memset(dst, ch, count);
+    }
+
+    // Get a root pointer
+    static inline void* get_object(int idx) {
+        return ((persist<void*>*)pmd->root)[idx].pload();
+    }
+
+    // Set a root pointer
+    static inline void put_object(int idx, void* obj) {
+        ((persist<void*>*)pmd->root)[idx].pstore(obj);
+    }
+
+    // Statistics of the persistent memory allocator
+    using AllocStats = EsLoco2<persist>::Stats;
+
+    // Fills 'stats' with a snapshot of the allocator, up to 'detail' (see AllocStats::Detail).
+    // Call this from within a transaction (a readTx is enough) to get a consistent snapshot.
+    static void getAllocStats(AllocStats& stats, AllocStats::Detail detail=AllocStats::kAll) {
+        gTrinity.esloco.getStats(stats, detail);
+    }
+
+    // Dumps the allocator statistics to stdout, in its own read-only transaction
+    static void printAllocStats() {
+        AllocStats stats;
+        readTx([&] () { getAllocStats(stats); });
+        printf("%s", stats.toString().c_str());
+    }
+
+    // Online compaction of the persistent memory pool (see the comment on EsLoco2::compactBegin()).
+    // The windows of the pool with less than 'maxLiveRatio' of their bytes in use are evacuated:
+    // 'relocator' must move to a new allocation (in its own small transactions) each live object
+    // for which mustRelocate() returns true. This can run while other threads execute transactions.
+    // Returns the number of bytes reclaimed, or zero if there is another compaction running.
+    static uint64_t compact(const std::function<void()>& relocator, double maxLiveRatio=0.5) {
+        auto& esloco = gTrinity.esloco;
+        if (!esloco.compactBegin()) return 0;
+        bool more = true;
+        for (uint64_t w = 0; more; w++) {
+            updateTx([&] () { more = esloco.compactScan(w); });
+        }
+        uint64_t reclaimed = 0;
+        if (esloco.compactSelect(maxLiveRatio) != 0) {
+            for (int it = 0; it <= REGISTRY_MAX_THREADS; it++) {
+                updateTx([&] () { esloco.compactDetach(it); });
+            }
+            relocator();
+            // From the last to the first window, so that contiguous windows at the end can go back to the top
+            for (uint64_t w = esloco.compactNumWindows(); w-- > 0; ) {
+                uint64_t bytes = 0;
+                updateTx([&] () { bytes = esloco.compactReclaim(w); });
+                reclaimed += bytes;
+            }
+            for (uint64_t w = 0; w < esloco.compactNumWindows(); w++) {
+                updateTx([&] () { esloco.compactRelist(w); });
+            }
+        }
+        esloco.compactEnd();
+        return reclaimed;
+    }
+
+    // Returns true if the object at 'ptr' must be relocated by the ongoing compaction
+    static inline bool mustRelocate(const void* ptr) {
+        return gTrinity.esloco.isEvacuating(ptr);
+    }
+};
+
+
+//
+// Wrapper methods to the global TM instance. The user should use these:
+//
+template<typename R, typename F> static R updateTx(F&& func) { return gTrinity.updateTx<R>(func); }
+template<typename R, typename F> static R readTx(F&& func) { return gTrinity.readTx<R>(func); }
+template<typename F> static void updateTx(F&& func) { gTrinity.transaction(func, TX_IS_UPDATE); }
+template<typename F> static void readTx(F&& func) { gTrinity.transaction(func, TX_IS_READ); }
+template<typename T, typename... Args> T* tmNew(Args&&... args) { return Trinity::tmNew<T>(args...); }
+template<typename T> void tmDelete(T* obj) { Trinity::tmDelete<T>(obj); }
+static void* tmMalloc(size_t size) { return Trinity::tmMalloc(size); }
+static void tmFree(void* obj) { Trinity::tmFree(obj); }
+
+
+#ifndef INCLUDED_FROM_MULTIPLE_CPP
+//
+// Place these in a .cpp if you include this header from multiple files (compilation units)
+//
+// Global/singleton to hold all the thread registry functionality
+ThreadRegistry gThreadRegistry {};
+// Array of locks
+std::atomic<uint64_t> *gHashLock {nullptr};
+#ifdef PTM_CONFLICT_TRACE
+// Samples of the conflicts on gHashLock. Must be constructed before gTrinity, which reports them in its destructor.
+ConflictTracer gConflictTracer {};
+#endif
+// Global clock for TL2
+alignas(128) std::atomic<uint64_t> gClockPaddingA {0};
+alignas(128) std::atomic<uint64_t> gClock {1};
+alignas(128) std::atomic<uint64_t> gClockPaddingB {0};
+// PTM singleton
+Trinity gTrinity {};
+// Thread-local data of the current ongoing transaction
+thread_local OpData* tl_opdata {nullptr};
+// This is where every thread stores the tid it has been assigned when it calls getTID() for the first time.
+// When the thread dies, the destructor of ThreadCheckInCheckOut will be called and de-register the thread.
+thread_local ThreadCheckInCheckOut tl_tcico {};
+// Helper function for thread de-registration
+void thread_registry_deregister_thread(const int tid) {
+    gThreadRegistry.deregister_thread(tid);
+}
+// Rolls back a nested transaction to its savepoint. Returns false if the whole transaction has to restart.
+static bool rollbackToSavepoint(OpData* myd, Savepoint* sp) {
+    // A lock acquisition that failed half-way through a range leaves locks that we can't give back
+    if (sp->attempt == MAX_NESTED_ATTEMPTS || !myd->writeSet.lastIsLockedByMe(myd->tid)) return false;
+    myd->undoLog.rollback(sp->undoLogSize);
+    myd->readSet.truncate(sp->readSetSize);
+    // The conflict may have been on a lock with a version newer than rClock. To see it on the retry,
+    // extend the snapshot to the current clock, which is only possible if the reads before the savepoint are still valid.
+    const uint64_t newClock = gClock.load();
+    if (!myd->readSet.validate(myd->rClock, myd->tid)) return false;
+    myd->rClock = newClock;
+    sp->attempt++;
+    return true;
+}
+
+// This is called from persist::load()/store() and endTx() if the read-set validation fails.
+[[noreturn]] void abortTx(OpData* myd) {
+    Savepoint* sp = myd->savepoint;
+    if (sp != nullptr && rollbackToSavepoint(myd, sp)) std::longjmp(sp->env, 1);
+    myd->savepoint = nullptr;
+    myd->writeSet.rollbackVR(myd->tid);
+    uint64_t nextClock = gClock.fetch_add(1)+1;
+    // Unlock with the new sequence
+    myd->writeSet.unlock(nextClock, myd->tid);
+    PTM_STATS_ABORT();
+    std::longjmp(myd->env, 1);
+}
+#endif // INCLUDED_FROM_MULTIPLE_CPP
+
+}
+